@@ -0,0 +1,42 @@
+/*
+* Filename:		benchCommon.h
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for helpers shared by the CHAT-SYSTEM benchmarks.
+*/
+
+#ifndef BENCHCOMMON_H_INCLUDED
+#define BENCHCOMMON_H_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../../common/inc/commonMessaging.h"
+
+#define BENCH_SUCCESS 0
+#define BENCH_ERROR -1
+
+// Timing
+int64_t benchNanoseconds();
+int64_t benchThreadCpuNanoseconds();
+
+// Loopback connections
+int benchLoopbackPair(int* senderSocket, int* receiverSocket);
+
+// Sample traffic
+size_t benchSampleBroadcast(char* json, size_t jsonLength, int sequence);
+
+// Arguments
+long benchArgument(int argc, char* argv[], const char* name, long defaultValue);
+
+#endif //BENCHCOMMON_H_INCLUDED
@@ -0,0 +1,149 @@
+/*
+* Filename:		benchCommon.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains helpers shared by the CHAT-SYSTEM benchmarks: clocks, loopback
+*               connections and broadcasts shaped like the server's.
+*/
+
+#include "../inc/benchCommon.h"
+
+
+/*
+* Function:     benchNanoseconds
+* Purpose:      Gets the monotonic clock in nanoseconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Nanoseconds since an arbitrary start point.
+*/
+int64_t benchNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*
+* Function:     benchThreadCpuNanoseconds
+* Purpose:      Gets the CPU time used by the calling thread, in nanoseconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         CPU nanoseconds used by this thread so far.
+*/
+int64_t benchThreadCpuNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (int64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+
+/*
+* Function:     benchLoopbackPair
+* Purpose:      Opens a TCP connection to itself over loopback, the way a client connects to the server.
+*
+* Inputs:       int*    senderSocket    Where to store the accepted (server) end.
+*               int*    receiverSocket  Where to store the connecting (client) end.
+*
+* Outputs:      senderSocket, receiverSocket
+*
+* Returns:      int                     BENCH_SUCCESS, or BENCH_ERROR.
+*/
+int benchLoopbackPair(int* senderSocket, int* receiverSocket)
+{
+    struct sockaddr_in address;
+    socklen_t addressLength = sizeof(address);
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0 || bind(listenSocket, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        listen(listenSocket, 1) < 0 || getsockname(listenSocket, (struct sockaddr*)&address, &addressLength) < 0)
+    {
+        perror("[BENCH] : loopback listen FAILED");
+        close(listenSocket);
+        return BENCH_ERROR;
+    }
+
+    *receiverSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (*receiverSocket < 0 || connect(*receiverSocket, (struct sockaddr*)&address, sizeof(address)) < 0 ||
+        (*senderSocket = accept(listenSocket, NULL, NULL)) < 0)
+    {
+        perror("[BENCH] : loopback connect FAILED");
+        close(*receiverSocket);
+        close(listenSocket);
+        return BENCH_ERROR;
+    }
+
+    close(listenSocket);
+    return BENCH_SUCCESS;
+}
+
+
+/*
+* Function:     benchSampleBroadcast
+* Purpose:      Serializes a broadcast of typical size, the way the server sends it.
+*
+* Inputs:       char*       json            Where to store the JSON.
+*               size_t      jsonLength      Size of json.
+*               int         sequence        Number put into the message, so messages differ.
+*
+* Outputs:      json
+*
+* Returns:      size_t                      Length of the JSON.
+*/
+size_t benchSampleBroadcast(char* json, size_t jsonLength, int sequence)
+{
+    Broadcast broadcast;
+    memset(&broadcast, 0, sizeof(broadcast));
+    strcpy(broadcast.clientIP, "192.168.100.101");
+    strcpy(broadcast.clientUserID, "bench");
+    snprintf(broadcast.message, sizeof(broadcast.message), "benchmark message number %d", sequence);
+
+    char* serialized = broadcastToJson(&broadcast);
+    if (serialized == NULL)
+    {
+        return 0;
+    }
+
+    snprintf(json, jsonLength, "%s", serialized);
+    free(serialized);
+
+    return strlen(json);
+}
+
+
+/*
+* Function:     benchArgument
+* Purpose:      Gets a numeric "-name value" command line argument.
+*
+* Inputs:       int         argc            Number of arguments.
+*               char*       argv[]          The arguments.
+*               const char* name            Argument name, with the dash.
+*               long        defaultValue    Value if the argument is not given.
+*
+* Outputs:      None
+*
+* Returns:      long                        The argument's value.
+*/
+long benchArgument(int argc, char* argv[], const char* name, long defaultValue)
+{
+    for (int i = 1; i < argc - 1; i++)
+    {
+        if (strcmp(argv[i], name) == 0)
+        {
+            return strtol(argv[i + 1], NULL, 10);
+        }
+    }
+
+    return defaultValue;
+}
@@ -0,0 +1,282 @@
+/*
+* Filename:		falseSharingBench.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains a benchmark of cache-line contention (false sharing) between server threads.
+*
+*               It runs the two access patterns the server's layout is arranged around, each with the
+*               state packed together and with it kept CACHE_LINE_LENGTH apart:
+*                   - counters      Every thread bumps a counter of its own, as the scheduler workers and
+*                                   coroutine loops do with their stats.
+*                   - shareddata    One thread bumps numClients (a client joining or leaving) while the
+*                                   others keep reading serverIsRunning and msgQueueID, in the server's
+*                                   SharedData and in its earlier layout, where all of them shared a line.
+*               Each thread is pinned to a CPU of its own where there are enough of them.
+*
+*               Reported per run: nanoseconds per operation (averaged over the threads) and the total
+*               operations per second. With fewer than two CPUs nothing can bounce between caches and
+*               both layouts run at the same speed.
+*
+*               To see the contended lines themselves, run one layout under perf c2c and compare the
+*               HITM counts it reports for the two:
+*                   perf c2c record -- bin/falseSharingBench -layout 1
+*                   perf c2c report --stdio
+*
+*               Usage: falseSharingBench [-threads N] [-operations N] [-layout 0 (both) | 1 (packed) | 2 (padded)]
+*/
+
+#define _GNU_SOURCE
+
+#include "../inc/benchCommon.h"
+#include "../../chat-server/inc/serverIPC.h"
+
+#include <sched.h>
+
+#define FALSE_SHARING_BENCH_THREADS 4
+#define FALSE_SHARING_BENCH_OPERATIONS 20000000
+#define FALSE_SHARING_BENCH_MAX_THREADS 64
+
+#define FALSE_SHARING_BENCH_BOTH 0
+#define FALSE_SHARING_BENCH_PACKED 1
+#define FALSE_SHARING_BENCH_PADDED 2
+
+#define FALSE_SHARING_BENCH_COUNTERS 0
+#define FALSE_SHARING_BENCH_SHARED_DATA 1
+
+// A counter alone on its cache line
+typedef struct
+{
+    uint64_t value;
+} __attribute__((aligned(CACHE_LINE_LENGTH))) PaddedCounter;
+
+// SharedData's first fields as they were laid out before they were split by how often they are written
+typedef struct
+{
+    int msgQueueID;
+    int serverSocket;
+    int numClients;
+    int serverIsRunning;
+    pthread_mutex_t deliveryMutex;
+} __attribute__((aligned(CACHE_LINE_LENGTH))) PackedSharedData;
+
+typedef struct
+{
+    int scenario;
+    int isPadded;
+    int index;                      // 0 is the writer in the shareddata scenario
+    long numOperations;
+    uint64_t* packedCounters;
+    PaddedCounter* paddedCounters;
+    PackedSharedData* packedSharedDataP;
+    SharedData* sharedDataP;
+    pthread_barrier_t* startBarrier;
+    int64_t elapsed;
+    uint64_t checksum;              // What the readers read - stored so the loads have a use
+} FalseSharingBenchThread;
+
+static const char* scenarioNames[] = {"counters", "shareddata"};
+
+
+/*
+* Function:     pinThread
+* Purpose:      Pins the calling thread to one of the online CPUs, so threads run on different cores.
+*
+* Inputs:       int         index               The thread's index.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void pinThread(int index)
+{
+    long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    cpu_set_t cpus;
+
+    CPU_ZERO(&cpus);
+    CPU_SET(index % (numCPUs < 1 ? 1 : numCPUs), &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+}
+
+
+/*
+* Function:     runThread
+* Purpose:      Thread function - does its share of the operations once every thread is ready.
+*
+* Inputs:       void*       arg                 The thread's FalseSharingBenchThread.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* runThread(void* arg)
+{
+    FalseSharingBenchThread* threadP = (FalseSharingBenchThread*)arg;
+    uint64_t checksum = 0;
+
+    pinThread(threadP->index);
+    pthread_barrier_wait(threadP->startBarrier);
+    int64_t startedAt = benchNanoseconds();
+
+    if (threadP->scenario == FALSE_SHARING_BENCH_COUNTERS)
+    {
+        uint64_t* counterP = threadP->isPadded ? &threadP->paddedCounters[threadP->index].value : &threadP->packedCounters[threadP->index];
+
+        for (long i = 0; i < threadP->numOperations; i++)
+        {
+            __atomic_add_fetch(counterP, 1, __ATOMIC_RELAXED);
+        }
+    }
+    else
+    {
+        int* numClientsP = threadP->isPadded ? &threadP->sharedDataP->numClients : &threadP->packedSharedDataP->numClients;
+        int* isRunningP = threadP->isPadded ? &threadP->sharedDataP->serverIsRunning : &threadP->packedSharedDataP->serverIsRunning;
+        int* msgQueueIDP = threadP->isPadded ? &threadP->sharedDataP->msgQueueID : &threadP->packedSharedDataP->msgQueueID;
+
+        for (long i = 0; i < threadP->numOperations; i++)
+        {
+            if (threadP->index == 0)
+            {
+                // A client joining, then leaving
+                __atomic_add_fetch(numClientsP, (i & 1) ? -1 : 1, __ATOMIC_RELEASE);
+            }
+            else
+            {
+                checksum += __atomic_load_n(isRunningP, __ATOMIC_ACQUIRE) + __atomic_load_n(msgQueueIDP, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    threadP->elapsed = benchNanoseconds() - startedAt;
+    threadP->checksum = checksum;
+
+    return NULL;
+}
+
+
+/*
+* Function:     runLayout
+* Purpose:      Runs one scenario with one layout and prints its line of results.
+*
+* Inputs:       int         scenario            FALSE_SHARING_BENCH_COUNTERS or FALSE_SHARING_BENCH_SHARED_DATA.
+*               int         isPadded            1 for the padded layout, 0 for the packed one.
+*               int         numThreads          Threads to run.
+*               long        numOperations       Operations per thread.
+*
+* Outputs:      None
+*
+* Returns:      int                             BENCH_SUCCESS, or BENCH_ERROR.
+*/
+static int runLayout(int scenario, int isPadded, int numThreads, long numOperations)
+{
+    FalseSharingBenchThread threads[FALSE_SHARING_BENCH_MAX_THREADS];
+    pthread_barrier_t startBarrier;
+
+    uint64_t* packedCounters = aligned_alloc(CACHE_LINE_LENGTH, sizeof(PaddedCounter) * FALSE_SHARING_BENCH_MAX_THREADS);
+    PaddedCounter* paddedCounters = aligned_alloc(CACHE_LINE_LENGTH, sizeof(PaddedCounter) * FALSE_SHARING_BENCH_MAX_THREADS);
+    PackedSharedData* packedSharedDataP = aligned_alloc(CACHE_LINE_LENGTH, sizeof(PackedSharedData));
+    SharedData* sharedDataP = aligned_alloc(CACHE_LINE_LENGTH, sizeof(SharedData));
+
+    if (packedCounters == NULL || paddedCounters == NULL || packedSharedDataP == NULL || sharedDataP == NULL)
+    {
+        fprintf(stderr, "[BENCH] : Out of memory\n");
+        free(packedCounters);
+        free(paddedCounters);
+        free(packedSharedDataP);
+        free(sharedDataP);
+        return BENCH_ERROR;
+    }
+
+    memset(packedCounters, 0, sizeof(PaddedCounter) * FALSE_SHARING_BENCH_MAX_THREADS);
+    memset(paddedCounters, 0, sizeof(PaddedCounter) * FALSE_SHARING_BENCH_MAX_THREADS);
+    memset(packedSharedDataP, 0, sizeof(PackedSharedData));
+    memset(sharedDataP, 0, sizeof(SharedData));
+    packedSharedDataP->serverIsRunning = 1;
+    sharedDataP->serverIsRunning = 1;
+
+    pthread_barrier_init(&startBarrier, NULL, numThreads);
+
+    for (int i = 0; i < numThreads; i++)
+    {
+        FalseSharingBenchThread* threadP = &threads[i];
+        memset(threadP, 0, sizeof(FalseSharingBenchThread));
+        threadP->scenario = scenario;
+        threadP->isPadded = isPadded;
+        threadP->index = i;
+        threadP->numOperations = numOperations;
+        threadP->packedCounters = packedCounters;
+        threadP->paddedCounters = paddedCounters;
+        threadP->packedSharedDataP = packedSharedDataP;
+        threadP->sharedDataP = sharedDataP;
+        threadP->startBarrier = &startBarrier;
+    }
+
+    pthread_t threadIDs[FALSE_SHARING_BENCH_MAX_THREADS];
+    for (int i = 0; i < numThreads; i++)
+    {
+        if (pthread_create(&threadIDs[i], NULL, runThread, &threads[i]) != 0)
+        {
+            // The barrier can never be passed now
+            perror("pthread_create");
+            exit(1);
+        }
+    }
+
+    int64_t totalElapsed = 0;
+    int64_t longestElapsed = 0;
+    for (int i = 0; i < numThreads; i++)
+    {
+        pthread_join(threadIDs[i], NULL);
+        totalElapsed += threads[i].elapsed;
+        longestElapsed = threads[i].elapsed > longestElapsed ? threads[i].elapsed : longestElapsed;
+    }
+
+    double nsPerOperation = (double)totalElapsed / numThreads / numOperations;
+    double operationsPerSecond = (double)numOperations * numThreads / (longestElapsed / 1e9);
+
+    printf("%-10s  %-6s  %7d  %10ld  %9.2f  %12.1f\n", scenarioNames[scenario], isPadded ? "padded" : "packed",
+        numThreads, numOperations, nsPerOperation, operationsPerSecond / 1e6);
+
+    pthread_barrier_destroy(&startBarrier);
+    free(packedCounters);
+    free(paddedCounters);
+    free(packedSharedDataP);
+    free(sharedDataP);
+
+    return BENCH_SUCCESS;
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numThreads = (int)benchArgument(argc, argv, "-threads", FALSE_SHARING_BENCH_THREADS);
+    long numOperations = benchArgument(argc, argv, "-operations", FALSE_SHARING_BENCH_OPERATIONS);
+    int layout = (int)benchArgument(argc, argv, "-layout", FALSE_SHARING_BENCH_BOTH);
+
+    if (numThreads < 2 || numThreads > FALSE_SHARING_BENCH_MAX_THREADS || numOperations < 1 ||
+        layout < FALSE_SHARING_BENCH_BOTH || layout > FALSE_SHARING_BENCH_PADDED)
+    {
+        fprintf(stderr, "Usage: %s [-threads 2..%d] [-operations N] [-layout 0 (both) | 1 (packed) | 2 (padded)]\n",
+            argv[0], FALSE_SHARING_BENCH_MAX_THREADS);
+        return 1;
+    }
+
+    long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    printf("%ld online CPU(s), %d-byte cache lines assumed%s\n", numCPUs, CACHE_LINE_LENGTH,
+        numCPUs < 2 ? " - threads share one CPU, so no line can bounce between caches" : "");
+    printf("%-10s  %-6s  %7s  %10s  %9s  %12s\n", "scenario", "layout", "threads", "ops/thread", "ns/op", "Mops/s");
+
+    for (int scenario = FALSE_SHARING_BENCH_COUNTERS; scenario <= FALSE_SHARING_BENCH_SHARED_DATA; scenario++)
+    {
+        if (layout != FALSE_SHARING_BENCH_PADDED)
+        {
+            runLayout(scenario, 0, numThreads, numOperations);
+        }
+        if (layout != FALSE_SHARING_BENCH_PACKED)
+        {
+            runLayout(scenario, 1, numThreads, numOperations);
+        }
+    }
+
+    return 0;
+}
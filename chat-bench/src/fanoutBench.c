@@ -0,0 +1,517 @@
+/*
+* Filename:		fanoutBench.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains a benchmark of how broadcast fan-out scales with the number of clients
+*               and the number of threads sending to them, written as CSV.
+*
+*               The server's chatBroadcaster() runs in-process, fed straight through the message queue
+*               as the filter workers feed it, with the scheduler started with 1..N workers - the
+*               threads a fan-out is spread over (with one, the broadcaster sends every broadcast
+*               itself; with more, it takes a shard and helps out while waiting). K receivers are put
+*               in the registry, each on a connection of a sink transport: a send is timed and
+*               counted, and costs nothing else, so what is measured is the broadcaster and the
+*               fan-out, not the kernel. For every K in {10, 100, 1000, 10000, 50000} and every
+*               number of threads:
+*                   - latency       One broadcast at a time, each let out before the next goes in.
+*                                   Two latencies are taken of every delivery: from the broadcast
+*                                   entering the queue to its frame being handed to the receiver's
+*                                   connection - which includes waking the broadcaster from msgrcv() -
+*                                   and the spread, from the broadcast's first delivery to this one.
+*                   - throughput    The queue kept full for a while, so the broadcaster never waits
+*                                   for work.
+*
+*               CSV columns: clients, threads, broadcasts/s and deliveries/s from the throughput run,
+*               the number of deliveries timed, and the p50, p99, p999 and maximum of both latencies
+*               in microseconds. Progress goes to stderr.
+*
+*               Usage: fanoutBench [-clients K] [-threads N] [-messages N] [-seconds N] > fanout.csv
+*                      -clients     One client count instead of the whole list
+*                      -threads     Most threads tried (default: online CPUs, up to SCHEDULER_MAX_WORKERS)
+*                      -messages    Broadcasts timed one at a time per run
+*                      -seconds     Length of each throughput run
+*/
+
+#define _GNU_SOURCE
+
+#include "../inc/benchCommon.h"
+#include "../../chat-server/inc/chatServer.h"
+
+#define FANOUT_BENCH_MESSAGES 100
+#define FANOUT_BENCH_SECONDS 2
+#define FANOUT_BENCH_FIRST_SOCKET 1000          // Receivers' socket numbers - none has a TLS session or is a WebSocket
+#define FANOUT_BENCH_MAX_CLIENTS (MAX_CLIENTS < TLS_MAX_FDS - FANOUT_BENCH_FIRST_SOCKET ? MAX_CLIENTS : TLS_MAX_FDS - FANOUT_BENCH_FIRST_SOCKET)
+#define FANOUT_BENCH_MAX_BROADCASTS (1 << 20)   // Broadcasts per run, across both phases
+#define FANOUT_BENCH_POLL_LENGTH 100            // 100 microseconds between checks on the deliveries
+#define FANOUT_BENCH_STALL_LENGTH 10            // No delivery for 10 seconds - give up on the run
+#define FANOUT_BENCH_TAG "\"message\":\"#"      // Starts the message of every broadcast, before its sequence number
+
+// Latency histogram - 32 linear buckets per power of two, about 3% wide
+#define FANOUT_BENCH_SUB_BUCKET_BITS 5
+#define FANOUT_BENCH_SUB_BUCKETS (1 << FANOUT_BENCH_SUB_BUCKET_BITS)
+#define FANOUT_BENCH_BUCKETS (FANOUT_BENCH_SUB_BUCKETS * (64 - FANOUT_BENCH_SUB_BUCKET_BITS + 1))
+
+#define FANOUT_BENCH_QUEUED 0                   // Latency from the queue
+#define FANOUT_BENCH_SPREAD 1                   // Latency from the broadcast's first delivery
+
+// Every sending thread - the broadcaster and each worker - counts on a line of its own
+#define FANOUT_BENCH_MAX_THREADS (SCHEDULER_MAX_WORKERS + 1)
+
+typedef struct
+{
+    uint64_t numDelivered;
+    uint64_t latencyBuckets[2][FANOUT_BENCH_BUCKETS];     // FANOUT_BENCH_QUEUED and FANOUT_BENCH_SPREAD
+} __attribute__((aligned(CACHE_LINE_LENGTH))) FanoutBenchCounters;
+
+static const int clientCounts[] = {10, 100, 1000, 10000, 50000};
+
+static FanoutBenchCounters threadCounters[FANOUT_BENCH_MAX_THREADS];
+static int numThreadCounters;
+static __thread FanoutBenchCounters* myCounters;
+
+static int64_t* enqueuedAt;                 // When each broadcast of the run went into the queue
+static int64_t* firstSentAt;                // When each was first handed to a receiver, or 0
+static int numEnqueued;
+static int isRecordingLatency;
+
+
+/*
+* Function:     bucketOf
+* Purpose:      Finds the latency histogram bucket of a number of nanoseconds.
+*
+* Inputs:       uint64_t    nanoseconds         The latency.
+*
+* Outputs:      None
+*
+* Returns:      int                             The bucket.
+*/
+static int bucketOf(uint64_t nanoseconds)
+{
+    if (nanoseconds < FANOUT_BENCH_SUB_BUCKETS)
+    {
+        return (int)nanoseconds;
+    }
+
+    int shift = 63 - __builtin_clzll(nanoseconds) - FANOUT_BENCH_SUB_BUCKET_BITS;
+    return FANOUT_BENCH_SUB_BUCKETS * (shift + 1) + (int)((nanoseconds >> shift) - FANOUT_BENCH_SUB_BUCKETS);
+}
+
+
+/*
+* Function:     bucketNanoseconds
+* Purpose:      Gets the smallest latency that falls in a histogram bucket.
+*
+* Inputs:       int         bucket              The bucket.
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        The latency in nanoseconds.
+*/
+static uint64_t bucketNanoseconds(int bucket)
+{
+    if (bucket < FANOUT_BENCH_SUB_BUCKETS)
+    {
+        return (uint64_t)bucket;
+    }
+
+    int shift = bucket / FANOUT_BENCH_SUB_BUCKETS - 1;
+    return (uint64_t)(FANOUT_BENCH_SUB_BUCKETS + bucket % FANOUT_BENCH_SUB_BUCKETS) << shift;
+}
+
+
+/*
+* Function:     sinkSend
+* Purpose:      Sends data to a receiver of the sink transport - counts it and, while latency is being
+*               recorded, times it from when its broadcast was queued.
+*
+* Inputs:       int             clientSocket    The receiver's socket number.
+*               const void*     data            Data to send - a broadcast's JSON.
+*               size_t          length          Number of bytes.
+*               int             flags           Ignored.
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         length - every send succeeds.
+*/
+static ssize_t sinkSend(int clientSocket, const void* data, size_t length, int flags)
+{
+    int64_t now = benchNanoseconds();
+
+    if (myCounters == NULL)
+    {
+        myCounters = &threadCounters[__atomic_fetch_add(&numThreadCounters, 1, __ATOMIC_RELAXED) % FANOUT_BENCH_MAX_THREADS];
+    }
+
+    if (__atomic_load_n(&isRecordingLatency, __ATOMIC_ACQUIRE))
+    {
+        // The JSON ends in a '\0', so the sequence number can be read in place
+        const char* tagP = memmem(data, length, FANOUT_BENCH_TAG, sizeof(FANOUT_BENCH_TAG) - 1);
+        long sequence = tagP != NULL ? strtol(tagP + sizeof(FANOUT_BENCH_TAG) - 1, NULL, 10) : -1;
+
+        if (sequence >= 0 && sequence < __atomic_load_n(&numEnqueued, __ATOMIC_ACQUIRE))
+        {
+            // Left 0 if this is the broadcast's first delivery
+            int64_t firstSent = 0;
+            __atomic_compare_exchange_n(&firstSentAt[sequence], &firstSent, now, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+
+            int64_t latency = now - enqueuedAt[sequence];
+            int64_t spread = firstSent > 0 && firstSent < now ? now - firstSent : 0;
+            __atomic_add_fetch(&myCounters->latencyBuckets[FANOUT_BENCH_QUEUED][bucketOf(latency > 0 ? latency : 0)], 1, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&myCounters->latencyBuckets[FANOUT_BENCH_SPREAD][bucketOf(spread)], 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    __atomic_add_fetch(&myCounters->numDelivered, 1, __ATOMIC_RELEASE);
+
+    return (ssize_t)length;
+}
+
+
+/*
+* Function:     sinkRecv
+* Purpose:      Reads from a receiver of the sink transport - there is never anything to read.
+*
+* Inputs:       int             clientSocket    The receiver's socket number.
+*               void*           buffer          Where the data would go.
+*               size_t          length          Size of buffer.
+*               int             flags           Ignored.
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         -1, with errno EAGAIN.
+*/
+static ssize_t sinkRecv(int clientSocket, void* buffer, size_t length, int flags)
+{
+    errno = EAGAIN;
+    return -1;
+}
+
+static const Transport sinkTransport = {"fan-out sink", sinkSend, sinkRecv};
+
+
+/*
+* Function:     getDelivered
+* Purpose:      Adds up the deliveries made by every sending thread so far.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        Number of deliveries.
+*/
+static uint64_t getDelivered()
+{
+    uint64_t numDelivered = 0;
+
+    for (int i = 0; i < FANOUT_BENCH_MAX_THREADS; i++)
+    {
+        numDelivered += __atomic_load_n(&threadCounters[i].numDelivered, __ATOMIC_ACQUIRE);
+    }
+
+    return numDelivered;
+}
+
+
+/*
+* Function:     getLatency
+* Purpose:      Gets a percentile of the latencies recorded by every sending thread.
+*
+* Inputs:       int         latency             FANOUT_BENCH_QUEUED or FANOUT_BENCH_SPREAD.
+*               double      fraction            The percentile, as a fraction (0.99 for p99), or 1 for the maximum.
+*               uint64_t*   numSamplesP         Where to store the number of latencies recorded, or NULL.
+*
+* Outputs:      numSamplesP
+*
+* Returns:      double                          The latency in microseconds, or 0 if none was recorded.
+*/
+static double getLatency(int latency, double fraction, uint64_t* numSamplesP)
+{
+    static uint64_t buckets[FANOUT_BENCH_BUCKETS];
+    uint64_t numSamples = 0;
+
+    for (int bucket = 0; bucket < FANOUT_BENCH_BUCKETS; bucket++)
+    {
+        buckets[bucket] = 0;
+        for (int i = 0; i < FANOUT_BENCH_MAX_THREADS; i++)
+        {
+            buckets[bucket] += __atomic_load_n(&threadCounters[i].latencyBuckets[latency][bucket], __ATOMIC_RELAXED);
+        }
+        numSamples += buckets[bucket];
+    }
+
+    if (numSamplesP != NULL)
+    {
+        *numSamplesP = numSamples;
+    }
+
+    // The sample at the percentile, counting from 1
+    uint64_t wanted = (uint64_t)(fraction * numSamples + 0.999999);
+    uint64_t seen = 0;
+    for (int bucket = 0; bucket < FANOUT_BENCH_BUCKETS && numSamples > 0; bucket++)
+    {
+        seen += buckets[bucket];
+        if (seen >= wanted && buckets[bucket] > 0)
+        {
+            return bucketNanoseconds(bucket) / 1e3;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+* Function:     enqueueBroadcast
+* Purpose:      Puts the run's next broadcast in the broadcaster's queue, as the filter workers would.
+*
+* Inputs:       int         msgQID              The message queue.
+*
+* Outputs:      None
+*
+* Returns:      int                             BENCH_SUCCESS, or BENCH_ERROR if it could not be queued.
+*/
+static int enqueueBroadcast(int msgQID)
+{
+    QueueMessageEnvelope envelope;
+    memset(&envelope, 0, sizeof(envelope));
+
+    int sequence = numEnqueued;
+    if (sequence >= FANOUT_BENCH_MAX_BROADCASTS)
+    {
+        return BENCH_ERROR;
+    }
+
+    envelope.type = TYPE_SERVERMESSAGE;
+    snprintf(envelope.broadcastMessage.clientIP, sizeof(envelope.broadcastMessage.clientIP), "10.0.0.1");
+    snprintf(envelope.broadcastMessage.clientUserID, sizeof(envelope.broadcastMessage.clientUserID), "bench");
+    snprintf(envelope.broadcastMessage.message, sizeof(envelope.broadcastMessage.message), "#%d fan-out benchmark broadcast", sequence);
+
+    // Stored before the broadcast can be sent, and published with it
+    enqueuedAt[sequence] = benchNanoseconds();
+    firstSentAt[sequence] = 0;
+    __atomic_store_n(&numEnqueued, sequence + 1, __ATOMIC_RELEASE);
+
+    if (msgsnd(msgQID, &envelope, QUEUE_MESSAGE_LENGTH, 0) == -1)
+    {
+        perror("msgsnd");
+        __atomic_store_n(&numEnqueued, sequence, __ATOMIC_RELEASE);
+        return BENCH_ERROR;
+    }
+
+    return BENCH_SUCCESS;
+}
+
+
+/*
+* Function:     waitForDeliveries
+* Purpose:      Waits until every receiver has been sent every broadcast queued so far.
+*
+* Inputs:       int         numClients          Receivers.
+*
+* Outputs:      None
+*
+* Returns:      int                             BENCH_SUCCESS, or BENCH_ERROR if deliveries stopped coming.
+*/
+static int waitForDeliveries(int numClients)
+{
+    uint64_t expected = (uint64_t)__atomic_load_n(&numEnqueued, __ATOMIC_ACQUIRE) * numClients;
+    uint64_t lastDelivered = getDelivered();
+    int64_t lastChangeAt = benchNanoseconds();
+
+    while (lastDelivered < expected)
+    {
+        usleep(FANOUT_BENCH_POLL_LENGTH);
+
+        uint64_t numDelivered = getDelivered();
+        if (numDelivered != lastDelivered)
+        {
+            lastDelivered = numDelivered;
+            lastChangeAt = benchNanoseconds();
+        }
+        else if (benchNanoseconds() - lastChangeAt > FANOUT_BENCH_STALL_LENGTH * 1000000000LL)
+        {
+            return BENCH_ERROR;
+        }
+    }
+
+    return BENCH_SUCCESS;
+}
+
+
+/*
+* Function:     runFanout
+* Purpose:      Runs both phases for one number of receivers and threads, and writes its CSV row.
+*
+* Inputs:       SharedData* sharedDataP         The server's shared data.
+*               int         numClients          Receivers.
+*               int         numThreads          Scheduler workers to start.
+*               int         numMessages         Broadcasts timed one at a time.
+*               int         numSeconds          Length of the throughput phase.
+*
+* Outputs:      None
+*
+* Returns:      int                             BENCH_SUCCESS, or BENCH_ERROR if the run failed.
+*/
+static int runFanout(SharedData* sharedDataP, int numClients, int numThreads, int numMessages, int numSeconds)
+{
+    int msgQID = sharedDataP->msgQueueID;
+    int retVal = BENCH_SUCCESS;
+
+    // A fresh registry, counters and queue for every run - no thread of the last run is left
+    memset(threadCounters, 0, sizeof(threadCounters));
+    numThreadCounters = 0;
+    numEnqueued = 0;
+    isRecordingLatency = 0;
+    initSharedData(sharedDataP, msgQID, -1);
+
+    const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+    for (int i = 0; i < numClients; i++)
+    {
+        char clientIP[CLIENT_IP_LENGTH + 1];
+        char clientUserID[CLIENT_USERID_LENGTH + 1];
+        snprintf(clientIP, sizeof(clientIP), "10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+        snprintf(clientUserID, sizeof(clientUserID), "r%c%c%c%c",
+            digits[(i / 46656) % 36], digits[(i / 1296) % 36], digits[(i / 36) % 36], digits[i % 36]);
+
+        RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+        pthread_mutex_lock(&shardP->mutex);
+        addToList(pthread_self(), clientIP, clientUserID, FANOUT_BENCH_FIRST_SOCKET + i, sharedDataP);
+        pthread_mutex_unlock(&shardP->mutex);
+    }
+
+    pthread_t broadcasterThread;
+    if (schedulerStartWorkers(numThreads) != SCHEDULER_SUCCESS ||
+        pthread_create(&broadcasterThread, NULL, chatBroadcaster, sharedDataP) != 0)
+    {
+        fprintf(stderr, "[BENCH] : The scheduler or the broadcaster did not start\n");
+        schedulerStop();
+        return BENCH_ERROR;
+    }
+
+    // One broadcast untimed - the broadcaster's first one also waits for it to start up
+    if (enqueueBroadcast(msgQID) != BENCH_SUCCESS || waitForDeliveries(numClients) != BENCH_SUCCESS)
+    {
+        retVal = BENCH_ERROR;
+    }
+
+    // Latency - one broadcast at a time, so no broadcast's deliveries wait for another's
+    __atomic_store_n(&isRecordingLatency, 1, __ATOMIC_RELEASE);
+    for (int i = 0; i < numMessages && retVal == BENCH_SUCCESS; i++)
+    {
+        if (enqueueBroadcast(msgQID) != BENCH_SUCCESS || waitForDeliveries(numClients) != BENCH_SUCCESS)
+        {
+            retVal = BENCH_ERROR;
+        }
+    }
+    __atomic_store_n(&isRecordingLatency, 0, __ATOMIC_RELEASE);
+
+    // Throughput - never let the queue run dry: the bench keeps sending and msgsnd() holds it back
+    // while the queue is full. Polling for room instead lets a quick fan-out empty the queue in between
+    uint64_t deliveredAtStart = getDelivered();
+    int64_t startedAt = benchNanoseconds();
+    int64_t finishedAt = startedAt;
+
+    while (retVal == BENCH_SUCCESS && finishedAt - startedAt < numSeconds * 1000000000LL)
+    {
+        retVal = enqueueBroadcast(msgQID);
+        finishedAt = benchNanoseconds();
+    }
+
+    uint64_t numDelivered = getDelivered() - deliveredAtStart;
+
+    if (retVal == BENCH_SUCCESS && waitForDeliveries(numClients) != BENCH_SUCCESS)
+    {
+        retVal = BENCH_ERROR;
+    }
+
+    // The broadcaster stops once there are no clients, and it is woken to see that
+    __atomic_store_n(&sharedDataP->numClients, 0, __ATOMIC_RELEASE);
+    wakeBroadcaster(sharedDataP);
+    pthread_join(broadcasterThread, NULL);
+    schedulerStop();
+
+    if (retVal != BENCH_SUCCESS)
+    {
+        fprintf(stderr, "[BENCH] : Deliveries stopped coming - %d clients, %d threads\n", numClients, numThreads);
+        return BENCH_ERROR;
+    }
+
+    double seconds = (finishedAt - startedAt) / 1e9;
+    uint64_t numSamples = 0;
+    double p50 = getLatency(FANOUT_BENCH_QUEUED, 0.50, &numSamples);
+
+    printf("%d,%d,%.1f,%.0f,%llu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", numClients, numThreads,
+        numDelivered / (double)numClients / seconds, numDelivered / seconds, (unsigned long long)numSamples,
+        p50, getLatency(FANOUT_BENCH_QUEUED, 0.99, NULL), getLatency(FANOUT_BENCH_QUEUED, 0.999, NULL),
+        getLatency(FANOUT_BENCH_QUEUED, 1.0, NULL), getLatency(FANOUT_BENCH_SPREAD, 0.50, NULL),
+        getLatency(FANOUT_BENCH_SPREAD, 0.99, NULL), getLatency(FANOUT_BENCH_SPREAD, 0.999, NULL),
+        getLatency(FANOUT_BENCH_SPREAD, 1.0, NULL));
+    fflush(stdout);
+
+    return BENCH_SUCCESS;
+}
+
+
+int main(int argc, char* argv[])
+{
+    long numCPUs = sysconf(_SC_NPROCESSORS_ONLN);
+    int onlyClients = (int)benchArgument(argc, argv, "-clients", 0);
+    int maxThreads = (int)benchArgument(argc, argv, "-threads", numCPUs < 1 ? 1 : numCPUs);
+    int numMessages = (int)benchArgument(argc, argv, "-messages", FANOUT_BENCH_MESSAGES);
+    int numSeconds = (int)benchArgument(argc, argv, "-seconds", FANOUT_BENCH_SECONDS);
+
+    if (maxThreads > SCHEDULER_MAX_WORKERS)
+    {
+        maxThreads = SCHEDULER_MAX_WORKERS;
+    }
+
+    if (onlyClients < 0 || onlyClients > FANOUT_BENCH_MAX_CLIENTS || maxThreads < 1 || numMessages < 1 || numSeconds < 1)
+    {
+        fprintf(stderr, "Usage: %s [-clients 1..%d] [-threads 1..%d] [-messages N] [-seconds N]\n", argv[0],
+            FANOUT_BENCH_MAX_CLIENTS, SCHEDULER_MAX_WORKERS);
+        return 1;
+    }
+
+    // The server, minus its listeners and everything but the broadcaster and the scheduler
+    transportUse(&sinkTransport);
+
+    int msgQID = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    SharedData* sharedDataP = aligned_alloc(CACHE_LINE_LENGTH, sizeof(SharedData));
+    enqueuedAt = malloc(sizeof(int64_t) * FANOUT_BENCH_MAX_BROADCASTS);
+    firstSentAt = malloc(sizeof(int64_t) * FANOUT_BENCH_MAX_BROADCASTS);
+
+    if (msgQID == -1 || sharedDataP == NULL || enqueuedAt == NULL || firstSentAt == NULL)
+    {
+        fprintf(stderr, "[BENCH] : Could not set up the server\n");
+        return 1;
+    }
+    sharedDataP->msgQueueID = msgQID;
+
+    printf("clients,threads,broadcasts_per_sec,deliveries_per_sec,latency_samples,p50_us,p99_us,p999_us,max_us,"
+        "spread_p50_us,spread_p99_us,spread_p999_us,spread_max_us\n");
+
+    int numCounts = onlyClients > 0 ? 1 : (int)(sizeof(clientCounts) / sizeof(clientCounts[0]));
+    for (int i = 0; i < numCounts; i++)
+    {
+        int numClients = onlyClients > 0 ? onlyClients : clientCounts[i];
+        if (numClients > FANOUT_BENCH_MAX_CLIENTS)
+        {
+            fprintf(stderr, "[BENCH] : Skipping %d clients - built for at most %d\n", numClients, FANOUT_BENCH_MAX_CLIENTS);
+            continue;
+        }
+
+        for (int numThreads = 1; numThreads <= maxThreads; numThreads++)
+        {
+            fprintf(stderr, "%d clients, %d threads...\n", numClients, numThreads);
+            runFanout(sharedDataP, numClients, numThreads, numMessages, numSeconds);
+        }
+    }
+
+    msgctl(msgQID, IPC_RMID, NULL);
+    free(enqueuedAt);
+    free(firstSentAt);
+    free(sharedDataP);
+
+    return 0;
+}
@@ -0,0 +1,236 @@
+/*
+* Filename:		hugePageBench.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains a benchmark of broadcast fan-out over the client registry on normal
+*               pages against the pages memAllocHuge() gives it.
+*
+*               The registry is the server's own SharedData, filled through addToList(), so clients
+*               land in the shards their user IDs hash to and every shard keeps REGISTRY_SHARD_CAPACITY
+*               slots, as in the server. A fan-out walks it the way fanOutChunk() does - shard by
+*               shard, reading each connected client's delivery mode and socket. The registry is mapped two ways:
+*                   - normal        4 KiB pages, with transparent huge pages turned off for it.
+*                   - memAllocHuge  Whatever memAllocHuge() gives a block this big: reserved huge
+*                                   pages where the system has them (see /proc/sys/vm/nr_hugepages),
+*                                   otherwise an aligned mapping marked for transparent huge pages.
+*
+*               Reported per mapping: nanoseconds per client visited, the speedup over normal pages,
+*               and how much of the registry the kernel actually put on huge pages. The registry is
+*               only as big as MAX_CLIENTS makes it - build with BENCH_MAX_CLIENTS to change it.
+*
+*               Usage: hugePageBench [-clients N] [-fanouts N]
+*/
+
+#define _GNU_SOURCE
+
+#include "../inc/benchCommon.h"
+#include "../../chat-server/inc/chatServer.h"
+
+#include <sys/mman.h>
+
+#define HUGE_PAGE_BENCH_CLIENTS MAX_CLIENTS
+#define HUGE_PAGE_BENCH_FANOUTS 200
+
+#define HUGE_PAGE_BENCH_NORMAL 0
+#define HUGE_PAGE_BENCH_ALLOC_HUGE 1
+
+static const char* mappingNames[] = {"normal", "memAllocHuge"};
+
+// Where the sockets read during a fan-out go, so the reads are not optimised away
+static volatile uint64_t socketChecksum;
+
+
+/*
+* Function:     hugePagesInUse
+* Purpose:      Reads how much memory is on huge pages right now - the process's transparent huge
+*               pages plus the system's reserved huge pages in use.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      long                            Kilobytes on huge pages, or -1 if unknown.
+*/
+static long hugePagesInUse()
+{
+    char line[256];
+    long transparent = -1;
+    long total = 0;
+    long free = 0;
+    long pageKilobytes = 0;
+
+    FILE* smaps = fopen("/proc/self/smaps_rollup", "r");
+    if (smaps == NULL)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), smaps) != NULL)
+    {
+        if (sscanf(line, "AnonHugePages: %ld kB", &transparent) == 1)
+        {
+            break;
+        }
+    }
+    fclose(smaps);
+
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo == NULL)
+    {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), meminfo) != NULL)
+    {
+        sscanf(line, "HugePages_Total: %ld", &total);
+        sscanf(line, "HugePages_Free: %ld", &free);
+        sscanf(line, "Hugepagesize: %ld kB", &pageKilobytes);
+    }
+    fclose(meminfo);
+
+    return transparent < 0 ? -1 : transparent + (total - free) * pageKilobytes;
+}
+
+
+/*
+* Function:     runMapping
+* Purpose:      Fills the registry on one kind of mapping, fans out over it and prints its line of results.
+*
+* Inputs:       int         mapping             HUGE_PAGE_BENCH_NORMAL or HUGE_PAGE_BENCH_ALLOC_HUGE.
+*               int         numClients          Clients to register.
+*               int         numFanouts          Fan-outs to time.
+*               double      baselineNs          ns per client on normal pages, or 0 while measuring them.
+*
+* Outputs:      None
+*
+* Returns:      double                          ns per client visited, or 0 if the mapping failed.
+*/
+static double runMapping(int mapping, int numClients, int numFanouts, double baselineNs)
+{
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mappedLength = (sizeof(SharedData) + pageSize - 1) / pageSize * pageSize;
+    long hugeBefore = hugePagesInUse();
+
+    SharedData* sharedDataP = NULL;
+    if (mapping == HUGE_PAGE_BENCH_ALLOC_HUGE)
+    {
+        sharedDataP = memAllocHuge(MEM_CONNECTION_STATE, sizeof(SharedData));
+    }
+    else
+    {
+        void* mapped = mmap(NULL, mappedLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped != MAP_FAILED)
+        {
+            madvise(mapped, mappedLength, MADV_NOHUGEPAGE);
+            sharedDataP = mapped;
+        }
+    }
+
+    if (sharedDataP == NULL)
+    {
+        printf("%-12s  skipped - could not map %zu bytes\n", mappingNames[mapping], sizeof(SharedData));
+        return 0;
+    }
+
+    // Set up and connect everyone as the server does - the first touch is where the kernel picks the page size
+    initSharedData(sharedDataP, -1, -1);
+    for (int i = 0; i < numClients; i++)
+    {
+        // A distinct user ID each, in base 36 to fit CLIENT_USERID_LENGTH
+        char clientUserID[CLIENT_USERID_LENGTH + 1];
+        int remaining = i;
+        for (int j = CLIENT_USERID_LENGTH - 1; j >= 0; j--)
+        {
+            clientUserID[j] = "0123456789abcdefghijklmnopqrstuvwxyz"[remaining % 36];
+            remaining /= 36;
+        }
+        clientUserID[CLIENT_USERID_LENGTH] = '\0';
+        addToList((pthread_t)0, "127.0.0.1", clientUserID, i + 3, sharedDataP);
+    }
+
+    long hugeAfter = hugePagesInUse();
+
+    // One fan-out untimed, so every run starts from the same cache state
+    uint64_t checksum = 0;
+    int64_t startedAt = 0;
+    for (int fanout = -1; fanout < numFanouts; fanout++)
+    {
+        if (fanout == 0)
+        {
+            startedAt = benchNanoseconds();
+        }
+
+        for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+        {
+            RegistryShard* shardP = &sharedDataP->shards[shard];
+
+            pthread_mutex_lock(&shardP->mutex);
+            for (int i = 0; i < shardP->numClients; i++)
+            {
+                if (shardP->connectedClients[i].delivery == DELIVERY_TCP)
+                {
+                    checksum += shardP->connectedClients[i].clientSocket;
+                }
+            }
+            pthread_mutex_unlock(&shardP->mutex);
+        }
+    }
+    int64_t elapsed = benchNanoseconds() - startedAt;
+
+    double nsPerClient = (double)elapsed / numFanouts / numClients;
+    char onHugePages[64];
+    if (hugeBefore < 0 || hugeAfter < 0)
+    {
+        snprintf(onHugePages, sizeof(onHugePages), "unknown");
+    }
+    else
+    {
+        snprintf(onHugePages, sizeof(onHugePages), "%ld / %zu KiB", hugeAfter - hugeBefore, sizeof(SharedData) / 1024);
+    }
+
+    printf("%-12s  %8d  %10zu  %10.2f  %8.2fx  %s\n", mappingNames[mapping], numClients, sizeof(SharedData) / 1024,
+        nsPerClient, baselineNs > 0 ? baselineNs / nsPerClient : 1.0, onHugePages);
+    socketChecksum = checksum;
+
+    // Everyone leaves, so the next mapping starts with no users known to the mention matcher
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+    {
+        RegistryShard* shardP = &sharedDataP->shards[shard];
+        while (shardP->numClients > 0)
+        {
+            removeFromList(shardP->numClients - 1, shardP, sharedDataP);
+        }
+    }
+
+    if (mapping == HUGE_PAGE_BENCH_ALLOC_HUGE)
+    {
+        memFreeHuge(MEM_CONNECTION_STATE, sharedDataP, sizeof(SharedData));
+    }
+    else
+    {
+        munmap(sharedDataP, mappedLength);
+    }
+    return nsPerClient;
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numClients = (int)benchArgument(argc, argv, "-clients", HUGE_PAGE_BENCH_CLIENTS);
+    int numFanouts = (int)benchArgument(argc, argv, "-fanouts", HUGE_PAGE_BENCH_FANOUTS);
+
+    if (numClients < 1 || numClients > MAX_CLIENTS || numFanouts < 1)
+    {
+        fprintf(stderr, "Usage: %s [-clients 1..%d] [-fanouts N]\n", argv[0], MAX_CLIENTS);
+        return 1;
+    }
+
+    // The registry is charged to the budget like any other pool - make room for it
+    memSetBudget(memGetBudget() + 2 * sizeof(SharedData));
+
+    printf("%-12s  %8s  %10s  %10s  %9s  %s\n", "mapping", "clients", "table KiB", "ns/client", "speedup", "on huge pages");
+
+    double baselineNs = runMapping(HUGE_PAGE_BENCH_NORMAL, numClients, numFanouts, 0);
+    runMapping(HUGE_PAGE_BENCH_ALLOC_HUGE, numClients, numFanouts, baselineNs);
+
+    return 0;
+}
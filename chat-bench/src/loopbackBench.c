@@ -0,0 +1,406 @@
+/*
+* Filename:		loopbackBench.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains a benchmark of the server's own CPU cost per message, with the server
+*               logic running in-process over the loopback transport instead of sockets.
+*
+*               The server's code is linked in and set up as runServer() does, minus the listeners:
+*               the registry lives on the heap, the message queue is a private one, and every client
+*               connection is a loopback connection. This thread plays the client handlers, calling
+*               processMessage() for each message a simulated client writes - under that client's own
+*               session ID (coroutineSetSelf()), so its bye removes its own entry - while the filter
+*               workers, the broadcaster, the scheduler's workers and the presence thread do the rest
+*               as they would in the server. Three phases are timed:
+*                   - registration  Every client registers (roster, presence deltas to everyone).
+*                   - messages      Clients take turns sending distinct chat messages, each parsed,
+*                                   spam-checked, queued and fanned out to every client.
+*                   - leave         Every client says bye.
+*
+*               Simulated clients read everything sent to them, as often as the server is polled for
+*               progress, so their outboxes do not fill up and sends are not dropped.
+*
+*               Reported per phase: the CPU time of the whole process (every server thread - nothing
+*               else runs - less the clients' reading) per operation and per send to a client, and the
+*               wall time until the server went quiet.
+*
+*               Usage: loopbackBench [-clients N] [-messages N]
+*/
+
+#include "../inc/benchCommon.h"
+#include "../../chat-server/inc/chatServer.h"
+#include "../../chat-server/inc/serverTransport.h"
+
+#define LOOPBACK_BENCH_CLIENTS 1000
+#define LOOPBACK_BENCH_MESSAGES 300
+#define LOOPBACK_BENCH_MAX_CLIENTS (MAX_CLIENTS < TRANSPORT_LOOPBACK_MAX_CONNECTIONS ? MAX_CLIENTS : TRANSPORT_LOOPBACK_MAX_CONNECTIONS)
+#define LOOPBACK_BENCH_READ_EVERY 32               // Registrations between clients reading
+#define LOOPBACK_BENCH_POLL_LENGTH 50000            // 50 milliseconds between checks for the server going quiet
+#define LOOPBACK_BENCH_QUIET_LENGTH 500             // Quiet for 500 milliseconds - the presence thread has flushed
+#define LOOPBACK_BENCH_STALL_LENGTH 3000            // No progress for 3 seconds - sends that are never coming
+
+typedef struct
+{
+    int clientSocket;
+    char clientIP[CLIENT_IP_LENGTH + 1];
+    char clientUserID[CLIENT_USERID_LENGTH + 1];
+} LoopbackBenchClient;
+
+typedef struct
+{
+    int64_t startedAt;
+    int64_t cpuAtStart;
+    uint64_t sendsAtStart;
+    int64_t readingAtStart;
+} LoopbackBenchPhase;
+
+static LoopbackBenchClient* clients;
+static int numClients;
+static int64_t readingNanoseconds;      // CPU time spent by the simulated clients reading
+
+
+/*
+* Function:     processCpuNanoseconds
+* Purpose:      Gets the CPU time used by every thread of the process so far.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         CPU time in nanoseconds.
+*/
+static int64_t processCpuNanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+
+/*
+* Function:     getSends
+* Purpose:      Gets the number of sends the server has made to loopback clients so far.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        Number of sends.
+*/
+static uint64_t getSends()
+{
+    TransportStats transportStats;
+    transportGetStats(&transportStats);
+
+    return transportStats.loopbackSends;
+}
+
+
+/*
+* Function:     readClients
+* Purpose:      Has some of the simulated clients read what the server has sent them, and throws it away.
+*
+* Inputs:       int         firstClient         The first client to read.
+*               int         numToRead           Clients to read, from firstClient on.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void readClients(int firstClient, int numToRead)
+{
+    static char buffer[TRANSPORT_LOOPBACK_OUTBOX_LENGTH];
+    int64_t cpuAtStart = benchThreadCpuNanoseconds();
+
+    for (int i = firstClient; i < firstClient + numToRead; i++)
+    {
+        transportLoopbackRead(clients[i].clientSocket, buffer, sizeof(buffer));
+    }
+
+    readingNanoseconds += benchThreadCpuNanoseconds() - cpuAtStart;
+}
+
+
+/*
+* Function:     waitForServer
+* Purpose:      Waits until the server has made the expected number of sends and then gone quiet, or
+*               until it stops making progress.
+*
+* Inputs:       uint64_t    expectedSends       Sends to wait for (counted from sendsAtStart), or 0 to just wait for quiet.
+*               uint64_t    sendsAtStart        Sends made before the phase.
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         When the last send was seen (benchNanoseconds()).
+*/
+static int64_t waitForServer(uint64_t expectedSends, uint64_t sendsAtStart)
+{
+    uint64_t lastSends = getSends();
+    int64_t lastChangeAt = benchNanoseconds();
+
+    while (1)
+    {
+        usleep(LOOPBACK_BENCH_POLL_LENGTH);
+        readClients(0, numClients);
+
+        uint64_t sends = getSends();
+        int64_t now = benchNanoseconds();
+        if (sends != lastSends)
+        {
+            lastSends = sends;
+            lastChangeAt = now;
+            continue;
+        }
+
+        int64_t quietMilliseconds = (now - lastChangeAt) / 1000000;
+        if ((sends - sendsAtStart >= expectedSends && quietMilliseconds >= LOOPBACK_BENCH_QUIET_LENGTH) ||
+            quietMilliseconds >= LOOPBACK_BENCH_STALL_LENGTH)
+        {
+            return lastChangeAt;
+        }
+    }
+}
+
+
+/*
+* Function:     startPhase
+* Purpose:      Notes where a phase starts.
+*
+* Inputs:       LoopbackBenchPhase* phaseP      The phase.
+*
+* Outputs:      phaseP
+*
+* Returns:      void
+*/
+static void startPhase(LoopbackBenchPhase* phaseP)
+{
+    phaseP->sendsAtStart = getSends();
+    phaseP->cpuAtStart = processCpuNanoseconds();
+    phaseP->readingAtStart = readingNanoseconds;
+    phaseP->startedAt = benchNanoseconds();
+}
+
+
+/*
+* Function:     endPhase
+* Purpose:      Waits for the server to finish a phase and prints its line of results.
+*
+* Inputs:       LoopbackBenchPhase* phaseP      The phase.
+*               const char* name                The phase's name.
+*               int         numClients          Clients connected during the phase.
+*               int         numOperations       Registrations, messages or byes in the phase.
+*               uint64_t    expectedSends       Sends the phase should make, or 0 if unknown.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void endPhase(LoopbackBenchPhase* phaseP, const char* name, int numClients, int numOperations, uint64_t expectedSends)
+{
+    int64_t finishedAt = waitForServer(expectedSends, phaseP->sendsAtStart);
+
+    // The wait itself barely uses any CPU - polling the stats every LOOPBACK_BENCH_POLL_LENGTH
+    double cpuNanoseconds = (double)(processCpuNanoseconds() - phaseP->cpuAtStart - (readingNanoseconds - phaseP->readingAtStart));
+    uint64_t numSends = getSends() - phaseP->sendsAtStart;
+
+    printf("%-12s  %7d  %10d  %9.1f  %10.2f  %10llu  %11.0f  %9.1f\n", name, numClients, numOperations,
+        cpuNanoseconds / 1e6, numOperations > 0 ? cpuNanoseconds / numOperations / 1e3 : 0.0,
+        (unsigned long long)numSends, numSends > 0 ? cpuNanoseconds / numSends : 0.0,
+        (finishedAt > phaseP->startedAt ? finishedAt - phaseP->startedAt : 0) / 1e6);
+}
+
+
+/*
+* Function:     sendFrame
+* Purpose:      Writes a message from a simulated client and has the server process it, as the client's
+*               handler would.
+*
+* Inputs:       LoopbackBenchClient* clientP    The client.
+*               const char* message             The message.
+*               SharedData* sharedDataP         The server's shared data.
+*               int         isRegistration      1 for the client's first message.
+*
+* Outputs:      None
+*
+* Returns:      int                             processMessage()'s result, or MESSAGE_PROCESS_FAILED if it could not be written.
+*/
+static int sendFrame(LoopbackBenchClient* clientP, const char* message, SharedData* sharedDataP, int isRegistration)
+{
+    char frame[JSON_LENGTH];
+    int frameLength = snprintf(frame, sizeof(frame), "{\"clientUserID\":\"%s\",\"message\":\"%s\"}", clientP->clientUserID, message);
+
+    if (transportLoopbackWrite(clientP->clientSocket, frame, frameLength) != TRANSPORT_SUCCESS)
+    {
+        return MESSAGE_PROCESS_FAILED;
+    }
+
+    // Each client is its own session in the registry - its address is no thread's or session's ID
+    coroutineSetSelf((pthread_t)(uintptr_t)clientP);
+
+    char registeredUserID[CLIENT_USERID_LENGTH + 1] = "";
+    int retVal = processMessage(clientP->clientSocket, clientP->clientIP, isRegistration ? registeredUserID : clientP->clientUserID,
+        sharedDataP, isRegistration);
+
+    coroutineSetSelf(0);
+
+    return retVal;
+}
+
+
+/*
+* Function:     makeChatMessage
+* Purpose:      Makes up a chat message of random words - no two alike, so the spam check lets them through.
+*
+* Inputs:       char*       message             Room for BROADCAST_MESSAGE_LENGTH + 1 characters.
+*               uint64_t*   seedP               The random number generator's state.
+*
+* Outputs:      message, seedP
+*
+* Returns:      void
+*/
+static void makeChatMessage(char* message, uint64_t* seedP)
+{
+    int length = 0;
+
+    while (length < BROADCAST_MESSAGE_LENGTH - 8)
+    {
+        // xorshift64
+        *seedP ^= *seedP << 13;
+        *seedP ^= *seedP >> 7;
+        *seedP ^= *seedP << 17;
+
+        int wordLength = 3 + (int)(*seedP % 5);
+        for (int i = 0; i < wordLength; i++)
+        {
+            message[length++] = 'a' + (char)((*seedP >> (8 + 5 * i)) % 26);
+        }
+        message[length++] = ' ';
+    }
+
+    message[length - 1] = '\0';
+}
+
+
+int main(int argc, char* argv[])
+{
+    numClients = (int)benchArgument(argc, argv, "-clients", LOOPBACK_BENCH_CLIENTS);
+    int numMessages = (int)benchArgument(argc, argv, "-messages", LOOPBACK_BENCH_MESSAGES);
+
+    if (numClients < 1 || numClients > LOOPBACK_BENCH_MAX_CLIENTS || numMessages < 0)
+    {
+        fprintf(stderr, "Usage: %s [-clients 1..%d] [-messages N]\n", argv[0], LOOPBACK_BENCH_MAX_CLIENTS);
+        return 1;
+    }
+
+    // The server, minus its listeners
+    transportUse(transportLoopback());
+
+    int msgQID = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    SharedData* sharedDataP = aligned_alloc(CACHE_LINE_LENGTH, sizeof(SharedData));
+    clients = calloc(numClients, sizeof(LoopbackBenchClient));
+
+    if (msgQID == -1 || sharedDataP == NULL || clients == NULL || initSharedData(sharedDataP, msgQID, -1) != SUCCESS)
+    {
+        fprintf(stderr, "[BENCH] : Could not set up the server\n");
+        return 1;
+    }
+
+    if (schedulerStart() != SCHEDULER_SUCCESS || presenceStart(sharedDataP) != PRESENCE_SUCCESS ||
+        filterStart(sendFilteredMessage, sharedDataP) != FILTER_SUCCESS)
+    {
+        fprintf(stderr, "[BENCH] : Some server threads did not start - results leave their work out\n");
+    }
+
+    printf("%-12s  %7s  %10s  %9s  %10s  %10s  %11s  %9s\n",
+        "phase", "clients", "operations", "cpu ms", "cpu us/op", "sends", "cpu ns/send", "wall ms");
+
+    // Registration
+    LoopbackBenchPhase phase;
+    int numRegistered = 0;
+    startPhase(&phase);
+
+    for (int i = 0; i < numClients; i++)
+    {
+        LoopbackBenchClient* clientP = &clients[i];
+        clientP->clientSocket = transportLoopbackOpen();
+        snprintf(clientP->clientIP, sizeof(clientP->clientIP), "10.%d.%d.%d", (i >> 16) & 0xff, (i >> 8) & 0xff, i & 0xff);
+
+        // "u" and the index in base 36 - four digits cover every loopback connection
+        const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+        snprintf(clientP->clientUserID, sizeof(clientP->clientUserID), "u%c%c%c%c",
+            digits[(i / 46656) % 36], digits[(i / 1296) % 36], digits[(i / 36) % 36], digits[i % 36]);
+
+        if (clientP->clientSocket != TRANSPORT_ERROR && sendFrame(clientP, SERVER_REGISTRATION_MSG, sharedDataP, 1) == MESSAGE_PROCESS_SUCCESS)
+        {
+            numRegistered++;
+        }
+
+        // The client reads its roster, and now and then everyone reads the presence updates
+        readClients(i, 1);
+        if (i % LOOPBACK_BENCH_READ_EVERY == 0)
+        {
+            readClients(0, i);
+        }
+    }
+
+    endPhase(&phase, "registration", numRegistered, numClients, 0);
+
+    // Messages - the broadcaster only starts once there are clients, like in the server
+    pthread_t broadcasterThread;
+    if (numRegistered == 0 || pthread_create(&broadcasterThread, NULL, chatBroadcaster, sharedDataP) != 0)
+    {
+        fprintf(stderr, "[BENCH] : No clients registered, or the broadcaster did not start\n");
+        return 1;
+    }
+
+    SpamStats spamBefore, spamAfter;
+    spamGetStats(&spamBefore);
+    uint64_t seed = 0x9e3779b97f4a7c15ULL;
+    startPhase(&phase);
+
+    for (int i = 0; i < numMessages; i++)
+    {
+        char message[BROADCAST_MESSAGE_LENGTH + 1];
+        makeChatMessage(message, &seed);
+        sendFrame(&clients[i % numClients], message, sharedDataP, 0);
+    }
+
+    spamGetStats(&spamAfter);
+    int numRejected = (int)(spamAfter.senderFloods + spamAfter.globalFloods - spamBefore.senderFloods - spamBefore.globalFloods);
+    endPhase(&phase, "messages", numRegistered, numMessages, (uint64_t)(numMessages - numRejected) * numRegistered);
+
+    // Leave - the broadcaster stops once the last client is gone and it is woken
+    startPhase(&phase);
+
+    for (int i = 0; i < numClients; i++)
+    {
+        sendFrame(&clients[i], SERVER_QUIT_MSG, sharedDataP, 0);
+    }
+
+    endPhase(&phase, "leave", numRegistered, numClients, 0);
+
+    TransportStats transportStats;
+    transportGetStats(&transportStats);
+    printf("\n%d messages rejected as spam, %llu of %llu bytes sent dropped (outboxes full - roster resyncs)\n",
+        numRejected, (unsigned long long)transportStats.loopbackBytesDropped, (unsigned long long)transportStats.loopbackBytesSent);
+
+    wakeBroadcaster(sharedDataP);
+    pthread_join(broadcasterThread, NULL);
+    filterStop();
+    presenceStop();
+    schedulerStop();
+
+    for (int i = 0; i < numClients; i++)
+    {
+        tlsForget(clients[i].clientSocket);
+        transportLoopbackClose(clients[i].clientSocket);
+    }
+
+    msgctl(msgQID, IPC_RMID, NULL);
+    free(clients);
+    free(sharedDataP);
+
+    return 0;
+}
@@ -0,0 +1,493 @@
+/*
+* Filename:		slowConsumerBench.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains a benchmark of what slow clients do to everyone else's broadcasts.
+*
+*               The server's chatBroadcaster() and scheduler run in-process over real TCP loopback
+*               connections, with small socket buffers so a client that does not keep up fills its
+*               buffers within seconds. Broadcasts are queued at a steady rate, as the filter workers
+*               would queue them. Healthy clients read everything as it arrives; a few pathological
+*               clients stay connected but, depending on the scenario:
+*                   - baseline      There are none - what healthy clients get on their own.
+*                   - trickle       Read a little at a time, slower than broadcasts arrive.
+*                   - stall         Read everything, then nothing for a while, over and over.
+*                   - dead          Never read at all.
+*               The broadcaster waits for every send to finish while holding the client's shard lock, so
+*               once a slow client's buffers are full, the broadcast waits for it.
+*
+*               Reported per scenario, for the healthy clients only: broadcasts received of those
+*               queued (and those the full queue turned away), and the p50, p99, p999 and maximum
+*               latency from a broadcast entering the queue to a healthy client reading it. At the
+*               end of each scenario the slow clients hang up, which lets a blocked broadcaster go.
+*
+*               Usage: slowConsumerBench [-healthy N] [-slow N] [-rate PER_SECOND] [-seconds N] [-buffer BYTES]
+*/
+
+#include "../inc/benchCommon.h"
+#include "../../chat-server/inc/chatServer.h"
+
+#include <poll.h>
+#include <signal.h>
+
+#define SLOW_BENCH_HEALTHY 50
+#define SLOW_BENCH_SLOW 3
+#define SLOW_BENCH_RATE 50                      // Broadcasts queued per second - far below what the broadcaster keeps up with
+#define SLOW_BENCH_SECONDS 8
+#define SLOW_BENCH_BUFFER_LENGTH 4096           // SO_SNDBUF and SO_RCVBUF of every connection
+#define SLOW_BENCH_MAX_CLIENTS 4096
+#define SLOW_BENCH_MAX_SAMPLES (1 << 22)
+#define SLOW_BENCH_DRAIN_LENGTH 2000            // 2 seconds for healthy clients to catch up after the last broadcast
+#define SLOW_BENCH_TICK_LENGTH 10000            // 10 milliseconds between a slow client's looks at its socket
+#define SLOW_BENCH_TRICKLE_LENGTH 16            // Bytes a trickling client reads per tick - about 1.6 KB/s
+#define SLOW_BENCH_STALL_LENGTH 3000            // A stalling client reads nothing for 3 seconds...
+#define SLOW_BENCH_UNSTALL_LENGTH 1000          // ...then everything for 1 second
+#define SLOW_BENCH_READ_LENGTH 65536
+#define SLOW_BENCH_TAG "\"message\":\"#"
+
+#define SLOW_BENCH_BASELINE 0
+#define SLOW_BENCH_TRICKLE 1
+#define SLOW_BENCH_STALL 2
+#define SLOW_BENCH_DEAD 3
+#define SLOW_BENCH_NUM_SCENARIOS 4
+
+typedef struct
+{
+    int serverSocket;           // The end the broadcaster sends on
+    int clientSocket;           // The end the client reads
+    int isSlow;
+    char partial[JSON_LENGTH];  // The start of a frame not read whole yet
+    size_t partialLength;
+} SlowBenchClient;
+
+static const char* scenarioNames[] = {"baseline", "trickle", "stall", "dead"};
+
+static SlowBenchClient clients[SLOW_BENCH_MAX_CLIENTS];
+static int numClients;
+static int scenario;
+static int isRunning;
+
+static int64_t* enqueuedAt;             // When each broadcast of the scenario went into the queue
+static int numEnqueued;
+static int64_t* latencies;              // Of every broadcast a healthy client read, in nanoseconds
+static int numLatencies;
+static uint64_t numHealthyReceived;
+
+
+/*
+* Function:     readFrames
+* Purpose:      Picks the complete broadcasts out of what a healthy client read, and times each one.
+*
+* Inputs:       SlowBenchClient* clientP        The client.
+*               const char* data                What it read.
+*               size_t      length              Number of bytes.
+*
+* Outputs:      clientP->partial                Whatever is left of a frame not read whole.
+*
+* Returns:      void
+*/
+static void readFrames(SlowBenchClient* clientP, const char* data, size_t length)
+{
+    int64_t now = benchNanoseconds();
+
+    for (size_t i = 0; i < length; i++)
+    {
+        if (clientP->partialLength < sizeof(clientP->partial) - 1)
+        {
+            clientP->partial[clientP->partialLength++] = data[i];
+        }
+
+        // Messages never hold a '}', so one ends every frame
+        if (data[i] != '}')
+        {
+            continue;
+        }
+
+        clientP->partial[clientP->partialLength] = '\0';
+        const char* tagP = strstr(clientP->partial, SLOW_BENCH_TAG);
+        long sequence = tagP != NULL ? strtol(tagP + sizeof(SLOW_BENCH_TAG) - 1, NULL, 10) : -1;
+        clientP->partialLength = 0;
+
+        if (sequence >= 0 && sequence < __atomic_load_n(&numEnqueued, __ATOMIC_ACQUIRE))
+        {
+            __atomic_add_fetch(&numHealthyReceived, 1, __ATOMIC_RELAXED);
+            if (numLatencies < SLOW_BENCH_MAX_SAMPLES)
+            {
+                latencies[numLatencies] = now - enqueuedAt[sequence];
+                __atomic_store_n(&numLatencies, numLatencies + 1, __ATOMIC_RELEASE);
+            }
+        }
+    }
+}
+
+
+/*
+* Function:     healthyReader
+* Purpose:      Thread reading every healthy client's broadcasts as soon as they arrive.
+*
+* Inputs:       void*       arg                 Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* healthyReader(void* arg)
+{
+    struct pollfd* pollSockets = calloc(numClients, sizeof(struct pollfd));
+    SlowBenchClient** polledClients = calloc(numClients, sizeof(SlowBenchClient*));
+    static char buffer[SLOW_BENCH_READ_LENGTH];
+    int numPolled = 0;
+
+    if (pollSockets == NULL || polledClients == NULL)
+    {
+        fprintf(stderr, "[BENCH] : Out of memory - healthy clients are not reading\n");
+        free(pollSockets);
+        free(polledClients);
+        return NULL;
+    }
+
+    for (int i = 0; i < numClients; i++)
+    {
+        if (!clients[i].isSlow)
+        {
+            pollSockets[numPolled].fd = clients[i].clientSocket;
+            pollSockets[numPolled].events = POLLIN;
+            polledClients[numPolled++] = &clients[i];
+        }
+    }
+
+    while (__atomic_load_n(&isRunning, __ATOMIC_ACQUIRE))
+    {
+        if (poll(pollSockets, numPolled, SLOW_BENCH_TICK_LENGTH / 1000) <= 0)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < numPolled; i++)
+        {
+            if (pollSockets[i].revents & POLLIN)
+            {
+                ssize_t numRead = recv(pollSockets[i].fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (numRead > 0)
+                {
+                    readFrames(polledClients[i], buffer, (size_t)numRead);
+                }
+            }
+        }
+    }
+
+    free(pollSockets);
+    free(polledClients);
+    return NULL;
+}
+
+
+/*
+* Function:     slowReader
+* Purpose:      Thread playing every slow client, each reading the way the scenario says.
+*
+* Inputs:       void*       arg                 Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* slowReader(void* arg)
+{
+    static char buffer[SLOW_BENCH_READ_LENGTH];
+    int64_t startedAt = benchNanoseconds();
+
+    while (__atomic_load_n(&isRunning, __ATOMIC_ACQUIRE))
+    {
+        int64_t cycleMilliseconds = (benchNanoseconds() - startedAt) / 1000000 % (SLOW_BENCH_STALL_LENGTH + SLOW_BENCH_UNSTALL_LENGTH);
+
+        for (int i = 0; i < numClients; i++)
+        {
+            if (!clients[i].isSlow)
+            {
+                continue;
+            }
+
+            if (scenario == SLOW_BENCH_TRICKLE)
+            {
+                recv(clients[i].clientSocket, buffer, SLOW_BENCH_TRICKLE_LENGTH, MSG_DONTWAIT);
+            }
+            else if (scenario == SLOW_BENCH_STALL && cycleMilliseconds >= SLOW_BENCH_STALL_LENGTH)
+            {
+                while (recv(clients[i].clientSocket, buffer, sizeof(buffer), MSG_DONTWAIT) > 0)
+                {
+                }
+            }
+        }
+
+        usleep(SLOW_BENCH_TICK_LENGTH);
+    }
+
+    return NULL;
+}
+
+
+/*
+* Function:     enqueueBroadcast
+* Purpose:      Puts the scenario's next broadcast in the broadcaster's queue, as the filter workers would -
+*               unless the queue is full.
+*
+* Inputs:       int         msgQID              The message queue.
+*
+* Outputs:      None
+*
+* Returns:      int                             BENCH_SUCCESS, or BENCH_ERROR if the queue was full.
+*/
+static int enqueueBroadcast(int msgQID)
+{
+    QueueMessageEnvelope envelope;
+    memset(&envelope, 0, sizeof(envelope));
+
+    int sequence = numEnqueued;
+    envelope.type = TYPE_SERVERMESSAGE;
+    snprintf(envelope.broadcastMessage.clientIP, sizeof(envelope.broadcastMessage.clientIP), "10.0.0.1");
+    snprintf(envelope.broadcastMessage.clientUserID, sizeof(envelope.broadcastMessage.clientUserID), "bench");
+    snprintf(envelope.broadcastMessage.message, sizeof(envelope.broadcastMessage.message), "#%d slow consumer broadcast", sequence);
+
+    // Published before the broadcast can be read
+    enqueuedAt[sequence] = benchNanoseconds();
+    __atomic_store_n(&numEnqueued, sequence + 1, __ATOMIC_RELEASE);
+
+    if (msgsnd(msgQID, &envelope, QUEUE_MESSAGE_LENGTH, IPC_NOWAIT) == -1)
+    {
+        __atomic_store_n(&numEnqueued, sequence, __ATOMIC_RELEASE);
+        return BENCH_ERROR;
+    }
+
+    return BENCH_SUCCESS;
+}
+
+
+/*
+* Function:     compareLatencies
+* Purpose:      Orders two latencies for qsort().
+*
+* Inputs:       const void* a                   The first latency.
+*               const void* b                   The second latency.
+*
+* Outputs:      None
+*
+* Returns:      int                             Negative, zero or positive as a is less than, equal to or greater than b.
+*/
+static int compareLatencies(const void* a, const void* b)
+{
+    int64_t latencyA = *(const int64_t*)a;
+    int64_t latencyB = *(const int64_t*)b;
+
+    return (latencyA > latencyB) - (latencyA < latencyB);
+}
+
+
+/*
+* Function:     getLatency
+* Purpose:      Gets a percentile of the sorted latencies.
+*
+* Inputs:       double      fraction            The percentile, as a fraction (0.99 for p99), or 1 for the maximum.
+*
+* Outputs:      None
+*
+* Returns:      double                          The latency in milliseconds, or 0 if none was taken.
+*/
+static double getLatency(double fraction)
+{
+    if (numLatencies == 0)
+    {
+        return 0;
+    }
+
+    int index = (int)(fraction * numLatencies + 0.999999) - 1;
+    index = index < 0 ? 0 : index >= numLatencies ? numLatencies - 1 : index;
+
+    return latencies[index] / 1e6;
+}
+
+
+/*
+* Function:     runScenario
+* Purpose:      Connects the clients, queues broadcasts for a while, and prints the scenario's line of results.
+*
+* Inputs:       SharedData* sharedDataP         The server's shared data.
+*               int         numHealthy          Healthy clients.
+*               int         numSlow             Slow clients (none for the baseline).
+*               int         rate                Broadcasts queued per second.
+*               int         numSeconds          How long broadcasts are queued for.
+*               int         bufferLength        SO_SNDBUF and SO_RCVBUF of every connection.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void runScenario(SharedData* sharedDataP, int numHealthy, int numSlow, int rate, int numSeconds, int bufferLength)
+{
+    int msgQID = sharedDataP->msgQueueID;
+
+    numClients = 0;
+    numEnqueued = 0;
+    numLatencies = 0;
+    numHealthyReceived = 0;
+    initSharedData(sharedDataP, msgQID, -1);
+
+    // Slow clients spread evenly among the healthy ones, and over the shards
+    for (int i = 0; i < numHealthy + numSlow; i++)
+    {
+        SlowBenchClient* clientP = &clients[numClients];
+        memset(clientP, 0, sizeof(SlowBenchClient));
+        clientP->isSlow = numSlow > 0 && i % ((numHealthy + numSlow) / numSlow) == 0 && i / ((numHealthy + numSlow) / numSlow) < numSlow;
+
+        if (benchLoopbackPair(&clientP->serverSocket, &clientP->clientSocket) != BENCH_SUCCESS)
+        {
+            break;
+        }
+        setsockopt(clientP->serverSocket, SOL_SOCKET, SO_SNDBUF, &bufferLength, sizeof(bufferLength));
+        setsockopt(clientP->clientSocket, SOL_SOCKET, SO_RCVBUF, &bufferLength, sizeof(bufferLength));
+
+        char clientIP[CLIENT_IP_LENGTH + 1];
+        char clientUserID[CLIENT_USERID_LENGTH + 1];
+        snprintf(clientIP, sizeof(clientIP), "10.0.%d.%d", (i >> 8) & 0xff, i & 0xff);
+        snprintf(clientUserID, sizeof(clientUserID), "%c%u", clientP->isSlow ? 's' : 'h', (unsigned)i % 10000);
+
+        RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+        pthread_mutex_lock(&shardP->mutex);
+        addToList(pthread_self(), clientIP, clientUserID, clientP->serverSocket, sharedDataP);
+        pthread_mutex_unlock(&shardP->mutex);
+
+        numClients++;
+    }
+
+    pthread_t broadcasterThread, healthyThread, slowThread;
+    __atomic_store_n(&isRunning, 1, __ATOMIC_RELEASE);
+    pthread_create(&healthyThread, NULL, healthyReader, NULL);
+    pthread_create(&slowThread, NULL, slowReader, NULL);
+    pthread_create(&broadcasterThread, NULL, chatBroadcaster, sharedDataP);
+
+    // Broadcasts at a steady rate, whether or not the broadcaster keeps up
+    int numQueueFull = 0;
+    int64_t startedAt = benchNanoseconds();
+    for (int i = 0; i < rate * numSeconds; i++)
+    {
+        int64_t dueAt = startedAt + (int64_t)i * 1000000000LL / rate;
+        int64_t now = benchNanoseconds();
+        if (dueAt > now)
+        {
+            usleep((useconds_t)((dueAt - now) / 1000));
+        }
+
+        if (enqueueBroadcast(msgQID) != BENCH_SUCCESS)
+        {
+            numQueueFull++;
+        }
+    }
+
+    // Healthy clients get a moment to catch up - the results are taken before the slow ones hang up
+    uint64_t numExpected = (uint64_t)numEnqueued * numHealthy;
+    int64_t drainUntil = benchNanoseconds() + SLOW_BENCH_DRAIN_LENGTH * 1000000LL;
+    while (__atomic_load_n(&numHealthyReceived, __ATOMIC_RELAXED) < numExpected && benchNanoseconds() < drainUntil)
+    {
+        usleep(SLOW_BENCH_TICK_LENGTH);
+    }
+
+    uint64_t numReceived = __atomic_load_n(&numHealthyReceived, __ATOMIC_RELAXED);
+    int numSamples = __atomic_load_n(&numLatencies, __ATOMIC_RELAXED);
+
+    // Hanging up makes a send blocked on a slow client fail, which lets the broadcaster go
+    for (int i = 0; i < numClients; i++)
+    {
+        if (clients[i].isSlow)
+        {
+            close(clients[i].clientSocket);
+            clients[i].clientSocket = -1;
+        }
+    }
+
+    __atomic_store_n(&sharedDataP->numClients, 0, __ATOMIC_RELEASE);
+    wakeBroadcaster(sharedDataP);
+    pthread_join(broadcasterThread, NULL);
+    __atomic_store_n(&isRunning, 0, __ATOMIC_RELEASE);
+    pthread_join(healthyThread, NULL);
+    pthread_join(slowThread, NULL);
+
+    // Whatever the broadcaster never got to
+    QueueMessageEnvelope envelope;
+    while (msgrcv(msgQID, &envelope, QUEUE_MESSAGE_LENGTH, TYPE_SERVERMESSAGE, IPC_NOWAIT) != -1)
+    {
+    }
+
+    for (int i = 0; i < numClients; i++)
+    {
+        tlsForget(clients[i].serverSocket); // Its output queue, before the socket number is reused
+        close(clients[i].serverSocket);
+        if (clients[i].clientSocket >= 0)
+        {
+            close(clients[i].clientSocket);
+        }
+    }
+
+    numLatencies = numSamples;
+    qsort(latencies, numLatencies, sizeof(int64_t), compareLatencies);
+
+    printf("%-9s  %4d / %-4d  %6d  %6d  %8.1f%%  %9.1f  %9.1f  %9.1f  %9.1f\n", scenarioNames[scenario], numSlow, numClients,
+        numEnqueued, numQueueFull, numExpected > 0 ? 100.0 * numReceived / numExpected : 0.0,
+        getLatency(0.50), getLatency(0.99), getLatency(0.999), getLatency(1.0));
+    fflush(stdout);
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numHealthy = (int)benchArgument(argc, argv, "-healthy", SLOW_BENCH_HEALTHY);
+    int numSlow = (int)benchArgument(argc, argv, "-slow", SLOW_BENCH_SLOW);
+    int rate = (int)benchArgument(argc, argv, "-rate", SLOW_BENCH_RATE);
+    int numSeconds = (int)benchArgument(argc, argv, "-seconds", SLOW_BENCH_SECONDS);
+    int bufferLength = (int)benchArgument(argc, argv, "-buffer", SLOW_BENCH_BUFFER_LENGTH);
+
+    if (numHealthy < 1 || numSlow < 1 || numHealthy + numSlow > SLOW_BENCH_MAX_CLIENTS || numHealthy + numSlow > MAX_CLIENTS ||
+        rate < 1 || numSeconds < 1 || bufferLength < 1)
+    {
+        fprintf(stderr, "Usage: %s [-healthy N] [-slow N] [-rate PER_SECOND] [-seconds N] [-buffer BYTES]\n", argv[0]);
+        return 1;
+    }
+
+    // A send to a client that hung up fails instead of ending the process
+    signal(SIGPIPE, SIG_IGN);
+
+    int msgQID = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+    SharedData* sharedDataP = aligned_alloc(CACHE_LINE_LENGTH, sizeof(SharedData));
+    enqueuedAt = malloc(sizeof(int64_t) * (size_t)rate * numSeconds);
+    latencies = malloc(sizeof(int64_t) * SLOW_BENCH_MAX_SAMPLES);
+
+    if (msgQID == -1 || sharedDataP == NULL || enqueuedAt == NULL || latencies == NULL)
+    {
+        fprintf(stderr, "[BENCH] : Could not set up the server\n");
+        return 1;
+    }
+    sharedDataP->msgQueueID = msgQID;
+
+    if (schedulerStart() != SCHEDULER_SUCCESS)
+    {
+        fprintf(stderr, "[BENCH] : The scheduler did not start - the broadcaster sends every broadcast itself\n");
+    }
+
+    printf("%d healthy clients, %d broadcasts/s for %d s, %d-byte socket buffers - latency in ms\n\n",
+        numHealthy, rate, numSeconds, bufferLength);
+    printf("%-9s  %11s  %6s  %6s  %9s  %9s  %9s  %9s  %9s\n",
+        "scenario", "slow", "queued", "full", "received", "p50", "p99", "p999", "max");
+
+    for (scenario = 0; scenario < SLOW_BENCH_NUM_SCENARIOS; scenario++)
+    {
+        runScenario(sharedDataP, numHealthy, scenario == SLOW_BENCH_BASELINE ? 0 : numSlow, rate, numSeconds, bufferLength);
+    }
+
+    schedulerStop();
+    msgctl(msgQID, IPC_RMID, NULL);
+    free(enqueuedAt);
+    free(latencies);
+    free(sharedDataP);
+
+    return 0;
+}
@@ -0,0 +1,359 @@
+/*
+* Filename:		tlsBench.c
+* Project:		CHAT-SYSTEM/chat-bench
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains a benchmark of broadcast fan-out over TLS against plaintext, on loopback.
+*
+*               It does what the chat broadcaster does for each broadcast - one write per connected
+*               client - over three kinds of connection:
+*                   - plain         send() on a TCP socket, as for plaintext clients.
+*                   - userspace     SSL_write(), i.e. the broadcaster encrypting once per recipient.
+*                   - kernel        send() on a socket whose TLS session was handed to the kernel (kTLS).
+*                                   Skipped, with a note, where the kernel has no "tls" module.
+*               A separate thread reads (and decrypts) everything on the receiving ends.
+*
+*               Reported per mode: the sending thread's CPU time per write - the cost that lands on the
+*               broadcaster - and the wall time until every receiver had everything.
+*
+*               Usage: tlsBench [-receivers N] [-broadcasts N]
+*/
+
+#include "../inc/benchCommon.h"
+
+#ifdef CHAT_TLS
+
+#include <poll.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+#define TLS_BENCH_RECEIVERS 8
+#define TLS_BENCH_BROADCASTS 20000
+#define TLS_BENCH_MAX_RECEIVERS 64
+#define TLS_BENCH_SAMPLES 64                // Different broadcasts cycled through
+#define TLS_BENCH_READ_LENGTH 65536
+
+#define TLS_BENCH_MODE_PLAIN 0
+#define TLS_BENCH_MODE_USERSPACE 1
+#define TLS_BENCH_MODE_KERNEL 2
+
+typedef struct
+{
+    int senderSocket;
+    int receiverSocket;
+    SSL* senderSsl;
+    SSL* receiverSsl;
+} TLSBenchConnection;
+
+typedef struct
+{
+    TLSBenchConnection* connections;
+    int numConnections;
+    uint64_t expectedBytes;
+    uint64_t receivedBytes;
+    int64_t finishedAt;
+} TLSBenchDrain;
+
+static const char* modeNames[] = {"plain", "userspace", "kernel"};
+
+
+/*
+* Function:     createContexts
+* Purpose:      Creates the sending (server) and receiving (client) TLS contexts, with a throwaway
+*               self-signed certificate.
+*
+* Inputs:       int         mode                TLS_BENCH_MODE_USERSPACE or TLS_BENCH_MODE_KERNEL.
+*               SSL_CTX**   senderContextP      Where to store the sending context.
+*               SSL_CTX**   receiverContextP    Where to store the receiving context.
+*
+* Outputs:      senderContextP, receiverContextP
+*
+* Returns:      int                             BENCH_SUCCESS, or BENCH_ERROR.
+*/
+static int createContexts(int mode, SSL_CTX** senderContextP, SSL_CTX** receiverContextP)
+{
+    EVP_PKEY* key = EVP_EC_gen("P-256");
+    X509* certificate = X509_new();
+    if (key == NULL || certificate == NULL)
+    {
+        return BENCH_ERROR;
+    }
+
+    X509_set_version(certificate, 2);
+    ASN1_INTEGER_set(X509_get_serialNumber(certificate), 1);
+    X509_gmtime_adj(X509_getm_notBefore(certificate), 0);
+    X509_gmtime_adj(X509_getm_notAfter(certificate), 3600);
+    X509_set_pubkey(certificate, key);
+    X509_NAME* name = X509_get_subject_name(certificate);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, (const unsigned char*)"chat-bench", -1, -1, 0);
+    X509_set_issuer_name(certificate, name);
+    X509_sign(certificate, key, EVP_sha256());
+
+    *senderContextP = SSL_CTX_new(TLS_server_method());
+    *receiverContextP = SSL_CTX_new(TLS_client_method());
+    if (*senderContextP == NULL || *receiverContextP == NULL ||
+        SSL_CTX_use_certificate(*senderContextP, certificate) != 1 || SSL_CTX_use_PrivateKey(*senderContextP, key) != 1)
+    {
+        return BENCH_ERROR;
+    }
+
+    // Same settings as the server's context
+    SSL_CTX_set_min_proto_version(*senderContextP, TLS1_2_VERSION);
+    SSL_CTX_set_num_tickets(*senderContextP, 0);
+    if (mode == TLS_BENCH_MODE_KERNEL)
+    {
+        SSL_CTX_set_options(*senderContextP, SSL_OP_ENABLE_KTLS);
+    }
+
+    X509_free(certificate);
+    EVP_PKEY_free(key);
+    return BENCH_SUCCESS;
+}
+
+
+/*
+* Function:     connectReceivers
+* Purpose:      Receiving side of the handshakes - runs next to the sending side's SSL_accept() calls.
+*
+* Inputs:       void*       arg         The TLSBenchDrain holding the connections.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* connectReceivers(void* arg)
+{
+    TLSBenchDrain* drainP = arg;
+
+    for (int i = 0; i < drainP->numConnections; i++)
+    {
+        SSL_connect(drainP->connections[i].receiverSsl);
+    }
+
+    return NULL;
+}
+
+
+/*
+* Function:     drainReceivers
+* Purpose:      Reads (and decrypts) everything the receivers are sent, until the expected number of
+*               bytes has arrived.
+*
+* Inputs:       void*       arg         The TLSBenchDrain.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* drainReceivers(void* arg)
+{
+    TLSBenchDrain* drainP = arg;
+    struct pollfd pollFds[TLS_BENCH_MAX_RECEIVERS];
+    char* buffer = malloc(TLS_BENCH_READ_LENGTH);
+
+    for (int i = 0; i < drainP->numConnections; i++)
+    {
+        pollFds[i].fd = drainP->connections[i].receiverSocket;
+        pollFds[i].events = POLLIN;
+    }
+
+    while (buffer != NULL && drainP->receivedBytes < drainP->expectedBytes)
+    {
+        if (poll(pollFds, drainP->numConnections, 1000) <= 0)
+        {
+            break;
+        }
+
+        for (int i = 0; i < drainP->numConnections; i++)
+        {
+            if (!(pollFds[i].revents & POLLIN))
+            {
+                continue;
+            }
+
+            SSL* ssl = drainP->connections[i].receiverSsl;
+            do
+            {
+                ssize_t numRead = ssl != NULL ? SSL_read(ssl, buffer, TLS_BENCH_READ_LENGTH) :
+                    recv(pollFds[i].fd, buffer, TLS_BENCH_READ_LENGTH, 0);
+                if (numRead > 0)
+                {
+                    drainP->receivedBytes += numRead;
+                }
+            } while (ssl != NULL && SSL_pending(ssl) > 0);
+        }
+    }
+
+    drainP->finishedAt = benchNanoseconds();
+    free(buffer);
+    return NULL;
+}
+
+
+/*
+* Function:     runMode
+* Purpose:      Runs the fan-out for one kind of connection and prints the results.
+*
+* Inputs:       int     mode            One of the TLS_BENCH_MODE_ values.
+*               int     numReceivers    Number of receiving connections.
+*               int     numBroadcasts   Number of broadcasts, each written to every receiver.
+*
+* Outputs:      A result line on stdout.
+*
+* Returns:      int                     BENCH_SUCCESS, or BENCH_ERROR.
+*/
+static int runMode(int mode, int numReceivers, int numBroadcasts)
+{
+    TLSBenchConnection connections[TLS_BENCH_MAX_RECEIVERS];
+    TLSBenchDrain drain = {.connections = connections, .numConnections = numReceivers};
+    SSL_CTX* senderContext = NULL;
+    SSL_CTX* receiverContext = NULL;
+    int retVal = BENCH_SUCCESS;
+
+    memset(connections, 0, sizeof(connections));
+
+    if (mode != TLS_BENCH_MODE_PLAIN && createContexts(mode, &senderContext, &receiverContext) != BENCH_SUCCESS)
+    {
+        fprintf(stderr, "[BENCH] : cannot set up TLS\n");
+        return BENCH_ERROR;
+    }
+
+    for (int i = 0; i < numReceivers; i++)
+    {
+        if (benchLoopbackPair(&connections[i].senderSocket, &connections[i].receiverSocket) != BENCH_SUCCESS)
+        {
+            return BENCH_ERROR;
+        }
+
+        // Like the server - small writes go out straight away
+        int noDelay = 1;
+        setsockopt(connections[i].senderSocket, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+
+        if (senderContext != NULL)
+        {
+            connections[i].senderSsl = SSL_new(senderContext);
+            connections[i].receiverSsl = SSL_new(receiverContext);
+            SSL_set_fd(connections[i].senderSsl, connections[i].senderSocket);
+            SSL_set_fd(connections[i].receiverSsl, connections[i].receiverSocket);
+        }
+    }
+
+    if (senderContext != NULL)
+    {
+        pthread_t handshakeThread;
+        pthread_create(&handshakeThread, NULL, connectReceivers, &drain);
+        for (int i = 0; i < numReceivers; i++)
+        {
+            if (SSL_accept(connections[i].senderSsl) != 1)
+            {
+                retVal = BENCH_ERROR;
+            }
+        }
+        pthread_join(handshakeThread, NULL);
+
+        if (retVal != BENCH_SUCCESS)
+        {
+            fprintf(stderr, "[BENCH] : TLS handshake FAILED\n");
+        }
+        else if (mode == TLS_BENCH_MODE_KERNEL && BIO_get_ktls_send(SSL_get_wbio(connections[0].senderSsl)) <= 0)
+        {
+            printf("%-10s  skipped - the kernel cannot take the session (no \"tls\" module?)\n", modeNames[mode]);
+            retVal = BENCH_ERROR;
+        }
+    }
+
+    // Prepared up front - serializing is the same cost for every mode
+    char samples[TLS_BENCH_SAMPLES][JSON_LENGTH];
+    size_t sampleLengths[TLS_BENCH_SAMPLES];
+    for (int i = 0; i < TLS_BENCH_SAMPLES; i++)
+    {
+        sampleLengths[i] = benchSampleBroadcast(samples[i], JSON_LENGTH, i);
+    }
+    for (int b = 0; b < numBroadcasts; b++)
+    {
+        drain.expectedBytes += sampleLengths[b % TLS_BENCH_SAMPLES] * numReceivers;
+    }
+
+    if (retVal == BENCH_SUCCESS)
+    {
+        pthread_t drainThread;
+        pthread_create(&drainThread, NULL, drainReceivers, &drain);
+
+        int64_t startTime = benchNanoseconds();
+        int64_t startCpu = benchThreadCpuNanoseconds();
+
+        for (int b = 0; b < numBroadcasts; b++)
+        {
+            const char* json = samples[b % TLS_BENCH_SAMPLES];
+            size_t jsonLength = sampleLengths[b % TLS_BENCH_SAMPLES];
+
+            for (int i = 0; i < numReceivers; i++)
+            {
+                if (mode == TLS_BENCH_MODE_USERSPACE)
+                {
+                    SSL_write(connections[i].senderSsl, json, (int)jsonLength);
+                }
+                else
+                {
+                    send(connections[i].senderSocket, json, jsonLength, 0);
+                }
+            }
+        }
+
+        int64_t cpuNanoseconds = benchThreadCpuNanoseconds() - startCpu;
+        int64_t sendNanoseconds = benchNanoseconds() - startTime;
+        pthread_join(drainThread, NULL);
+        int64_t wallNanoseconds = drain.finishedAt - startTime;
+
+        double numWrites = (double)numBroadcasts * numReceivers;
+        printf("%-10s  %9d  %10d  %12.0f  %13.1f  %11.1f  %9.1f%s\n", modeNames[mode], numReceivers, numBroadcasts,
+            cpuNanoseconds / numWrites, sendNanoseconds / 1e6, wallNanoseconds / 1e6,
+            drain.receivedBytes / (wallNanoseconds / 1e9) / 1e6,
+            drain.receivedBytes < drain.expectedBytes ? "  (incomplete)" : "");
+    }
+
+    for (int i = 0; i < numReceivers; i++)
+    {
+        SSL_free(connections[i].senderSsl);
+        SSL_free(connections[i].receiverSsl);
+        close(connections[i].senderSocket);
+        close(connections[i].receiverSocket);
+    }
+    SSL_CTX_free(senderContext);
+    SSL_CTX_free(receiverContext);
+
+    return retVal;
+}
+
+
+int main(int argc, char* argv[])
+{
+    int numReceivers = (int)benchArgument(argc, argv, "-receivers", TLS_BENCH_RECEIVERS);
+    int numBroadcasts = (int)benchArgument(argc, argv, "-broadcasts", TLS_BENCH_BROADCASTS);
+
+    if (numReceivers < 1 || numReceivers > TLS_BENCH_MAX_RECEIVERS || numBroadcasts < 1)
+    {
+        fprintf(stderr, "Usage: %s [-receivers 1..%d] [-broadcasts N]\n", argv[0], TLS_BENCH_MAX_RECEIVERS);
+        return 1;
+    }
+
+    printf("%-10s  %9s  %10s  %12s  %13s  %11s  %9s\n",
+        "mode", "receivers", "broadcasts", "cpu ns/write", "send time ms", "wall ms", "MB/s");
+
+    for (int mode = TLS_BENCH_MODE_PLAIN; mode <= TLS_BENCH_MODE_KERNEL; mode++)
+    {
+        runMode(mode, numReceivers, numBroadcasts);
+    }
+
+    return 0;
+}
+
+#else // Built without TLS
+
+int main()
+{
+    fprintf(stderr, "tlsBench: built without TLS (make TLS=1)\n");
+    return 1;
+}
+
+#endif // CHAT_TLS
@@ -17,25 +17,66 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <pthread.h>
+#include <time.h>
+#include <endian.h>
 #include <ncurses.h>
+#include <poll.h>
+#include <fcntl.h>
+
+#ifdef CHAT_TLS
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+#endif
 
 #include "../../common/inc/commonMessaging.h"
+#include "../../common/inc/localRing.h"
+#include "../../common/inc/multicastProtocol.h"
 
 #define PORT_NUM 30000
+#define TLS_PORT_NUM 30004 //the server's TLS port, for -tls
+#ifndef TLS_CA_FILE
+#define TLS_CA_FILE "chat-server.crt" //trusted for the server's certificate, as well as the system's CAs
+#endif
 #define HISTORY_SIZE 10 //max number of messages to dusplay at a time
 #define MESSAGE_MAX_LENGTH 80 //max message length
+#define RECEIVE_BUFFER_LENGTH (JSON_LENGTH * 4) //room for several messages received at once
+#define TYPING_MSG ">>typing<<" //sent while the user types, and the server's "who is typing" frame
+#define TYPING_PING_INTERVAL_MS 300 //at most one typing ping this often
+#define TYPING_INDICATOR_LENGTH 64 //room for the "... typing" line
+#define LOCAL_MSG ">>local<<" //asks the server for broadcasts through the shared-memory ring
+#define MENTION_MSG ">>mention<<" //the server's heads-up that the next message mentions this user
+#define LOCAL_RING_WAIT_MS 100 //longest sleep between checks whether the client is closing
+#define MULTICAST_RECEIVE_TIMEOUT_MS 100 //same, for the multicast socket
 
 
 pthread_mutex_t ncurses_mutex = PTHREAD_MUTEX_INITIALIZER;
 int sockfd;
 WINDOW *input_win, *output_win;
 char currentUserID[CLIENT_USERID_LENGTH];
+char typingIndicator[TYPING_INDICATOR_LENGTH]; //who else is typing, shown on the output window border
+int useLocalRing = 0; //-local given - read broadcasts from the server's shared-memory ring
+LocalRing localRing;
+pthread_t ring_thread;
+volatile int ring_thread_running = 0;
+int useMulticast = 0; //-multicast given - get broadcasts from the server's multicast group
+int multicast_sock = -1;
+uint64_t multicast_expected = 0; //next sequence number expected from the group
+pthread_t multicast_thread;
+volatile int multicast_thread_running = 0;
+int useTLS = 0; //-tls given - connect to the server's TLS port
+#ifdef CHAT_TLS
+SSL *tls_session = NULL;
+int tls_kernel_send = 0; //the kernel encrypts what is sent - plain send() does
+pthread_mutex_t tls_mutex = PTHREAD_MUTEX_INITIALIZER; //input and output threads take turns with the SSL object
+#endif
 
 //prototypes
 //struct Broadcast* jsonToBroadcast(const char* json_str);
 //struct ClientMessage* jsonToClientMessage(const char* json_str);
 WINDOW *create_newwin(int height, int width, int starty, int startx);
 void display_message(WINDOW *win, const char *ip, const char *username, const char *msg, const char *direction);
+void update_typing_indicator(const char *userIDs);
+void draw_typing_indicator(WINDOW *win);
 
 
 
@@ -71,7 +112,9 @@ MessageHistory messageHistory = { .start = 0, .end = 0, .count = 0 };
 
 /**
  * Function:       parseArguments
- * Purpose:        Parses the command line arguments to extract user ID and server name
+ * Purpose:        Parses the command line arguments to extract user ID and server name, and whether
+ *                 -local (read broadcasts from the server's shared-memory ring), -multicast (get
+ *                 broadcasts from the server's multicast group) or -tls (encrypt the connection) was given
  *
  * Inputs:
  *   int argc - number of command line arguments
@@ -93,6 +136,12 @@ void parseArguments(int argc, char *argv[], char *userID, size_t userIDSize, cha
         } else if (strncmp(argv[i], "-server", 7) == 0) {
             strncpy(serverName, argv[i] + 7, serverNameSize - 1);
             serverName[serverNameSize - 1] = '\0'; //null-termination
+        } else if (strcmp(argv[i], "-local") == 0) {
+            useLocalRing = 1;
+        } else if (strcmp(argv[i], "-multicast") == 0) {
+            useMulticast = 1;
+        } else if (strcmp(argv[i], "-tls") == 0) {
+            useTLS = 1;
         }
     }
 }
@@ -148,4 +197,241 @@ int connectToServer(const char* serverName, int port) {
     return sockfd;
 }
 
-#endif
\ No newline at end of file
+/**
+ * Function:       joinMulticastGroup
+ * Purpose:        open a UDP socket on the multicast port and join the server's multicast group on
+ *                 the interface the TCP connection to the server goes through
+ *
+ * Inputs:
+ *   int serverSocket - connected TCP socket to the server
+ *
+ * Outputs:        NOne
+ *
+ * Returns:
+ *   int - the multicast socket, or -1 if the group could not be joined
+ */
+int joinMulticastGroup(int serverSocket) {
+    struct sockaddr_in localAddress;
+    socklen_t localLength = sizeof(localAddress);
+    if (getsockname(serverSocket, (struct sockaddr*)&localAddress, &localLength) < 0) {
+        return -1;
+    }
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sock < 0) {
+        perror("ERROR opening multicast socket");
+        return -1;
+    }
+
+    //several clients on one host all listen on the same port
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    struct sockaddr_in groupAddress;
+    memset(&groupAddress, 0, sizeof(groupAddress));
+    groupAddress.sin_family = AF_INET;
+    groupAddress.sin_port = htons(MULTICAST_PORT);
+    inet_pton(AF_INET, MULTICAST_GROUP, &groupAddress.sin_addr);
+
+    struct ip_mreq membership;
+    membership.imr_multiaddr = groupAddress.sin_addr;
+    membership.imr_interface = localAddress.sin_addr;
+
+    //wake up now and then to see if the client is closing
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = MULTICAST_RECEIVE_TIMEOUT_MS * 1000};
+
+    if (bind(sock, (struct sockaddr*)&groupAddress, sizeof(groupAddress)) < 0 ||
+        setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0 ||
+        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    return sock;
+}
+
+/**
+ * Function:       tls_connect
+ * Purpose:        do the TLS handshake on the connection to the server and check the server's
+ *                 certificate against TLS_CA_FILE and the system's CAs. The session's keys are handed
+ *                 to the kernel if it can take them; otherwise the socket is made non-blocking so the
+ *                 input and output threads can take turns with the SSL object
+ *
+ * Inputs:
+ *   const char* serverName - name or address of the server, which the certificate must be for
+ *
+ * Outputs:        NOne
+ *
+ * Returns:
+ *   int - 0 if the connection is encrypted, -1 otherwise
+ */
+int tls_connect(const char* serverName) {
+#ifdef CHAT_TLS
+    SSL_CTX *context = SSL_CTX_new(TLS_client_method());
+    if (context == NULL) {
+        return -1;
+    }
+    SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+    SSL_CTX_set_options(context, SSL_OP_ENABLE_KTLS);
+    SSL_CTX_set_verify(context, SSL_VERIFY_PEER, NULL);
+    SSL_CTX_set_default_verify_paths(context);
+    SSL_CTX_load_verify_locations(context, TLS_CA_FILE, NULL); //fine if it is not there
+
+    tls_session = SSL_new(context);
+    SSL_CTX_free(context); //the session keeps its own reference
+    if (tls_session == NULL) {
+        return -1;
+    }
+
+    //the certificate must be for the name or address the user gave
+    struct in_addr address;
+    if (inet_pton(AF_INET, serverName, &address) == 1) {
+        X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(tls_session), serverName);
+    } else {
+        SSL_set_tlsext_host_name(tls_session, serverName);
+        SSL_set1_host(tls_session, serverName);
+    }
+
+    if (SSL_set_fd(tls_session, sockfd) != 1 || SSL_connect(tls_session) != 1) {
+        fprintf(stderr, "TLS handshake failed: %s\n", X509_verify_cert_error_string(SSL_get_verify_result(tls_session)));
+        SSL_free(tls_session);
+        tls_session = NULL;
+        return -1;
+    }
+
+    tls_kernel_send = BIO_get_ktls_send(SSL_get_wbio(tls_session)) > 0;
+    if (!tls_kernel_send) {
+        fcntl(sockfd, F_SETFL, fcntl(sockfd, F_GETFL, 0) | O_NONBLOCK);
+    }
+    return 0;
+#else
+    (void)serverName;
+    fprintf(stderr, "built without TLS (make TLS=1)\n");
+    return -1;
+#endif
+}
+
+/**
+ * Function:       tls_wait
+ * Purpose:        wait until OpenSSL can make progress on the non-blocking server socket
+ *
+ * Inputs:
+ *   int ssl_error - SSL_get_error() of the call that could not finish
+ *
+ * Outputs:        NOne
+ *
+ * Returns:
+ *   int - 0 to try again, -1 if the connection failed
+ */
+int tls_wait(int ssl_error) {
+#ifdef CHAT_TLS
+    if (ssl_error != SSL_ERROR_WANT_READ && ssl_error != SSL_ERROR_WANT_WRITE) {
+        return -1;
+    }
+    struct pollfd pollfd = {.fd = sockfd, .events = ssl_error == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT};
+    poll(&pollfd, 1, -1);
+    return 0;
+#else
+    (void)ssl_error;
+    return -1;
+#endif
+}
+
+/**
+ * Function:       server_send
+ * Purpose:        send data to the server - encrypted by SSL_write() if the connection is TLS and the
+ *                 kernel is not doing it
+ *
+ * Inputs:
+ *   const void *data - the data
+ *   size_t length - number of bytes
+ *
+ * Outputs:        the data to the server
+ *
+ * Returns:
+ *   ssize_t - number of bytes sent, or -1 on error
+ */
+ssize_t server_send(const void *data, size_t length) {
+#ifdef CHAT_TLS
+    if (tls_session != NULL && !tls_kernel_send) {
+        size_t sent = 0;
+        int failed = 0;
+        pthread_mutex_lock(&tls_mutex);
+        while (sent < length && !failed) {
+            size_t written = 0;
+            int result = SSL_write_ex(tls_session, (const char*)data + sent, length - sent, &written);
+            if (result > 0) {
+                sent += written;
+            } else {
+                failed = tls_wait(SSL_get_error(tls_session, result)) < 0;
+            }
+        }
+        pthread_mutex_unlock(&tls_mutex);
+        return failed ? -1 : (ssize_t)sent;
+    }
+#endif
+    return send(sockfd, data, length, MSG_NOSIGNAL);
+}
+
+/**
+ * Function:       server_recv
+ * Purpose:        read (decrypted) data from the server
+ *
+ * Inputs:
+ *   void *buffer - where to store the data
+ *   size_t length - size of buffer
+ *   int flags - 0, or MSG_PEEK to leave the data for the next read
+ *
+ * Outputs:        buffer
+ *
+ * Returns:
+ *   ssize_t - number of bytes read, 0 if the server closed the connection, or -1 on error
+ */
+ssize_t server_recv(void *buffer, size_t length, int flags) {
+#ifdef CHAT_TLS
+    if (tls_session != NULL) {
+        while (1) {
+            //the socket is waited on outside the lock, so the input thread can still send
+            pthread_mutex_lock(&tls_mutex);
+            size_t received = 0;
+            int result = flags & MSG_PEEK ? SSL_peek_ex(tls_session, buffer, length, &received) :
+                SSL_read_ex(tls_session, buffer, length, &received);
+            int ssl_error = result > 0 ? SSL_ERROR_NONE : SSL_get_error(tls_session, result);
+            pthread_mutex_unlock(&tls_mutex);
+
+            if (result > 0) {
+                return (ssize_t)received;
+            }
+            if (ssl_error == SSL_ERROR_ZERO_RETURN) {
+                return 0;
+            }
+            if (tls_wait(ssl_error) < 0) {
+                return -1;
+            }
+        }
+    }
+#endif
+    return recv(sockfd, buffer, length, flags);
+}
+
+/**
+ * Function:       tls_close
+ * Purpose:        end the TLS session, if there is one
+ *
+ * Inputs:         None
+ *
+ * Outputs:        NOne
+ *
+ * Returns:        None
+ */
+void tls_close() {
+#ifdef CHAT_TLS
+    if (tls_session != NULL) {
+        SSL_shutdown(tls_session);
+        SSL_free(tls_session);
+        tls_session = NULL;
+    }
+#endif
+}
+
+#endif
@@ -7,6 +7,110 @@
 */
 #include "chatClient.h"
 
+/**
+ * Function:       send_server_request
+ * Description:    sends a control message (e.g. ">>local<<" or ">>nack<< 5 2") to the server
+ * 
+ * Inputs:
+ *                const char *userID - user ID of the sender
+ *                const char *request - the message
+ * 
+ * Outputs:       the message to the server
+ * 
+ * Returns:       None
+ */
+void send_server_request(const char *userID, const char *request) {
+    struct ClientMessage clientMsg;
+    memset(&clientMsg, 0, sizeof(clientMsg));
+    strncpy(clientMsg.clientUserID, userID, CLIENT_USERID_LENGTH);
+    strncpy(clientMsg.message, request, CLIENT_MESSAGE_LENGTH);
+
+    char* jsonMsg = clientMessageToJson(&clientMsg);
+    if (jsonMsg) {
+        server_send(jsonMsg, strlen(jsonMsg));
+        free(jsonMsg);
+    }
+}
+
+
+
+/**
+ * Function:       send_typing_ping
+ * Description:    tells the server the user is typing. Throttled so that at most one ping is sent
+ *                 every TYPING_PING_INTERVAL_MS no matter how fast the user types
+ * 
+ * Inputs:
+ *                const char *userID - user ID of the sender
+ * 
+ * Outputs:       a ">>typing<<" message to the server
+ * 
+ * Returns:       None
+ */
+void send_typing_ping(const char *userID) {
+    static long long last_ping_ms = 0;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long long now_ms = (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+
+    if (now_ms - last_ping_ms < TYPING_PING_INTERVAL_MS) {
+        return;
+    }
+    last_ping_ms = now_ms;
+
+    send_server_request(userID, TYPING_MSG);
+}
+
+
+
+/**
+ * Function:       read_message
+ * Description:    reads a line typed in the input window one key at a time (instead of wgetnstr)
+ *                 so that a typing ping can go out while the user is still typing
+ * 
+ * Inputs:
+ *                char *message - buffer for the line, CLIENT_MESSAGE_LENGTH + 1 bytes
+ *                const char *userID - user ID, for the typing pings
+ * 
+ * Outputs:       message - the line typed, without the newline
+ * 
+ * Returns:       None
+ */
+void read_message(char *message, const char *userID) {
+    int length = 0;
+    message[0] = '\0';
+
+    while (1) {
+        int ch = wgetch(input_win);
+
+        if (ch == ERR || ch == '\n' || ch == '\r' || ch == KEY_ENTER) {
+            break;
+        }
+
+        pthread_mutex_lock(&ncurses_mutex);
+        if ((ch == KEY_BACKSPACE || ch == 127 || ch == '\b') && length > 0) {
+            //erase the last character on screen as well
+            int y, x;
+            getyx(input_win, y, x);
+            mvwaddch(input_win, y, x - 1, ' ');
+            wmove(input_win, y, x - 1);
+            message[--length] = '\0';
+        } else if (ch >= ' ' && ch < 127 && length < CLIENT_MESSAGE_LENGTH) {
+            waddch(input_win, ch);
+            message[length++] = (char)ch;
+            message[length] = '\0';
+        }
+        wrefresh(input_win);
+        pthread_mutex_unlock(&ncurses_mutex);
+
+        if (length > 0) {
+            send_typing_ping(userID);
+        }
+    }
+}
+
+
+
 /**
  * Function:       input_handler
  * Description:    handling user input for sending messages in the chat client and sends the messages them to the server. 
@@ -22,7 +126,10 @@
 void *input_handler(void *arg) {
     char *userID = (char*)arg;
     char message[CLIENT_MESSAGE_LENGTH + 1];
-   
+
+    pthread_mutex_lock(&ncurses_mutex);
+    keypad(input_win, TRUE);
+    pthread_mutex_unlock(&ncurses_mutex);
     
     while (1) {
         pthread_mutex_lock(&ncurses_mutex);
@@ -31,15 +138,14 @@ void *input_handler(void *arg) {
         box(input_win, 0, 0);
         mvwprintw(input_win, 1, 1, "Enter message: ");   //promting the user
         wrefresh(input_win);
-        echo();
 
         pthread_mutex_unlock(&ncurses_mutex);
         
-        wgetnstr(input_win, message, CLIENT_MESSAGE_LENGTH);
+        read_message(message, userID);
 
         // check if exit command was entered
         if (strcmp(message, ">>bye<<") == 0) {
-            send(sockfd, message, strlen(message), 0);
+            server_send(message, strlen(message));
             break;
         }
         
@@ -49,7 +155,7 @@ void *input_handler(void *arg) {
         strncpy(clientMsg.message, message, CLIENT_MESSAGE_LENGTH);
         
         char* jsonMsg = clientMessageToJson(&clientMsg);
-        if (send(sockfd, jsonMsg, strlen(jsonMsg), 0) < 0) {
+        if (server_send(jsonMsg, strlen(jsonMsg)) < 0) {
             perror("send failed");
         }
         free(jsonMsg);    
@@ -67,44 +173,214 @@ void *input_handler(void *arg) {
 
 
 
+/**
+ * Function:       ring_handler
+ * Description:    reads broadcasts from the server's shared-memory ring and displays them. No system
+ *                 call is made while there is something to read; when there is not, the thread sleeps
+ *                 until the server wakes it
+ * 
+ * Outputs:        the broadcasts are displayed in the output window
+ * 
+ * Returns:        None
+ */
+void *ring_handler(void *unused) {
+    Broadcast bcast;
+    uint64_t numLagged;
+
+    while (ring_thread_running) {
+        int result = localRingRead(&localRing, &bcast, &numLagged);
+
+        if (numLagged > 0) {
+            char notice[BROADCAST_MESSAGE_LENGTH + 1];
+            snprintf(notice, sizeof(notice), "[%llu messages missed]", (unsigned long long)numLagged);
+            pthread_mutex_lock(&ncurses_mutex);
+            display_message(output_win, "", "", notice, "<<");
+            pthread_mutex_unlock(&ncurses_mutex);
+        }
+
+        if (result == LOCAL_RING_MESSAGE) {
+            const char* direction = strcmp(bcast.clientUserID, currentUserID) == 0 ? ">>" : "<<";
+            pthread_mutex_lock(&ncurses_mutex);
+            display_message(output_win, bcast.clientIP, bcast.clientUserID, bcast.message, direction);
+            pthread_mutex_unlock(&ncurses_mutex);
+        } else {
+            localRingWait(&localRing, LOCAL_RING_WAIT_MS);
+        }
+    }
+    pthread_exit(NULL);
+}
+
+
+
+/**
+ * Function:       multicast_handler
+ * Description:    receives broadcasts from the server's multicast group and displays them. A gap in
+ *                 the sequence numbers (also noticed from the server's heartbeats) is NACKed over
+ *                 the TCP connection; the repairs arrive there and output_handler displays them
+ * 
+ * Outputs:        the broadcasts are displayed in the output window
+ * 
+ * Returns:        None
+ */
+void *multicast_handler(void *unused) {
+    MulticastPacket packet;
+
+    while (multicast_thread_running) {
+        if (recv(multicast_sock, &packet, sizeof(packet), 0) != sizeof(packet) ||
+            ntohl(packet.magic) != MULTICAST_MAGIC) {
+            continue;
+        }
+
+        uint64_t sequence = be64toh(packet.sequence);
+        int isHeartbeat = ntohl(packet.kind) == MULTICAST_KIND_HEARTBEAT;
+
+        // a heartbeat carries the next sequence number, a broadcast its own
+        if (sequence > multicast_expected) {
+            char nack[CLIENT_MESSAGE_LENGTH + 1];
+            snprintf(nack, sizeof(nack), "%s %llu %llu", MULTICAST_NACK_MSG,
+                (unsigned long long)multicast_expected, (unsigned long long)(sequence - multicast_expected));
+            send_server_request(currentUserID, nack);
+            multicast_expected = sequence;
+        }
+
+        if (isHeartbeat || sequence < multicast_expected) {
+            continue; //nothing to show, or already repaired
+        }
+        multicast_expected = sequence + 1;
+
+        const char* direction = strcmp(packet.broadcast.clientUserID, currentUserID) == 0 ? ">>" : "<<";
+        pthread_mutex_lock(&ncurses_mutex);
+        display_message(output_win, packet.broadcast.clientIP, packet.broadcast.clientUserID, packet.broadcast.message, direction);
+        pthread_mutex_unlock(&ncurses_mutex);
+    }
+    pthread_exit(NULL);
+}
+
+
+
 /**
  * Function:       output_handler
  * Description:    recieving messages from the server and displays them to the user. Creates
  *                 operates in its own thread, continuously reading from the socket. Uses mutex lock
- *                 to ensure that access to the ncurses window is thread-safe.
+ *                 to ensure that access to the ncurses window is thread-safe. One read can hold
+ *                 several messages (e.g. search results), so the data is split into JSON objects.
  * Outputs:         the recieved messages are displayed in the output window
  * 
  * Returns:        None
  */
 void *output_handler(void *unused) {
-    char buffer[JSON_LENGTH];
+    char buffer[RECEIVE_BUFFER_LENGTH];
+    char frame[JSON_LENGTH];
+    int buffered = 0;
+    int running = 1;
 
-    while (1) {
-        memset(buffer, 0, JSON_LENGTH);
-        int bytes_received = recv(sockfd, buffer, JSON_LENGTH, 0);
+    while (running) {
+        int bytes_received = server_recv(buffer + buffered, RECEIVE_BUFFER_LENGTH - buffered, 0);
 
         if (bytes_received <= 0) {
             break;
         }
-        
-        struct Broadcast* bcast = jsonToBroadcast(buffer);
-        if (bcast) {
-            pthread_mutex_lock(&ncurses_mutex);
+        buffered += bytes_received;
+
+        // the server may send several broadcasts back to back, handle every complete one
+        int frameLength;
+        while (running && (frameLength = jsonObjectLength(buffer, buffered)) > 0) {
+            int copyLength = frameLength < JSON_LENGTH ? frameLength : JSON_LENGTH - 1;
+            memcpy(frame, buffer, copyLength);
+            frame[copyLength] = '\0';
+
+            buffered -= frameLength;
+            memmove(buffer, buffer + frameLength, buffered);
+
+            struct Broadcast* bcast = jsonToBroadcast(frame);
+            if (bcast) {
+                pthread_mutex_lock(&ncurses_mutex);
+
+                // check if this is a failure message
+                if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' && 
+                    strcmp(bcast->message, ">>failed<<") == 0) {
+                    // failure message, signal the main thread to close
+                    pthread_mutex_unlock(&ncurses_mutex);
+                    free(bcast);
+                    running = 0; //quit
+                    break;
+                }
+
+                // the server moved our broadcasts onto the ring - start reading where TCP stopped
+                if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' &&
+                    strncmp(bcast->message, LOCAL_MSG, strlen(LOCAL_MSG)) == 0) {
+                    if (!ring_thread_running && localRing.mapping != NULL) {
+                        localRing.nextSequence = strtoull(bcast->message + strlen(LOCAL_MSG), NULL, 10);
+                        ring_thread_running = 1;
+                        pthread_create(&ring_thread, NULL, ring_handler, NULL);
+                    }
+                    pthread_mutex_unlock(&ncurses_mutex);
+                    free(bcast);
+                    continue;
+                }
+
+                // the server moved our broadcasts onto the multicast group
+                if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' &&
+                    strncmp(bcast->message, MULTICAST_MSG, strlen(MULTICAST_MSG)) == 0) {
+                    if (!multicast_thread_running && multicast_sock >= 0) {
+                        multicast_expected = strtoull(bcast->message + strlen(MULTICAST_MSG), NULL, 10);
+                        multicast_thread_running = 1;
+                        pthread_create(&multicast_thread, NULL, multicast_handler, NULL);
+                    }
+                    pthread_mutex_unlock(&ncurses_mutex);
+                    free(bcast);
+                    continue;
+                }
+
+                // repaired broadcasts follow this header and are displayed as usual
+                if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' &&
+                    strncmp(bcast->message, MULTICAST_REPAIR_MSG, strlen(MULTICAST_REPAIR_MSG)) == 0) {
+                    unsigned long long numRepaired = 0, numLost = 0;
+                    sscanf(bcast->message + strlen(MULTICAST_REPAIR_MSG), "%llu %llu", &numRepaired, &numLost);
+                    if (numLost > 0) {
+                        char notice[BROADCAST_MESSAGE_LENGTH + 1];
+                        snprintf(notice, sizeof(notice), "[%llu messages missed]", numLost);
+                        display_message(output_win, "", "", notice, "<<");
+                    }
+                    pthread_mutex_unlock(&ncurses_mutex);
+                    free(bcast);
+                    continue;
+                }
+
+                // someone mentioned this user - ring the bell and say who, the message itself follows
+                if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' &&
+                    strncmp(bcast->message, MENTION_MSG, strlen(MENTION_MSG)) == 0) {
+                    char notice[BROADCAST_MESSAGE_LENGTH + 1];
+                    snprintf(notice, sizeof(notice), "[mentioned by%s]", bcast->message + strlen(MENTION_MSG));
+                    display_message(output_win, "", "", notice, "<<");
+                    beep();
+                    pthread_mutex_unlock(&ncurses_mutex);
+                    free(bcast);
+                    continue;
+                }
+
+                // "who is typing" goes on the window border, not into the history
+                if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' &&
+                    strncmp(bcast->message, TYPING_MSG, strlen(TYPING_MSG)) == 0) {
+                    update_typing_indicator(bcast->message + strlen(TYPING_MSG));
+                    draw_typing_indicator(output_win);
+                    wrefresh(output_win);
+                    pthread_mutex_unlock(&ncurses_mutex);
+                    free(bcast);
+                    continue;
+                }
 
-            // check if this is a failure message
-            if (bcast->clientUserID[0] == '\0' && bcast->clientIP[0] == '\0' && 
-                strcmp(bcast->message, ">>failed<<") == 0) {
-                // failure message, signal the main thread to close
+                 const char* direction = strcmp(bcast->clientUserID, currentUserID) == 0 ? ">>" : "<<";
+
+                display_message(output_win, bcast->clientIP, bcast->clientUserID, bcast->message, direction);
                 pthread_mutex_unlock(&ncurses_mutex);
                 free(bcast);
-                break; //quit
             }
+        }
 
-             const char* direction = strcmp(bcast->clientUserID, currentUserID) == 0 ? ">>" : "<<";
-
-            display_message(output_win, bcast->clientIP, bcast->clientUserID, bcast->message, direction);
-            pthread_mutex_unlock(&ncurses_mutex);
-            free(bcast);
+        // buffer full without a complete message - drop the garbage
+        if (buffered == RECEIVE_BUFFER_LENGTH) {
+            buffered = 0;
         }
     }
     pthread_exit(NULL);
@@ -112,6 +388,67 @@ void *output_handler(void *unused) {
 
 
 
+/**
+ * Function:       update_typing_indicator
+ * Description:    rebuilds the typing line from the user IDs of a ">>typing<<" frame, leaving out
+ *                 this user. An empty list clears it
+ * 
+ * Inputs:
+ *   const char *userIDs - space separated user IDs, possibly ending in "+N" for more users
+ * 
+ * Outputs:       typingIndicator
+ * 
+ * Returns:       None
+ */
+void update_typing_indicator(const char *userIDs) {
+    char list[BROADCAST_MESSAGE_LENGTH + 1];
+    strncpy(list, userIDs, BROADCAST_MESSAGE_LENGTH);
+    list[BROADCAST_MESSAGE_LENGTH] = '\0';
+
+    int length = 0;
+    typingIndicator[0] = '\0';
+
+    char *savePtr = NULL;
+    for (char *userID = strtok_r(list, " ", &savePtr); userID != NULL; userID = strtok_r(NULL, " ", &savePtr)) {
+        if (strcmp(userID, currentUserID) == 0) {
+            continue;
+        }
+        length += snprintf(typingIndicator + length, TYPING_INDICATOR_LENGTH - length, "%s%s", length > 0 ? " " : "", userID);
+        if (length >= TYPING_INDICATOR_LENGTH) {
+            length = TYPING_INDICATOR_LENGTH - 1;
+        }
+    }
+
+    if (length > 0) {
+        snprintf(typingIndicator + length, TYPING_INDICATOR_LENGTH - length, " typing...");
+    }
+}
+
+
+
+/**
+ * Function:       draw_typing_indicator
+ * Description:    draws the typing line on the bottom border of a window (the border alone if nobody is typing)
+ * 
+ * Inputs:
+ *   WINDOW *win - window to draw on
+ * 
+ * Outputs:       the bottom border of the window, not refreshed
+ * 
+ * Returns:       None
+ */
+void draw_typing_indicator(WINDOW *win) {
+    int height, width;
+    getmaxyx(win, height, width);
+
+    mvwhline(win, height - 1, 1, ACS_HLINE, width - 2);
+    if (typingIndicator[0] != '\0') {
+        mvwprintw(win, height - 1, 2, " %.*s ", width - 6, typingIndicator);
+    }
+}
+
+
+
 /**
  * Function:       add_message_to_history
  * Description:    adding message to the chat history. updates the message history structure by
@@ -174,6 +511,7 @@ void display_message(WINDOW *win, const char *ip, const char *username, const ch
         wprintw(win, "%s", messageHistory.messages[historyIndex]);
         historyIndex = (historyIndex + 1) % HISTORY_SIZE;
     }
+    draw_typing_indicator(win);
 
     // refresh the winfow with new info
     wrefresh(win);
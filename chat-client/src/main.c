@@ -23,12 +23,15 @@ int main(int argc, char* argv[]) {
 
     // check if w parsed successfully
     if (strlen(userID) == 0 || strlen(serverName) == 0) {
-        fprintf(stderr, "Usage: %s -user<UserID> -server<ServerName>\n", argv[0]);
+        fprintf(stderr, "Usage: %s -user<UserID> -server<ServerName> [-local] [-multicast] [-tls]\n", argv[0]);
         return 1;
     }
     strncpy(currentUserID, userID, sizeof(currentUserID) - 1);
 
-    sockfd = connectToServer(serverName, PORT_NUM);
+    sockfd = connectToServer(serverName, useTLS ? TLS_PORT_NUM : PORT_NUM);
+    if (useTLS && tls_connect(serverName) < 0) {
+        return 1;
+    }
      char helloMessage[CLIENT_MESSAGE_LENGTH + 1];
      const char* helloMsgContent = ">>hello<<";
     
@@ -49,7 +52,7 @@ int main(int argc, char* argv[]) {
     
     } else {
     
-        if (send(sockfd, jsonMsg, strlen(jsonMsg), 0) < 0) {
+        if (server_send(jsonMsg, strlen(jsonMsg)) < 0) {
             perror("send failed");
         }
         free(jsonMsg); 
@@ -58,7 +61,14 @@ int main(int argc, char* argv[]) {
     // Check server response
     char buffer[JSON_LENGTH];
     memset(buffer, 0, JSON_LENGTH);
-    int bytes_received = recv(sockfd, buffer, JSON_LENGTH, 0);
+    // peek first - a returning user's missed messages may follow right behind the reply,
+    // so only the reply itself is taken off the socket and the rest is left for output_handler
+    int bytes_received = server_recv(buffer, JSON_LENGTH - 1, MSG_PEEK);
+    if (bytes_received > 0) {
+        int frameLength = jsonObjectLength(buffer, bytes_received);
+        memset(buffer, 0, JSON_LENGTH);
+        bytes_received = server_recv(buffer, frameLength > 0 ? frameLength : JSON_LENGTH - 1, 0);
+    }
     if (bytes_received <= 0) {
         perror("Failed to receive data from server");
         return 1;
@@ -85,6 +95,18 @@ int main(int argc, char* argv[]) {
     return 1;
     }
 
+    // same host as the server - map its broadcast ring and ask for broadcasts through it.
+    // output_handler starts reading it once the server says where to start
+    if (useLocalRing && localRingOpen(&localRing) == LOCAL_RING_SUCCESS) {
+        send_server_request(userID, LOCAL_MSG);
+    }
+
+    // LAN client - join the multicast group and ask for broadcasts through it.
+    // output_handler starts listening once the server says which sequence number comes next
+    if (useMulticast && (multicast_sock = joinMulticastGroup(sockfd)) >= 0) {
+        send_server_request(userID, MULTICAST_MSG);
+    }
+
     pthread_t input_thread, output_thread;
     pthread_create(&input_thread, NULL, input_handler, (void*)userID);
     pthread_create(&output_thread, NULL, output_handler, NULL);
@@ -92,8 +114,22 @@ int main(int argc, char* argv[]) {
     pthread_join(input_thread, NULL);
     pthread_join(output_thread, NULL);
 
+    if (ring_thread_running) {
+        ring_thread_running = 0;
+        pthread_join(ring_thread, NULL);
+    }
+    localRingClose(&localRing);
+    if (multicast_thread_running) {
+        multicast_thread_running = 0;
+        pthread_join(multicast_thread, NULL);
+    }
+    if (multicast_sock >= 0) {
+        close(multicast_sock);
+    }
+
     //cleaning up
     endwin();
+    tls_close();
     close(sockfd);
     pthread_mutex_destroy(&ncurses_mutex);
     
@@ -0,0 +1,115 @@
+/*
+* Filename:		chatLog.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the persisted chat log of the CHAT-SYSTEM server.
+*/
+
+#ifndef CHATLOG_H_INCLUDED
+#define CHATLOG_H_INCLUDED
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <pthread.h>
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverMemory.h"
+#include "crc32c.h"
+
+#define CHAT_LOG_DIR "./chat-log"
+#define LOG_SEGMENT_PREFIX "segment-"
+#define LOG_SEGMENT_SUFFIX ".v2.log"     // Record format version - segments of other versions are ignored
+#define LOG_SEGMENT_NAME_LENGTH 64
+#define LOG_DIR_LENGTH 128
+#define LOG_PATH_LENGTH 256
+#define LOG_SEGMENT_MAX_RECORDS 65536   // 65536 records of 96 bytes = 6 MiB per segment
+#define LOG_RECOVERY_CHUNK_RECORDS 4096 // Records validated per read during recovery
+#define LOG_PUNCH_BLOCK_SIZE 4096       // Granularity of head compaction (file system block)
+
+// Retention - 0 disables a limit (can be overridden at compile time)
+#ifndef LOG_RETENTION_MAX_AGE_SECONDS
+#define LOG_RETENTION_MAX_AGE_SECONDS (7 * 24 * 60 * 60)   // 1 week
+#endif
+#ifndef LOG_RETENTION_MAX_BYTES
+#define LOG_RETENTION_MAX_BYTES (1024ULL * 1024ULL * 1024ULL)  // 1 GiB
+#endif
+#define LOG_RETENTION_INTERVAL_SECONDS 60
+#define LOG_RETENTION_LOOP_SLEEP_LENGTH 10000    // 10 milliseconds
+
+#define RETENTION_RUNNING 1
+#define RETENTION_STOPPED 0
+
+#define LOG_RECORD_BROADCAST 0          // Sent to everyone - replayed and indexed
+#define LOG_RECORD_DIRECT 1             // Direct message queued in recipientUserID's mailbox
+#define LOG_RECORD_DIRECT_DELIVERED 2   // Direct message sent live to recipientUserID - never queued
+#define LOG_RECORD_MAILBOX_DRAINED 3    // recipientUserID's mailbox was delivered - carries no message
+
+#define LOG_SUCCESS 0
+#define LOG_ERROR -1
+#define LOG_NOT_FOUND -2
+#define LOG_CORRUPT -3
+
+// One persisted chat message. Records are fixed size, so a record is found by its sequence alone.
+// The checksum is a CRC32C of everything from kind to the end of the record.
+typedef struct
+{
+    uint32_t checksum;
+    uint32_t kind;
+    uint64_t sequence;
+    int64_t timestamp;
+    Broadcast broadcast;
+    char recipientUserID[CLIENT_USERID_LENGTH + 1];     // Empty for LOG_RECORD_BROADCAST
+} LogRecord;
+
+// A segment file holds the records [baseSequence, baseSequence + numRecords), of which
+// [firstSequence, baseSequence + numRecords) are still retained (older ones were compacted away)
+typedef struct
+{
+    uint64_t baseSequence;
+    uint64_t firstSequence;
+    uint64_t numRecords;
+    int fd;
+} LogSegment;
+
+typedef struct
+{
+    int numSegments;
+    uint64_t retainedBytes;
+    uint64_t deletedSegments;       // Removed by retention
+    uint64_t truncatedRecords;      // Torn records dropped during recovery
+    uint64_t corruptRecords;        // Checksum failures seen when reading
+} LogStats;
+
+// Set-up
+int logOpen(const char* logDir);
+void logClose();
+
+// Appending and reading
+int64_t logAppend(const Broadcast* broadcastP);
+int64_t logAppendDirect(const Broadcast* broadcastP, const char* recipientUserID);
+int64_t logAppendDelivered(const Broadcast* broadcastP, const char* recipientUserID);
+int64_t logAppendMailboxDrained(const char* recipientUserID);
+int logRead(uint64_t sequence, LogRecord* recordP);
+int logReadRange(uint64_t startSequence, LogRecord* records, int maxRecords);
+int logRecordIsValid(const LogRecord* recordP, uint64_t expectedSequence);
+
+// Sequence bounds - records in [first, next) are available
+uint64_t logGetFirstSequence();
+uint64_t logGetNextSequence();
+
+// Retention
+int logRetentionStart();
+void logRetentionStop();
+int logApplyRetention(int64_t maxAgeSeconds, uint64_t maxBytes);
+
+// Stats
+void logGetStats(LogStats* statsP);
+
+#endif //CHATLOG_H_INCLUDED
@@ -10,7 +10,24 @@
 #define CHATSERVER_H_INCLUDED
 
 #include <ctype.h>
+#include <signal.h>
 #include "serverIPC.h"
+#include "serverMemory.h"
+#include "chatLog.h"
+#include "historyIndex.h"
+#include "serverSession.h"
+#include "serverSnapshot.h"
+#include "serverMailbox.h"
+#include "serverPresence.h"
+#include "serverFirehose.h"
+#include "serverLocalRing.h"
+#include "serverMulticast.h"
+#include "serverWebSocket.h"
+#include "serverTLS.h"
+#include "serverFilter.h"
+#include "serverSpam.h"
+#include "serverCoroutine.h"
+#include "serverScheduler.h"
 
 //#define TESTING // Uncomment for testing!
 
@@ -24,6 +41,10 @@
 #define THREAD_STARTUP_SHUTDOWN_SLEEP_LENGTH 2     // 2 seconds
 #define THREAD_LOOP_SLEEP_LENGTH 10000    // 10 milliseconds
 
+#define FANOUT_PARALLEL_THRESHOLD 4     // A broadcast to fewer clients is sent by the broadcaster alone
+
+#define SESSION_STACK_RESERVE (32 * 1024)   // Stack a session's deepest path (registration) may use - none of it sized by MAX_CLIENTS
+
 #define RUNNING 1
 #define STOPPING 0
 
@@ -38,8 +59,17 @@
 #define SERVER_QUIT_MSG ">>bye<<"
 #define SERVER_REGISTRATION_SUCCESS_MSG ">>success<<"
 #define SERVER_REGISTRATION_FAIL_MSG ">>failed<<"
+#define SERVER_SEARCH_MSG ">>search<<"
+#define SERVER_SEARCH_RESULTS_MSG ">>results<<"
+#define SERVER_MISSED_MSG ">>missed<<"
+#define SERVER_DIRECT_MSG ">>dm<<"
+#define SERVER_MAILBOX_MSG ">>mail<<"
 
 #define TYPE_SERVERMESSAGE 1
+#define TYPE_BROADCASTER_WAKE 2     // Wakes the broadcaster to check for clients - queued after every broadcast
+
+#define STATS_SIGNAL SIGUSR1 // Send this signal to the server to print its stats
+#define FILTER_RELOAD_SIGNAL SIGHUP // Send this signal to the server to reload its filter patterns
 
 typedef struct NewClient
 {
@@ -47,6 +77,19 @@ typedef struct NewClient
     SharedData* sharedDataP;
 } NewClient;
 
+// One registry shard's clients to send one broadcast to, as a scheduler task
+typedef struct FanoutChunk
+{
+    RegistryShard* shardP;
+    const char* broadcastMsg;
+    size_t broadcastLength;
+    char* websocketFrame;           // Shared by all chunks - framed on first use
+    size_t* websocketFrameLengthP;  // 0 until framed
+    const MentionList* onlyMentionsP;   // Set while shedding - only the users it mentions get the broadcast over TCP
+    int hasMulticastClients;        // Set if a client in the shard gets broadcasts by multicast
+    SchedulerTask task;
+} FanoutChunk;
+
 // Set-up
 int setupServer(int* msgQID, int* sharedMemID, int* serverSocket);
 int cleanUpServer(int msgQID, int sharedMemID, int serverSocket);
@@ -55,16 +98,38 @@ int cleanUpServer(int msgQID, int sharedMemID, int serverSocket);
 int runServer();
 
 // Threads
+int startServerThreads(SharedData* sharedDataP);
+int startClientHandler(int clientSocket, SharedData* sharedDataP);
+int acceptWebSocketClient(int clientSocket, void* arg);
+int acceptTLSClient(int clientSocket, void* arg);
 void* clientConnectionMonitor(void* arg);
 void* clientHandler (void* arg); 
 void* chatBroadcaster(void* arg);
+void wakeBroadcaster(SharedData* sharedDataP);
 
 // Helper functions
-int processMessage(int clientSocket, const char* clientIP, SharedData* sharedDataP, int isRegistration);
-int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, SharedData* sharedDataP);
+int processMessage(int clientSocket, const char* clientIP, char* clientUserID, SharedData* sharedDataP, int isRegistration);
+int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, const MentionList* mentionsP, SharedData* sharedDataP);
+void sendFilteredMessage(const char* clientIP, ClientMessage* clientMessageP, const MentionList* mentionsP, int verdict, void* arg);
+int buildBroadcasts(const char* clientIP, const ClientMessage* clientMessageP, Broadcast* broadcastMessages);
 char* getClientIP(int clientSocket);
 void splitString(const char *input, char *firstPart, char *secondPart, int maxSize);
-void sendServerMessage(int clientSocket, const char* serverMessage);
+void sendServerMessage(int clientSocket, const char* serverMessage, int flags);
+int sendBroadcast(int clientSocket, Broadcast* broadcastP, int flags);
+void fanOutChunk(void* arg);
+void sendMentionFlags(const char* senderUserID, const MentionList* mentionsP, SharedData* sharedDataP);
+void sendMentionCopies(const char* clientIP, const ClientMessage* clientMessageP, const MentionList* mentionsP, SharedData* sharedDataP);
+void sendSearchResults(int clientSocket, const char* query);
+void sendMissedMessages(int clientSocket, uint64_t fromSequence);
+int sendDirectMessage(int clientSocket, const char* clientIP, ClientMessage* clientMessageP, SharedData* sharedDataP);
+void sendMailbox(int clientSocket, const char* clientUserID);
+void moveToLocalRing(int clientSocket, const char* clientUserID, SharedData* sharedDataP);
+void moveToMulticast(int clientSocket, const char* clientUserID, SharedData* sharedDataP);
 int isWhitespace(const char *str);
 
+// Stats
+void handleStatsSignal(int signalNumber);
+void handleReloadSignal(int signalNumber);
+void printServerStats(SharedData* sharedDataP);
+
 #endif //CHATSERVER_H_INCLUDED
\ No newline at end of file
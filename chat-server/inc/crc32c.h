@@ -0,0 +1,21 @@
+/*
+* Filename:		crc32c.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for CRC32C (Castagnoli) checksums used by the CHAT-SYSTEM server.
+*/
+
+#ifndef CRC32C_H_INCLUDED
+#define CRC32C_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CRC32C_POLYNOMIAL 0x82F63B78 // Reflected Castagnoli polynomial
+
+uint32_t crc32c(const void* data, size_t length);
+uint32_t crc32cExtend(uint32_t crc, const void* data, size_t length);
+int crc32cIsHardwareAccelerated();
+
+#endif //CRC32C_H_INCLUDED
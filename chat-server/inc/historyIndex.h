@@ -0,0 +1,65 @@
+/*
+* Filename:		historyIndex.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the full-text history index of the CHAT-SYSTEM server.
+*/
+
+#ifndef HISTORYINDEX_H_INCLUDED
+#define HISTORYINDEX_H_INCLUDED
+
+#include <stdint.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "chatLog.h"
+#include "serverMemory.h"
+#include "serverSnapshot.h"
+
+#define INDEX_MAX_TERM_LENGTH BROADCAST_MESSAGE_LENGTH
+#define INDEX_MAX_TERMS_PER_MESSAGE (BROADCAST_MESSAGE_LENGTH / 2 + 1)
+#define INDEX_INITIAL_TABLE_SIZE 1024   // Must be a power of 2
+#define INDEX_INITIAL_POSTINGS_SIZE 16
+#define INDEX_BATCH_RECORDS 256         // Records indexed per write-lock
+#define INDEX_PRUNE_BATCH 4096          // Table slots pruned per write-lock
+#define INDEX_LOOP_SLEEP_LENGTH 10000   // 10 milliseconds
+
+#define SEARCH_MAX_TERMS 8
+#define SEARCH_MAX_RESULTS 10
+
+#define INDEXER_RUNNING 1
+#define INDEXER_STOPPED 0
+
+#define INDEX_SUCCESS 0
+#define INDEX_ERROR -1
+
+// Posting list for one term: the sequence numbers of the records containing it, stored
+// as varint-encoded deltas (first entry relative to 0).
+typedef struct
+{
+    char term[INDEX_MAX_TERM_LENGTH + 1];
+    uint8_t* postings;
+    size_t length;
+    size_t capacity;
+    uint64_t lastSequence;
+    uint32_t count;
+} PostingList;
+
+// Indexer thread
+int historyIndexStart();
+void historyIndexStop();
+
+// Snapshots - Begin/End bracket a fork(); Write runs in the child process
+void historyIndexBeginSnapshot(uint64_t* indexedUpToP, uint64_t* firstSequenceP, uint32_t* numTermsP);
+void historyIndexWriteSnapshot(SnapshotWriter* writerP);
+void historyIndexEndSnapshot();
+int historyIndexLoadSnapshot(SnapshotReader* readerP, uint32_t numTerms, uint64_t indexedUpTo, uint64_t firstSequence);
+
+// Searching
+int searchHistory(const char* query, uint64_t* results, int maxResults);
+
+// Stats
+void historyIndexGetStats(uint64_t* indexedUpTo, size_t* numTerms, size_t* postingBytes);
+
+#endif //HISTORYINDEX_H_INCLUDED
@@ -0,0 +1,80 @@
+/*
+* Filename:		serverCoroutine.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the coroutine client sessions of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERCOROUTINE_H_INCLUDED
+#define SERVERCOROUTINE_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverMemory.h"
+
+#ifndef COROUTINE_STACK_SIZE
+#define COROUTINE_STACK_SIZE (64 * 1024)        // Per session, plus a guard page - only the pages touched are resident
+#endif
+#ifndef COROUTINE_NUM_LOOPS
+#define COROUTINE_NUM_LOOPS 2                   // Event loop threads the sessions are spread over
+#endif
+
+#define COROUTINE_POOL_LENGTH 1024              // Stacks kept for reuse once their session ends
+#define COROUTINE_MAX_EVENTS 256                // Events taken from epoll per wait
+#define COROUTINE_NO_TIMEOUT -1
+
+#define COROUTINE_RUNNING 1
+#define COROUTINE_STOPPED 0
+
+#define COROUTINE_READY 0                       // The socket can be read (or written)
+#define COROUTINE_TIMED_OUT 1
+
+#define COROUTINE_SUCCESS 0
+#define COROUTINE_ERROR -1
+
+// A session's sequential code - runs on its own stack until it returns
+typedef void* (*CoroutineEntry)(void* arg);
+
+typedef struct
+{
+    int numSessions;            // Sessions running now
+    int peakSessions;
+    int numPooledStacks;
+    uint64_t sessionsStarted;
+    uint64_t switches;          // Switches into a session
+    uint64_t waits;             // Times a session waited for its socket
+} CoroutineStats;
+
+// Event loops
+int coroutineStart();
+void coroutineStop();
+
+// Sessions
+int coroutineSpawn(CoroutineEntry entry, void* arg);
+pthread_t coroutineSelf();
+void coroutineSetSelf(pthread_t sessionID);
+int coroutineIsSession();
+
+// Waiting without blocking the event loop - outside a session, these block the calling thread as usual
+int coroutineWaitFd(int fd, short events, int timeoutMilliseconds);
+void coroutineSleep(int milliseconds);
+ssize_t coroutineRecv(int fd, void* buffer, size_t length, int flags);
+
+// Stats
+void coroutineGetStats(CoroutineStats* statsP);
+
+#endif //SERVERCOROUTINE_H_INCLUDED
@@ -0,0 +1,120 @@
+/*
+* Filename:		serverFilter.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the message filter stage of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERFILTER_H_INCLUDED
+#define SERVERFILTER_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverMemory.h"
+#include "serverMention.h"
+#include "serverCoroutine.h"
+
+#ifndef FILTER_PATTERN_FILE
+#define FILTER_PATTERN_FILE "chat-filter.conf"  // "block <pattern>" or "mask <pattern>" per line, '#' for comments
+#endif
+
+#define FILTER_BLOCKED_MSG ">>filtered<<"       // Sent to a client whose message was blocked
+
+#define FILTER_NUM_WORKERS 2                    // Messages from one user always go to the same worker, so stay in order
+#define FILTER_QUEUE_LENGTH 256                 // Per worker - a full queue holds the submitting handler up
+#define FILTER_FULL_RETRY_LENGTH 1              // Milliseconds a coroutine session sleeps before looking at a full queue again
+#define FILTER_MAX_PATTERN_LENGTH CLIENT_MESSAGE_LENGTH
+#define FILTER_MAX_STATES 65535                 // States are 16-bit
+#define FILTER_ALPHABET 256
+#define FILTER_RELOAD_CHECK_INTERVAL 1000000    // 1 second between checks of the pattern file
+#define FILTER_LOOP_SLEEP_LENGTH 10000          // 10 milliseconds
+
+#define FILTER_ACTION_BLOCK 0x01
+#define FILTER_ACTION_MASK 0x02
+#define FILTER_MASK_CHARACTER '*'
+
+#define FILTER_PASSED 0
+#define FILTER_MASKED 1
+#define FILTER_BLOCKED 2
+
+#define FILTER_QUEUED 0
+#define FILTER_NOT_QUEUED 1                     // No patterns loaded - the caller passes the message on itself
+
+#define FILTER_RUNNING 1
+#define FILTER_STOPPED 0
+
+#define FILTER_SUCCESS 0
+#define FILTER_ERROR -1
+
+// Next stage of the pipeline - gets every filtered message with its verdict, on a filter worker
+typedef void (*FilterNextStage)(const char* clientIP, ClientMessage* clientMessageP, const MentionList* mentionsP, int verdict, void* stageArg);
+
+// All patterns compiled into one deterministic Aho-Corasick automaton - never changed once built
+typedef struct
+{
+    int numPatterns;
+    int numStates;
+    uint16_t* transitions;      // numStates * FILTER_ALPHABET, failure links already folded in
+    uint8_t* actions;           // FILTER_ACTION_ bits of every pattern ending in this state
+    uint8_t* maskLengths;       // Longest mask pattern ending in this state
+    int references;             // Workers using it, plus one while it is the current automaton
+} FilterAutomaton;
+
+// A message waiting for a worker
+typedef struct
+{
+    char clientIP[CLIENT_IP_LENGTH + 1];
+    ClientMessage message;
+    MentionList mentions;
+} FilterJob;
+
+typedef struct
+{
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty;
+    pthread_cond_t notFull;
+    FilterJob* queue;
+    int head;
+    int numQueued;
+} __attribute__((aligned(CACHE_LINE_LENGTH))) FilterWorker;     // Workers take their own mutex - keep them apart
+
+typedef struct
+{
+    int numPatterns;
+    int numStates;
+    uint64_t messagesFiltered;
+    uint64_t messagesMasked;
+    uint64_t messagesBlocked;
+    uint64_t reloads;
+    uint64_t reloadsFailed;
+} FilterStats;
+
+// Filter workers
+int filterStart(FilterNextStage nextStage, void* stageArg);
+void filterStop();
+void filterRequestReload();
+
+// Filtering
+int filterSubmit(const char* clientIP, const ClientMessage* clientMessageP, const MentionList* mentionsP);
+int filterApply(const FilterAutomaton* automaton, char* message);
+int filterCheck(char* message);
+
+// Patterns
+FilterAutomaton* filterCompile(const char* patternFile);
+void filterFree(FilterAutomaton* automaton);
+
+// Stats
+void filterGetStats(FilterStats* statsP);
+
+#endif //SERVERFILTER_H_INCLUDED
@@ -0,0 +1,94 @@
+/*
+* Filename:		serverFirehose.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the read-only firehose subscribers of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERFIREHOSE_H_INCLUDED
+#define SERVERFIREHOSE_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef FIREHOSE_ZLIB
+#include <zlib.h>
+#endif
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverIPC.h"
+#include "serverMemory.h"
+
+#define FIREHOSE_PORT 30001
+#define FIREHOSE_SUBSCRIBE_MSG ">>firehose<<"       // ">>firehose<<" or ">>firehose<< deflate"
+#define FIREHOSE_DEFLATE_OPTION "deflate"
+#define FIREHOSE_SUCCESS_MSG ">>success<<"          // ">>success<<" or ">>success<< deflate" - how the stream is encoded
+#define FIREHOSE_FAIL_MSG ">>failed<<"
+#define FIREHOSE_LAGGED_MSG ">>lagged<<"            // ">>lagged<< <count>" - messages skipped because the subscriber fell behind
+
+#define FIREHOSE_MAX_SUBSCRIBERS 16
+#define FIREHOSE_RING_SLOTS 4096                    // A subscriber further behind than this loses the oldest messages
+#define FIREHOSE_BATCH_INTERVAL 50000               // 50 milliseconds - each subscriber gets at most one write per interval
+#define FIREHOSE_BATCH_MAX_MESSAGES 256
+#define FIREHOSE_BATCH_LENGTH ((FIREHOSE_BATCH_MAX_MESSAGES + 1) * JSON_LENGTH)
+#define FIREHOSE_OUTPUT_LENGTH (FIREHOSE_BATCH_LENGTH + 1024)   // Room for deflate's worst-case expansion
+#define FIREHOSE_HANDSHAKE_TIMEOUT 2000000          // 2 seconds to send the subscription request
+#define FIREHOSE_LOOP_SLEEP_LENGTH 10000            // 10 milliseconds
+#define FIREHOSE_DEFLATE_LEVEL 1                    // Fastest - the stream is mostly repeated JSON keys anyway
+
+#define FIREHOSE_RUNNING 1
+#define FIREHOSE_STOPPED 0
+
+#define FIREHOSE_SLOT_FREE 0
+#define FIREHOSE_SLOT_HANDSHAKE 1
+#define FIREHOSE_SLOT_STREAMING 2
+
+#define FIREHOSE_SUCCESS 0
+#define FIREHOSE_ERROR -1
+
+typedef struct
+{
+    int state;
+    int socket;
+    int isCompressed;
+    int64_t connectedAt;        // Monotonic microseconds, for the handshake timeout
+    uint64_t nextSequence;      // Next ring position this subscriber has not seen
+    char request[JSON_LENGTH];  // Subscription request received so far
+    int requestLength;
+    char* output;               // Batch being sent
+    size_t outputLength;
+    size_t outputSent;
+#ifdef FIREHOSE_ZLIB
+    z_stream deflater;          // One stream per subscriber, flushed after every batch
+#endif
+} FirehoseSubscriber;
+
+typedef struct
+{
+    int numSubscribers;
+    uint64_t messagesPublished;
+    uint64_t messagesSent;
+    uint64_t messagesDropped;   // Skipped for subscribers that fell behind
+    uint64_t batchesSent;
+    uint64_t bytesBeforeCompression;
+    uint64_t bytesSent;
+} FirehoseStats;
+
+// Firehose thread
+int firehoseStart(uint16_t firehosePort);
+void firehoseStop();
+
+// Feeding the firehose
+void firehosePublish(const Broadcast* broadcastP);
+
+// Stats
+void firehoseGetStats(FirehoseStats* statsP);
+
+#endif //SERVERFIREHOSE_H_INCLUDED
@@ -23,8 +23,21 @@
 #include <pthread.h>
 
 #include "../../common/inc/commonMessaging.h"
+#include "serverMention.h"
 
+#ifndef MAX_CLIENTS
 #define MAX_CLIENTS 10
+#endif
+#ifndef REGISTRY_NUM_SHARDS
+#define REGISTRY_NUM_SHARDS 8       // Independently locked partitions of the client registry
+#endif
+
+// Clients one shard has room for: an even share, plus a quarter and REGISTRY_SHARD_SLACK more for an
+// uneven hash - many standard deviations for any MAX_CLIENTS - but never more than MAX_CLIENTS
+#define REGISTRY_SHARD_SLACK 32
+#define REGISTRY_SHARD_SHARE ((MAX_CLIENTS + REGISTRY_NUM_SHARDS - 1) / REGISTRY_NUM_SHARDS)
+#define REGISTRY_SHARD_CAPACITY (REGISTRY_SHARD_SHARE + REGISTRY_SHARD_SHARE / 4 + REGISTRY_SHARD_SLACK < MAX_CLIENTS ? \
+    REGISTRY_SHARD_SHARE + REGISTRY_SHARD_SHARE / 4 + REGISTRY_SHARD_SLACK : MAX_CLIENTS)
 
 #define SUCCESS 0
 #define SOCKET_ERROR -1
@@ -36,6 +49,10 @@
 #define SHARED_MEM_SECRET 16535
 #define SHARED_MEM_PATH "."
 
+#define DELIVERY_TCP 0
+#define DELIVERY_LOCAL_RING 1   // Reads broadcasts from the shared-memory ring, not its socket
+#define DELIVERY_MULTICAST 2    // Gets broadcasts from the multicast group, repairs over its socket
+
 #define ENTRY_NOT_FOUND_OR_NULL -1
 #define TOO_MANY_CLIENTS -2
 
@@ -45,25 +62,43 @@ typedef struct
 {
     long type;
     Broadcast broadcastMessage; 
+    MentionList mentions;       // Users the message mentions - only on the first part of a split message
 } QueueMessageEnvelope;
 
+#define QUEUE_MESSAGE_LENGTH (sizeof(QueueMessageEnvelope) - sizeof(long))
+
 typedef struct
 {
     pthread_t threadID;
     char clientIP[CLIENT_IP_LENGTH + 1];
     char clientUserID[CLIENT_USERID_LENGTH + 1];
     int clientSocket;
+    int delivery;       // How the client gets broadcasts - DELIVERY_TCP, DELIVERY_LOCAL_RING or DELIVERY_MULTICAST
 } ClientState;
 
 
+// One partition of the client registry - a client lives in the shard its user ID hashes to.
+// A shard has room for REGISTRY_SHARD_CAPACITY clients; should a hash ever fill one, a client
+// hashing to it is turned away as if the server were full.
+// Shards start on a cache line of their own, so taking one shard's lock never slows down another's.
+typedef struct
+{
+    pthread_mutex_t mutex;
+    int numClients;
+    ClientState connectedClients[REGISTRY_SHARD_CAPACITY];
+} __attribute__((aligned(CACHE_LINE_LENGTH))) RegistryShard;
+
+
+// Laid out by how often each part is written: the read-mostly fields share the first cache line,
+// and the join/leave counter and the broadcaster's mutex each get a line of their own.
 typedef struct
 {
     int msgQueueID;
     int serverSocket;
-    int numClients;
-    int serverIsRunning;
-    pthread_mutex_t mutex;
-    ClientState connectedClients[MAX_CLIENTS];
+    int serverIsRunning;                // Cleared atomically, before serverSocket is closed - read without a lock
+    int numClients __attribute__((aligned(CACHE_LINE_LENGTH)));  // Across all shards - updated atomically, read without a lock
+    pthread_mutex_t deliveryMutex __attribute__((aligned(CACHE_LINE_LENGTH)));  // Orders broadcasts against clients changing how they get them
+    RegistryShard shards[REGISTRY_NUM_SHARDS];
 } SharedData;
 
 
@@ -82,10 +117,17 @@ int closeSharedMemory(int sharedMemID);
 
 // SharedData processing
 SharedData* getSharedData(int sharedMemID);
-int findThreadIDInList(pthread_t threadID, SharedData* sharedDataP);
-int findUserInList(const char* clientIP, const char* clientUserID, SharedData* sharedDataP);
+int initSharedData(SharedData* sharedDataP, int msgQID, int serverSocket);
+int sharedDataIsRunning(SharedData* sharedDataP);
+void sharedDataStop(SharedData* sharedDataP);
+RegistryShard* registryGetShard(const char* clientUserID, SharedData* sharedDataP);
+void registryLockAll(SharedData* sharedDataP);
+void registryUnlockAll(SharedData* sharedDataP);
+int registryGetNumClients(SharedData* sharedDataP);
+int findThreadIDInList(pthread_t threadID, RegistryShard* shardP);
+int findUserInList(const char* clientIP, const char* clientUserID, RegistryShard* shardP);
 int addToList(pthread_t threadID, const char* clientIP, const char* clientUserID, int clientSocket, SharedData* sharedDataP);
-int removeFromList(int entryIndex, SharedData* sharedDataP);
+int removeFromList(int entryIndex, RegistryShard* shardP, SharedData* sharedDataP);
 
 // For testing
 void printSharedData(SharedData* sharedDataP);
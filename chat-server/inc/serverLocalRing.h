@@ -0,0 +1,50 @@
+/*
+* Filename:		serverLocalRing.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the shared-memory broadcast ring of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERLOCALRING_H_INCLUDED
+#define SERVERLOCALRING_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "../../common/inc/localRing.h"
+
+#define LOCAL_RING_MSG ">>local<<"          // Client asks for broadcasts through the ring; the reply is ">>local<< <sequence>"
+#define LOCAL_RING_BACKLOG 16
+
+#define LOCAL_RING_RUNNING 1
+#define LOCAL_RING_STOPPED 0
+
+typedef struct
+{
+    uint64_t ringsHandedOut;
+    uint64_t broadcastsWritten;
+    uint64_t wakeups;
+} LocalRingStats;
+
+// Ring and hand-out thread
+int localRingStart();
+void localRingStop();
+
+// Writing the ring - only ever called by the chat broadcaster
+void localRingPublish(const Broadcast* broadcastP);
+uint64_t localRingGetHead();
+int localRingIsAvailable();
+
+// Stats
+void localRingGetStats(LocalRingStats* statsP);
+
+#endif //SERVERLOCALRING_H_INCLUDED
@@ -0,0 +1,62 @@
+/*
+* Filename:		serverMailbox.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the offline direct message mailboxes of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERMAILBOX_H_INCLUDED
+#define SERVERMAILBOX_H_INCLUDED
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverMemory.h"
+#include "chatLog.h"
+#include "serverSnapshot.h"
+
+#define MAILBOX_MAX_USERS 1024          // Users with pending direct messages
+#define MAILBOX_MAX_MESSAGES 32         // Pending messages per user - the oldest is dropped beyond this
+#define MAILBOX_RECOVERY_BATCH 256      // Log records scanned per read when recovering mailboxes
+
+#define MAILBOX_SUCCESS 0
+#define MAILBOX_FULL -1
+#define MAILBOX_ERROR -2
+
+// Pending direct messages for one user, as a ring of log sequence numbers (the messages
+// themselves are only stored once, in the chat log)
+typedef struct
+{
+    char recipientUserID[CLIENT_USERID_LENGTH + 1];
+    uint32_t count;
+    uint32_t head;              // Index of the oldest pending message
+    uint64_t sequences[MAILBOX_MAX_MESSAGES];
+} Mailbox;
+
+typedef struct
+{
+    int numMailboxes;
+    uint64_t numPending;
+    uint64_t numQueued;
+    uint64_t numDelivered;
+    uint64_t numDropped;        // Pushed out of a full mailbox, or refused because all mailboxes were in use
+} MailboxStats;
+
+// Posting and collecting
+int mailboxPost(const char* recipientUserID, const Broadcast* broadcastP);
+int mailboxPeek(const char* recipientUserID, uint64_t* sequences, int maxSequences);
+void mailboxAck(const char* recipientUserID, uint64_t lastSequence);
+
+// Snapshots - Begin/End bracket a fork(); Write runs in the child process
+void mailboxBeginSnapshot(uint64_t* upToP, uint32_t* numMailboxesP);
+void mailboxWriteSnapshot(SnapshotWriter* writerP);
+void mailboxEndSnapshot();
+int mailboxLoadSnapshot(SnapshotReader* readerP, uint32_t numMailboxes);
+void mailboxRecoverFromLog(uint64_t fromSequence);
+
+// Stats
+void mailboxGetStats(MailboxStats* statsP);
+
+#endif //SERVERMAILBOX_H_INCLUDED
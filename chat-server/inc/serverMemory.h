@@ -0,0 +1,71 @@
+/*
+* Filename:		serverMemory.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains the memory accountant for the CHAT-SYSTEM server.
+*               Every heap allocation made by the server is charged to one of a few categories,
+*               so that memory use can be capped by a hard budget and reported per subsystem.
+*/
+
+#ifndef SERVERMEMORY_H_INCLUDED
+#define SERVERMEMORY_H_INCLUDED
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+
+// Hard budget for all accounted server memory (can be overridden at compile time)
+#ifndef MEMORY_BUDGET_BYTES
+#define MEMORY_BUDGET_BYTES (64UL * 1024UL * 1024UL)   // 64 MiB
+#endif
+
+// Above this percentage of the budget, the server starts shedding new work
+#define MEMORY_SHED_WATERMARK_PERCENT 90
+
+// memAllocHuge() puts its blocks on huge pages (built with CHAT_HUGE_PAGES), rounded up to whole pages -
+// it is for the few pools every fan-out walks, where the TLB misses are worth the rest of a page
+#define MEMORY_HUGE_PAGE_LENGTH (2UL * 1024UL * 1024UL)
+
+#define MEMORY_OK 0
+#define MEMORY_OVER_BUDGET -1
+
+typedef enum
+{
+    MEM_CONNECTION_STATE = 0,   // Per-client state (IP strings, session data)
+    MEM_OUTBOUND_BUFFERS,       // Serialized broadcasts waiting to be sent
+    MEM_HISTORY_CACHE,          // Stored chat history and indexes
+    MEM_PARSER_BUFFERS,         // Deserialized client messages
+    MEM_FILTER_PATTERNS,        // Compiled moderation patterns and queued messages
+    MEM_NUM_CATEGORIES
+} MemoryCategory;
+
+// Reclaimer callback - asked to free up to bytesWanted bytes, returns the number of bytes freed
+typedef size_t (*MemoryReclaimer)(size_t bytesWanted);
+
+// Budget
+void memSetBudget(size_t budgetBytes);
+size_t memGetBudget();
+int memIsUnderPressure();
+
+// Allocation and accounting
+void* memAlloc(MemoryCategory category, size_t size);
+void* memCalloc(MemoryCategory category, size_t count, size_t size);
+void* memRealloc(MemoryCategory category, void* ptr, size_t size);
+void memFree(MemoryCategory category, void* ptr);
+void* memAllocHuge(MemoryCategory category, size_t size);
+void memFreeHuge(MemoryCategory category, void* ptr, size_t size);
+int memCharge(MemoryCategory category, size_t size);
+void memRelease(MemoryCategory category, size_t size);
+void memRegisterReclaimer(MemoryCategory category, MemoryReclaimer reclaimer);
+
+// Load shedding counters
+void memNoteShed(MemoryCategory category);
+
+// Stats
+size_t memGetUsed(MemoryCategory category);
+size_t memGetTotalUsed();
+const char* memCategoryName(MemoryCategory category);
+void memPrintStats(FILE* out);
+
+#endif //SERVERMEMORY_H_INCLUDED
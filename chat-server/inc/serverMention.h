@@ -0,0 +1,56 @@
+/*
+* Filename:		serverMention.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for @mentions in the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERMENTION_H_INCLUDED
+#define SERVERMENTION_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <pthread.h>
+
+#include "../../common/inc/commonMessaging.h"
+
+#define MENTION_MSG ">>mention<<"               // ">>mention<< <userID>" - sent to a mentioned user ahead of the message
+#define MENTION_MARKER '@'
+#define MENTION_MAX_TARGETS 4                   // Further mentions in one message are ignored
+
+#define MENTION_SUCCESS 0
+#define MENTION_ERROR -1
+
+// Users mentioned in a message, carried with it to the chat broadcaster
+typedef struct
+{
+    int numTargets;
+    char targets[MENTION_MAX_TARGETS][CLIENT_USERID_LENGTH + 1];
+} MentionList;
+
+typedef struct
+{
+    int numUsers;               // Connected users in the trie
+    int numNodes;
+    uint64_t messagesParsed;
+    uint64_t messagesWithMentions;
+    uint64_t mentionsFound;
+    uint64_t priorityCopies;    // Sent straight to a mentioned user while messages were being shed
+} MentionStats;
+
+// Connected users
+int mentionAddUser(const char* clientUserID);
+void mentionRemoveUser(const char* clientUserID);
+
+// Messages
+int mentionParse(const char* message, MentionList* mentionsP);
+int mentionIsTarget(const MentionList* mentionsP, const char* clientUserID);
+void mentionNotePriorityCopy();
+
+// Stats
+void mentionGetStats(MentionStats* statsP);
+
+#endif //SERVERMENTION_H_INCLUDED
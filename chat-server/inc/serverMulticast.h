@@ -0,0 +1,73 @@
+/*
+* Filename:		serverMulticast.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the multicast broadcast mode of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERMULTICAST_H_INCLUDED
+#define SERVERMULTICAST_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../../common/inc/multicastProtocol.h"
+#include "serverMemory.h"
+#include "serverWebSocket.h"
+
+#ifndef MULTICAST_INTERFACE
+#define MULTICAST_INTERFACE "127.0.0.1"     // Address of the interface to send on - loopback unless built for a LAN
+#endif
+
+#define MULTICAST_TTL 1                     // Never routed off the segment
+#define MULTICAST_HISTORY_SLOTS 1024        // Broadcasts kept for repairs
+#define MULTICAST_MAX_REPAIR 64             // Most broadcasts resent for one NACK
+#define MULTICAST_HEARTBEAT_INTERVAL 1000000    // 1 second of silence and a heartbeat is sent
+
+#define MULTICAST_SUCCESS 0
+#define MULTICAST_ERROR -1
+
+// A sent broadcast, kept for repairs
+typedef struct
+{
+    uint64_t sequence;
+    Broadcast broadcast;
+} MulticastHistoryEntry;
+
+typedef struct
+{
+    uint64_t packetsSent;
+    uint64_t heartbeatsSent;
+    uint64_t sendErrors;
+    uint64_t nacksReceived;
+    uint64_t broadcastsRepaired;
+    uint64_t broadcastsLost;        // Asked for, but already gone from the history
+} MulticastStats;
+
+// Multicast socket
+int multicastStart();
+void multicastStop();
+int multicastIsAvailable();
+void multicastAddSubscriber();
+
+// Sending - multicastPublish() is only ever called by the chat broadcaster, multicastHeartbeat() by the client monitor
+void multicastPublish(const Broadcast* broadcastP);
+void multicastHeartbeat();
+uint64_t multicastGetNextSequence();
+
+// Repairs
+void multicastRepair(int clientSocket, const char* nackArguments);
+
+// Stats
+void multicastGetStats(MulticastStats* statsP);
+
+#endif //SERVERMULTICAST_H_INCLUDED
@@ -0,0 +1,89 @@
+/*
+* Filename:		serverPresence.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the presence roster of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERPRESENCE_H_INCLUDED
+#define SERVERPRESENCE_H_INCLUDED
+
+#include <stdint.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverIPC.h"
+#include "serverMemory.h"
+#include "serverWebSocket.h"
+
+#define PRESENCE_ROSTER_MSG ">>roster<<"    // ">>roster<< <count>", followed by ">>online<<" frames
+#define PRESENCE_ONLINE_MSG ">>online<<"
+#define PRESENCE_JOINED_MSG ">>joined<<"
+#define PRESENCE_LEFT_MSG ">>left<<"
+#define PRESENCE_TYPING_MSG ">>typing<<"    // ">>typing<< <userID> ... [+<more>]" - an empty list means nobody is typing
+
+#define PRESENCE_WINDOW_LENGTH 250000       // 250 milliseconds - deltas are coalesced over this window
+#define PRESENCE_LOOP_SLEEP_LENGTH 10000    // 10 milliseconds
+#define PRESENCE_MAX_PENDING 256            // Beyond this, everyone is sent a full roster instead
+#define PRESENCE_MAX_FRAMES (PRESENCE_MAX_PENDING / 4 + 4)
+#define PRESENCE_BATCH_LENGTH (PRESENCE_MAX_FRAMES * JSON_LENGTH)
+
+#define TYPING_EXPIRY_LENGTH 1000000        // 1 second without a ping and a user is no longer typing
+#define TYPING_MAX_UNSENT_BYTES 2048        // A client with this much output still queued is not sent typing frames
+#define TYPING_MORE_LENGTH 4                // Room kept for " +NN" when not every typist fits in the frame
+
+#define PRESENCE_RUNNING 1
+#define PRESENCE_STOPPED 0
+
+#define PRESENCE_SUCCESS 0
+#define PRESENCE_ERROR -1
+
+// A join or leave not yet sent out
+typedef struct
+{
+    char clientIP[CLIENT_IP_LENGTH + 1];
+    char clientUserID[CLIENT_USERID_LENGTH + 1];
+    int isJoin;
+} PresenceDelta;
+
+// A user that has sent a typing ping recently
+typedef struct
+{
+    char clientIP[CLIENT_IP_LENGTH + 1];
+    char clientUserID[CLIENT_USERID_LENGTH + 1];
+    int64_t lastPing;           // Monotonic microseconds
+} TypingUser;
+
+typedef struct
+{
+    uint64_t deltasQueued;
+    uint64_t deltasCoalesced;   // Cancelled out within one window (e.g. a quick reconnect)
+    uint64_t batchesSent;
+    uint64_t framesSent;
+    uint64_t rosterResyncs;
+    uint64_t typingPings;
+    uint64_t typingFramesSent;
+    uint64_t typingFramesDropped;   // Skipped for a backed-up client or under memory pressure
+} PresenceStats;
+
+// Presence thread
+int presenceStart(SharedData* sharedDataP);
+void presenceStop();
+
+// Membership changes
+void presenceJoined(const char* clientIP, const char* clientUserID);
+void presenceLeft(const char* clientIP, const char* clientUserID);
+void presenceSendRoster(int clientSocket, SharedData* sharedDataP);
+
+// Typing indicators
+void presenceTyping(const char* clientIP, const char* clientUserID);
+void presenceStoppedTyping(const char* clientIP, const char* clientUserID);
+
+// Stats
+void presenceGetStats(PresenceStats* statsP);
+
+#endif //SERVERPRESENCE_H_INCLUDED
@@ -0,0 +1,79 @@
+/*
+* Filename:		serverScheduler.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the work-stealing task scheduler of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERSCHEDULER_H_INCLUDED
+#define SERVERSCHEDULER_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "../../common/inc/commonMessaging.h"
+
+#ifndef SCHEDULER_MAX_WORKERS
+#define SCHEDULER_MAX_WORKERS 8                 // Workers started - one per online CPU, up to this many
+#endif
+#ifndef SCHEDULER_NUM_WORKERS
+#define SCHEDULER_NUM_WORKERS 0                 // Workers to start regardless of CPUs (up to the maximum), or 0
+#endif
+
+#define SCHEDULER_DEQUE_LENGTH 256              // Tasks a worker can hold in its deque (power of 2)
+#define SCHEDULER_WAIT_SPINS 1000               // Polls of a task group before a waiter starts sleeping
+#define SCHEDULER_WAIT_SLEEP_LENGTH 50          // 50 microseconds between polls after that
+#define SCHEDULER_ANY_WORKER -1
+
+#define SCHEDULER_RUNNING 1
+#define SCHEDULER_STOPPED 0
+
+#define SCHEDULER_SUCCESS 0
+#define SCHEDULER_ERROR -1
+
+typedef void (*SchedulerFunction)(void* arg);
+
+// Tasks waited for together - schedulerWait() returns once all of them have run
+typedef struct
+{
+    int numPending;
+} SchedulerGroup;
+
+// A task - owned by the submitter, and must stay valid until its group has been waited for
+typedef struct SchedulerTask
+{
+    SchedulerFunction function;
+    void* arg;
+    SchedulerGroup* groupP;
+    struct SchedulerTask* next;     // In a worker's inbox
+} SchedulerTask;
+
+typedef struct
+{
+    int numWorkers;
+    uint64_t tasksSubmitted;
+    uint64_t tasksRun;
+    uint64_t tasksStolen;           // Run by a worker other than the one they were submitted to
+    uint64_t tasksRunByWaiters;     // Run by a thread waiting for its own task group
+    uint64_t tasksRunInline;        // Run by the submitter - no workers, or a full deque
+} SchedulerStats;
+
+// Workers
+int schedulerStart();
+int schedulerStartWorkers(int numWanted);
+void schedulerStop();
+int schedulerIsAvailable();
+
+// Tasks
+void schedulerSubmit(SchedulerTask* taskP, SchedulerGroup* groupP, SchedulerFunction function, void* arg, int affinity);
+void schedulerWait(SchedulerGroup* groupP);
+
+// Stats
+void schedulerGetStats(SchedulerStats* statsP);
+
+#endif //SERVERSCHEDULER_H_INCLUDED
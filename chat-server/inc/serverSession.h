@@ -0,0 +1,47 @@
+/*
+* Filename:		serverSession.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the session registry of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERSESSION_H_INCLUDED
+#define SERVERSESSION_H_INCLUDED
+
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../../common/inc/commonMessaging.h"
+
+#define SESSION_MAX_KNOWN 1024          // Least recently seen sessions are forgotten beyond this
+#define SESSION_REPLAY_MAX_RECORDS 20   // Most missed messages sent to a returning user
+
+#define SESSION_NEW 0
+#define SESSION_RESUMED 1
+
+// A user known to the server - identified, like a registration, by IP and user ID
+typedef struct
+{
+    char clientIP[CLIENT_IP_LENGTH + 1];
+    char clientUserID[CLIENT_USERID_LENGTH + 1];
+    uint8_t isConnected;
+    int64_t lastSeen;
+    uint64_t lastSequence;      // Log sequence up to which the user has received broadcasts
+} SessionRecord;
+
+// Registration and disconnection
+int sessionConnect(const char* clientIP, const char* clientUserID, uint64_t currentSequence, uint64_t* lastSequenceP);
+void sessionDisconnect(const char* clientIP, const char* clientUserID, uint64_t currentSequence);
+int sessionIsKnownUser(const char* clientUserID);
+
+// Snapshots
+int sessionCopyAll(SessionRecord* records, int maxRecords, uint64_t* versionP);
+void sessionRestore(const SessionRecord* records, int numRecords, uint64_t resumeSequence);
+uint64_t sessionGetVersion();
+
+// Stats
+void sessionGetStats(int* numKnown, int* numConnected);
+
+#endif //SERVERSESSION_H_INCLUDED
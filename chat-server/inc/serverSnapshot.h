@@ -0,0 +1,106 @@
+/*
+* Filename:		serverSnapshot.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the registry snapshots of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERSNAPSHOT_H_INCLUDED
+#define SERVERSNAPSHOT_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "crc32c.h"
+
+#define SNAPSHOT_FILE_NAME "registry.snapshot"
+#define SNAPSHOT_TEMP_SUFFIX ".tmp"
+#define SNAPSHOT_PATH_LENGTH 256
+#define SNAPSHOT_MAGIC 0x50534843       // "CHSP"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_WRITE_BUFFER_SIZE 65536
+#define SNAPSHOT_INTERVAL_SECONDS 30
+#define SNAPSHOT_LOOP_SLEEP_LENGTH 10000    // 10 milliseconds
+
+#define SNAPSHOTTER_RUNNING 1
+#define SNAPSHOTTER_STOPPED 0
+
+#define SNAPSHOT_SUCCESS 0
+#define SNAPSHOT_ERROR -1
+#define SNAPSHOT_NOT_FOUND -2
+#define SNAPSHOT_CORRUPT -3
+
+// Start of a snapshot file. It is followed by numSessions SessionRecords, then numMailboxes
+// mailboxes, then numTerms index terms, then a CRC32C of everything before it.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    int64_t createdAt;
+    uint64_t indexedUpTo;       // Log records [indexFirstSequence, indexedUpTo) are in the index
+    uint64_t indexFirstSequence;
+    uint64_t mailboxUpTo;       // Direct messages logged before this are in the mailboxes
+    uint32_t numSessions;
+    uint32_t numMailboxes;
+    uint32_t numTerms;
+    uint32_t reserved;
+} SnapshotHeader;
+
+// Buffered writer used by the snapshot child process - plain write() calls only
+typedef struct
+{
+    int fd;
+    int hasFailed;
+    uint32_t checksum;
+    size_t used;
+    uint8_t buffer[SNAPSHOT_WRITE_BUFFER_SIZE];
+} SnapshotWriter;
+
+// Reader over a mapped snapshot file
+typedef struct
+{
+    const uint8_t* data;
+    size_t length;
+    size_t offset;
+} SnapshotReader;
+
+typedef struct
+{
+    uint64_t numTaken;
+    uint64_t numFailed;
+    uint64_t lastBytes;
+    int64_t lastPauseMicroseconds;  // Time the server was paused to fork
+    int64_t lastWriteMicroseconds;  // Time the child took to write and sync the file
+    int64_t restoreMicroseconds;    // Time the start-up restore took (-1 if nothing was restored)
+    int restoredSessions;
+    uint32_t restoredTerms;
+} SnapshotStats;
+
+// Writing and reading snapshot data
+void snapshotWrite(SnapshotWriter* writerP, const void* data, size_t length);
+int snapshotRead(SnapshotReader* readerP, void* data, size_t length);
+const uint8_t* snapshotReadInPlace(SnapshotReader* readerP, size_t length);
+
+// Taking and restoring snapshots
+int snapshotTake(const char* snapshotDir);
+int snapshotRestore(const char* snapshotDir);
+
+// Snapshot thread
+int snapshotStart(const char* snapshotDir);
+void snapshotStop();
+
+// Stats
+void snapshotGetStats(SnapshotStats* statsP);
+
+#endif //SERVERSNAPSHOT_H_INCLUDED
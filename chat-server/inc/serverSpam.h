@@ -0,0 +1,54 @@
+/*
+* Filename:		serverSpam.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for near-duplicate spam detection in the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERSPAM_H_INCLUDED
+#define SERVERSPAM_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "../../common/inc/commonMessaging.h"
+
+#define SPAM_REJECTED_MSG ">>spam<<"            // Sent to a client whose message was rejected as a flood
+
+#define SPAM_SHINGLE_LENGTH 4                   // Characters per shingle of normalized text
+#define SPAM_NUM_HASHES 8                       // MinHash signature length
+#define SPAM_BAND_SIZE 2                        // Signature values per band - one matching band makes a near-duplicate
+#define SPAM_NUM_BANDS (SPAM_NUM_HASHES / SPAM_BAND_SIZE)
+
+#define SPAM_SKETCH_DEPTH 4                     // Count-min sketch rows
+#define SPAM_SKETCH_WIDTH 4096                  // Counters per row - a power of two
+#define SPAM_WINDOW_LENGTH 15                   // Seconds per window - counts cover the current and previous one
+
+#define SPAM_SENDER_LIMIT 3                     // Near-duplicates one sender may send per window pair
+#define SPAM_GLOBAL_LIMIT 8                     // Near-duplicates all senders together may send per window pair
+#define SPAM_MIN_GLOBAL_LENGTH 8                // Shorter normalized messages ("ok", "lol") are only limited per sender
+
+#define SPAM_ACCEPTED 0
+#define SPAM_SENDER_FLOOD 1
+#define SPAM_GLOBAL_FLOOD 2
+
+typedef struct
+{
+    uint64_t messagesChecked;
+    uint64_t senderFloods;      // Rejected - the same sender repeating itself
+    uint64_t globalFloods;      // Rejected - many senders pasting the same thing
+    uint64_t windowsRotated;
+} SpamStats;
+
+// Checking
+int spamCheck(const char* clientIP, const ClientMessage* clientMessageP);
+
+// Stats
+void spamGetStats(SpamStats* statsP);
+
+#endif //SERVERSPAM_H_INCLUDED
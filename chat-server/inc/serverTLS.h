@@ -0,0 +1,106 @@
+/*
+* Filename:		serverTLS.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for TLS connections to the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERTLS_H_INCLUDED
+#define SERVERTLS_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#ifdef CHAT_TLS
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#endif
+
+#include "serverIPC.h"
+#include "serverMemory.h"
+#include "serverCoroutine.h"
+#include "serverTransport.h"
+
+#define TLS_PORT 30004
+
+#ifndef TLS_CERT_FILE
+#define TLS_CERT_FILE "chat-server.crt"     // PEM certificate chain, relative to the server's working directory
+#endif
+#ifndef TLS_KEY_FILE
+#define TLS_KEY_FILE "chat-server.key"      // PEM private key
+#endif
+
+#define TLS_MAX_FDS 65536                   // Sockets with higher numbers are refused
+#define TLS_OUTPUT_MAX_PENDING 65536        // Bytes queued for a socket beyond which a send that cannot wait is refused
+#define TLS_HANDSHAKE_TIMEOUT 2             // 2 seconds to finish the handshake
+#define TLS_LOOP_SLEEP_LENGTH 10000         // 10 milliseconds
+
+#define TLS_RUNNING 1
+#define TLS_STOPPED 0
+
+#define TLS_SUCCESS 0
+#define TLS_ERROR -1
+
+// Called by the TLS listener for every accepted connection - starts a client handler for it
+typedef int (*TLSAcceptHandler)(int clientSocket, void* handlerArg);
+
+#ifdef CHAT_TLS
+typedef struct
+{
+    SSL* ssl;
+    int isKernelSend;           // kTLS encrypts what is written to the socket - send() is all it takes
+    int isKernelRecv;
+    pthread_mutex_t mutex;      // Without kernel send, SSL_write() and SSL_read() must take turns
+} TLSSession;
+#endif
+
+// What a chat client's socket could not take yet, in the order it was sent.
+// Queues sit side by side in one pool - each on a cache line of its own, so neighbours' sends do not collide.
+typedef struct
+{
+    pthread_mutex_t mutex;      // Never held while waiting for the socket
+    char* pending;              // memAlloc()ed, NULL when nothing is pending
+    size_t pendingLength;
+    short waitEvents;           // What to wait for before the next write - POLLOUT, or POLLIN while OpenSSL reads
+    int isBroken;               // A write failed - nothing more goes out
+} __attribute__((aligned(CACHE_LINE_LENGTH))) TLSOutput;
+
+typedef struct
+{
+    uint64_t handshakes;
+    uint64_t handshakesFailed;
+    uint64_t kernelSendSessions;    // Records encrypted by the kernel
+    uint64_t kernelRecvSessions;    // Records decrypted by the kernel
+    uint64_t userspaceSends;        // Sends that fell back to SSL_write()
+    uint64_t userspaceBytes;
+    uint64_t sendsQueued;           // Sends the socket could not take whole right away
+    uint64_t sendsRefused;          // Sends that could not wait, refused whole with the queue full
+} TLSStats;
+
+// TLS listener
+int tlsStart(uint16_t tlsPort, TLSAcceptHandler acceptHandler, void* handlerArg);
+void tlsStop();
+
+// Connections
+int tlsIsClient(int clientSocket);
+int tlsHandshake(int clientSocket);
+void tlsForget(int clientSocket);
+
+// Reading from and writing to any chat client - sockets without a TLS session use recv() and send()
+ssize_t tlsRecv(int clientSocket, void* buffer, size_t length, int flags);
+ssize_t tlsSend(int clientSocket, const void* data, size_t length, int flags);
+void tlsFlushPending();
+size_t tlsGetPendingLength(int clientSocket);
+
+// Stats
+void tlsGetStats(TLSStats* statsP);
+
+#endif //SERVERTLS_H_INCLUDED
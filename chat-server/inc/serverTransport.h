@@ -0,0 +1,69 @@
+/*
+* Filename:		serverTransport.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the transports that carry the bytes of
+*               CHAT-SYSTEM client connections - sockets, or an in-memory loopback for benchmarks.
+*/
+
+#ifndef SERVERTRANSPORT_H_INCLUDED
+#define SERVERTRANSPORT_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "serverCoroutine.h"
+
+#define TRANSPORT_LOOPBACK_FIRST_SOCKET 40000           // Loopback connections are numbered from here, above any real socket
+#define TRANSPORT_LOOPBACK_MAX_CONNECTIONS 16384        // Keeps every number below TLS_MAX_FDS and WEBSOCKET_MAX_FDS
+#define TRANSPORT_LOOPBACK_INBOX_LENGTH 1024            // Bytes written by the client and not yet read by the server
+#define TRANSPORT_LOOPBACK_OUTBOX_LENGTH 65536          // Bytes sent by the server and not yet read by the client - sends that do not fit are dropped
+
+#define TRANSPORT_SUCCESS 0
+#define TRANSPORT_ERROR -1
+
+// How a client connection's bytes are sent and received
+typedef struct
+{
+    const char* name;
+    ssize_t (*send)(int clientSocket, const void* data, size_t length, int flags);
+    ssize_t (*recv)(int clientSocket, void* buffer, size_t length, int flags);
+} Transport;
+
+typedef struct
+{
+    int numLoopbackConnections;
+    uint64_t loopbackSends;
+    uint64_t loopbackBytesSent;
+    uint64_t loopbackBytesDropped;      // Sent while the client's outbox was full
+    uint64_t loopbackReads;
+    uint64_t loopbackBytesRead;
+} TransportStats;
+
+// Choosing a transport
+const Transport* transportSockets();
+const Transport* transportLoopback();
+void transportUse(const Transport* transportP);
+const Transport* transportGetCurrent();
+
+// Client connection I/O
+ssize_t transportSend(int clientSocket, const void* data, size_t length, int flags);
+ssize_t transportRecv(int clientSocket, void* buffer, size_t length, int flags);
+
+// Loopback connections - the client's end
+int transportLoopbackOpen();
+void transportLoopbackClose(int clientSocket);
+int transportLoopbackWrite(int clientSocket, const void* data, size_t length);
+ssize_t transportLoopbackRead(int clientSocket, void* buffer, size_t length);
+
+// Stats
+void transportGetStats(TransportStats* statsP);
+
+#endif //SERVERTRANSPORT_H_INCLUDED
@@ -0,0 +1,91 @@
+/*
+* Filename:		serverWebSocket.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for the WebSocket gateway of the CHAT-SYSTEM server.
+*/
+
+#ifndef SERVERWEBSOCKET_H_INCLUDED
+#define SERVERWEBSOCKET_H_INCLUDED
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "../../common/inc/commonMessaging.h"
+#include "serverIPC.h"
+#include "serverMemory.h"
+#include "serverTLS.h"
+#include "sha1.h"
+
+#define WEBSOCKET_PORT 30003
+#define WEBSOCKET_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"   // RFC 6455 - appended to the client's key
+#define WEBSOCKET_VERSION "13"
+
+#define WEBSOCKET_MAX_FDS 65536                     // Sockets with higher numbers are refused
+#define WEBSOCKET_REQUEST_LENGTH 4096               // Longest handshake request accepted
+#define WEBSOCKET_HANDSHAKE_TIMEOUT 2               // 2 seconds to send the handshake request
+#define WEBSOCKET_MAX_HEADER_LENGTH 4               // Server frames are never masked and never longer than 65535 bytes
+#define WEBSOCKET_MAX_CONTROL_LENGTH 125
+#define WEBSOCKET_LOOP_SLEEP_LENGTH 10000           // 10 milliseconds
+
+#define WEBSOCKET_OPCODE_CONTINUATION 0x0
+#define WEBSOCKET_OPCODE_TEXT 0x1
+#define WEBSOCKET_OPCODE_BINARY 0x2
+#define WEBSOCKET_OPCODE_CLOSE 0x8
+#define WEBSOCKET_OPCODE_PING 0x9
+#define WEBSOCKET_OPCODE_PONG 0xA
+#define WEBSOCKET_FIN 0x80
+#define WEBSOCKET_MASKED 0x80
+
+#define WEBSOCKET_CLOSE_NORMAL 1000
+#define WEBSOCKET_CLOSE_PROTOCOL_ERROR 1002
+#define WEBSOCKET_CLOSE_UNSUPPORTED 1003
+#define WEBSOCKET_CLOSE_TOO_BIG 1009
+
+#define WEBSOCKET_RUNNING 1
+#define WEBSOCKET_STOPPED 0
+
+#define WEBSOCKET_SUCCESS 0
+#define WEBSOCKET_ERROR -1
+
+// Called by the gateway for every accepted connection - starts a client handler for it
+typedef int (*WebSocketAcceptHandler)(int clientSocket, void* handlerArg);
+
+typedef struct
+{
+    uint64_t connectionsAccepted;
+    uint64_t handshakesFailed;
+    uint64_t framesReceived;
+    uint64_t framesSent;
+    uint64_t pingsAnswered;
+    uint64_t closesReceived;
+    uint64_t framesRejected;    // Fragmented, binary, unmasked or too long
+} WebSocketStats;
+
+// Gateway thread
+int websocketStart(uint16_t websocketPort, WebSocketAcceptHandler acceptHandler, void* handlerArg);
+void websocketStop();
+
+// Connections
+int websocketIsClient(int clientSocket);
+int websocketHandshake(int clientSocket);
+void websocketForget(int clientSocket);
+int websocketReadMessage(int clientSocket, char* buffer, size_t bufferLength);
+
+// Sending to any chat client - JSON objects are framed for WebSocket clients, sent as they are to the rest
+size_t websocketFrameText(const char* payload, size_t payloadLength, char* frame);
+ssize_t websocketSendFrame(int clientSocket, const char* frame, size_t frameLength);
+ssize_t clientSend(int clientSocket, const void* data, size_t length, int flags);
+
+// Stats
+void websocketGetStats(WebSocketStats* statsP);
+
+#endif //SERVERWEBSOCKET_H_INCLUDED
@@ -0,0 +1,19 @@
+/*
+* Filename:		sha1.h
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains function prototypes for SHA-1 hashes used by the WebSocket handshake of the CHAT-SYSTEM server.
+*/
+
+#ifndef SHA1_H_INCLUDED
+#define SHA1_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA1_DIGEST_LENGTH 20
+
+void sha1(const void* data, size_t length, uint8_t digest[SHA1_DIGEST_LENGTH]);
+
+#endif //SHA1_H_INCLUDED
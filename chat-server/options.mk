@@ -0,0 +1,57 @@
+# Build options of the server, shared with the benchmarks that link its code (chat-bench) so both
+# compile it the same way. Each option adds to OPTION_CFLAGS and LDLIBS.
+
+# Firehose subscribers can ask for a deflate stream - build with FIREHOSE_ZLIB=0 to drop the zlib
+# dependency, and every subscriber gets the plain stream
+FIREHOSE_ZLIB ?= 1
+ifeq ($(FIREHOSE_ZLIB),1)
+OPTION_CFLAGS += -DFIREHOSE_ZLIB
+LDLIBS += -lz
+endif
+
+# Clients can connect over TLS (OpenSSL, with kernel TLS where available) - build with TLS=0 to drop
+# the OpenSSL dependency; TLS_CERT_FILE and TLS_KEY_FILE set where the certificate and key are read from
+TLS ?= 1
+ifeq ($(TLS),1)
+OPTION_CFLAGS += -DCHAT_TLS
+LDLIBS += -lssl -lcrypto
+endif
+ifdef TLS_CERT_FILE
+OPTION_CFLAGS += -DTLS_CERT_FILE=\"$(TLS_CERT_FILE)\" -DTLS_KEY_FILE=\"$(TLS_KEY_FILE)\"
+endif
+
+# Large pools (and the shared-memory registry, when MAX_CLIENTS makes it big enough) go on huge pages
+# where the system has them - build with HUGE_PAGES=0 to keep everything on normal pages
+HUGE_PAGES ?= 1
+ifeq ($(HUGE_PAGES),1)
+OPTION_CFLAGS += -DCHAT_HUGE_PAGES
+endif
+
+# Build with TSAN=1 to look for data races with ThreadSanitizer (after a make clean). Client handlers
+# then get a thread each, as it cannot follow the coroutines' stack switches, and the deque's fences
+# are left to it to ignore
+TSAN ?= 0
+ifeq ($(TSAN),1)
+OPTION_CFLAGS += -fsanitize=thread -g -Wno-tsan
+COROUTINES := 0
+endif
+
+# Client handlers run as coroutines on event loop threads - build with COROUTINES=0 for a thread per
+# client; COROUTINE_STACK_SIZE sets each handler's stack in bytes
+COROUTINES ?= 1
+ifeq ($(COROUTINES),1)
+OPTION_CFLAGS += -DCHAT_COROUTINES
+endif
+ifdef COROUTINE_STACK_SIZE
+OPTION_CFLAGS += -DCOROUTINE_STACK_SIZE=$(COROUTINE_STACK_SIZE)
+endif
+
+# Chat messages are filtered with the patterns in chat-filter.conf - FILTER_PATTERN_FILE sets another file
+ifdef FILTER_PATTERN_FILE
+OPTION_CFLAGS += -DFILTER_PATTERN_FILE=\"$(FILTER_PATTERN_FILE)\"
+endif
+
+# Multicast broadcasts go out on loopback - build with MULTICAST_INTERFACE=<LAN address> to use a LAN
+ifdef MULTICAST_INTERFACE
+OPTION_CFLAGS += -DMULTICAST_INTERFACE=\"$(MULTICAST_INTERFACE)\"
+endif
@@ -0,0 +1,1000 @@
+/*
+* Filename:		chatLog.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the persisted chat log of the CHAT-SYSTEM server.
+*
+*               Every broadcast is appended to the log by the chat broadcaster and given a sequence
+*               number; direct messages are appended by the sender's client handler, tagged with their
+*               recipient. The log is split into segment files in CHAT_LOG_DIR, each named after the
+*               sequence of its first record (e.g. "segment-00000000000000065536.v2.log"), and a new
+*               segment is started once the active one holds LOG_SEGMENT_MAX_RECORDS records.
+*
+*               Records are fixed size, so the record for a sequence number is read with a single
+*               pread() at a computed offset. Appends are plain writes to the page cache (no fsync),
+*               so persisting a message costs one syscall on the broadcaster thread.
+*
+*               All access goes through logMutex; reads and appends are short, so the lock is never
+*               held across anything slower than one pread()/pwrite().
+*
+*               Each record carries a CRC32C checksum (crc32c.c, SSE4.2 accelerated), computed on append.
+*               Only the active (last) segment can end in a torn record after a crash, so recovery in
+*               logOpen() validates just that segment, in large reads, and truncates it at the first
+*               bad record. Sealed segments are validated lazily: every read checks each record, and a
+*               corrupt record is reported as LOG_CORRUPT so replay and indexing skip it.
+*
+*               Retention runs on its own thread every LOG_RETENTION_INTERVAL_SECONDS:
+*                   - Whole sealed segments are deleted once their newest record is older than the
+*                     maximum age, or while the log is larger than the maximum size.
+*                   - The oldest segment is compacted by punching a hole over its expired head, so the
+*                     disk space is freed but the offsets of the remaining records do not change.
+*               Only the segment list update is done under logMutex; reading timestamps, unlinking and
+*               hole punching happen outside it, so appends never wait on retention I/O. This is safe
+*               because the retention thread is the only one that removes segments or closes their files.
+*/
+
+#define _GNU_SOURCE // For fallocate()
+#include "../inc/chatLog.h"
+
+static pthread_mutex_t logMutex = PTHREAD_MUTEX_INITIALIZER;
+static char logDirectory[LOG_DIR_LENGTH];
+static LogSegment* logSegments = NULL;
+static int logNumSegments = 0;
+static int logSegmentsCapacity = 0;
+static uint64_t logNextSequence = 0;
+static int logIsOpen = 0;
+static uint64_t logDeletedSegments = 0;
+static uint64_t logTruncatedRecords = 0;
+static uint64_t logCorruptRecords = 0;
+
+static pthread_t retentionThread;
+static int retentionIsRunning = RETENTION_STOPPED;
+
+
+/*
+* Function:     logSegmentPath
+* Purpose:      Builds the path of the segment file starting at baseSequence.
+*
+* Inputs:       uint64_t        baseSequence    Sequence of the first record in the segment.
+*               char*           path            Buffer of LOG_PATH_LENGTH bytes for the path.
+*
+* Outputs:      path                            The segment file path.
+*
+* Returns:      void
+*/
+static void logSegmentPath(uint64_t baseSequence, char* path)
+{
+    snprintf(path, LOG_PATH_LENGTH, "%s/%s%020llu%s", logDirectory, LOG_SEGMENT_PREFIX,
+        (unsigned long long)baseSequence, LOG_SEGMENT_SUFFIX);
+}
+
+
+/*
+* Function:     logAddSegment
+* Purpose:      Adds a segment to the in-memory segment list, growing it if needed.
+*               NOTE: Make sure to lock and unlock logMutex before and after calling this function!
+*
+* Inputs:       uint64_t        baseSequence    Sequence of the first record in the segment.
+*               uint64_t        numRecords      Number of records in the segment.
+*               int             fd              Open file descriptor of the segment.
+*
+* Outputs:      None
+*
+* Returns:      int                             LOG_SUCCESS, or LOG_ERROR if out of memory.
+*/
+static int logAddSegment(uint64_t baseSequence, uint64_t numRecords, int fd)
+{
+    if (logNumSegments == logSegmentsCapacity)
+    {
+        int newCapacity = logSegmentsCapacity == 0 ? 16 : logSegmentsCapacity * 2;
+        LogSegment* newSegments = memRealloc(MEM_HISTORY_CACHE, logSegments, newCapacity * sizeof(LogSegment));
+        if (newSegments == NULL)
+        {
+            return LOG_ERROR;
+        }
+
+        logSegments = newSegments;
+        logSegmentsCapacity = newCapacity;
+    }
+
+    logSegments[logNumSegments].baseSequence = baseSequence;
+    logSegments[logNumSegments].firstSequence = baseSequence;
+    logSegments[logNumSegments].numRecords = numRecords;
+    logSegments[logNumSegments].fd = fd;
+    logNumSegments++;
+
+    return LOG_SUCCESS;
+}
+
+
+/*
+* Function:     logCreateSegment
+* Purpose:      Creates a new, empty segment file starting at baseSequence and makes it the active segment.
+*               NOTE: Make sure to lock and unlock logMutex before and after calling this function!
+*
+* Inputs:       uint64_t        baseSequence    Sequence of the first record in the segment.
+*
+* Outputs:      None
+*
+* Returns:      int                             LOG_SUCCESS, or LOG_ERROR on failure.
+*/
+static int logCreateSegment(uint64_t baseSequence)
+{
+    char path[LOG_PATH_LENGTH];
+    logSegmentPath(baseSequence, path);
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        perror("[LOG] : open() FAILED");
+        return LOG_ERROR;
+    }
+
+    if (logAddSegment(baseSequence, 0, fd) != LOG_SUCCESS)
+    {
+        close(fd);
+        unlink(path);
+        return LOG_ERROR;
+    }
+
+    return LOG_SUCCESS;
+}
+
+
+/*
+* Function:     logFindSegment
+* Purpose:      Finds the segment holding a sequence number (binary search on base sequences).
+*               NOTE: Make sure to lock and unlock logMutex before and after calling this function!
+*
+* Inputs:       uint64_t        sequence        Sequence number to look for.
+*
+* Outputs:      None
+*
+* Returns:      int                             Index of the segment, or LOG_NOT_FOUND.
+*/
+static int logFindSegment(uint64_t sequence)
+{
+    int low = 0;
+    int high = logNumSegments - 1;
+    int found = LOG_NOT_FOUND;
+
+    while (low <= high)
+    {
+        int mid = low + (high - low) / 2;
+
+        if (logSegments[mid].baseSequence <= sequence)
+        {
+            found = mid;
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+
+    if (found != LOG_NOT_FOUND &&
+        (sequence < logSegments[found].firstSequence ||
+         sequence >= logSegments[found].baseSequence + logSegments[found].numRecords))
+    {
+        found = LOG_NOT_FOUND;
+    }
+
+    return found;
+}
+
+
+/*
+* Function:     logRecordChecksum
+* Purpose:      Computes the checksum of a record (everything after the checksum).
+*
+* Inputs:       const LogRecord*    recordP     The record.
+*
+* Outputs:      None
+*
+* Returns:      uint32_t                        The checksum.
+*/
+static uint32_t logRecordChecksum(const LogRecord* recordP)
+{
+    return crc32c(&recordP->kind, sizeof(LogRecord) - offsetof(LogRecord, kind));
+}
+
+
+/*
+* Function:     logRecordIsValid
+* Purpose:      Checks a record's checksum and that it holds the expected sequence number.
+*
+* Inputs:       const LogRecord*    recordP             The record.
+*               uint64_t            expectedSequence    Sequence the record should have.
+*
+* Outputs:      None
+*
+* Returns:      int                                     1 if valid, otherwise 0.
+*/
+int logRecordIsValid(const LogRecord* recordP, uint64_t expectedSequence)
+{
+    return recordP->sequence == expectedSequence && recordP->checksum == logRecordChecksum(recordP);
+}
+
+
+/*
+* Function:     readRecordAt
+* Purpose:      Reads the record at a given index within a segment file.
+*
+* Inputs:       int             fd              Segment file descriptor.
+*               uint64_t        recordIndex     Index of the record within the segment.
+*               LogRecord*      recordP         Where to store the record.
+*
+* Outputs:      recordP                         The record read.
+*
+* Returns:      int                             LOG_SUCCESS, or LOG_ERROR on a short read.
+*/
+static int readRecordAt(int fd, uint64_t recordIndex, LogRecord* recordP)
+{
+    off_t offset = (off_t)(recordIndex * sizeof(LogRecord));
+
+    return pread(fd, recordP, sizeof(LogRecord), offset) == sizeof(LogRecord) ? LOG_SUCCESS : LOG_ERROR;
+}
+
+
+/*
+* Function:     findFirstRetained
+* Purpose:      Finds the first record of a segment that was not compacted away. Compacted records read
+*               back as zeros, and the compacted range is always a prefix, so a binary search is enough.
+*
+* Inputs:       int             fd              Segment file descriptor.
+*               uint64_t        baseSequence    Sequence of the first record in the segment.
+*               uint64_t        numRecords      Number of records in the segment.
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        Sequence of the first retained record.
+*/
+static uint64_t findFirstRetained(int fd, uint64_t baseSequence, uint64_t numRecords)
+{
+    uint64_t low = 0;
+    uint64_t high = numRecords;
+    LogRecord record;
+
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+
+        if (readRecordAt(fd, mid, &record) == LOG_SUCCESS && logRecordIsValid(&record, baseSequence + mid))
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return baseSequence + low;
+}
+
+
+/*
+* Function:     recoverSegment
+* Purpose:      Validates the retained records of a segment and truncates it at the first bad one,
+*               which is where an append was torn by a crash.
+*               NOTE: Make sure to lock and unlock logMutex before and after calling this function!
+*
+* Inputs:       LogSegment*     segmentP        The segment to recover.
+*
+* Outputs:      segmentP->numRecords            Updated if the segment was truncated.
+*
+* Returns:      int                             LOG_SUCCESS, or LOG_ERROR if out of memory.
+*/
+static int recoverSegment(LogSegment* segmentP)
+{
+    LogRecord* chunk = memAlloc(MEM_HISTORY_CACHE, LOG_RECOVERY_CHUNK_RECORDS * sizeof(LogRecord));
+    if (chunk == NULL)
+    {
+        return LOG_ERROR;
+    }
+
+    uint64_t endSequence = segmentP->baseSequence + segmentP->numRecords;
+    uint64_t sequence = segmentP->firstSequence;
+    int isTorn = 0;
+
+    while (sequence < endSequence && !isTorn)
+    {
+        uint64_t remaining = endSequence - sequence;
+        int count = remaining < LOG_RECOVERY_CHUNK_RECORDS ? (int)remaining : LOG_RECOVERY_CHUNK_RECORDS;
+
+        off_t offset = (off_t)((sequence - segmentP->baseSequence) * sizeof(LogRecord));
+        ssize_t bytesRead = pread(segmentP->fd, chunk, count * sizeof(LogRecord), offset);
+        int numRead = bytesRead < 0 ? 0 : (int)(bytesRead / sizeof(LogRecord));
+
+        for (int i = 0; i < numRead; i++)
+        {
+            if (!logRecordIsValid(&chunk[i], sequence))
+            {
+                isTorn = 1;
+                break;
+            }
+            sequence++;
+        }
+
+        if (numRead < count)
+        {
+            isTorn = 1;
+        }
+    }
+
+    if (isTorn)
+    {
+        logTruncatedRecords += endSequence - sequence;
+        segmentP->numRecords = sequence - segmentP->baseSequence;
+
+        if (ftruncate(segmentP->fd, (off_t)(segmentP->numRecords * sizeof(LogRecord))) == -1)
+        {
+            perror("[LOG] : ftruncate() FAILED");
+        }
+    }
+
+    memFree(MEM_HISTORY_CACHE, chunk);
+
+    return LOG_SUCCESS;
+}
+
+
+/*
+* Function:     compareSegments
+* Purpose:      qsort() comparator ordering segments by base sequence.
+*
+* Inputs:       const void*     a               First LogSegment.
+*               const void*     b               Second LogSegment.
+*
+* Outputs:      None
+*
+* Returns:      int                             Negative, zero or positive.
+*/
+static int compareSegments(const void* a, const void* b)
+{
+    uint64_t baseA = ((const LogSegment*)a)->baseSequence;
+    uint64_t baseB = ((const LogSegment*)b)->baseSequence;
+
+    return (baseA > baseB) - (baseA < baseB);
+}
+
+
+/*
+* Function:     logOpen
+* Purpose:      Opens the chat log in logDir, creating the directory if needed, and loads the list of
+*               existing segments. A partially written record at the end of a segment is truncated.
+*
+* Inputs:       const char*     logDir          Directory holding the segment files.
+*
+* Outputs:      None
+*
+* Returns:      int                             LOG_SUCCESS, or LOG_ERROR on failure.
+*/
+int logOpen(const char* logDir)
+{
+    pthread_mutex_lock(&logMutex);
+
+    if (logIsOpen)
+    {
+        pthread_mutex_unlock(&logMutex);
+        return LOG_SUCCESS;
+    }
+
+    strncpy(logDirectory, logDir, LOG_DIR_LENGTH - 1);
+    logDirectory[LOG_DIR_LENGTH - 1] = '\0';
+
+    if (mkdir(logDirectory, 0755) == -1 && errno != EEXIST)
+    {
+        perror("[LOG] : mkdir() FAILED");
+        pthread_mutex_unlock(&logMutex);
+        return LOG_ERROR;
+    }
+
+    DIR* dir = opendir(logDirectory);
+    if (dir == NULL)
+    {
+        perror("[LOG] : opendir() FAILED");
+        pthread_mutex_unlock(&logMutex);
+        return LOG_ERROR;
+    }
+
+    int retVal = LOG_SUCCESS;
+    struct dirent* entry;
+    size_t prefixLength = strlen(LOG_SEGMENT_PREFIX);
+
+    while ((entry = readdir(dir)) != NULL && retVal == LOG_SUCCESS)
+    {
+        // Only look at "segment-<base>.log" files
+        if (strncmp(entry->d_name, LOG_SEGMENT_PREFIX, prefixLength) != 0)
+        {
+            continue;
+        }
+
+        char* end;
+        uint64_t baseSequence = strtoull(entry->d_name + prefixLength, &end, 10);
+        if (end == entry->d_name + prefixLength || strcmp(end, LOG_SEGMENT_SUFFIX) != 0)
+        {
+            continue;
+        }
+
+        char path[LOG_PATH_LENGTH];
+        logSegmentPath(baseSequence, path);
+
+        int fd = open(path, O_RDWR);
+        struct stat fileInfo;
+        if (fd == -1 || fstat(fd, &fileInfo) == -1)
+        {
+            perror("[LOG] : open() FAILED");
+            if (fd != -1)
+            {
+                close(fd);
+            }
+            continue;
+        }
+
+        // Drop a torn record left behind by a crash mid-write
+        uint64_t numRecords = fileInfo.st_size / sizeof(LogRecord);
+        if (fileInfo.st_size % sizeof(LogRecord) != 0)
+        {
+            if (ftruncate(fd, numRecords * sizeof(LogRecord)) == -1)
+            {
+                perror("[LOG] : ftruncate() FAILED");
+            }
+        }
+
+        if (logAddSegment(baseSequence, numRecords, fd) != LOG_SUCCESS)
+        {
+            close(fd);
+            retVal = LOG_ERROR;
+        }
+        else
+        {
+            logSegments[logNumSegments - 1].firstSequence = findFirstRetained(fd, baseSequence, numRecords);
+        }
+    }
+
+    closedir(dir);
+
+    if (logNumSegments > 0)
+    {
+        qsort(logSegments, logNumSegments, sizeof(LogSegment), compareSegments);
+
+        // Only the active segment can have been torn by a crash
+        LogSegment* lastSegment = &logSegments[logNumSegments - 1];
+        if (recoverSegment(lastSegment) != LOG_SUCCESS)
+        {
+            retVal = LOG_ERROR;
+        }
+        logNextSequence = lastSegment->baseSequence + lastSegment->numRecords;
+    }
+    else
+    {
+        logNextSequence = 0;
+    }
+
+    logIsOpen = 1;
+
+    pthread_mutex_unlock(&logMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     logClose
+* Purpose:      Closes all segment files and frees the segment list.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void logClose()
+{
+    pthread_mutex_lock(&logMutex);
+
+    for (int i = 0; i < logNumSegments; i++)
+    {
+        close(logSegments[i].fd);
+    }
+
+    memFree(MEM_HISTORY_CACHE, logSegments);
+    logSegments = NULL;
+    logNumSegments = 0;
+    logSegmentsCapacity = 0;
+    logIsOpen = 0;
+
+    pthread_mutex_unlock(&logMutex);
+}
+
+
+/*
+* Function:     logAppendRecord
+* Purpose:      Appends a record to the log, starting a new segment if the active one is full.
+*
+* Inputs:       uint32_t            kind                One of the LOG_RECORD_ kinds.
+*               const Broadcast*    broadcastP          The message to persist.
+*               const char*         recipientUserID     Recipient of a direct message, otherwise "".
+*
+* Outputs:      None
+*
+* Returns:      int64_t                                 Sequence number of the new record, or LOG_ERROR.
+*/
+static int64_t logAppendRecord(uint32_t kind, const Broadcast* broadcastP, const char* recipientUserID)
+{
+    int64_t retVal = LOG_ERROR;
+
+    pthread_mutex_lock(&logMutex);
+
+    if (logIsOpen)
+    {
+        if (logNumSegments == 0 || logSegments[logNumSegments - 1].numRecords >= LOG_SEGMENT_MAX_RECORDS)
+        {
+            if (logCreateSegment(logNextSequence) != LOG_SUCCESS)
+            {
+                pthread_mutex_unlock(&logMutex);
+                return LOG_ERROR;
+            }
+        }
+
+        LogSegment* segment = &logSegments[logNumSegments - 1];
+
+        LogRecord record;
+        memset(&record, 0, sizeof(record));
+        record.kind = kind;
+        record.sequence = logNextSequence;
+        record.timestamp = (int64_t)time(NULL);
+        record.broadcast = *broadcastP;
+        strncpy(record.recipientUserID, recipientUserID, CLIENT_USERID_LENGTH);
+        record.checksum = logRecordChecksum(&record);
+
+        off_t offset = (off_t)(segment->numRecords * sizeof(LogRecord));
+        if (pwrite(segment->fd, &record, sizeof(record), offset) == sizeof(record))
+        {
+            segment->numRecords++;
+            retVal = (int64_t)logNextSequence++;
+        }
+        else
+        {
+            perror("[LOG] : pwrite() FAILED");
+        }
+    }
+
+    pthread_mutex_unlock(&logMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     logAppend
+* Purpose:      Appends a broadcast to the log.
+*
+* Inputs:       const Broadcast*    broadcastP      The broadcast to persist.
+*
+* Outputs:      None
+*
+* Returns:      int64_t                             Sequence number of the new record, or LOG_ERROR.
+*/
+int64_t logAppend(const Broadcast* broadcastP)
+{
+    return logAppendRecord(LOG_RECORD_BROADCAST, broadcastP, "");
+}
+
+
+/*
+* Function:     logAppendDirect
+* Purpose:      Appends a direct message queued in the recipient's mailbox to the log.
+*
+* Inputs:       const Broadcast*    broadcastP          The message to persist.
+*               const char*         recipientUserID     User ID of the recipient.
+*
+* Outputs:      None
+*
+* Returns:      int64_t                                 Sequence number of the new record, or LOG_ERROR.
+*/
+int64_t logAppendDirect(const Broadcast* broadcastP, const char* recipientUserID)
+{
+    return logAppendRecord(LOG_RECORD_DIRECT, broadcastP, recipientUserID);
+}
+
+
+/*
+* Function:     logAppendDelivered
+* Purpose:      Appends a direct message that was sent to the connected recipient to the log. Mailbox
+*               recovery skips these, so they are not delivered again after a restart.
+*
+* Inputs:       const Broadcast*    broadcastP          The message to persist.
+*               const char*         recipientUserID     User ID of the recipient.
+*
+* Outputs:      None
+*
+* Returns:      int64_t                                 Sequence number of the new record, or LOG_ERROR.
+*/
+int64_t logAppendDelivered(const Broadcast* broadcastP, const char* recipientUserID)
+{
+    return logAppendRecord(LOG_RECORD_DIRECT_DELIVERED, broadcastP, recipientUserID);
+}
+
+
+/*
+* Function:     logAppendMailboxDrained
+* Purpose:      Appends a marker saying that every direct message queued for a user before it has
+*               been delivered.
+*
+* Inputs:       const char*         recipientUserID     User ID whose mailbox was delivered.
+*
+* Outputs:      None
+*
+* Returns:      int64_t                                 Sequence number of the new record, or LOG_ERROR.
+*/
+int64_t logAppendMailboxDrained(const char* recipientUserID)
+{
+    Broadcast empty = {.clientIP = "", .clientUserID = "", .message = ""};
+    return logAppendRecord(LOG_RECORD_MAILBOX_DRAINED, &empty, recipientUserID);
+}
+
+
+/*
+* Function:     logRead
+* Purpose:      Reads the record with a given sequence number.
+*
+* Inputs:       uint64_t        sequence        Sequence number of the record.
+*               LogRecord*      recordP         Where to store the record.
+*
+* Outputs:      recordP                         The record read.
+*
+* Returns:      int                             LOG_SUCCESS, LOG_NOT_FOUND, LOG_CORRUPT or LOG_ERROR.
+*/
+int logRead(uint64_t sequence, LogRecord* recordP)
+{
+    int retVal = logReadRange(sequence, recordP, 1);
+
+    if (retVal == 0)
+    {
+        retVal = LOG_NOT_FOUND;
+    }
+
+    return retVal < 0 ? retVal : LOG_SUCCESS;
+}
+
+
+/*
+* Function:     logReadRange
+* Purpose:      Reads up to maxRecords consecutive valid records starting at startSequence, stopping at
+*               the end of the segment holding startSequence (callers simply read again from there)
+*               or just before a record that fails validation.
+*
+* Inputs:       uint64_t        startSequence   Sequence number of the first record.
+*               LogRecord*      records         Buffer for at least maxRecords records.
+*               int             maxRecords      Maximum number of records to read.
+*
+* Outputs:      records                         The records read.
+*
+* Returns:      int                             Number of records read (0 at the end of the log),
+*                                               LOG_NOT_FOUND if startSequence is no longer in the log,
+*                                               LOG_CORRUPT if the record at startSequence is corrupt,
+*                                               or LOG_ERROR on a read error.
+*/
+int logReadRange(uint64_t startSequence, LogRecord* records, int maxRecords)
+{
+    int retVal = 0;
+
+    pthread_mutex_lock(&logMutex);
+
+    if (startSequence < logNextSequence && maxRecords > 0)
+    {
+        int segmentIndex = logFindSegment(startSequence);
+
+        if (segmentIndex == LOG_NOT_FOUND)
+        {
+            retVal = LOG_NOT_FOUND;
+        }
+        else
+        {
+            LogSegment* segment = &logSegments[segmentIndex];
+            uint64_t available = segment->baseSequence + segment->numRecords - startSequence;
+            int count = available < (uint64_t)maxRecords ? (int)available : maxRecords;
+
+            off_t offset = (off_t)((startSequence - segment->baseSequence) * sizeof(LogRecord));
+            ssize_t bytesRead = pread(segment->fd, records, count * sizeof(LogRecord), offset);
+
+            retVal = bytesRead < 0 ? LOG_ERROR : (int)(bytesRead / sizeof(LogRecord));
+        }
+    }
+
+    pthread_mutex_unlock(&logMutex);
+
+    // Validate outside the lock - stop at the first corrupt record
+    for (int i = 0; i < retVal; i++)
+    {
+        if (!logRecordIsValid(&records[i], startSequence + i))
+        {
+            pthread_mutex_lock(&logMutex);
+            logCorruptRecords++;
+            pthread_mutex_unlock(&logMutex);
+
+            retVal = i == 0 ? LOG_CORRUPT : i;
+            break;
+        }
+    }
+
+    return retVal;
+}
+
+
+/*
+* Function:     logGetFirstSequence
+* Purpose:      Gets the sequence number of the oldest record still in the log.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                Oldest sequence (equal to the next sequence if the log is empty).
+*/
+uint64_t logGetFirstSequence()
+{
+    pthread_mutex_lock(&logMutex);
+    uint64_t firstSequence = logNumSegments > 0 ? logSegments[0].firstSequence : logNextSequence;
+    pthread_mutex_unlock(&logMutex);
+
+    return firstSequence;
+}
+
+
+/*
+* Function:     logGetNextSequence
+* Purpose:      Gets the sequence number the next appended record will get.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                Next sequence.
+*/
+uint64_t logGetNextSequence()
+{
+    pthread_mutex_lock(&logMutex);
+    uint64_t nextSequence = logNextSequence;
+    pthread_mutex_unlock(&logMutex);
+
+    return nextSequence;
+}
+
+
+/*
+* Function:     findFirstNotExpired
+* Purpose:      Finds the first record of a segment written at or after a cut-off time.
+*               Records are appended in time order, so a binary search is enough.
+*
+* Inputs:       LogSegment      segment         Copy of the segment to search.
+*               int64_t         cutoff          Oldest timestamp to keep.
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        Sequence of the first record to keep.
+*/
+static uint64_t findFirstNotExpired(LogSegment segment, int64_t cutoff)
+{
+    uint64_t low = segment.firstSequence - segment.baseSequence;
+    uint64_t high = segment.numRecords;
+    LogRecord record;
+
+    while (low < high)
+    {
+        uint64_t mid = low + (high - low) / 2;
+
+        if (readRecordAt(segment.fd, mid, &record) == LOG_SUCCESS && record.timestamp >= cutoff)
+        {
+            high = mid;
+        }
+        else
+        {
+            low = mid + 1;
+        }
+    }
+
+    return segment.baseSequence + low;
+}
+
+
+/*
+* Function:     logApplyRetention
+* Purpose:      Deletes whole segments that are too old or exceed the size limit, and compacts the
+*               expired head of the oldest remaining segment. The active segment is never deleted.
+*
+* Inputs:       int64_t         maxAgeSeconds   Maximum age of a record (0 for no limit).
+*               uint64_t        maxBytes        Maximum size of the retained log (0 for no limit).
+*
+* Outputs:      None
+*
+* Returns:      int                             Number of segments deleted.
+*/
+int logApplyRetention(int64_t maxAgeSeconds, uint64_t maxBytes)
+{
+    int numDeleted = 0;
+    int64_t cutoff = maxAgeSeconds > 0 ? (int64_t)time(NULL) - maxAgeSeconds : 0;
+
+    // Oldest segment first, one per pass - stops at the first segment that is kept, or when none are left
+    for (;;)
+    {
+        pthread_mutex_lock(&logMutex);
+
+        if (logNumSegments == 0)
+        {
+            pthread_mutex_unlock(&logMutex);
+            break;
+        }
+
+        LogSegment oldest = logSegments[0];
+        int isActive = logNumSegments == 1;
+
+        uint64_t retainedBytes = (logNextSequence - oldest.firstSequence) * sizeof(LogRecord);
+
+        pthread_mutex_unlock(&logMutex);
+
+        // Sealed segments never change, so their newest record can be read without the lock
+        LogRecord newest;
+        int isExpired = !isActive && cutoff > 0 &&
+            readRecordAt(oldest.fd, oldest.numRecords - 1, &newest) == LOG_SUCCESS &&
+            newest.timestamp < cutoff;
+        int isOverSize = !isActive && maxBytes > 0 && retainedBytes > maxBytes;
+
+        if (isExpired || isOverSize)
+        {
+            // Drop the whole segment from the list, then remove the file outside the lock
+            pthread_mutex_lock(&logMutex);
+            memmove(&logSegments[0], &logSegments[1], (logNumSegments - 1) * sizeof(LogSegment));
+            logNumSegments--;
+            logDeletedSegments++;
+            pthread_mutex_unlock(&logMutex);
+
+            char path[LOG_PATH_LENGTH];
+            logSegmentPath(oldest.baseSequence, path);
+            close(oldest.fd);
+            unlink(path);
+
+            numDeleted++;
+            continue;
+        }
+
+        // Oldest segment is partly expired - punch out the whole blocks holding expired records
+        if (cutoff > 0)
+        {
+            uint64_t newFirst = findFirstNotExpired(oldest, cutoff);
+
+            if (newFirst > oldest.firstSequence)
+            {
+                off_t punchLength = (off_t)((newFirst - oldest.baseSequence) * sizeof(LogRecord));
+                punchLength -= punchLength % LOG_PUNCH_BLOCK_SIZE;
+
+                if (punchLength > 0 &&
+                    fallocate(oldest.fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, 0, punchLength) == -1)
+                {
+                    perror("[LOG] : fallocate() FAILED");
+                }
+
+                pthread_mutex_lock(&logMutex);
+                logSegments[0].firstSequence = newFirst;
+                pthread_mutex_unlock(&logMutex);
+            }
+        }
+
+        break;
+    }
+
+    return numDeleted;
+}
+
+
+/*
+* Function:     logRetention
+* Purpose:      Retention thread - applies the retention limits every LOG_RETENTION_INTERVAL_SECONDS.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* logRetention(void* arg)
+{
+    (void)arg;
+
+    int ticksPerInterval = (LOG_RETENTION_INTERVAL_SECONDS * 1000000) / LOG_RETENTION_LOOP_SLEEP_LENGTH;
+    int ticks = ticksPerInterval; // Apply once at start-up
+
+    while (__atomic_load_n(&retentionIsRunning, __ATOMIC_ACQUIRE))
+    {
+        if (ticks >= ticksPerInterval)
+        {
+            ticks = 0;
+            int numDeleted = logApplyRetention(LOG_RETENTION_MAX_AGE_SECONDS, LOG_RETENTION_MAX_BYTES);
+
+            #ifdef TESTING
+                if (numDeleted > 0)
+                {
+                    printf("\nRetention deleted %d log segments\n", numDeleted);
+                }
+            #else
+                (void)numDeleted;
+            #endif
+        }
+
+        usleep(LOG_RETENTION_LOOP_SLEEP_LENGTH);
+        ticks++;
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     logRetentionStart
+* Purpose:      Starts the retention thread. The log must already be open.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                     LOG_SUCCESS, or LOG_ERROR if the thread could not be started.
+*/
+int logRetentionStart()
+{
+    __atomic_store_n(&retentionIsRunning, RETENTION_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&retentionThread, NULL, logRetention, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&retentionIsRunning, RETENTION_STOPPED, __ATOMIC_RELEASE);
+        return LOG_ERROR;
+    }
+
+    return LOG_SUCCESS;
+}
+
+
+/*
+* Function:     logRetentionStop
+* Purpose:      Stops the retention thread. Must be called before logClose().
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void logRetentionStop()
+{
+    if (__atomic_load_n(&retentionIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&retentionIsRunning, RETENTION_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(retentionThread, NULL);
+    }
+}
+
+
+/*
+* Function:     logGetStats
+* Purpose:      Gets the log size, retention and integrity counters.
+*
+* Inputs:       LogStats*       statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void logGetStats(LogStats* statsP)
+{
+    pthread_mutex_lock(&logMutex);
+    statsP->numSegments = logNumSegments;
+    statsP->retainedBytes = logNumSegments > 0 ? (logNextSequence - logSegments[0].firstSequence) * sizeof(LogRecord) : 0;
+    statsP->deletedSegments = logDeletedSegments;
+    statsP->truncatedRecords = logTruncatedRecords;
+    statsP->corruptRecords = logCorruptRecords;
+    pthread_mutex_unlock(&logMutex);
+}
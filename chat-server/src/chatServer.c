@@ -31,12 +31,13 @@
 *               shared memory. The information it contains includes:
 *                   - The message queue ID (for client handler and chat broadcaster threads).
 *                   - The server socket (for the client monitor to close the socket).
-*                   - The number of currently connected clients.
+*                   - The number of currently connected clients (atomic).
 *                   - The server's status (for the monitor thread to signal the main thread
 *                     that the server should be shutting down, i.e., accept() call is supposed 
-*                     to give an error).
-*                   - A mutex to synchronize and protect access to the SharedData members.
-*                   - An array of ClientState structs, one struct for each connected client.
+*                     to give an error). Published atomically, so nobody locks to read it.
+*                   - The delivery mutex, ordering broadcasts against delivery switches.
+*                   - The registry shards, each a mutex and an array of ClientState structs,
+*                     one struct for each connected client whose user ID hashes to the shard.
 *               
 *               Each client's ClientState struct contains:
 *                   - The thread ID for the client's handler. (Used to remove the client from the list)
@@ -56,12 +57,99 @@
 *                   - The client's user ID (if this is not provided, the server will reject the connection)
 *                   - The client's message (of max length 40)
 *               
+*               All heap memory used by the server is charged to the memory accountant (serverMemory.c).
+*               Above the shedding watermark, new registrations are refused and new chat messages are
+*               dropped, so the server degrades before the budget (or the OOM killer) is hit. A broadcast
+*               that finds the budget already spent is only sent over TCP to the users it mentions; the
+*               history index and the firehose's stalled subscribers are evicted first, when they can be.
+*               Sending STATS_SIGNAL (SIGUSR1) to the server prints its stats, including memory per category.
+*               
+*               Every broadcast is also appended to the persisted chat log (chatLog.c) by the chat
+*               broadcaster, and indexed off the hot path by the history indexer thread (historyIndex.c).
+*               A client can search past messages by sending ">>search<< <terms>"; the newest matches
+*               are sent back to that client only, after a ">>results<< <count>" server message.
+*               Old log segments are deleted or compacted in the background by the retention thread.
+*               
+*               The server also remembers every user that has registered (serverSession.c). When a known
+*               user registers again, it is sent a ">>missed<< <count>" server message followed by the
+*               newest messages it missed. The known users and the history index are saved in periodic
+*               registry snapshots (serverSnapshot.c), so after a restart or crash the server restores
+*               them from the snapshot and only replays the log records written after it.
+*               
+*               A client can send a direct message with ">>dm<< <userID> <message>". It is logged (but
+*               never indexed or replayed to others) and sent to the recipient if connected; otherwise
+*               a reference to it is queued in the recipient's mailbox (serverMailbox.c). On its next
+*               registration, the recipient gets a ">>mail<< <count>" server message and the pending
+*               messages in a single write.
+*               
+*               Every client gets the roster of connected users at registration, then only join/leave
+*               deltas, coalesced over a short window by the presence thread (serverPresence.c).
+*               Clients ping ">>typing<<" while their user types; the presence thread turns the pings into
+*               one lossy ">>typing<< <userID> ..." frame per window, dropped first when a client backs up.
+*               
+*               Analytics and archival tools can subscribe to every broadcast on FIREHOSE_PORT
+*               (serverFirehose.c). They get batched, optionally deflated, drop-on-lag streams from
+*               their own thread and are not chat clients, so they never hold up chat fan-out.
+*               
+*               Clients on the same host can map the shared-memory broadcast ring (serverLocalRing.c)
+*               and send ">>local<<"; their broadcasts are then written to the ring once instead of
+*               being sent over TCP.
+*               
+*               LAN clients can send ">>multicast<<" instead, to get their broadcasts from a multicast
+*               group (serverMulticast.c); gaps are repaired over TCP when they send ">>nack<<".
+*               
+*               Web clients connect to WEBSOCKET_PORT (serverWebSocket.c). After the handshake they are
+*               handled like any other client; only their messages travel in WebSocket text frames.
+*               
+*               Clients that want encryption connect to TLS_PORT (serverTLS.c). Their session keys are
+*               handed to the kernel after the handshake where possible, so broadcasts to them are
+*               still a single send() each.
+*               
+*               Every send to a client goes through its output queue (tlsSend()). A client handler only
+*               ever waits for its own client's socket, in its event loop; what it sends to another
+*               client, or with a registry shard locked, is queued whole without waiting - or refused
+*               if that client is too far behind.
+*               
+*               Chat messages pass through the filter stage (serverFilter.c) before the message queue.
+*               Patterns from the filter pattern file block a message (the sender gets ">>filtered<<")
+*               or mask words in it; they are matched on separate filter workers, and reloaded without
+*               stopping traffic when the file changes or FILTER_RELOAD_SIGNAL (SIGHUP) is sent.
+*               Before that, near-duplicate floods are rejected (serverSpam.c): a message too close to
+*               ones the same sender - or everyone together - sent in the last half minute gets ">>spam<<".
+*               
+*               "@<userID>" in a message mentions a connected user (serverMention.c). Mentions are found
+*               once, when the message comes in, and travel with it; the broadcaster sends each mentioned
+*               user ">>mention<< <sender>" ahead of the message. While messages are being shed, the
+*               mentioned users still get the flag and the message, straight from the client handler.
+*               
+*               The client registry is split into REGISTRY_NUM_SHARDS shards by a hash of the user ID, each
+*               with its own mutex, and the client count is kept atomically: clients in different shards
+*               register, leave and are looked up without waiting for each other. Only the presence roster
+*               locks every shard (in order). The client count and the running flag are atomics, so the
+*               monitor and the broadcaster poll them without taking any lock.
+*               
+*               The broadcaster fans out one task per shard on a work-stealing pool of worker threads
+*               (serverScheduler.c), each locking only its shard, so a broadcast to a busy room is sent
+*               from every core rather than one thread. The delivery mutex keeps broadcasts and clients
+*               switching to the local ring or multicast in order.
+*               
+*               Client handlers run as coroutines (serverCoroutine.c) on a couple of event loop threads
+*               rather than one thread each: a handler waiting for its client's next message costs a
+*               small stack, not a thread. Where the loops cannot be started, every client gets a thread.
+*               
 *               NOTE: Currently, no reply is sent to clients when invalid registration is received.
 *                     Invalid registration is due to either duplicate IP/UserID pair OR faulty/missing registration message.
 */
 
 #include "../inc/chatServer.h"
 
+// Set by the STATS_SIGNAL handler, consumed by the client monitor
+static volatile sig_atomic_t statsRequested = 0;
+
+// Sessions run on COROUTINE_STACK_SIZE stacks, so whatever grows with MAX_CLIENTS is kept off them (static, or not
+// collected at all) and the stack only has to cover the fixed frames
+_Static_assert(COROUTINE_STACK_SIZE >= SESSION_STACK_RESERVE,
+    "COROUTINE_STACK_SIZE is smaller than a session needs - keep arrays sized by MAX_CLIENTS off session stacks");
 
 /*
 * Function:     setupServer
@@ -180,6 +268,91 @@ int runServer()
     SharedData* sharedDataP = getSharedData(shrdMemID);
     //sharedDataP->numClients = 3;
 
+    // Open the persisted chat log and start indexing it - the server still works without history
+    if (logOpen(CHAT_LOG_DIR) != LOG_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : chat history unavailable - messages will not be persisted\n");
+    }
+    else
+    {
+        // Restore known users and the index from the latest snapshot, so only the log after it is replayed
+        if (snapshotRestore(CHAT_LOG_DIR) == SNAPSHOT_CORRUPT)
+        {
+            fprintf(stderr, "[SERVER] : registry snapshot is corrupt - rebuilding from the chat log\n");
+        }
+
+        if (historyIndexStart() != INDEX_SUCCESS || logRetentionStart() != LOG_SUCCESS || snapshotStart(CHAT_LOG_DIR) != SNAPSHOT_SUCCESS)
+        {
+            fprintf(stderr, "[SERVER] : chat history only partially available\n");
+        }
+    }
+
+    // Start sending presence deltas
+    if (presenceStart(sharedDataP) != PRESENCE_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : presence updates unavailable\n");
+    }
+
+    // Accept read-only firehose subscribers on their own port
+    if (firehoseStart(FIREHOSE_PORT) != FIREHOSE_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : firehose unavailable\n");
+    }
+
+    // Hand the shared-memory broadcast ring out to same-host clients
+    if (localRingStart() != LOCAL_RING_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : shared-memory ring unavailable - local clients will use TCP\n");
+    }
+
+    // Let LAN clients take their broadcasts from the multicast group
+    if (multicastStart() != MULTICAST_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : multicast unavailable - clients will use TCP\n");
+    }
+
+    // Broadcast fan-out is split into tasks over a work-stealing pool
+    if (schedulerStart() != SCHEDULER_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : scheduler unavailable - the broadcaster will fan out alone\n");
+    }
+
+    // Client handlers share a few event loop threads instead of taking a thread each
+    if (coroutineStart() != COROUTINE_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : event loops unavailable - every client gets a thread\n");
+    }
+
+    // Web clients connect through the WebSocket gateway, into the same registry and broadcaster
+    if (websocketStart(WEBSOCKET_PORT, acceptWebSocketClient, sharedDataP) != WEBSOCKET_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : WebSocket gateway unavailable\n");
+    }
+
+    // Encrypted clients connect to the TLS port - kernel TLS keeps their fan-out a plain send()
+    if (tlsStart(TLS_PORT, acceptTLSClient, sharedDataP) != TLS_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : TLS unavailable\n");
+    }
+
+    // Moderate chat messages on the filter workers before they reach the message queue
+    if (filterStart(sendFilteredMessage, sharedDataP) != FILTER_SUCCESS)
+    {
+        fprintf(stderr, "[SERVER] : message filter unavailable - messages will not be filtered\n");
+    }
+
+    // Print stats on request - SA_RESTART so accept() and read() are not interrupted
+    struct sigaction statsAction;
+    memset(&statsAction, 0, sizeof(statsAction));
+    statsAction.sa_handler = handleStatsSignal;
+    statsAction.sa_flags = SA_RESTART;
+    sigemptyset(&statsAction.sa_mask);
+    sigaction(STATS_SIGNAL, &statsAction, NULL);
+
+    // Reload the filter patterns on request, the same way
+    statsAction.sa_handler = handleReloadSignal;
+    sigaction(FILTER_RELOAD_SIGNAL, &statsAction, NULL);
+
     totalConnections = 0;
 
     #ifdef TESTING
@@ -192,57 +365,36 @@ int runServer()
 
         // Blocking call to accept() - should unblock if client connects or socket shuts down
         if ((clientSocket = accept(serverSocket, (struct sockaddr *)&clientAddress, &clientLen)) < 0) {
-            pthread_mutex_lock(&sharedDataP->mutex);
-
-            if (sharedDataP->serverIsRunning)
+            if (sharedDataIsRunning(sharedDataP))
             {
                 // Server is still supposed to be running - unexpected error occurred!
                 perror("[SERVER] : accept() FAILED\n");
                 retVal = SOCKET_ERROR;
             }
 
-            pthread_mutex_unlock(&sharedDataP->mutex);
             break;
         }
 
-        // New client has connected - prep data for sending to clientHandler
-        NewClient newClient = {.clientSocket = clientSocket, .sharedDataP = sharedDataP};
-        pthread_t newClientThread;
-
-        // Start client handler
-        if (pthread_create(&newClientThread, NULL, clientHandler, (void*)&newClient) != 0) {
-            perror("pthread_create");
+        // New client has connected - start its handler (and the monitor and broadcaster, if this is the first)
+        if (startClientHandler(clientSocket, sharedDataP) != SUCCESS)
+        {
+            close(clientSocket);
             retVal = THREAD_ERROR;
             break;
         }
 
-        // Start client monitor and broadcaster AFTER first client has already connected
-        // Monitor and broadcaster should wait MONITOR_STARTUP_SLEEP_LENGTH amount of seconds before starting
-        // To make sure client has enough time to register
-        if (totalConnections == 0)
-        {
-            pthread_t monitorThread, broadcasterThread;
-
-            //sleep(THREAD_STARTUP_SLEEP_LENGTH);
-
-            // Start client monitor
-            if (pthread_create(&monitorThread, NULL, clientConnectionMonitor, sharedDataP) != 0) {
-                perror("pthread_create");
-                retVal = THREAD_ERROR;
-                break;
-            }
-
-            // Start broadcaster
-            if (pthread_create(&broadcasterThread, NULL, chatBroadcaster, sharedDataP) != 0) {
-                perror("pthread_create");
-                retVal = THREAD_ERROR;
-                break;
-            }
-        }
-
         totalConnections++;
     }
 
+    websocketStop();
+    tlsStop();
+    coroutineStop();
+    filterStop();
+    presenceStop();
+    firehoseStop();
+    localRingStop();
+    multicastStop();
+
     // Socket is probably already closed at this stage, but attempting to close it again should
     // not cause any issues
     retVal = cleanUpServer(msgQID, shrdMemID, serverSocket);
@@ -250,7 +402,14 @@ int runServer()
     // Sleep here to make sure all threads are stopped - alternatively, could wait and join threads?
     sleep(THREAD_STARTUP_SHUTDOWN_SLEEP_LENGTH);
 
+    schedulerStop();
+    snapshotStop();
+    logRetentionStop();
+    historyIndexStop();
+    logClose();
+
     #ifdef TESTING
+        memPrintStats(stdout);
         printf("Server stopped - should be clean!\n");
     #endif
 
@@ -258,6 +417,132 @@ int runServer()
 }
 
 
+/*
+* Function:     startServerThreads
+* Purpose:      Starts the client monitor and the chat broadcaster, the first time it is called. They are
+*               started once the first client has connected, through either the chat or the WebSocket port.
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                             SUCCESS, or THREAD_ERROR if a thread could not be started.
+*/
+int startServerThreads(SharedData* sharedDataP)
+{
+    static pthread_mutex_t startMutex = PTHREAD_MUTEX_INITIALIZER;
+    static int isStarted = 0;
+
+    int retVal = SUCCESS;
+
+    pthread_mutex_lock(&startMutex);
+
+    if (!isStarted)
+    {
+        pthread_t monitorThread, broadcasterThread;
+
+        // Start client monitor
+        if (pthread_create(&monitorThread, NULL, clientConnectionMonitor, sharedDataP) != 0) {
+            perror("pthread_create");
+            retVal = THREAD_ERROR;
+        }
+        // Start broadcaster
+        else if (pthread_create(&broadcasterThread, NULL, chatBroadcaster, sharedDataP) != 0) {
+            perror("pthread_create");
+            retVal = THREAD_ERROR;
+        }
+        else
+        {
+            // Never joined - they stop on their own once the last client is gone
+            pthread_detach(monitorThread);
+            pthread_detach(broadcasterThread);
+            isStarted = 1;
+        }
+    }
+
+    pthread_mutex_unlock(&startMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     startClientHandler
+* Purpose:      Starts the handler for a newly connected client - a coroutine on one of the event loops,
+*               or a thread of its own if the loops are not running.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               SharedData*     sharedDataP     Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                             SUCCESS, or THREAD_ERROR if the handler could not be started.
+*/
+int startClientHandler(int clientSocket, SharedData* sharedDataP)
+{
+    // Freed by the handler - the accepting thread moves on to the next client straight away
+    NewClient* newClientP = memAlloc(MEM_CONNECTION_STATE, sizeof(NewClient));
+    if (newClientP == NULL)
+    {
+        return THREAD_ERROR;
+    }
+    newClientP->clientSocket = clientSocket;
+    newClientP->sharedDataP = sharedDataP;
+
+    pthread_t newClientThread;
+
+    // Start client handler
+    if (coroutineSpawn(clientHandler, (void*)newClientP) != COROUTINE_SUCCESS)
+    {
+        if (pthread_create(&newClientThread, NULL, clientHandler, (void*)newClientP) != 0) {
+            perror("pthread_create");
+            memFree(MEM_CONNECTION_STATE, newClientP);
+            return THREAD_ERROR;
+        }
+
+        // Nobody waits for a handler thread - its stack goes back as soon as the client leaves
+        pthread_detach(newClientThread);
+    }
+
+    // Start client monitor and broadcaster AFTER first client has already connected
+    return startServerThreads(sharedDataP);
+}
+
+
+/*
+* Function:     acceptWebSocketClient
+* Purpose:      Called by the WebSocket gateway for each web client that connects.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               void*           arg             A pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                             WEBSOCKET_SUCCESS, or WEBSOCKET_ERROR if no handler could be started.
+*/
+int acceptWebSocketClient(int clientSocket, void* arg)
+{
+    return startClientHandler(clientSocket, (SharedData*)arg) == SUCCESS ? WEBSOCKET_SUCCESS : WEBSOCKET_ERROR;
+}
+
+
+/*
+* Function:     acceptTLSClient
+* Purpose:      Called by the TLS listener for each client that connects.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               void*           arg             A pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                             TLS_SUCCESS, or TLS_ERROR if no handler could be started.
+*/
+int acceptTLSClient(int clientSocket, void* arg)
+{
+    return startClientHandler(clientSocket, (SharedData*)arg) == SUCCESS ? TLS_SUCCESS : TLS_ERROR;
+}
+
+
 /*
 * Function:     clientConnectionMonitor
 * Purpose:      Monitors client connections and stops the server if there are no active clients.
@@ -278,17 +563,11 @@ void* clientConnectionMonitor(void* arg)
     //sleep(THREAD_STARTUP_SLEEP_LENGTH);
     while (!serverIsRunning)
     {
-        // Lock
-        pthread_mutex_lock(&sharedDataP->mutex);
-
-        if (sharedDataP->numClients > 0)
+        if (registryGetNumClients(sharedDataP) > 0)
         {
             serverIsRunning = RUNNING;
         }
 
-        // Unlock
-        pthread_mutex_unlock(&sharedDataP->mutex);
-
         usleep(THREAD_LOOP_SLEEP_LENGTH); // Sleep for 10 milliseconds
     }
     
@@ -300,18 +579,24 @@ void* clientConnectionMonitor(void* arg)
      // Increment counter in a loop
     while (serverIsRunning) 
     {
-        // Lock mutex before accessing shared data
-        pthread_mutex_lock(&sharedDataP->mutex);
-
-        if (sharedDataP->numClients <= 0) 
+        // Both read and published without a lock - see sharedDataStop()
+        if (registryGetNumClients(sharedDataP) <= 0) 
         {
-            closeServerSocket(sharedDataP->serverSocket);
-            sharedDataP->serverIsRunning = 0;
+            sharedDataStop(sharedDataP);
+            wakeBroadcaster(sharedDataP);
             serverIsRunning = STOPPING;
         }
 
-        // Unlock mutex after accessing shared data
-        pthread_mutex_unlock(&sharedDataP->mutex);
+        // Let idle multicast clients notice lost tail packets - the broadcaster only runs when there is a broadcast
+        multicastHeartbeat();
+
+        // Push out what sends that could not wait left queued for slow clients
+        tlsFlushPending();
+
+        if (__atomic_exchange_n(&statsRequested, 0, __ATOMIC_ACQUIRE))
+        {
+            printServerStats(sharedDataP);
+        }
 
         usleep(THREAD_LOOP_SLEEP_LENGTH); // Sleep for 10 milliseconds
     }
@@ -337,7 +622,7 @@ void* clientConnectionMonitor(void* arg)
 void* clientHandler (void* arg)
 {
     NewClient* newClientP = (NewClient*) arg;
-    pthread_t threadID = pthread_self();
+    pthread_t threadID = coroutineSelf();
 
     #ifdef TESTING
         //printf("New client on thread ID: %lu\n", threadID);
@@ -346,32 +631,46 @@ void* clientHandler (void* arg)
     // Retrieve necessary data
     int clientSocket = newClientP->clientSocket;
     SharedData* sharedDataP = newClientP->sharedDataP;
+    memFree(MEM_CONNECTION_STATE, newClientP);
     //int msgQID = sharedDataP->msgQueueID; // Should be safe to access without mutex since it should never change
 
+    // Web clients upgrade their connection first, TLS clients set up their session
+    if ((websocketIsClient(clientSocket) && websocketHandshake(clientSocket) != WEBSOCKET_SUCCESS) ||
+        (tlsIsClient(clientSocket) && tlsHandshake(clientSocket) != TLS_SUCCESS))
+    {
+        close(clientSocket);
+        return NULL;
+    }
+
     // Get client IP
     char* clientIP = getClientIP(clientSocket);
     if (clientIP == NULL)
     {
         perror("getClientIP");
+        websocketForget(clientSocket);
+        tlsForget(clientSocket);
         close(clientSocket);
-        pthread_exit(NULL);
+        return NULL;
     }
 
 
-    // Attempt to register client
-    if (processMessage(clientSocket, clientIP, sharedDataP, IS_REGISTRATION) != MESSAGE_PROCESS_SUCCESS)
+    // Attempt to register client - the user ID it registered with picks its registry shard from now on
+    char clientUserID[CLIENT_USERID_LENGTH + 1] = "";
+    if (processMessage(clientSocket, clientIP, clientUserID, sharedDataP, IS_REGISTRATION) != MESSAGE_PROCESS_SUCCESS)
     {
         // Client failed to register correctly
+        websocketForget(clientSocket);
+        tlsForget(clientSocket);
         close(clientSocket);
-        free(clientIP);
-        pthread_exit(NULL);
+        memFree(MEM_CONNECTION_STATE, clientIP);
+        return NULL;
     }
 
     // Client registered - loop until quit
     int processResult;
     while (RUNNING)
     {
-        processResult = processMessage(clientSocket, clientIP, sharedDataP, IS_MESSAGE);
+        processResult = processMessage(clientSocket, clientIP, clientUserID, sharedDataP, IS_MESSAGE);
 
         if (processResult != MESSAGE_PROCESS_SUCCESS)
         {
@@ -379,25 +678,37 @@ void* clientHandler (void* arg)
         }
     }
 
-    // Remove client from list
-    // Lock mutex
-    pthread_mutex_lock(&sharedDataP->mutex);
+    // Remove client from list (after a ">>bye<<", the client is already removed)
+    // Lock the client's shard
+    RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+    pthread_mutex_lock(&shardP->mutex);
+
+    int clientIndex = findThreadIDInList(threadID, shardP);
+    removeFromList(clientIndex, shardP, sharedDataP);
 
-    int clientIndex = findThreadIDInList(threadID, sharedDataP);
-    removeFromList(clientIndex, sharedDataP);
+    // Unlock the shard
+    pthread_mutex_unlock(&shardP->mutex);
 
     #ifdef TESTING
-        printf("\nClient '%s' from '%s' disconnected!\n", sharedDataP->connectedClients[clientIndex].clientUserID, clientIP);
+        printf("\nClient '%s' from '%s' disconnected!\n", clientUserID, clientIP);
+        registryLockAll(sharedDataP);
         printSharedData(sharedDataP);
+        registryUnlockAll(sharedDataP);
     #endif
 
-    // Unlock mutex
-    pthread_mutex_unlock(&sharedDataP->mutex);
+    if (clientIndex != ENTRY_NOT_FOUND_OR_NULL)
+    {
+        sessionDisconnect(clientIP, clientUserID, logGetNextSequence());
+        presenceLeft(clientIP, clientUserID);
+        presenceStoppedTyping(clientIP, clientUserID);
+    }
 
     // Clean up
+    websocketForget(clientSocket);
+    tlsForget(clientSocket);
     close(clientSocket);
-    free(clientIP);
-    pthread_exit(NULL);
+    memFree(MEM_CONNECTION_STATE, clientIP);
+    return NULL;
 }
 
 
@@ -424,17 +735,11 @@ void* chatBroadcaster(void* arg)
     //sleep(THREAD_STARTUP_SLEEP_LENGTH);
     while (!serverIsRunning)
     {
-        // Lock
-        pthread_mutex_lock(&sharedDataP->mutex);
-
-        if (sharedDataP->numClients > 0)
+        if (registryGetNumClients(sharedDataP) > 0)
         {
             serverIsRunning = RUNNING;
         }
 
-        // Unlock
-        pthread_mutex_unlock(&sharedDataP->mutex);
-
         usleep(THREAD_LOOP_SLEEP_LENGTH); // Sleep for 10 milliseconds
     }
 
@@ -447,55 +752,123 @@ void* chatBroadcaster(void* arg)
         // Lock mutex
         //pthread_mutex_lock(&sharedDataP->mutex);
 
-        if (sharedDataP->numClients <= 0) 
+        if (registryGetNumClients(sharedDataP) <= 0) 
         {
             serverIsRunning = STOPPING;
             break;
         }
 
-        // Receive message envelope from the message queue
-        if (msgrcv(msgQID, &envelope, sizeof(Broadcast), TYPE_SERVERMESSAGE, IPC_NOWAIT) == -1) {
-            // Error occured - if error is ENOMSG, then no problem just continue; otherwise break
-            if (errno != ENOMSG)
+        // Wait for the next message envelope - broadcasts are taken before a wake-up (see wakeBroadcaster())
+        if (msgrcv(msgQID, &envelope, QUEUE_MESSAGE_LENGTH, -TYPE_BROADCASTER_WAKE, 0) == -1) {
+            // Error occured - if a signal interrupted the wait, just wait again; otherwise break
+            if (errno != EINTR)
             {
                 serverIsRunning = STOPPING;
                 perror("msgrcv");
                 break;
             }
         }
-        else
+        else if (envelope.type == TYPE_SERVERMESSAGE)
         {
-            // Message received from queue - broadcast to all clients!
+            // Message received from queue - persist it, then broadcast to all clients!
+            logAppend(&envelope.broadcastMessage);
+            firehosePublish(&envelope.broadcastMessage);
+
             char* broadcastMsg = broadcastToJson(&envelope.broadcastMessage);
+            size_t broadcastLength = strlen(broadcastMsg);
+
+            // Over budget - shed the TCP fan-out to everyone but the users the message mentions. The local
+            // ring, multicast and the mention flags cost no per-client buffers, so they still go out, and
+            // the broadcast is logged, so history and catch-up still have it
+            int isShedding = memCharge(MEM_OUTBOUND_BUFFERS, broadcastLength + 1) == MEMORY_OVER_BUDGET;
+            if (isShedding)
+            {
+                memNoteShed(MEM_OUTBOUND_BUFFERS);
+            }
+
+            // Framed once here for every web client, rather than once per web client
+            char websocketFrame[JSON_LENGTH + WEBSOCKET_MAX_HEADER_LENGTH];
+            size_t websocketFrameLength = 0;
+
+            // Lock - no client changes how it gets broadcasts until this one is out
+            pthread_mutex_lock(&sharedDataP->deliveryMutex);
+
+            // Written once for every same-host reader - under the delivery mutex, so moveToLocalRing()
+            // can tell exactly where a client's TCP broadcasts end
+            localRingPublish(&envelope.broadcastMessage);
+
+            // Mentioned users get their heads-up ahead of the message, however their broadcasts travel
+            if (envelope.mentions.numTargets > 0)
+            {
+                sendMentionFlags(envelope.broadcastMessage.clientUserID, &envelope.mentions, sharedDataP);
+            }
+
+            // Broadcast broadcastMsg to all clients that get broadcasts over TCP - a shard per task on
+            // the scheduler's workers when there are enough clients, with this thread taking the first
+            FanoutChunk chunks[REGISTRY_NUM_SHARDS];
+            int isParallel = !isShedding && schedulerIsAvailable() && registryGetNumClients(sharedDataP) >= FANOUT_PARALLEL_THRESHOLD;
+            SchedulerGroup fanoutGroup = {0};
 
-            // Lock
-            pthread_mutex_lock(&sharedDataP->mutex);
+            if (isParallel)
+            {
+                // Framed up front, so the tasks only ever read it
+                websocketFrameLength = websocketFrameText(broadcastMsg, broadcastLength, websocketFrame);
+            }
+
+            for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+            {
+                FanoutChunk* chunkP = &chunks[shard];
+                chunkP->shardP = &sharedDataP->shards[shard];
+                chunkP->broadcastMsg = broadcastMsg;
+                chunkP->broadcastLength = broadcastLength;
+                chunkP->websocketFrame = websocketFrame;
+                chunkP->websocketFrameLengthP = &websocketFrameLength;
+                chunkP->onlyMentionsP = isShedding ? &envelope.mentions : NULL;
+                chunkP->hasMulticastClients = 0;
+
+                // Same shard, same worker - its sockets stay warm in that CPU's cache
+                if (!isParallel)
+                {
+                    fanOutChunk(chunkP);
+                }
+                else if (shard > 0)
+                {
+                    schedulerSubmit(&chunkP->task, &fanoutGroup, fanOutChunk, chunkP, shard);
+                }
+            }
+
+            if (isParallel)
+            {
+                fanOutChunk(&chunks[0]);
+                schedulerWait(&fanoutGroup);
+            }
 
-            int clientSocket;
+            int hasMulticastClients = 0;
+            for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+            {
+                hasMulticastClients |= chunks[shard].hasMulticastClients;
+            }
 
-            // Broadcast broadcastMsg to all clients
-            for (int i = 0; i < sharedDataP->numClients; i++)
+            // Sent once to the group for all multicast clients - also under the delivery mutex, for moveToMulticast()
+            if (hasMulticastClients)
             {
-                clientSocket = sharedDataP->connectedClients[i].clientSocket;
-                send(clientSocket, broadcastMsg, strlen(broadcastMsg), 0);
+                multicastPublish(&envelope.broadcastMessage);
             }
 
             // Unlock
-            pthread_mutex_unlock(&sharedDataP->mutex);      
+            pthread_mutex_unlock(&sharedDataP->deliveryMutex);
 
             #ifdef TESTING
                 printf("\nBroadcasting '%s' to all clients.\n", broadcastMsg);
             #endif
 
-            free(broadcastMsg);                                    
+            free(broadcastMsg);
+            memRelease(MEM_OUTBOUND_BUFFERS, broadcastLength + 1);
 
         }
 
         // Unlock mutex
         //pthread_mutex_unlock(&sharedDataP->mutex);
-
-        
-        usleep(THREAD_LOOP_SLEEP_LENGTH);
     }
 
     #ifdef TESTING
@@ -506,24 +879,102 @@ void* chatBroadcaster(void* arg)
 }
 
 
+/*
+* Function:     wakeBroadcaster
+* Purpose:      Wakes the chat broadcaster, which waits in msgrcv() for the next broadcast, so it checks
+*               whether any clients are left. The wake-up is taken after every broadcast already queued.
+*               If the queue is full, nothing is sent - the broadcaster is not waiting then, and checks
+*               before taking each broadcast.
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void wakeBroadcaster(SharedData* sharedDataP)
+{
+    QueueMessageEnvelope envelope;
+    memset(&envelope, 0, sizeof(envelope));
+    envelope.type = TYPE_BROADCASTER_WAKE;
+
+    if (msgsnd(sharedDataP->msgQueueID, &envelope, QUEUE_MESSAGE_LENGTH, IPC_NOWAIT) == -1 && errno != EAGAIN)
+    {
+        perror("msgsnd");
+    }
+}
+
+
+/*
+* Function:     fanOutChunk
+* Purpose:      Scheduler task sending a broadcast to the clients of one registry shard that get
+*               broadcasts over TCP. Locks the shard itself, so it only ever waits for clients in it.
+*
+* Inputs:       void*           arg             The shard, a FanoutChunk.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void fanOutChunk(void* arg)
+{
+    FanoutChunk* chunkP = (FanoutChunk*) arg;
+    RegistryShard* shardP = chunkP->shardP;
+
+    pthread_mutex_lock(&shardP->mutex);
+
+    for (int i = 0; i < shardP->numClients; i++)
+    {
+        if (shardP->connectedClients[i].delivery != DELIVERY_TCP)
+        {
+            chunkP->hasMulticastClients |= shardP->connectedClients[i].delivery == DELIVERY_MULTICAST;
+            continue;
+        }
+
+        if (chunkP->onlyMentionsP != NULL && !mentionIsTarget(chunkP->onlyMentionsP, shardP->connectedClients[i].clientUserID))
+        {
+            continue;
+        }
+
+        int clientSocket = shardP->connectedClients[i].clientSocket;
+        if (websocketIsClient(clientSocket))
+        {
+            if (*chunkP->websocketFrameLengthP == 0)
+            {
+                *chunkP->websocketFrameLengthP = websocketFrameText(chunkP->broadcastMsg, chunkP->broadcastLength, chunkP->websocketFrame);
+            }
+            websocketSendFrame(clientSocket, chunkP->websocketFrame, *chunkP->websocketFrameLengthP);
+        }
+        else
+        {
+            tlsSend(clientSocket, chunkP->broadcastMsg, chunkP->broadcastLength, 0);
+        }
+    }
+
+    pthread_mutex_unlock(&shardP->mutex);
+}
+
+
 /*
 * Function:     processMessage
 * Purpose:      Processes messages received from clients, including registration and normal messages.
 *
 * Inputs:       int             clientSocket        The socket file descriptor of the client.
 *               const char*     clientIP            The IP address of the client.
+*               char*           clientUserID        The user ID the client registered with (CLIENT_USERID_LENGTH + 1 bytes).
 *               SharedData*     sharedDataP         Pointer to the shared data structure.
 *               int             isRegistration      Flag indicating if the message is a registration message.
 *
-* Outputs:      None
+* Outputs:      clientUserID                        Set when the client registers.
 *
 * Returns:      int                                 MESSAGE_PROCESS_SUCCESS if successful, MESSAGE_PROCESS_FAILED if failed to process message, MESSAGE_PROCESS_QUIT if the message indicates the client is quitting.
 */
-int processMessage(int clientSocket, const char* clientIP, SharedData* sharedDataP, int isRegistration)
+int processMessage(int clientSocket, const char* clientIP, char* clientUserID, SharedData* sharedDataP, int isRegistration)
 {
     int retVal = MESSAGE_PROCESS_SUCCESS;
+    int isChatMessage = 0;
 
-    pthread_t threadID = pthread_self();
+    pthread_t threadID = coroutineSelf();
 
     #ifdef TESTING
         //printf("Process Message thread ID: %lu\n", threadID);
@@ -534,11 +985,27 @@ int processMessage(int clientSocket, const char* clientIP, SharedData* sharedDat
 
     memset(readBuffer, 0, JSON_LENGTH);
 
-    // Read message
-    numBytesRead = read(clientSocket, readBuffer, JSON_LENGTH);
+    // Read exactly one message - a typing ping and the message typed right after it
+    // can arrive together, so peek first and leave whatever follows for the next call.
+    // Web clients send one message per WebSocket frame.
+    if (websocketIsClient(clientSocket))
+    {
+        numBytesRead = websocketReadMessage(clientSocket, readBuffer, JSON_LENGTH);
+    }
+    else if ((numBytesRead = tlsRecv(clientSocket, readBuffer, JSON_LENGTH - 1, MSG_PEEK)) > 0)
+    {
+        int frameLength = jsonObjectLength(readBuffer, numBytesRead);
+        memset(readBuffer, 0, JSON_LENGTH);
+        numBytesRead = tlsRecv(clientSocket, readBuffer, frameLength > 0 ? frameLength : JSON_LENGTH - 1, 0);
+    }
 
     // Message successfully read! Try to deserialize
     ClientMessage* clientMessage = jsonToClientMessage(readBuffer);
+    if (clientMessage == NULL)
+    {
+        return MESSAGE_PROCESS_FAILED;
+    }
+    int parserCharge = memCharge(MEM_PARSER_BUFFERS, sizeof(ClientMessage));
 
     // Check number of bytes for an error - in theory, if client closes connection, should be here
     if (numBytesRead == -1 || strlen(clientMessage->clientUserID) == 0 || isWhitespace(clientMessage->clientUserID) == 1)
@@ -549,24 +1016,62 @@ int processMessage(int clientSocket, const char* clientIP, SharedData* sharedDat
 
         if (isRegistration)
         {
-            sendServerMessage(clientSocket, SERVER_REGISTRATION_FAIL_MSG);
+            sendServerMessage(clientSocket, SERVER_REGISTRATION_FAIL_MSG, 0);
         }
 
+        free(clientMessage);
+        memRelease(MEM_PARSER_BUFFERS, sizeof(ClientMessage));
         return MESSAGE_PROCESS_FAILED;
     }
 
+    if (parserCharge == MEMORY_OVER_BUDGET)
+    {
+        // Over budget - refuse a registration, drop a message but keep the client
+        memNoteShed(MEM_PARSER_BUFFERS);
+
+        #ifdef TESTING
+            printf("\nMessage from '%s' shed - server is over its memory budget!\n", clientIP);
+        #endif
+
+        // Released first, so the refusal itself is not shed
+        free(clientMessage);
+        memRelease(MEM_PARSER_BUFFERS, sizeof(ClientMessage));
+
+        if (isRegistration)
+        {
+            sendServerMessage(clientSocket, SERVER_REGISTRATION_FAIL_MSG, 0);
+        }
+
+        return isRegistration ? REGISTRATION_FAILED : MESSAGE_PROCESS_SUCCESS;
+    }
+
     if (isRegistration)
     {
-        // Lock mutex
-        pthread_mutex_lock(&sharedDataP->mutex);
+        int sessionStatus = SESSION_NEW;
+        uint64_t lastSequence = 0;
+
+        // Lock every shard - a duplicate registration can only be in the user ID's own shard, but the
+        // roster spans them all, and must be queued before anything else can reach the new client
+        RegistryShard* shardP = registryGetShard(clientMessage->clientUserID, sharedDataP);
+        registryLockAll(sharedDataP);
 
         // Registration so check for ">>hello<<" message AND for non-duplicate/unregistered user
-        int foundIndex = findUserInList(clientIP, clientMessage->clientUserID, sharedDataP);
+        int foundIndex = findUserInList(clientIP, clientMessage->clientUserID, shardP);
 
-        if (strncmp(clientMessage->message, SERVER_REGISTRATION_MSG, sizeof(SERVER_REGISTRATION_MSG)) == 0
-            && foundIndex == ENTRY_NOT_FOUND_OR_NULL)
+        if (memIsUnderPressure())
         {
-            // Valid registration - add to list
+            // Shed new connections before running out of memory
+            retVal = REGISTRATION_FAILED;
+            memNoteShed(MEM_CONNECTION_STATE);
+
+            #ifdef TESTING
+                printf("\nClient '%s' from '%s' refused - server is over its memory watermark!\n", clientMessage->clientUserID, clientIP);
+            #endif
+        }
+        else if (strncmp(clientMessage->message, SERVER_REGISTRATION_MSG, sizeof(SERVER_REGISTRATION_MSG)) == 0
+            && foundIndex == ENTRY_NOT_FOUND_OR_NULL)
+        {
+            // Valid registration - add to list
             if (addToList(threadID, clientIP, clientMessage->clientUserID, clientSocket, sharedDataP) == TOO_MANY_CLIENTS)
             {
                 retVal = MESSAGE_PROCESS_FAILED;
@@ -576,81 +1081,179 @@ int processMessage(int clientSocket, const char* clientIP, SharedData* sharedDat
             }
             else
             {
-                sendServerMessage(clientSocket, SERVER_REGISTRATION_SUCCESS_MSG);
+                // Reply and roster are queued without waiting, as every shard is locked
+                sessionStatus = sessionConnect(clientIP, clientMessage->clientUserID, logGetNextSequence(), &lastSequence);
+                sendServerMessage(clientSocket, SERVER_REGISTRATION_SUCCESS_MSG, MSG_DONTWAIT);
+                presenceSendRoster(clientSocket, sharedDataP);
+                presenceJoined(clientIP, clientMessage->clientUserID);
+
+                strncpy(clientUserID, clientMessage->clientUserID, CLIENT_USERID_LENGTH);
+                clientUserID[CLIENT_USERID_LENGTH] = '\0'; // Ensure null termination
+
                 #ifdef TESTING
-                    printf("\nClient '%s' from '%s' connected!\n", clientMessage->clientUserID, clientIP);
+                    printf("\nClient '%s' from '%s' connected!\n", clientUserID, clientIP);
                     printSharedData(sharedDataP);
-                #endif 
+                #endif
             }
-
-            
         }
         else
         {
             retVal = REGISTRATION_FAILED;
-            // User failed to register - send reply
-            sendServerMessage(clientSocket, SERVER_REGISTRATION_FAIL_MSG);
 
             #ifdef TESTING
                 printf("\nClient '%s' from '%s' attempted to register with already existing User ID or without correct registration message!\n", clientMessage->clientUserID, clientIP);
             #endif
         }
 
-        // Unlock mutex
-        pthread_mutex_unlock(&sharedDataP->mutex);
+        // Unlock the shards
+        registryUnlockAll(sharedDataP);
+
+        // User failed to register - send reply, now that the send may wait
+        if (retVal == REGISTRATION_FAILED)
+        {
+            sendServerMessage(clientSocket, SERVER_REGISTRATION_FAIL_MSG, 0);
+        }
+
+        // Known user coming back - catch it up from the log, outside the shard lock
+        if (sessionStatus == SESSION_RESUMED)
+        {
+            sendMissedMessages(clientSocket, lastSequence);
+        }
+
+        if (retVal == MESSAGE_PROCESS_SUCCESS)
+        {
+            sendMailbox(clientSocket, clientMessage->clientUserID);
+        }
+    }
+    else if (strncmp(clientMessage->message, SERVER_SEARCH_MSG, strlen(SERVER_SEARCH_MSG)) == 0)
+    {
+        // History search - only reads the log and index, so no need to lock SharedData
+        sendSearchResults(clientSocket, clientMessage->message + strlen(SERVER_SEARCH_MSG));
+    }
+    else if (strncmp(clientMessage->message, MULTICAST_MSG, sizeof(MULTICAST_MSG)) == 0)
+    {
+        // LAN client getting broadcasts from the multicast group instead
+        moveToMulticast(clientSocket, clientUserID, sharedDataP);
+    }
+    else if (strncmp(clientMessage->message, MULTICAST_NACK_MSG, strlen(MULTICAST_NACK_MSG)) == 0)
+    {
+        // Multicast client missed some broadcasts - resend them from the history
+        multicastRepair(clientSocket, clientMessage->message + strlen(MULTICAST_NACK_MSG));
+    }
+    else if (strncmp(clientMessage->message, LOCAL_RING_MSG, sizeof(LOCAL_RING_MSG)) == 0)
+    {
+        // Same-host client reading broadcasts from the shared-memory ring instead
+        moveToLocalRing(clientSocket, clientUserID, sharedDataP);
+    }
+    else if (strncmp(clientMessage->message, PRESENCE_TYPING_MSG, sizeof(PRESENCE_TYPING_MSG)) == 0)
+    {
+        // Typing ping - just noted, the presence thread sends the aggregated frame
+        presenceTyping(clientIP, clientMessage->clientUserID);
+    }
+    else if (strncmp(clientMessage->message, SERVER_DIRECT_MSG, strlen(SERVER_DIRECT_MSG)) == 0)
+    {
+        // Direct message - locks the recipient's shard itself to find it
+        sendDirectMessage(clientSocket, clientIP, clientMessage, sharedDataP);
     }
     else
     {
-        // Lock mutex
-        pthread_mutex_lock(&sharedDataP->mutex);
-
         // Normal message, check for ">>bye<<"
         if (strncmp(clientMessage->message, SERVER_QUIT_MSG, sizeof(SERVER_QUIT_MSG)) == 0)
         {
-            int clientIndex = findThreadIDInList(threadID, sharedDataP);
-            removeFromList(clientIndex, sharedDataP);
+            // Lock the client's shard
+            RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+            pthread_mutex_lock(&shardP->mutex);
+
+            int clientIndex = findThreadIDInList(threadID, shardP);
+            if (clientIndex != ENTRY_NOT_FOUND_OR_NULL)
+            {
+                sessionDisconnect(clientIP, clientUserID, logGetNextSequence());
+                presenceLeft(clientIP, clientUserID);
+                presenceStoppedTyping(clientIP, clientUserID);
+            }
+            removeFromList(clientIndex, shardP, sharedDataP);
+
+            // Unlock the shard
+            pthread_mutex_unlock(&shardP->mutex);
 
             retVal = MESSAGE_PROCESS_QUIT;
         }
+        else if (memIsUnderPressure())
+        {
+            // Shed the message rather than queueing more outbound data - only the users it mentions still get it,
+            // once it has passed the same spam check and filter as any other chat message
+            memNoteShed(MEM_OUTBOUND_BUFFERS);
+
+            MentionList mentions;
+            if (mentionParse(clientMessage->message, &mentions) > 0)
+            {
+                if (spamCheck(clientIP, clientMessage) != SPAM_ACCEPTED)
+                {
+                    sendServerMessage(clientSocket, SPAM_REJECTED_MSG, 0);
+                }
+                else if (filterCheck(clientMessage->message) == FILTER_BLOCKED)
+                {
+                    sendServerMessage(clientSocket, FILTER_BLOCKED_MSG, 0);
+                }
+                else
+                {
+                    sendMentionCopies(clientIP, clientMessage, &mentions, sharedDataP);
+                }
+            }
+        }
         else
         {
-            // Normal message! Send to message queue
-            sendMessageToQueue(clientIP, clientMessage, sharedDataP);
+            isChatMessage = 1;
         }
 
-        // Unlock mutex
-        pthread_mutex_unlock(&sharedDataP->mutex);
+        if (isChatMessage)
+        {
+            // Normal message! Floods are turned away before the fan-out can multiply them
+            if (spamCheck(clientIP, clientMessage) != SPAM_ACCEPTED)
+            {
+                sendServerMessage(clientSocket, SPAM_REJECTED_MSG, 0);
+            }
+            else
+            {
+                // Mentions are found here, once, and travel with the message from now on
+                MentionList mentions;
+                mentionParse(clientMessage->message, &mentions);
+
+                // Through the filter stage if there are patterns, straight to the message queue if not.
+                // Not under a shard lock - a full filter queue holds this handler up, and the filter workers need the sender's shard
+                if (filterSubmit(clientIP, clientMessage, &mentions) != FILTER_QUEUED)
+                {
+                    sendMessageToQueue(clientIP, clientMessage, &mentions, sharedDataP);
+                }
+            }
+            presenceStoppedTyping(clientIP, clientMessage->clientUserID);
+        }
     }
 
     // Clean up memory
     free(clientMessage);
+    memRelease(MEM_PARSER_BUFFERS, sizeof(ClientMessage));
 
     return retVal;
 }
 
 
 /*
-* Function:     sendMessageToQueue
-* Purpose:      Sends a message received from a client to the message queue for broadcasting.
+* Function:     buildBroadcasts
+* Purpose:      Turns a message received from a client into the broadcasts that carry it, splitting it
+*               in two if it is longer than a broadcast.
 *
 * Inputs:       const char*         clientIP            The IP address of the client.
-*               ClientMessage*      clientMessageP      Pointer to the ClientMessage structure containing the client's message.
-*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*               const ClientMessage* clientMessageP     The client's message.
+*               Broadcast*          broadcastMessages   Room for MAX_BROADCASTS_PER_MSG broadcasts.
 *
-* Outputs:      None
+* Outputs:      broadcastMessages
 *
-* Returns:      int                                     SUCCESS if successful, MESSAGE_PROCESS_FAILED if failed to send message to queue.
+* Returns:      int                                     Number of broadcasts.
 */
-int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, SharedData* sharedDataP)
+int buildBroadcasts(const char* clientIP, const ClientMessage* clientMessageP, Broadcast* broadcastMessages)
 {
-    int retVal = SUCCESS;
-
-    int msgQID = sharedDataP->msgQueueID;
-
-    // Message elements
     int numMessages = 1;
-    Broadcast broadcastMessages[MAX_BROADCASTS_PER_MSG];
-    QueueMessageEnvelope envelope;
 
     if (strlen(clientMessageP->message) > BROADCAST_MESSAGE_LENGTH)
     {
@@ -668,9 +1271,6 @@ int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, Shar
         broadcastMessages[0].message[BROADCAST_MESSAGE_LENGTH] = '\0'; // Ensure null termination
     }
 
-    // Lock mutex
-    //pthread_mutex_lock(&sharedDataP->mutex);
-
     for (int i = 0; i < numMessages; i++)
     {
         // Copy client IP
@@ -680,13 +1280,53 @@ int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, Shar
         // Copy client user ID
         strncpy(broadcastMessages[i].clientUserID, clientMessageP->clientUserID, CLIENT_USERID_LENGTH);
         broadcastMessages[i].clientUserID[CLIENT_USERID_LENGTH] = '\0'; // Ensure null termination
+    }
 
-        // Fill message envelope
+    return numMessages;
+}
+
+
+/*
+* Function:     sendMessageToQueue
+* Purpose:      Sends a message received from a client to the message queue for broadcasting.
+*
+* Inputs:       const char*         clientIP            The IP address of the client.
+*               ClientMessage*      clientMessageP      Pointer to the ClientMessage structure containing the client's message.
+*               const MentionList*  mentionsP           Users the message mentions.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                                     SUCCESS if successful, MESSAGE_PROCESS_FAILED if failed to send message to queue.
+*/
+int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, const MentionList* mentionsP, SharedData* sharedDataP)
+{
+    int retVal = SUCCESS;
+
+    int msgQID = sharedDataP->msgQueueID;
+
+    // Message elements
+    Broadcast broadcastMessages[MAX_BROADCASTS_PER_MSG];
+    QueueMessageEnvelope envelope;
+
+    int numMessages = buildBroadcasts(clientIP, clientMessageP, broadcastMessages);
+
+    // Lock mutex
+    //pthread_mutex_lock(&sharedDataP->mutex);
+
+    for (int i = 0; i < numMessages; i++)
+    {
+        // Fill message envelope - one heads-up per mention is enough, so only the first part carries them
         envelope.type = TYPE_SERVERMESSAGE;
         envelope.broadcastMessage = broadcastMessages[i];
+        envelope.mentions = *mentionsP;
+        if (i > 0)
+        {
+            envelope.mentions.numTargets = 0;
+        }
 
         // Send to message queue at msgQID
-        if (msgsnd(msgQID, (void *)&envelope, sizeof(Broadcast), 0) == -1) {
+        if (msgsnd(msgQID, (void *)&envelope, QUEUE_MESSAGE_LENGTH, 0) == -1) {
             perror("mq_send");
             retVal = MESSAGE_PROCESS_FAILED; 
         }
@@ -705,6 +1345,45 @@ int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, Shar
 }
 
 
+/*
+* Function:     sendFilteredMessage
+* Purpose:      Next stage after the message filter - called on a filter worker for every filtered message.
+*               Passed and masked messages go to the message queue; the sender of a blocked one is told.
+*
+* Inputs:       const char*         clientIP            The IP address of the client.
+*               ClientMessage*      clientMessageP      The message, with any masked patterns overwritten.
+*               const MentionList*  mentionsP           Users the message mentions.
+*               int                 verdict             FILTER_PASSED, FILTER_MASKED or FILTER_BLOCKED.
+*               void*               arg                 Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sendFilteredMessage(const char* clientIP, ClientMessage* clientMessageP, const MentionList* mentionsP, int verdict, void* arg)
+{
+    SharedData* sharedDataP = (SharedData*)arg;
+
+    if (verdict != FILTER_BLOCKED)
+    {
+        sendMessageToQueue(clientIP, clientMessageP, mentionsP, sharedDataP);
+        return;
+    }
+
+    // The sender may have left (or reconnected on another socket) while the message was queued
+    RegistryShard* shardP = registryGetShard(clientMessageP->clientUserID, sharedDataP);
+    pthread_mutex_lock(&shardP->mutex);
+
+    int clientIndex = findUserInList(clientIP, clientMessageP->clientUserID, shardP);
+    if (clientIndex != ENTRY_NOT_FOUND_OR_NULL)
+    {
+        sendServerMessage(shardP->connectedClients[clientIndex].clientSocket, FILTER_BLOCKED_MSG, MSG_DONTWAIT);
+    }
+
+    pthread_mutex_unlock(&shardP->mutex);
+}
+
+
 /*
 * Function:     getClientIP
 * Purpose:      Retrieves the IP address of a client given its socket.
@@ -718,24 +1397,24 @@ int sendMessageToQueue(const char* clientIP, ClientMessage* clientMessageP, Shar
 char* getClientIP(int clientSocket) {
     struct sockaddr_in clientAddr;
     socklen_t clientAddrLen = sizeof(clientAddr);
-    char* clientIP = malloc(INET_ADDRSTRLEN);
+    char* clientIP = memAlloc(MEM_CONNECTION_STATE, INET_ADDRSTRLEN);
 
     if (clientIP == NULL) {
-        perror("malloc");
+        perror("memAlloc");
         return NULL;
     }
 
     // Get the client's address
     if (getpeername(clientSocket, (struct sockaddr *)&clientAddr, &clientAddrLen) == -1) {
         perror("getpeername");
-        free(clientIP);
+        memFree(MEM_CONNECTION_STATE, clientIP);
         return NULL;
     }
 
     // Convert the binary IP address to a human-readable string
     if (inet_ntop(AF_INET, &(clientAddr.sin_addr), clientIP, INET_ADDRSTRLEN) == NULL) {
         perror("inet_ntop");
-        free(clientIP);
+        memFree(MEM_CONNECTION_STATE, clientIP);
         return NULL;
     }
 
@@ -804,22 +1483,560 @@ void splitString(const char *input, char *firstPart, char *secondPart, int maxSi
 *
 * Inputs:       int                 clientSocket              Client's socket.
 *               const char*         serverMessage             Message from server to send.
+*               int                 flags                     As for sendBroadcast().
 *
 * Outputs:      None
 *
 * Returns:      void
 */
-void sendServerMessage(int clientSocket, const char* serverMessage)
+void sendServerMessage(int clientSocket, const char* serverMessage, int flags)
 {
 
     Broadcast serverBroadcast = {.clientIP = "", .clientUserID = ""};
-    strncpy(serverBroadcast.message, serverMessage, BROADCAST_MESSAGE_LENGTH + 1); // Copy the message
+    strncpy(serverBroadcast.message, serverMessage, BROADCAST_MESSAGE_LENGTH); // Copy the message
+    serverBroadcast.message[BROADCAST_MESSAGE_LENGTH] = '\0'; // Ensure null termination
+
+    sendBroadcast(clientSocket, &serverBroadcast, flags);
+}
 
-    char* broadcastJSON = broadcastToJson(&serverBroadcast);
 
-    send(clientSocket, broadcastJSON, strlen(broadcastJSON), 0);
+/*
+* Function:     sendBroadcast
+* Purpose:      Sends a single broadcast to a specific client - shed if the server is over its memory budget.
+*               A send that may wait must only go to the caller's own socket, with no shard locked;
+*               with a shard locked, or to any other client, use MSG_DONTWAIT.
+*
+* Inputs:       int                 clientSocket              Client's socket.
+*               Broadcast*          broadcastP                Broadcast to send.
+*               int                 flags                     0, or MSG_DONTWAIT to queue it whole or not at all.
+*
+* Outputs:      None
+*
+* Returns:      int                                           1 if the client took it, 0 if it was shed or refused.
+*/
+int sendBroadcast(int clientSocket, Broadcast* broadcastP, int flags)
+{
+    char* broadcastJSON = broadcastToJson(broadcastP);
+    size_t broadcastLength = strlen(broadcastJSON);
+    int isSent = 0;
+
+    // Over budget - shed the send rather than hold more outbound memory
+    if (memCharge(MEM_OUTBOUND_BUFFERS, broadcastLength + 1) == MEMORY_OVER_BUDGET)
+    {
+        memNoteShed(MEM_OUTBOUND_BUFFERS);
+    }
+    else
+    {
+        isSent = clientSend(clientSocket, broadcastJSON, broadcastLength, flags) >= 0;
+    }
 
     free(broadcastJSON);
+    memRelease(MEM_OUTBOUND_BUFFERS, broadcastLength + 1);
+
+    return isSent;
+}
+
+
+/*
+* Function:     sendMentionFlags
+* Purpose:      Sends every connected user a message mentions ">>mention<< <sender>".
+*               Locks each mentioned user's registry shard in turn - do not call it with a shard locked.
+*
+* Inputs:       const char*         senderUserID        User ID of the message's sender.
+*               const MentionList*  mentionsP           Users the message mentions.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sendMentionFlags(const char* senderUserID, const MentionList* mentionsP, SharedData* sharedDataP)
+{
+    char flag[BROADCAST_MESSAGE_LENGTH + 1];
+    snprintf(flag, sizeof(flag), "%s %s", MENTION_MSG, senderUserID);
+
+    // A user is only ever in its own shard - the other shards are left alone
+    for (int target = 0; target < mentionsP->numTargets; target++)
+    {
+        RegistryShard* shardP = registryGetShard(mentionsP->targets[target], sharedDataP);
+
+        pthread_mutex_lock(&shardP->mutex);
+        for (int i = 0; i < shardP->numClients; i++)
+        {
+            if (strncmp(shardP->connectedClients[i].clientUserID, mentionsP->targets[target], CLIENT_USERID_LENGTH) == 0)
+            {
+                sendServerMessage(shardP->connectedClients[i].clientSocket, flag, MSG_DONTWAIT);
+            }
+        }
+        pthread_mutex_unlock(&shardP->mutex);
+    }
+}
+
+
+/*
+* Function:     sendMentionCopies
+* Purpose:      Sends a message that is being shed straight to the users it mentions - the flag, then the
+*               message itself. It is not logged, like every other shed message. The caller has already
+*               put it through the spam check and the filter.
+*               Locks each mentioned user's registry shard in turn - do not call it with a shard locked.
+*
+* Inputs:       const char*         clientIP            The IP address of the sender.
+*               const ClientMessage* clientMessageP     The sender's message.
+*               const MentionList*  mentionsP           Users the message mentions.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sendMentionCopies(const char* clientIP, const ClientMessage* clientMessageP, const MentionList* mentionsP, SharedData* sharedDataP)
+{
+    Broadcast broadcastMessages[MAX_BROADCASTS_PER_MSG];
+    int numMessages = buildBroadcasts(clientIP, clientMessageP, broadcastMessages);
+
+    char flag[BROADCAST_MESSAGE_LENGTH + 1];
+    snprintf(flag, sizeof(flag), "%s %s", MENTION_MSG, clientMessageP->clientUserID);
+
+    for (int target = 0; target < mentionsP->numTargets; target++)
+    {
+        RegistryShard* shardP = registryGetShard(mentionsP->targets[target], sharedDataP);
+
+        pthread_mutex_lock(&shardP->mutex);
+        for (int i = 0; i < shardP->numClients; i++)
+        {
+            if (strncmp(shardP->connectedClients[i].clientUserID, mentionsP->targets[target], CLIENT_USERID_LENGTH) != 0)
+            {
+                continue;
+            }
+
+            sendServerMessage(shardP->connectedClients[i].clientSocket, flag, MSG_DONTWAIT);
+            for (int j = 0; j < numMessages; j++)
+            {
+                sendBroadcast(shardP->connectedClients[i].clientSocket, &broadcastMessages[j], MSG_DONTWAIT);
+            }
+            mentionNotePriorityCopy();
+        }
+        pthread_mutex_unlock(&shardP->mutex);
+    }
+}
+
+
+/*
+* Function:     sendSearchResults
+* Purpose:      Searches the chat history and sends the matching messages to a specific client,
+*               preceded by a ">>results<< <count>" server message.
+*
+* Inputs:       int                 clientSocket              Client's socket.
+*               const char*         query                     Search terms.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sendSearchResults(int clientSocket, const char* query)
+{
+    uint64_t results[SEARCH_MAX_RESULTS];
+    int numResults = searchHistory(query, results, SEARCH_MAX_RESULTS);
+
+    char header[BROADCAST_MESSAGE_LENGTH + 1];
+    snprintf(header, sizeof(header), "%s %d", SERVER_SEARCH_RESULTS_MSG, numResults);
+    sendServerMessage(clientSocket, header, 0);
+
+    // Oldest first, so the newest match ends up at the bottom of the client's window
+    for (int i = numResults - 1; i >= 0; i--)
+    {
+        LogRecord record;
+        if (logRead(results[i], &record) == LOG_SUCCESS)
+        {
+            sendBroadcast(clientSocket, &record.broadcast, 0);
+        }
+    }
+
+    #ifdef TESTING
+        printf("\nSearch for '%s' returned %d results\n", query, numResults);
+    #endif
+}
+
+
+/*
+* Function:     sendMissedMessages
+* Purpose:      Sends a returning user the messages logged since it was last connected (if any), preceded by
+*               a ">>missed<< <count>" server message. Only the newest SESSION_REPLAY_MAX_RECORDS are
+*               sent; older ones can still be found with ">>search<<".
+*
+* Inputs:       int                 clientSocket              Client's socket.
+*               uint64_t            fromSequence              First log sequence the user has not received.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sendMissedMessages(int clientSocket, uint64_t fromSequence)
+{
+    uint64_t firstSequence = logGetFirstSequence();
+    uint64_t nextSequence = logGetNextSequence();
+
+    if (fromSequence < firstSequence)
+    {
+        fromSequence = firstSequence; // Older messages were removed by retention
+    }
+    if (nextSequence - fromSequence > SESSION_REPLAY_MAX_RECORDS)
+    {
+        fromSequence = nextSequence - SESSION_REPLAY_MAX_RECORDS;
+    }
+
+    // A read stops at the end of a segment - keep reading until the range is done
+    LogRecord records[SESSION_REPLAY_MAX_RECORDS];
+    int numRecords = 0;
+    uint64_t sequence = fromSequence;
+    while (sequence < nextSequence)
+    {
+        int numRead = logReadRange(sequence, &records[numRecords], (int)(nextSequence - sequence));
+        if (numRead == LOG_CORRUPT)
+        {
+            sequence++; // Skip the bad record
+            continue;
+        }
+        if (numRead <= 0)
+        {
+            break;
+        }
+
+        numRecords += numRead;
+        sequence += numRead;
+    }
+
+    // Direct messages are not for everyone - pending ones come from the mailbox
+    int numMissed = 0;
+    for (int i = 0; i < numRecords; i++)
+    {
+        if (records[i].kind == LOG_RECORD_BROADCAST)
+        {
+            records[numMissed++] = records[i];
+        }
+    }
+
+    if (numMissed == 0)
+    {
+        return; // Nothing missed
+    }
+
+    char header[BROADCAST_MESSAGE_LENGTH + 1];
+    snprintf(header, sizeof(header), "%s %d", SERVER_MISSED_MSG, numMissed);
+    sendServerMessage(clientSocket, header, 0);
+
+    for (int i = 0; i < numMissed; i++)
+    {
+        sendBroadcast(clientSocket, &records[i].broadcast, 0);
+    }
+
+    #ifdef TESTING
+        printf("\nSent %d missed messages from sequence %llu\n", numMissed, (unsigned long long)fromSequence);
+    #endif
+}
+
+
+/*
+* Function:     sendDirectMessage
+* Purpose:      Handles a ">>dm<< <userID> <message>" from a client. The message is logged and sent to
+*               every connection of the recipient, or queued in its mailbox if it is not connected.
+*               The sender gets a copy, so the message shows up in its own window.
+*
+* Inputs:       int                 clientSocket        The sender's socket.
+*               const char*         clientIP            The sender's IP address.
+*               ClientMessage*      clientMessageP      The message received.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                                     MESSAGE_PROCESS_SUCCESS, or MESSAGE_PROCESS_FAILED
+*                                                       if the message was malformed or not delivered.
+*/
+int sendDirectMessage(int clientSocket, const char* clientIP, ClientMessage* clientMessageP, SharedData* sharedDataP)
+{
+    char recipientUserID[CLIENT_USERID_LENGTH + 1];
+    const char* cursor = clientMessageP->message + strlen(SERVER_DIRECT_MSG);
+    int recipientLength = 0;
+
+    // Split "<userID> <message>"
+    while (isspace((unsigned char)*cursor))
+    {
+        cursor++;
+    }
+    while (*cursor && !isspace((unsigned char)*cursor))
+    {
+        if (recipientLength == CLIENT_USERID_LENGTH)
+        {
+            return MESSAGE_PROCESS_FAILED; // No such user ID
+        }
+        recipientUserID[recipientLength++] = *cursor++;
+    }
+    recipientUserID[recipientLength] = '\0';
+
+    while (isspace((unsigned char)*cursor))
+    {
+        cursor++;
+    }
+
+    if (recipientLength == 0 || *cursor == '\0')
+    {
+        return MESSAGE_PROCESS_FAILED;
+    }
+
+    if (memIsUnderPressure())
+    {
+        memNoteShed(MEM_OUTBOUND_BUFFERS);
+        return MESSAGE_PROCESS_FAILED;
+    }
+
+    // Split it like a broadcast
+    int numMessages = strlen(cursor) > BROADCAST_MESSAGE_LENGTH ? 2 : 1;
+    Broadcast messages[MAX_BROADCASTS_PER_MSG];
+    memset(messages, 0, sizeof(messages));
+
+    if (numMessages == 2)
+    {
+        splitString(cursor, messages[0].message, messages[1].message, BROADCAST_MESSAGE_LENGTH);
+    }
+    else
+    {
+        strncpy(messages[0].message, cursor, BROADCAST_MESSAGE_LENGTH);
+    }
+
+    for (int i = 0; i < numMessages; i++)
+    {
+        strncpy(messages[i].clientIP, clientIP, CLIENT_IP_LENGTH);
+        strncpy(messages[i].clientUserID, clientMessageP->clientUserID, CLIENT_USERID_LENGTH);
+    }
+
+    int retVal = MESSAGE_PROCESS_SUCCESS;
+
+    // Lock the recipient's shard - it must not register between the check and queueing in its mailbox
+    RegistryShard* shardP = registryGetShard(recipientUserID, sharedDataP);
+    pthread_mutex_lock(&shardP->mutex);
+
+    // The recipient may be connected from several addresses - counted here rather than collected, so
+    // nothing on this (possibly coroutine) stack grows with the number of clients. Sent to them without
+    // waiting, as the shard is locked
+    int numRecipientSockets = 0;
+    int isRecipient = 0;
+    for (int i = 0; i < shardP->numClients; i++)
+    {
+        if (strncmp(shardP->connectedClients[i].clientUserID, recipientUserID, CLIENT_USERID_LENGTH) == 0)
+        {
+            numRecipientSockets++;
+            isRecipient |= shardP->connectedClients[i].clientSocket == clientSocket;
+        }
+    }
+
+    for (int i = 0; i < numMessages && retVal == MESSAGE_PROCESS_SUCCESS; i++)
+    {
+        if (numRecipientSockets > 0)
+        {
+            logAppendDelivered(&messages[i], recipientUserID);
+
+            int numTaken = 0;
+            for (int j = 0; j < shardP->numClients; j++)
+            {
+                if (strncmp(shardP->connectedClients[j].clientUserID, recipientUserID, CLIENT_USERID_LENGTH) == 0)
+                {
+                    numTaken += sendBroadcast(shardP->connectedClients[j].clientSocket, &messages[i], MSG_DONTWAIT);
+                }
+            }
+
+            // Every connection of the recipient is too far behind to take it
+            if (numTaken == 0)
+            {
+                retVal = MESSAGE_PROCESS_FAILED;
+            }
+        }
+        else if (!sessionIsKnownUser(recipientUserID) || mailboxPost(recipientUserID, &messages[i]) != MAILBOX_SUCCESS)
+        {
+            retVal = MESSAGE_PROCESS_FAILED;
+        }
+    }
+
+    // Unlock
+    pthread_mutex_unlock(&shardP->mutex);
+
+    // Echo to the sender, unless it just received it as the recipient
+    for (int i = 0; i < numMessages && retVal == MESSAGE_PROCESS_SUCCESS && !isRecipient; i++)
+    {
+        sendBroadcast(clientSocket, &messages[i], 0);
+    }
+
+    #ifdef TESTING
+        printf("\nDirect message from '%s' to '%s' %s\n", clientMessageP->clientUserID, recipientUserID,
+            retVal != MESSAGE_PROCESS_SUCCESS ? "not delivered" : numRecipientSockets > 0 ? "delivered" : "queued");
+    #endif
+
+    return retVal;
+}
+
+
+/*
+* Function:     sendMailbox
+* Purpose:      Sends a user the direct messages queued while it was away, preceded by a
+*               ">>mail<< <count>" server message, all in a single write. They leave the mailbox only
+*               once the write has succeeded.
+*
+* Inputs:       int                 clientSocket              Client's socket.
+*               const char*         clientUserID              Client's user ID.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sendMailbox(int clientSocket, const char* clientUserID)
+{
+    uint64_t sequences[MAILBOX_MAX_MESSAGES];
+    int numPending = mailboxPeek(clientUserID, sequences, MAILBOX_MAX_MESSAGES);
+    if (numPending == 0)
+    {
+        return;
+    }
+
+    // Read them back from the log (some may have been removed by retention)
+    LogRecord records[MAILBOX_MAX_MESSAGES];
+    int numRecords = 0;
+    for (int i = 0; i < numPending; i++)
+    {
+        if (logRead(sequences[i], &records[numRecords]) == LOG_SUCCESS && records[numRecords].kind == LOG_RECORD_DIRECT)
+        {
+            numRecords++;
+        }
+    }
+
+    Broadcast header = {.clientIP = "", .clientUserID = ""};
+    snprintf(header.message, sizeof(header.message), "%s %d", SERVER_MAILBOX_MSG, numRecords);
+
+    // Header and messages back to back, in one buffer
+    char batch[(MAILBOX_MAX_MESSAGES + 1) * JSON_LENGTH];
+    size_t batchLength = 0;
+
+    for (int i = -1; i < numRecords; i++)
+    {
+        char* json = broadcastToJson(i < 0 ? &header : &records[i].broadcast);
+        if (json == NULL)
+        {
+            continue;
+        }
+
+        size_t jsonLength = strlen(json);
+        if (batchLength + jsonLength <= sizeof(batch))
+        {
+            memcpy(batch + batchLength, json, jsonLength);
+            batchLength += jsonLength;
+        }
+        free(json);
+    }
+
+    if (clientSend(clientSocket, batch, batchLength, 0) <= 0)
+    {
+        return;
+    }
+    mailboxAck(clientUserID, sequences[numPending - 1]);
+
+    #ifdef TESTING
+        printf("\nDelivered %d pending direct messages to '%s'\n", numRecords, clientUserID);
+    #endif
+}
+
+
+/*
+* Function:     moveToLocalRing
+* Purpose:      Handles ">>local<<" from a client that has mapped the shared-memory broadcast ring:
+*               its broadcasts are no longer sent over TCP, and it is told the ring position to start
+*               reading at with ">>local<< <sequence>". Holding the delivery mutex, which the broadcaster
+*               also holds while it writes the ring, means no broadcast is sent twice or missed.
+*
+* Inputs:       int                 clientSocket        The client's socket.
+*               const char*         clientUserID        The user ID the client registered with.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void moveToLocalRing(int clientSocket, const char* clientUserID, SharedData* sharedDataP)
+{
+    if (!localRingIsAvailable())
+    {
+        // No ring - the client just keeps getting broadcasts over TCP
+        return;
+    }
+
+    char reply[BROADCAST_MESSAGE_LENGTH + 1] = "";
+
+    RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+    pthread_mutex_lock(&sharedDataP->deliveryMutex);
+    pthread_mutex_lock(&shardP->mutex);
+
+    int clientIndex = findThreadIDInList(coroutineSelf(), shardP);
+    if (clientIndex != ENTRY_NOT_FOUND_OR_NULL && shardP->connectedClients[clientIndex].delivery == DELIVERY_TCP)
+    {
+        shardP->connectedClients[clientIndex].delivery = DELIVERY_LOCAL_RING;
+
+        snprintf(reply, sizeof(reply), "%s %llu", LOCAL_RING_MSG, (unsigned long long)localRingGetHead());
+    }
+
+    pthread_mutex_unlock(&shardP->mutex);
+    pthread_mutex_unlock(&sharedDataP->deliveryMutex);
+
+    // Sent once unlocked - the client gets no more broadcasts over TCP, so nothing can overtake it
+    if (reply[0] != '\0')
+    {
+        sendServerMessage(clientSocket, reply, 0);
+    }
+}
+
+
+/*
+* Function:     moveToMulticast
+* Purpose:      Handles ">>multicast<<" from a client that has joined the multicast group: its
+*               broadcasts are no longer sent over TCP, and it is told the sequence number to expect
+*               next with ">>multicast<< <sequence>". As with moveToLocalRing(), holding the delivery
+*               mutex makes the switch exact.
+*
+* Inputs:       int                 clientSocket        The client's socket.
+*               const char*         clientUserID        The user ID the client registered with.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void moveToMulticast(int clientSocket, const char* clientUserID, SharedData* sharedDataP)
+{
+    if (!multicastIsAvailable())
+    {
+        // No multicast - the client just keeps getting broadcasts over TCP
+        return;
+    }
+
+    char reply[BROADCAST_MESSAGE_LENGTH + 1] = "";
+
+    RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+    pthread_mutex_lock(&sharedDataP->deliveryMutex);
+    pthread_mutex_lock(&shardP->mutex);
+
+    int clientIndex = findThreadIDInList(coroutineSelf(), shardP);
+    if (clientIndex != ENTRY_NOT_FOUND_OR_NULL && shardP->connectedClients[clientIndex].delivery == DELIVERY_TCP)
+    {
+        shardP->connectedClients[clientIndex].delivery = DELIVERY_MULTICAST;
+        multicastAddSubscriber();
+
+        snprintf(reply, sizeof(reply), "%s %llu", MULTICAST_MSG, (unsigned long long)multicastGetNextSequence());
+    }
+
+    pthread_mutex_unlock(&shardP->mutex);
+    pthread_mutex_unlock(&sharedDataP->deliveryMutex);
+
+    // Sent once unlocked - the client gets no more broadcasts over TCP, so nothing can overtake it
+    if (reply[0] != '\0')
+    {
+        sendServerMessage(clientSocket, reply, 0);
+    }
 }
 
 
@@ -842,4 +2059,173 @@ int isWhitespace(const char *str)
         str++;
     }
     return 1; // All characters are whitespace or it's an empty string
-}
\ No newline at end of file
+}
+
+
+/*
+* Function:     handleStatsSignal
+* Purpose:      Signal handler for STATS_SIGNAL - flags that the stats should be printed.
+*               The client monitor does the actual printing, since printf() is not signal safe.
+*
+* Inputs:       int                 signalNumber        The signal received.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void handleStatsSignal(int signalNumber)
+{
+    (void)signalNumber;
+    __atomic_store_n(&statsRequested, 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     handleReloadSignal
+* Purpose:      Signal handler for FILTER_RELOAD_SIGNAL - asks the filter to reload its pattern file.
+*
+* Inputs:       int                 signalNumber        The signal received.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void handleReloadSignal(int signalNumber)
+{
+    (void)signalNumber;
+    filterRequestReload();
+}
+
+
+/*
+* Function:     printServerStats
+* Purpose:      Prints the server stats: connected clients and memory use per category.
+*
+* Inputs:       SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      Stats on stdout.
+*
+* Returns:      void
+*/
+void printServerStats(SharedData* sharedDataP)
+{
+    int numClients = registryGetNumClients(sharedDataP);
+
+    printf("\n---- Server stats ----\n");
+    printf("Connected clients: %d / %d\n", numClients, MAX_CLIENTS);
+
+    uint64_t indexedUpTo;
+    size_t numTerms, postingBytes;
+    historyIndexGetStats(&indexedUpTo, &numTerms, &postingBytes);
+    printf("History: %llu messages logged, %llu indexed, %zu terms (%zu posting bytes)\n",
+        (unsigned long long)logGetNextSequence(), (unsigned long long)indexedUpTo, numTerms, postingBytes);
+
+    LogStats logStats;
+    logGetStats(&logStats);
+    printf("Log: %d segments, %llu bytes retained, %llu segments deleted by retention\n",
+        logStats.numSegments, (unsigned long long)logStats.retainedBytes, (unsigned long long)logStats.deletedSegments);
+    printf("Log integrity: %llu torn records truncated, %llu corrupt records skipped (CRC32C %s)\n",
+        (unsigned long long)logStats.truncatedRecords, (unsigned long long)logStats.corruptRecords,
+        crc32cIsHardwareAccelerated() ? "SSE4.2" : "table");
+
+    int numKnownSessions, numConnectedSessions;
+    sessionGetStats(&numKnownSessions, &numConnectedSessions);
+    SnapshotStats snapshotStats;
+    snapshotGetStats(&snapshotStats);
+    printf("Sessions: %d known users, %d connected\n", numKnownSessions, numConnectedSessions);
+    PresenceStats presenceStats;
+    presenceGetStats(&presenceStats);
+    printf("Presence: %llu deltas queued, %llu coalesced away, %llu batches / %llu frames sent, %llu roster resyncs\n",
+        (unsigned long long)presenceStats.deltasQueued, (unsigned long long)presenceStats.deltasCoalesced,
+        (unsigned long long)presenceStats.batchesSent, (unsigned long long)presenceStats.framesSent,
+        (unsigned long long)presenceStats.rosterResyncs);
+    printf("Typing: %llu pings, %llu frames sent, %llu frames dropped\n",
+        (unsigned long long)presenceStats.typingPings, (unsigned long long)presenceStats.typingFramesSent,
+        (unsigned long long)presenceStats.typingFramesDropped);
+    FirehoseStats firehoseStats;
+    firehoseGetStats(&firehoseStats);
+    printf("Firehose: %d subscribers, %llu published, %llu sent / %llu dropped, %llu batches, %llu bytes sent (%llu before compression)\n",
+        firehoseStats.numSubscribers, (unsigned long long)firehoseStats.messagesPublished,
+        (unsigned long long)firehoseStats.messagesSent, (unsigned long long)firehoseStats.messagesDropped,
+        (unsigned long long)firehoseStats.batchesSent, (unsigned long long)firehoseStats.bytesSent,
+        (unsigned long long)firehoseStats.bytesBeforeCompression);
+    LocalRingStats localRingStats;
+    localRingGetStats(&localRingStats);
+    printf("Local ring: handed out %llu times, %llu broadcasts written, %llu wakeups\n",
+        (unsigned long long)localRingStats.ringsHandedOut, (unsigned long long)localRingStats.broadcastsWritten,
+        (unsigned long long)localRingStats.wakeups);
+    MulticastStats multicastStats;
+    multicastGetStats(&multicastStats);
+    printf("Multicast: %llu packets, %llu heartbeats, %llu send errors, %llu NACKs, %llu repaired, %llu lost\n",
+        (unsigned long long)multicastStats.packetsSent, (unsigned long long)multicastStats.heartbeatsSent,
+        (unsigned long long)multicastStats.sendErrors, (unsigned long long)multicastStats.nacksReceived,
+        (unsigned long long)multicastStats.broadcastsRepaired, (unsigned long long)multicastStats.broadcastsLost);
+    WebSocketStats websocketStats;
+    websocketGetStats(&websocketStats);
+    printf("WebSocket: %llu connections, %llu failed handshakes, %llu frames received / %llu sent, %llu pings, %llu closes, %llu rejected\n",
+        (unsigned long long)websocketStats.connectionsAccepted, (unsigned long long)websocketStats.handshakesFailed,
+        (unsigned long long)websocketStats.framesReceived, (unsigned long long)websocketStats.framesSent,
+        (unsigned long long)websocketStats.pingsAnswered, (unsigned long long)websocketStats.closesReceived,
+        (unsigned long long)websocketStats.framesRejected);
+    TLSStats tlsStats;
+    tlsGetStats(&tlsStats);
+    printf("TLS: %llu handshakes, %llu failed, %llu sessions with kernel send / %llu kernel receive, %llu userspace sends (%llu bytes)\n",
+        (unsigned long long)tlsStats.handshakes, (unsigned long long)tlsStats.handshakesFailed,
+        (unsigned long long)tlsStats.kernelSendSessions, (unsigned long long)tlsStats.kernelRecvSessions,
+        (unsigned long long)tlsStats.userspaceSends, (unsigned long long)tlsStats.userspaceBytes);
+    printf("Output: %llu sends queued for slow clients, %llu refused with a full queue\n",
+        (unsigned long long)tlsStats.sendsQueued, (unsigned long long)tlsStats.sendsRefused);
+    FilterStats filterStats;
+    filterGetStats(&filterStats);
+    printf("Filter: %d patterns (%d states), %llu messages filtered, %llu masked, %llu blocked, %llu reloads, %llu failed\n",
+        filterStats.numPatterns, filterStats.numStates, (unsigned long long)filterStats.messagesFiltered,
+        (unsigned long long)filterStats.messagesMasked, (unsigned long long)filterStats.messagesBlocked,
+        (unsigned long long)filterStats.reloads, (unsigned long long)filterStats.reloadsFailed);
+    MentionStats mentionStats;
+    mentionGetStats(&mentionStats);
+    printf("Mentions: %d users (%d trie nodes), %llu messages parsed, %llu with mentions, %llu mentions, %llu priority copies\n",
+        mentionStats.numUsers, mentionStats.numNodes, (unsigned long long)mentionStats.messagesParsed,
+        (unsigned long long)mentionStats.messagesWithMentions, (unsigned long long)mentionStats.mentionsFound,
+        (unsigned long long)mentionStats.priorityCopies);
+    SchedulerStats schedulerStats;
+    schedulerGetStats(&schedulerStats);
+    printf("Scheduler: %d workers, %llu tasks submitted, %llu run, %llu stolen, %llu run by waiters, %llu run inline\n",
+        schedulerStats.numWorkers, (unsigned long long)schedulerStats.tasksSubmitted,
+        (unsigned long long)schedulerStats.tasksRun, (unsigned long long)schedulerStats.tasksStolen,
+        (unsigned long long)schedulerStats.tasksRunByWaiters, (unsigned long long)schedulerStats.tasksRunInline);
+    CoroutineStats coroutineStats;
+    coroutineGetStats(&coroutineStats);
+    printf("Coroutines: %d sessions (peak %d), %d pooled stacks, %llu started, %llu switches, %llu waits\n",
+        coroutineStats.numSessions, coroutineStats.peakSessions, coroutineStats.numPooledStacks,
+        (unsigned long long)coroutineStats.sessionsStarted, (unsigned long long)coroutineStats.switches,
+        (unsigned long long)coroutineStats.waits);
+    TransportStats transportStats;
+    transportGetStats(&transportStats);
+    printf("Transport: %s, %d loopback connections, %llu loopback sends (%llu bytes, %llu dropped), %llu reads (%llu bytes)\n",
+        transportGetCurrent()->name, transportStats.numLoopbackConnections, (unsigned long long)transportStats.loopbackSends,
+        (unsigned long long)transportStats.loopbackBytesSent, (unsigned long long)transportStats.loopbackBytesDropped,
+        (unsigned long long)transportStats.loopbackReads, (unsigned long long)transportStats.loopbackBytesRead);
+    SpamStats spamStats;
+    spamGetStats(&spamStats);
+    printf("Spam: %llu messages checked, %llu sender floods, %llu global floods rejected, %llu windows rotated\n",
+        (unsigned long long)spamStats.messagesChecked, (unsigned long long)spamStats.senderFloods,
+        (unsigned long long)spamStats.globalFloods, (unsigned long long)spamStats.windowsRotated);
+    MailboxStats mailboxStats;
+    mailboxGetStats(&mailboxStats);
+    printf("Mailboxes: %d users with %llu pending messages, %llu queued, %llu delivered, %llu dropped\n",
+        mailboxStats.numMailboxes, (unsigned long long)mailboxStats.numPending, (unsigned long long)mailboxStats.numQueued,
+        (unsigned long long)mailboxStats.numDelivered, (unsigned long long)mailboxStats.numDropped);
+    printf("Snapshots: %llu taken, %llu failed, last %llu bytes (paused %lld us, written in %lld us)\n",
+        (unsigned long long)snapshotStats.numTaken, (unsigned long long)snapshotStats.numFailed,
+        (unsigned long long)snapshotStats.lastBytes, (long long)snapshotStats.lastPauseMicroseconds,
+        (long long)snapshotStats.lastWriteMicroseconds);
+    if (snapshotStats.restoreMicroseconds >= 0)
+    {
+        printf("Restored %d sessions and %u index terms from snapshot in %lld us\n",
+            snapshotStats.restoredSessions, snapshotStats.restoredTerms, (long long)snapshotStats.restoreMicroseconds);
+    }
+
+    memPrintStats(stdout);
+    printf("----------------------\n");
+    fflush(stdout);
+}
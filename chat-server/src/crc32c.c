@@ -0,0 +1,182 @@
+/*
+* Filename:		crc32c.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for CRC32C (Castagnoli) checksums used by the CHAT-SYSTEM server.
+*
+*               On x86-64 CPUs with SSE4.2, the checksum is computed with the crc32 instruction,
+*               8 bytes at a time. Otherwise a 256-entry table is used, one byte at a time. The
+*               implementation is picked once, on first use, so the makefile does not need -msse4.2
+*               and the same binary runs on older CPUs.
+*/
+
+#include <string.h>
+#include <pthread.h>
+#include "../inc/crc32c.h"
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define CRC32C_HAVE_SSE42 1
+#endif
+
+typedef uint32_t (*Crc32cFunction)(uint32_t crc, const uint8_t* data, size_t length);
+
+static uint32_t crc32cTable[256];
+static Crc32cFunction crc32cImplementation = NULL;
+static int crc32cUsesHardware = 0;
+static pthread_once_t crc32cOnce = PTHREAD_ONCE_INIT;
+
+
+/*
+* Function:     crc32cSoftware
+* Purpose:      Table-driven CRC32C, one byte at a time.
+*
+* Inputs:       uint32_t        crc             Running CRC (inverted).
+*               const uint8_t*  data            Data to checksum.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      uint32_t                        Updated running CRC.
+*/
+static uint32_t crc32cSoftware(uint32_t crc, const uint8_t* data, size_t length)
+{
+    while (length--)
+    {
+        crc = crc32cTable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+#ifdef CRC32C_HAVE_SSE42
+/*
+* Function:     crc32cHardware
+* Purpose:      CRC32C using the SSE4.2 crc32 instruction, 8 bytes at a time.
+*
+* Inputs:       uint32_t        crc             Running CRC (inverted).
+*               const uint8_t*  data            Data to checksum.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      uint32_t                        Updated running CRC.
+*/
+__attribute__((target("sse4.2")))
+static uint32_t crc32cHardware(uint32_t crc, const uint8_t* data, size_t length)
+{
+    uint64_t crc64 = crc;
+
+    while (length >= sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word)); // Unaligned-safe load
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += sizeof(uint64_t);
+        length -= sizeof(uint64_t);
+    }
+
+    crc = (uint32_t)crc64;
+    while (length--)
+    {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+
+    return crc;
+}
+#endif
+
+
+/*
+* Function:     crc32cInit
+* Purpose:      Builds the lookup table and picks the fastest implementation for this CPU.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void crc32cInit()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        crc32cTable[i] = crc;
+    }
+
+    crc32cImplementation = crc32cSoftware;
+
+    #ifdef CRC32C_HAVE_SSE42
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("sse4.2"))
+        {
+            crc32cImplementation = crc32cHardware;
+            crc32cUsesHardware = 1;
+        }
+    #endif
+}
+
+
+/*
+* Function:     crc32c
+* Purpose:      Computes the CRC32C of a buffer.
+*
+* Inputs:       const void*     data            Data to checksum.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      uint32_t                        The checksum.
+*/
+uint32_t crc32c(const void* data, size_t length)
+{
+    pthread_once(&crc32cOnce, crc32cInit);
+
+    return ~crc32cImplementation(0xFFFFFFFF, (const uint8_t*)data, length);
+}
+
+
+/*
+* Function:     crc32cExtend
+* Purpose:      Continues a checksum over more data, so large or scattered data can be checksummed
+*               in pieces: crc32cExtend(crc32c(a), b) == crc32c(a followed by b).
+*
+* Inputs:       uint32_t        crc             Checksum of the data so far (0 for none).
+*               const void*     data            Next data to checksum.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      uint32_t                        The checksum of all data so far.
+*/
+uint32_t crc32cExtend(uint32_t crc, const void* data, size_t length)
+{
+    pthread_once(&crc32cOnce, crc32cInit);
+
+    return ~crc32cImplementation(~crc, (const uint8_t*)data, length);
+}
+
+
+/*
+* Function:     crc32cIsHardwareAccelerated
+* Purpose:      Checks whether the SSE4.2 implementation is in use.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if hardware accelerated, otherwise 0.
+*/
+int crc32cIsHardwareAccelerated()
+{
+    pthread_once(&crc32cOnce, crc32cInit);
+
+    return crc32cUsesHardware;
+}
@@ -0,0 +1,959 @@
+/*
+* Filename:		historyIndex.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the full-text history index of the CHAT-SYSTEM server.
+*
+*               The index is an inverted index: a hash table (open addressing, FNV-1a) mapping each
+*               term to the list of log sequence numbers whose message contains it. Terms are runs of
+*               letters and digits, lower-cased. Sequence numbers only grow, so each posting list is
+*               stored as varint-encoded deltas - typically one byte per entry.
+*
+*               The index is built incrementally by the history indexer thread, which tails the chat
+*               log in batches. The broadcaster only appends to the log, so indexing never runs on the
+*               message hot path. On start-up, the indexer catches up on the whole persisted log.
+*
+*               When retention removes old records from the log, the indexer trims the expired head
+*               of each posting list (re-encoding only the first remaining entry), a batch of table
+*               slots at a time, so searches are never blocked for the whole pass. Terms are never
+*               removed from the table (that would break probe chains); they are left with an empty list.
+*               Over the memory budget, the oldest postings are evicted the same way ahead of retention
+*               (historyIndexReclaim): the records stay in the log, but searches no longer find them.
+*
+*               For fast restarts, the index is saved in registry snapshots (serverSnapshot.c). The
+*               snapshot child process writes it out while the parent holds only a read lock for the
+*               duration of fork(); on start-up, the saved posting lists are loaded back as they are
+*               and the indexer resumes from the snapshot's sequence.
+*
+*               Searches take the read side of indexLock and AND together the posting lists of all
+*               query terms, walking the shortest list and skipping forward in the others. Only the
+*               newest matches are kept.
+*/
+
+#include "../inc/historyIndex.h"
+
+static pthread_rwlock_t indexLock = PTHREAD_RWLOCK_INITIALIZER;
+static PostingList* indexTable = NULL;
+static size_t indexTableSize = 0;
+static size_t indexNumTerms = 0;
+static size_t indexPostingBytes = 0;
+static uint64_t indexIndexedUpTo = 0;
+static uint64_t indexPrunedUpTo = 0;
+
+static pthread_t indexerThread;
+static int indexerIsRunning = INDEXER_STOPPED;
+
+// Decoder walking one posting list
+typedef struct
+{
+    const uint8_t* current;
+    const uint8_t* end;
+    uint64_t sequence;
+    int started;
+} PostingDecoder;
+
+
+/*
+* Function:     hashTerm
+* Purpose:      FNV-1a hash of a term.
+*
+* Inputs:       const char*     term            The term.
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        The hash.
+*/
+static uint64_t hashTerm(const char* term)
+{
+    uint64_t hash = 1469598103934665603ULL;
+
+    while (*term)
+    {
+        hash ^= (unsigned char)*term++;
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+/*
+* Function:     tokenize
+* Purpose:      Splits text into unique lower-cased terms made of letters and digits.
+*
+* Inputs:       const char*     text            The text to split.
+*               char            terms[][]       Buffer for up to maxTerms terms.
+*               int             maxTerms        Maximum number of terms.
+*
+* Outputs:      terms                           The terms found.
+*
+* Returns:      int                             Number of terms found.
+*/
+static int tokenize(const char* text, char terms[][INDEX_MAX_TERM_LENGTH + 1], int maxTerms)
+{
+    int numTerms = 0;
+
+    while (*text && numTerms < maxTerms)
+    {
+        // Skip separators
+        while (*text && !isalnum((unsigned char)*text))
+        {
+            text++;
+        }
+
+        int length = 0;
+        while (*text && isalnum((unsigned char)*text))
+        {
+            if (length < INDEX_MAX_TERM_LENGTH)
+            {
+                terms[numTerms][length++] = tolower((unsigned char)*text);
+            }
+            text++;
+        }
+
+        if (length == 0)
+        {
+            continue;
+        }
+        terms[numTerms][length] = '\0';
+
+        // Keep terms unique so a posting list never sees the same sequence twice
+        int isDuplicate = 0;
+        for (int i = 0; i < numTerms; i++)
+        {
+            if (strcmp(terms[i], terms[numTerms]) == 0)
+            {
+                isDuplicate = 1;
+                break;
+            }
+        }
+
+        if (!isDuplicate)
+        {
+            numTerms++;
+        }
+    }
+
+    return numTerms;
+}
+
+
+/*
+* Function:     findSlot
+* Purpose:      Finds the table slot holding a term, or the empty slot where it would go.
+*               NOTE: Make sure to hold indexLock before calling this function!
+*
+* Inputs:       PostingList*    table           The hash table.
+*               size_t          tableSize       Number of slots (power of 2).
+*               const char*     term            The term.
+*
+* Outputs:      None
+*
+* Returns:      PostingList*                    The slot.
+*/
+static PostingList* findSlot(PostingList* table, size_t tableSize, const char* term)
+{
+    size_t mask = tableSize - 1;
+    size_t slot = hashTerm(term) & mask;
+
+    while (table[slot].term[0] != '\0' && strcmp(table[slot].term, term) != 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+
+    return &table[slot];
+}
+
+
+/*
+* Function:     growTable
+* Purpose:      Doubles the hash table (or creates it) and re-inserts all terms.
+*               NOTE: Make sure to hold the write side of indexLock before calling this function!
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             INDEX_SUCCESS, or INDEX_ERROR if out of memory.
+*/
+static int growTable()
+{
+    size_t newSize = indexTableSize == 0 ? INDEX_INITIAL_TABLE_SIZE : indexTableSize * 2;
+    PostingList* newTable = memCalloc(MEM_HISTORY_CACHE, newSize, sizeof(PostingList));
+    if (newTable == NULL)
+    {
+        return INDEX_ERROR;
+    }
+
+    for (size_t i = 0; i < indexTableSize; i++)
+    {
+        if (indexTable[i].term[0] != '\0')
+        {
+            *findSlot(newTable, newSize, indexTable[i].term) = indexTable[i];
+        }
+    }
+
+    memFree(MEM_HISTORY_CACHE, indexTable);
+    indexTable = newTable;
+    indexTableSize = newSize;
+
+    return INDEX_SUCCESS;
+}
+
+
+/*
+* Function:     addPosting
+* Purpose:      Appends a sequence number to the posting list of a term, creating the term if needed.
+*               NOTE: Make sure to hold the write side of indexLock before calling this function!
+*
+* Inputs:       const char*     term            The term.
+*               uint64_t        sequence        Sequence of the record containing the term.
+*
+* Outputs:      None
+*
+* Returns:      int                             INDEX_SUCCESS, or INDEX_ERROR if out of memory.
+*/
+static int addPosting(const char* term, uint64_t sequence)
+{
+    // Keep the load factor under 1/2
+    if ((indexNumTerms + 1) * 2 > indexTableSize && growTable() != INDEX_SUCCESS)
+    {
+        return INDEX_ERROR;
+    }
+
+    PostingList* list = findSlot(indexTable, indexTableSize, term);
+
+    if (list->count > 0 && list->lastSequence >= sequence)
+    {
+        return INDEX_SUCCESS; // Already indexed (retry after a failed batch)
+    }
+
+    // At most 10 bytes for a 64-bit varint
+    if (list->length + 10 > list->capacity)
+    {
+        size_t newCapacity = list->capacity == 0 ? INDEX_INITIAL_POSTINGS_SIZE : list->capacity * 2;
+        uint8_t* newPostings = memRealloc(MEM_HISTORY_CACHE, list->postings, newCapacity);
+        if (newPostings == NULL)
+        {
+            return INDEX_ERROR;
+        }
+
+        indexPostingBytes += newCapacity - list->capacity;
+        list->postings = newPostings;
+        list->capacity = newCapacity;
+    }
+
+    if (list->term[0] == '\0')
+    {
+        strncpy(list->term, term, INDEX_MAX_TERM_LENGTH);
+        list->term[INDEX_MAX_TERM_LENGTH] = '\0';
+        indexNumTerms++;
+    }
+
+    uint64_t delta = list->count == 0 ? sequence : sequence - list->lastSequence;
+    while (delta >= 0x80)
+    {
+        list->postings[list->length++] = (uint8_t)(delta | 0x80);
+        delta >>= 7;
+    }
+    list->postings[list->length++] = (uint8_t)delta;
+
+    list->lastSequence = sequence;
+    list->count++;
+
+    return INDEX_SUCCESS;
+}
+
+
+/*
+* Function:     indexRecord
+* Purpose:      Adds all terms of a log record to the index. Direct messages are skipped.
+*               NOTE: Make sure to hold the write side of indexLock before calling this function!
+*
+* Inputs:       const LogRecord*    recordP     The record.
+*
+* Outputs:      None
+*
+* Returns:      int                             INDEX_SUCCESS, or INDEX_ERROR if out of memory.
+*/
+static int indexRecord(const LogRecord* recordP)
+{
+    if (recordP->kind != LOG_RECORD_BROADCAST)
+    {
+        return INDEX_SUCCESS; // Direct messages are private - never searchable
+    }
+
+    char terms[INDEX_MAX_TERMS_PER_MESSAGE][INDEX_MAX_TERM_LENGTH + 1];
+    int numTerms = tokenize(recordP->broadcast.message, terms, INDEX_MAX_TERMS_PER_MESSAGE);
+
+    for (int i = 0; i < numTerms; i++)
+    {
+        if (addPosting(terms[i], recordP->sequence) != INDEX_SUCCESS)
+        {
+            return INDEX_ERROR;
+        }
+    }
+
+    return INDEX_SUCCESS;
+}
+
+
+/*
+* Function:     decoderNext
+* Purpose:      Advances a posting decoder to its next sequence number.
+*
+* Inputs:       PostingDecoder*     decoderP    The decoder.
+*
+* Outputs:      decoderP->sequence              The next sequence.
+*
+* Returns:      int                             1 if a sequence was decoded, 0 at the end of the list.
+*/
+static int decoderNext(PostingDecoder* decoderP)
+{
+    if (decoderP->current >= decoderP->end)
+    {
+        return 0;
+    }
+
+    uint64_t delta = 0;
+    int shift = 0;
+    uint8_t byte;
+
+    do
+    {
+        byte = *decoderP->current++;
+        delta |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && decoderP->current < decoderP->end);
+
+    decoderP->sequence = decoderP->started ? decoderP->sequence + delta : delta;
+    decoderP->started = 1;
+
+    return 1;
+}
+
+
+/*
+* Function:     pruneList
+* Purpose:      Removes all sequence numbers below firstSequence from a posting list.
+*               NOTE: Make sure to hold the write side of indexLock before calling this function!
+*
+* Inputs:       PostingList*    list            The posting list.
+*               uint64_t        firstSequence   Oldest sequence to keep.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void pruneList(PostingList* list, uint64_t firstSequence)
+{
+    if (list->count == 0)
+    {
+        return;
+    }
+
+    PostingDecoder decoder = {.current = list->postings, .end = list->postings + list->length, .sequence = 0, .started = 0};
+    const uint8_t* entryStart = decoder.current;
+    uint32_t numRemoved = 0;
+
+    while (entryStart < decoder.end)
+    {
+        decoderNext(&decoder);
+        if (decoder.sequence >= firstSequence)
+        {
+            break;
+        }
+
+        numRemoved++;
+        entryStart = decoder.current;
+    }
+
+    if (numRemoved == 0)
+    {
+        return;
+    }
+
+    if (numRemoved == list->count)
+    {
+        // Nothing left - keep the term, drop the postings
+        indexPostingBytes -= list->capacity;
+        memFree(MEM_HISTORY_CACHE, list->postings);
+        list->postings = NULL;
+        list->length = 0;
+        list->capacity = 0;
+        list->count = 0;
+        return;
+    }
+
+    // The first kept entry becomes absolute; the deltas after it are unchanged
+    uint8_t firstEntry[10];
+    int firstLength = 0;
+    uint64_t value = decoder.sequence;
+    while (value >= 0x80)
+    {
+        firstEntry[firstLength++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    firstEntry[firstLength++] = (uint8_t)value;
+
+    size_t restLength = decoder.end - decoder.current;
+    memmove(list->postings + firstLength, decoder.current, restLength);
+    memcpy(list->postings, firstEntry, firstLength);
+
+    list->length = firstLength + restLength;
+    list->count -= numRemoved;
+}
+
+
+/*
+* Function:     pruneIndex
+* Purpose:      Removes records no longer in the log from all posting lists, INDEX_PRUNE_BATCH slots
+*               per write-lock so searches can run in between.
+*
+* Inputs:       uint64_t        firstSequence   Oldest sequence still in the log.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void pruneIndex(uint64_t firstSequence)
+{
+    size_t slot = 0;
+    int isDone = 0;
+
+    while (!isDone)
+    {
+        pthread_rwlock_wrlock(&indexLock);
+
+        size_t end = slot + INDEX_PRUNE_BATCH;
+        if (end >= indexTableSize)
+        {
+            end = indexTableSize;
+            isDone = 1;
+        }
+
+        for (; slot < end; slot++)
+        {
+            pruneList(&indexTable[slot], firstSequence);
+        }
+
+        // The reclaimer may already have evicted further than retention
+        if (isDone && firstSequence > indexPrunedUpTo)
+        {
+            indexPrunedUpTo = firstSequence;
+        }
+
+        pthread_rwlock_unlock(&indexLock);
+    }
+}
+
+
+/*
+* Function:     historyIndexReclaim
+* Purpose:      Memory reclaimer for MEM_HISTORY_CACHE - evicts the oldest half of the indexed records
+*               from every posting list, then half of what is left, until enough has been freed. The
+*               records stay in the log; searches just no longer find them.
+*               Gives up straight away if the index is locked, as it is while the indexer itself allocates.
+*
+* Inputs:       size_t      bytesWanted     Number of bytes the memory accountant would like freed.
+*
+* Outputs:      None
+*
+* Returns:      size_t                      Number of bytes freed.
+*/
+static size_t historyIndexReclaim(size_t bytesWanted)
+{
+    if (pthread_rwlock_trywrlock(&indexLock) != 0)
+    {
+        return 0;
+    }
+
+    size_t bytesBefore = indexPostingBytes;
+    uint64_t firstSequence = indexPrunedUpTo;
+
+    while (bytesBefore - indexPostingBytes < bytesWanted && firstSequence < indexIndexedUpTo)
+    {
+        firstSequence += (indexIndexedUpTo - firstSequence + 1) / 2;
+
+        for (size_t slot = 0; slot < indexTableSize; slot++)
+        {
+            pruneList(&indexTable[slot], firstSequence);
+        }
+    }
+
+    indexPrunedUpTo = firstSequence;
+    size_t bytesFreed = bytesBefore - indexPostingBytes;
+
+    pthread_rwlock_unlock(&indexLock);
+
+    return bytesFreed;
+}
+
+
+/*
+* Function:     historyIndexer
+* Purpose:      Indexer thread - tails the chat log and indexes new records in batches.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* historyIndexer(void* arg)
+{
+    (void)arg;
+
+    LogRecord* batch = memAlloc(MEM_HISTORY_CACHE, INDEX_BATCH_RECORDS * sizeof(LogRecord));
+    if (batch == NULL)
+    {
+        fprintf(stderr, "[INDEX] : could not allocate indexing buffer\n");
+        pthread_exit(NULL);
+    }
+
+    while (__atomic_load_n(&indexerIsRunning, __ATOMIC_ACQUIRE))
+    {
+        // Drop what retention removed from the log
+        uint64_t firstSequence = logGetFirstSequence();
+        if (firstSequence > indexPrunedUpTo)
+        {
+            pruneIndex(firstSequence);
+        }
+
+        int numRecords = logReadRange(indexIndexedUpTo, batch, INDEX_BATCH_RECORDS);
+
+        if (numRecords == LOG_NOT_FOUND)
+        {
+            // Older records are gone from the log - continue from the oldest one left
+            pthread_rwlock_wrlock(&indexLock);
+            indexIndexedUpTo = logGetFirstSequence();
+            pthread_rwlock_unlock(&indexLock);
+            continue;
+        }
+
+        if (numRecords == LOG_CORRUPT)
+        {
+            // Failed its checksum - nothing to index
+            pthread_rwlock_wrlock(&indexLock);
+            indexIndexedUpTo++;
+            pthread_rwlock_unlock(&indexLock);
+            continue;
+        }
+
+        if (numRecords <= 0)
+        {
+            usleep(INDEX_LOOP_SLEEP_LENGTH);
+            continue;
+        }
+
+        pthread_rwlock_wrlock(&indexLock);
+
+        int numIndexed = 0;
+        while (numIndexed < numRecords && indexRecord(&batch[numIndexed]) == INDEX_SUCCESS)
+        {
+            numIndexed++;
+        }
+        indexIndexedUpTo += numIndexed;
+
+        pthread_rwlock_unlock(&indexLock);
+
+        if (numIndexed < numRecords)
+        {
+            // Over the memory budget - retry later, the remaining records stay in the log
+            memNoteShed(MEM_HISTORY_CACHE);
+            usleep(INDEX_LOOP_SLEEP_LENGTH);
+        }
+    }
+
+    memFree(MEM_HISTORY_CACHE, batch);
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     historyIndexStart
+* Purpose:      Starts the history indexer thread. The chat log must already be open.
+*               If an index was loaded from a snapshot, only the log records after it are indexed.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                     INDEX_SUCCESS, or INDEX_ERROR if the thread could not be started.
+*/
+int historyIndexStart()
+{
+    pthread_rwlock_wrlock(&indexLock);
+    if (indexTableSize == 0)
+    {
+        // Nothing restored from a snapshot - index the whole log
+        indexIndexedUpTo = logGetFirstSequence();
+        indexPrunedUpTo = indexIndexedUpTo;
+    }
+    pthread_rwlock_unlock(&indexLock);
+
+    __atomic_store_n(&indexerIsRunning, INDEXER_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&indexerThread, NULL, historyIndexer, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&indexerIsRunning, INDEXER_STOPPED, __ATOMIC_RELEASE);
+        return INDEX_ERROR;
+    }
+
+    // Over the budget, the oldest postings give way first
+    memRegisterReclaimer(MEM_HISTORY_CACHE, historyIndexReclaim);
+
+    return INDEX_SUCCESS;
+}
+
+
+/*
+* Function:     historyIndexStop
+* Purpose:      Stops the history indexer thread and frees the index.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void historyIndexStop()
+{
+    if (__atomic_load_n(&indexerIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&indexerIsRunning, INDEXER_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(indexerThread, NULL);
+    }
+
+    memRegisterReclaimer(MEM_HISTORY_CACHE, NULL);
+
+    pthread_rwlock_wrlock(&indexLock);
+
+    for (size_t i = 0; i < indexTableSize; i++)
+    {
+        memFree(MEM_HISTORY_CACHE, indexTable[i].postings);
+    }
+
+    memFree(MEM_HISTORY_CACHE, indexTable);
+    indexTable = NULL;
+    indexTableSize = 0;
+    indexNumTerms = 0;
+    indexPostingBytes = 0;
+
+    pthread_rwlock_unlock(&indexLock);
+}
+
+
+/*
+* Function:     historyIndexBeginSnapshot
+* Purpose:      Freezes the index for a snapshot by holding the read side of indexLock until
+*               historyIndexEndSnapshot(). Fork the snapshot process in between.
+*
+* Inputs:       uint64_t*       indexedUpToP    Where to store the next sequence to be indexed.
+*               uint64_t*       firstSequenceP  Where to store the oldest sequence left in the index.
+*               uint32_t*       numTermsP       Where to store the number of terms.
+*
+* Outputs:      The index position and size.
+*
+* Returns:      void
+*/
+void historyIndexBeginSnapshot(uint64_t* indexedUpToP, uint64_t* firstSequenceP, uint32_t* numTermsP)
+{
+    pthread_rwlock_rdlock(&indexLock);
+
+    *indexedUpToP = indexIndexedUpTo;
+    *firstSequenceP = indexPrunedUpTo;
+    *numTermsP = (uint32_t)indexNumTerms;
+}
+
+
+/*
+* Function:     historyIndexWriteSnapshot
+* Purpose:      Writes every term and its posting list to a snapshot. Called in the snapshot child
+*               process, which has its own copy of the frozen index, so no locks are taken.
+*
+* Inputs:       SnapshotWriter*     writerP     The snapshot writer.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void historyIndexWriteSnapshot(SnapshotWriter* writerP)
+{
+    for (size_t i = 0; i < indexTableSize; i++)
+    {
+        PostingList* list = &indexTable[i];
+        if (list->term[0] == '\0')
+        {
+            continue;
+        }
+
+        uint8_t termLength = (uint8_t)strlen(list->term);
+        uint32_t length = (uint32_t)list->length;
+
+        snapshotWrite(writerP, &termLength, sizeof(termLength));
+        snapshotWrite(writerP, list->term, termLength);
+        snapshotWrite(writerP, &list->count, sizeof(list->count));
+        snapshotWrite(writerP, &list->lastSequence, sizeof(list->lastSequence));
+        snapshotWrite(writerP, &length, sizeof(length));
+        snapshotWrite(writerP, list->postings, length);
+    }
+}
+
+
+/*
+* Function:     historyIndexEndSnapshot
+* Purpose:      Releases the index after the snapshot process has been forked.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void historyIndexEndSnapshot()
+{
+    pthread_rwlock_unlock(&indexLock);
+}
+
+
+/*
+* Function:     historyIndexLoadSnapshot
+* Purpose:      Replaces the index with the terms saved in a snapshot. Must be called before
+*               historyIndexStart(), which then resumes indexing from indexedUpTo.
+*
+* Inputs:       SnapshotReader*     readerP         Reader positioned at the first term.
+*               uint32_t            numTerms        Number of terms in the snapshot.
+*               uint64_t            indexedUpTo     Next sequence to be indexed.
+*               uint64_t            firstSequence   Oldest sequence left in the saved index.
+*
+* Outputs:      None
+*
+* Returns:      int                                 INDEX_SUCCESS, or INDEX_ERROR if the data is invalid or
+*                                                   out of memory (the index is then left empty).
+*/
+int historyIndexLoadSnapshot(SnapshotReader* readerP, uint32_t numTerms, uint64_t indexedUpTo, uint64_t firstSequence)
+{
+    int retVal = INDEX_SUCCESS;
+
+    pthread_rwlock_wrlock(&indexLock);
+
+    // Size the table once, keeping the load factor under 1/2
+    size_t tableSize = INDEX_INITIAL_TABLE_SIZE;
+    while (((size_t)numTerms + 1) * 2 > tableSize)
+    {
+        tableSize *= 2;
+    }
+
+    indexTable = memCalloc(MEM_HISTORY_CACHE, tableSize, sizeof(PostingList));
+    if (indexTable == NULL)
+    {
+        pthread_rwlock_unlock(&indexLock);
+        return INDEX_ERROR;
+    }
+    indexTableSize = tableSize;
+
+    for (uint32_t i = 0; i < numTerms && retVal == INDEX_SUCCESS; i++)
+    {
+        uint8_t termLength;
+        char term[INDEX_MAX_TERM_LENGTH + 1];
+        uint32_t count;
+        uint64_t lastSequence;
+        uint32_t length;
+
+        if (snapshotRead(readerP, &termLength, sizeof(termLength)) != SNAPSHOT_SUCCESS ||
+            termLength == 0 || termLength > INDEX_MAX_TERM_LENGTH ||
+            snapshotRead(readerP, term, termLength) != SNAPSHOT_SUCCESS ||
+            snapshotRead(readerP, &count, sizeof(count)) != SNAPSHOT_SUCCESS ||
+            snapshotRead(readerP, &lastSequence, sizeof(lastSequence)) != SNAPSHOT_SUCCESS ||
+            snapshotRead(readerP, &length, sizeof(length)) != SNAPSHOT_SUCCESS)
+        {
+            retVal = INDEX_ERROR;
+            break;
+        }
+        term[termLength] = '\0';
+
+        const uint8_t* postings = snapshotReadInPlace(readerP, length);
+        PostingList* list = findSlot(indexTable, indexTableSize, term);
+        if ((length > 0 && postings == NULL) || list->term[0] != '\0')
+        {
+            retVal = INDEX_ERROR; // Truncated, or the same term twice
+            break;
+        }
+
+        if (length > 0)
+        {
+            list->postings = memAlloc(MEM_HISTORY_CACHE, length);
+            if (list->postings == NULL)
+            {
+                retVal = INDEX_ERROR;
+                break;
+            }
+            memcpy(list->postings, postings, length);
+        }
+
+        memcpy(list->term, term, termLength + 1);
+        list->length = length;
+        list->capacity = length;
+        list->count = length > 0 ? count : 0;
+        list->lastSequence = lastSequence;
+
+        indexNumTerms++;
+        indexPostingBytes += length;
+    }
+
+    if (retVal == INDEX_SUCCESS)
+    {
+        indexIndexedUpTo = indexedUpTo;
+        indexPrunedUpTo = firstSequence;
+    }
+    else
+    {
+        for (size_t i = 0; i < indexTableSize; i++)
+        {
+            memFree(MEM_HISTORY_CACHE, indexTable[i].postings);
+        }
+
+        memFree(MEM_HISTORY_CACHE, indexTable);
+        indexTable = NULL;
+        indexTableSize = 0;
+        indexNumTerms = 0;
+        indexPostingBytes = 0;
+    }
+
+    pthread_rwlock_unlock(&indexLock);
+
+    return retVal;
+}
+
+
+/*
+* Function:     searchHistory
+* Purpose:      Finds the newest log records containing all the terms of a query.
+*
+* Inputs:       const char*     query           Search terms separated by spaces or punctuation.
+*               uint64_t*       results         Buffer for up to maxResults sequence numbers.
+*               int             maxResults      Maximum number of results (at most SEARCH_MAX_RESULTS).
+*
+* Outputs:      results                         Matching sequence numbers, newest first.
+*
+* Returns:      int                             Number of results.
+*/
+int searchHistory(const char* query, uint64_t* results, int maxResults)
+{
+    char terms[SEARCH_MAX_TERMS][INDEX_MAX_TERM_LENGTH + 1];
+    int numTerms = tokenize(query, terms, SEARCH_MAX_TERMS);
+
+    if (numTerms == 0 || maxResults <= 0)
+    {
+        return 0;
+    }
+
+    if (maxResults > SEARCH_MAX_RESULTS)
+    {
+        maxResults = SEARCH_MAX_RESULTS;
+    }
+
+    uint64_t newest[SEARCH_MAX_RESULTS];
+    int numFound = 0;
+    PostingDecoder decoders[SEARCH_MAX_TERMS];
+
+    pthread_rwlock_rdlock(&indexLock);
+
+    // Set up one decoder per term, shortest list first
+    int allTermsFound = indexTableSize > 0;
+    for (int i = 0; i < numTerms && allTermsFound; i++)
+    {
+        PostingList* list = findSlot(indexTable, indexTableSize, terms[i]);
+        if (list->term[0] == '\0')
+        {
+            allTermsFound = 0;
+            break;
+        }
+
+        PostingDecoder decoder = {.current = list->postings, .end = list->postings + list->length, .sequence = 0, .started = 0};
+        int j = i;
+        while (j > 0 && (decoders[j - 1].end - decoders[j - 1].current) > (decoder.end - decoder.current))
+        {
+            decoders[j] = decoders[j - 1];
+            j--;
+        }
+        decoders[j] = decoder;
+    }
+
+    if (allTermsFound)
+    {
+        // Walk the shortest list, keeping the newest maxResults matches in a ring
+        while (decoderNext(&decoders[0]))
+        {
+            uint64_t candidate = decoders[0].sequence;
+            int isMatch = 1;
+
+            for (int i = 1; i < numTerms && isMatch; i++)
+            {
+                while ((!decoders[i].started || decoders[i].sequence < candidate) && decoderNext(&decoders[i]))
+                {
+                    // skip forward
+                }
+
+                if (!decoders[i].started || decoders[i].sequence < candidate)
+                {
+                    // List exhausted - no further matches possible
+                    allTermsFound = 0;
+                    isMatch = 0;
+                }
+                else if (decoders[i].sequence != candidate)
+                {
+                    isMatch = 0;
+                }
+            }
+
+            if (isMatch)
+            {
+                newest[numFound % maxResults] = candidate;
+                numFound++;
+            }
+
+            if (!allTermsFound)
+            {
+                break;
+            }
+        }
+    }
+
+    pthread_rwlock_unlock(&indexLock);
+
+    // Copy out newest first
+    int numResults = numFound < maxResults ? numFound : maxResults;
+    for (int i = 0; i < numResults; i++)
+    {
+        results[i] = newest[(numFound - 1 - i) % maxResults];
+    }
+
+    return numResults;
+}
+
+
+/*
+* Function:     historyIndexGetStats
+* Purpose:      Gets the indexer progress and index size.
+*
+* Inputs:       uint64_t*       indexedUpTo     Where to store the next sequence to be indexed.
+*               size_t*         numTerms        Where to store the number of distinct terms.
+*               size_t*         postingBytes    Where to store the bytes allocated for posting lists.
+*
+* Outputs:      The stats.
+*
+* Returns:      void
+*/
+void historyIndexGetStats(uint64_t* indexedUpTo, size_t* numTerms, size_t* postingBytes)
+{
+    pthread_rwlock_rdlock(&indexLock);
+    *indexedUpTo = indexIndexedUpTo;
+    *numTerms = indexNumTerms;
+    *postingBytes = indexPostingBytes;
+    pthread_rwlock_unlock(&indexLock);
+}
@@ -0,0 +1,954 @@
+/*
+* Filename:		serverCoroutine.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the coroutine client sessions of the CHAT-SYSTEM server.
+*
+*               A client handler is sequential code - handshake, register, then read one message after
+*               another. Run on a thread of its own, every connected client costs a thread and its
+*               megabytes of stack. Run as a coroutine, the same code costs a small stack instead.
+*
+*               Each session gets a COROUTINE_STACK_SIZE stack (mmap()ed, with a guard page below it so
+*               an overflow faults instead of corrupting a neighbour). Stacks of finished sessions are
+*               pooled and reused. Sessions are spread over COROUTINE_NUM_LOOPS event loop threads.
+*
+*               Where a session would block reading its socket, coroutineRecv() and coroutineWaitFd()
+*               arm the socket in the loop's epoll instance (one-shot) and switch back to the loop,
+*               which runs the next ready session. When epoll reports the socket, the session is
+*               switched back in and carries on where it left off. Waits with a timeout (handshakes)
+*               are kept on a short list the loop checks; SO_RCVTIMEO is honoured the same way.
+*
+*               Switching is hand-rolled on x86-64: the callee-saved registers, MXCSR and the x87
+*               control word are pushed on the current stack, the stack pointers are swapped, and
+*               the other side's registers are popped. Other architectures use swapcontext().
+*
+*               NOTE: A session must never wait while holding a mutex another session on its loop may
+*                     take - both would be on the same thread. Only reads wait; sends block as before.
+*
+*               Built without CHAT_COROUTINES (make COROUTINES=0), coroutineStart() fails and every
+*               client gets a thread of its own again.
+*/
+
+#include "../inc/serverCoroutine.h"
+
+static CoroutineStats coroutineStats;
+
+// Set by coroutineSetSelf() - a benchmark playing many clients on one thread tells them apart by it
+static __thread pthread_t standInSelf = 0;
+
+#ifdef CHAT_COROUTINES
+
+#ifndef __x86_64__
+#include <ucontext.h>
+#endif
+
+struct CoroutineLoop;
+
+typedef struct Coroutine
+{
+    #ifdef __x86_64__
+    void* stackPointer;             // Saved while switched out
+    #else
+    ucontext_t context;
+    #endif
+    uint8_t* mapping;               // Guard page, then the stack, then this struct
+    CoroutineEntry entry;
+    void* arg;
+    struct CoroutineLoop* loop;
+    struct Coroutine* next;         // In the new, ready or pooled list
+    struct Coroutine* nextTimed;    // In the loop's list of waits with a timeout
+    int registeredFd;               // Socket added to the loop's epoll instance, or -1
+    int waitResult;
+    int isFinished;
+    int64_t deadline;               // Monotonic milliseconds, or 0 for no timeout
+} Coroutine;
+
+typedef struct CoroutineLoop
+{
+    pthread_t thread;
+    int epollFd;
+    int wakeFd;                     // eventfd - written when sessions are added or the loops stop
+    pthread_mutex_t mutex;          // Protects newHead and newTail
+    Coroutine* newHead;
+    Coroutine* newTail;
+    Coroutine* readyHead __attribute__((aligned(CACHE_LINE_LENGTH)));   // Loop thread only, from here down
+    Coroutine* readyTail;
+    Coroutine* timedWaiters;
+    #ifdef __x86_64__
+    void* schedulerStackPointer;
+    #else
+    ucontext_t schedulerContext;
+    #endif
+    uint64_t switches;              // Summed by coroutineGetStats()
+    uint64_t waits;
+} __attribute__((aligned(CACHE_LINE_LENGTH))) CoroutineLoop;
+
+#define COROUTINE_COUNT(loop, counter, amount) __atomic_add_fetch(&(loop)->counter, amount, __ATOMIC_RELAXED)
+
+static CoroutineLoop coroutineLoops[COROUTINE_NUM_LOOPS];
+static int numCoroutineLoops = 0;
+static int coroutineIsRunning = COROUTINE_STOPPED;
+static unsigned int nextLoop = 0;
+
+// Session running on this thread, if any
+static __thread Coroutine* currentCoroutine = NULL;
+
+// Stacks of finished sessions
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;
+static Coroutine* pooledCoroutines = NULL;
+
+static size_t pageSize = 0;
+static size_t mappingSize = 0;
+
+#ifdef __x86_64__
+
+// coroutineSwitch(saveStackPointer, loadStackPointer) - saves this side, resumes the other.
+// coroutineTrampoline is where a new session's first switch returns to: it calls the function in r12.
+void coroutineSwitch(void** saveStackPointer, void* loadStackPointer);
+void coroutineTrampoline();
+
+__asm__(
+    ".text\n"
+    ".globl coroutineSwitch\n"
+    ".hidden coroutineSwitch\n"
+    ".type coroutineSwitch, @function\n"
+    "coroutineSwitch:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    subq $8, %rsp\n"
+    "    stmxcsr (%rsp)\n"
+    "    fnstcw 4(%rsp)\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    ldmxcsr (%rsp)\n"
+    "    fldcw 4(%rsp)\n"
+    "    addq $8, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    ".size coroutineSwitch, .-coroutineSwitch\n"
+    ".globl coroutineTrampoline\n"
+    ".hidden coroutineTrampoline\n"
+    ".type coroutineTrampoline, @function\n"
+    "coroutineTrampoline:\n"
+    "    callq *%r12\n"
+    "    ud2\n"
+    ".size coroutineTrampoline, .-coroutineTrampoline\n"
+);
+
+#define COROUTINE_INITIAL_MXCSR 0x1F80      // All exceptions masked, round to nearest
+#define COROUTINE_INITIAL_FPU_CW 0x037F
+
+#endif
+
+
+/*
+* Function:     monotonicMilliseconds
+* Purpose:      Gets the monotonic clock in milliseconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Milliseconds since an arbitrary start point.
+*/
+static int64_t monotonicMilliseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+
+/*
+* Function:     resumeCoroutine
+* Purpose:      Switches from a loop to one of its sessions, until the session waits or finishes.
+*
+* Inputs:       CoroutineLoop*  loop            The loop (the calling thread).
+*               Coroutine*      coroutine       The session.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void resumeCoroutine(CoroutineLoop* loop, Coroutine* coroutine)
+{
+    currentCoroutine = coroutine;
+    COROUTINE_COUNT(loop, switches, 1);
+
+    #ifdef __x86_64__
+    coroutineSwitch(&loop->schedulerStackPointer, coroutine->stackPointer);
+    #else
+    swapcontext(&loop->schedulerContext, &coroutine->context);
+    #endif
+
+    currentCoroutine = NULL;
+}
+
+
+/*
+* Function:     suspendCoroutine
+* Purpose:      Switches from a session back to its loop. Returns once the loop resumes the session.
+*
+* Inputs:       Coroutine*      coroutine       The session (the caller).
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void suspendCoroutine(Coroutine* coroutine)
+{
+    #ifdef __x86_64__
+    coroutineSwitch(&coroutine->stackPointer, coroutine->loop->schedulerStackPointer);
+    #else
+    swapcontext(&coroutine->context, &coroutine->loop->schedulerContext);
+    #endif
+}
+
+
+/*
+* Function:     runCoroutine
+* Purpose:      First function on every session's stack - runs the session and hands its stack back.
+*
+* Inputs:       None - the session is currentCoroutine.
+*
+* Outputs:      None
+*
+* Returns:      void                            Never - the loop does not resume a finished session.
+*/
+static void runCoroutine()
+{
+    Coroutine* coroutine = currentCoroutine;
+
+    coroutine->entry(coroutine->arg);
+
+    coroutine->isFinished = 1;
+    suspendCoroutine(coroutine);
+}
+
+
+/*
+* Function:     allocateCoroutine
+* Purpose:      Takes a session (and its stack) from the pool, or maps a new one.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      Coroutine*                      The session, or NULL if no stack could be mapped.
+*/
+static Coroutine* allocateCoroutine()
+{
+    pthread_mutex_lock(&poolMutex);
+
+    Coroutine* coroutine = pooledCoroutines;
+    if (coroutine != NULL)
+    {
+        pooledCoroutines = coroutine->next;
+        coroutineStats.numPooledStacks--;
+    }
+
+    pthread_mutex_unlock(&poolMutex);
+
+    if (coroutine != NULL)
+    {
+        return coroutine;
+    }
+
+    uint8_t* mapping = mmap(NULL, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        perror("mmap");
+        return NULL;
+    }
+
+    // Guard page at the bottom - the stack grows down into it
+    mprotect(mapping, pageSize, PROT_NONE);
+
+    coroutine = (Coroutine*)(mapping + mappingSize - sizeof(Coroutine));
+    coroutine->mapping = mapping;
+
+    return coroutine;
+}
+
+
+/*
+* Function:     releaseCoroutine
+* Purpose:      Pools a finished session's stack for the next one, or unmaps it if the pool is full.
+*
+* Inputs:       Coroutine*      coroutine       The finished session.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void releaseCoroutine(Coroutine* coroutine)
+{
+    pthread_mutex_lock(&poolMutex);
+
+    coroutineStats.numSessions--;
+
+    int isPooled = coroutineStats.numPooledStacks < COROUTINE_POOL_LENGTH;
+    if (isPooled)
+    {
+        coroutine->next = pooledCoroutines;
+        pooledCoroutines = coroutine;
+        coroutineStats.numPooledStacks++;
+    }
+
+    pthread_mutex_unlock(&poolMutex);
+
+    if (!isPooled)
+    {
+        munmap(coroutine->mapping, mappingSize);
+    }
+}
+
+
+/*
+* Function:     pushReady
+* Purpose:      Puts a session at the back of its loop's ready list.
+*
+* Inputs:       CoroutineLoop*  loop            The loop (the calling thread).
+*               Coroutine*      coroutine       The session.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void pushReady(CoroutineLoop* loop, Coroutine* coroutine)
+{
+    coroutine->next = NULL;
+    if (loop->readyTail != NULL)
+    {
+        loop->readyTail->next = coroutine;
+    }
+    else
+    {
+        loop->readyHead = coroutine;
+    }
+    loop->readyTail = coroutine;
+}
+
+
+/*
+* Function:     removeTimedWaiter
+* Purpose:      Takes a session off its loop's list of waits with a timeout, if it is on it.
+*
+* Inputs:       CoroutineLoop*  loop            The loop (the calling thread).
+*               Coroutine*      coroutine       The session.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void removeTimedWaiter(CoroutineLoop* loop, Coroutine* coroutine)
+{
+    if (coroutine->deadline == 0)
+    {
+        return;
+    }
+
+    Coroutine** link = &loop->timedWaiters;
+    while (*link != NULL && *link != coroutine)
+    {
+        link = &(*link)->nextTimed;
+    }
+    if (*link != NULL)
+    {
+        *link = coroutine->nextTimed;
+    }
+
+    coroutine->deadline = 0;
+}
+
+
+/*
+* Function:     coroutineLoop
+* Purpose:      Thread function for an event loop. Runs every ready session until it waits or finishes,
+*               then waits in epoll for sockets, new sessions or the earliest timeout.
+*
+* Inputs:       void*           arg             The loop's CoroutineLoop.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* coroutineLoop(void* arg)
+{
+    CoroutineLoop* loop = arg;
+    struct epoll_event events[COROUTINE_MAX_EVENTS];
+
+    while (__atomic_load_n(&coroutineIsRunning, __ATOMIC_ACQUIRE))
+    {
+        // Sessions added by the accepting threads
+        pthread_mutex_lock(&loop->mutex);
+        Coroutine* newSessions = loop->newHead;
+        loop->newHead = NULL;
+        loop->newTail = NULL;
+        pthread_mutex_unlock(&loop->mutex);
+
+        while (newSessions != NULL)
+        {
+            Coroutine* next = newSessions->next;
+            pushReady(loop, newSessions);
+            newSessions = next;
+        }
+
+        // Run everything that can make progress
+        while (loop->readyHead != NULL)
+        {
+            Coroutine* coroutine = loop->readyHead;
+            loop->readyHead = coroutine->next;
+            if (loop->readyHead == NULL)
+            {
+                loop->readyTail = NULL;
+            }
+
+            resumeCoroutine(loop, coroutine);
+
+            if (coroutine->isFinished)
+            {
+                releaseCoroutine(coroutine);
+            }
+        }
+
+        // Sleep until a socket is ready, a session is added, or the earliest timeout
+        int64_t now = monotonicMilliseconds();
+        int timeout = COROUTINE_NO_TIMEOUT;
+        for (Coroutine* waiter = loop->timedWaiters; waiter != NULL; waiter = waiter->nextTimed)
+        {
+            int remaining = waiter->deadline > now ? (int)(waiter->deadline - now) : 0;
+            if (timeout == COROUTINE_NO_TIMEOUT || remaining < timeout)
+            {
+                timeout = remaining;
+            }
+        }
+
+        int numEvents = epoll_wait(loop->epollFd, events, COROUTINE_MAX_EVENTS, timeout);
+
+        for (int i = 0; i < numEvents; i++)
+        {
+            Coroutine* coroutine = events[i].data.ptr;
+            if (coroutine == NULL)
+            {
+                uint64_t numWakeups;
+                if (read(loop->wakeFd, &numWakeups, sizeof(numWakeups)) < 0)
+                {
+                    // Nothing to read - another event already drained it
+                }
+                continue;
+            }
+
+            removeTimedWaiter(loop, coroutine);
+            coroutine->waitResult = COROUTINE_READY;
+            pushReady(loop, coroutine);
+        }
+
+        // Waits that timed out - disarm their sockets so a late event cannot wake them twice
+        now = monotonicMilliseconds();
+        Coroutine** link = &loop->timedWaiters;
+        while (*link != NULL)
+        {
+            Coroutine* coroutine = *link;
+            if (coroutine->deadline > now)
+            {
+                link = &coroutine->nextTimed;
+                continue;
+            }
+
+            *link = coroutine->nextTimed;
+            coroutine->deadline = 0;
+            epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, coroutine->registeredFd, NULL);
+            coroutine->registeredFd = -1;
+            coroutine->waitResult = COROUTINE_TIMED_OUT;
+            pushReady(loop, coroutine);
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+* Function:     coroutineSpawn
+* Purpose:      Starts a session: entry(arg) runs as a coroutine on one of the event loops.
+*
+* Inputs:       CoroutineEntry  entry           The session's code.
+*               void*           arg             Passed to entry.
+*
+* Outputs:      None
+*
+* Returns:      int                             COROUTINE_SUCCESS, or COROUTINE_ERROR if the loops are not
+*                                               running or no stack could be mapped.
+*/
+int coroutineSpawn(CoroutineEntry entry, void* arg)
+{
+    if (!__atomic_load_n(&coroutineIsRunning, __ATOMIC_ACQUIRE))
+    {
+        return COROUTINE_ERROR;
+    }
+
+    Coroutine* coroutine = allocateCoroutine();
+    if (coroutine == NULL)
+    {
+        return COROUTINE_ERROR;
+    }
+
+    CoroutineLoop* loop = &coroutineLoops[__atomic_fetch_add(&nextLoop, 1, __ATOMIC_RELAXED) % numCoroutineLoops];
+
+    uint8_t* mapping = coroutine->mapping;
+    memset(coroutine, 0, sizeof(Coroutine));
+    coroutine->mapping = mapping;
+    coroutine->entry = entry;
+    coroutine->arg = arg;
+    coroutine->loop = loop;
+    coroutine->registeredFd = -1;
+
+    // Stack runs from just below this struct down to the guard page
+    uintptr_t stackTop = ((uintptr_t)coroutine) & ~(uintptr_t)15;
+
+    #ifdef __x86_64__
+    // What coroutineSwitch() pops: FPU state, r15, r14, r13, r12 (the function for the trampoline),
+    // rbx, rbp, then the return address. stackTop stays 16-byte aligned for the trampoline's call.
+    uint64_t* stackPointer = (uint64_t*)stackTop - 8;
+    stackPointer[0] = COROUTINE_INITIAL_MXCSR | ((uint64_t)COROUTINE_INITIAL_FPU_CW << 32);
+    stackPointer[1] = 0;
+    stackPointer[2] = 0;
+    stackPointer[3] = 0;
+    stackPointer[4] = (uint64_t)(uintptr_t)runCoroutine;
+    stackPointer[5] = 0;
+    stackPointer[6] = 0;
+    stackPointer[7] = (uint64_t)(uintptr_t)coroutineTrampoline;
+    coroutine->stackPointer = stackPointer;
+    #else
+    getcontext(&coroutine->context);
+    coroutine->context.uc_stack.ss_sp = mapping + pageSize;
+    coroutine->context.uc_stack.ss_size = stackTop - (uintptr_t)(mapping + pageSize);
+    coroutine->context.uc_link = NULL;
+    makecontext(&coroutine->context, runCoroutine, 0);
+    #endif
+
+    pthread_mutex_lock(&poolMutex);
+    coroutineStats.numSessions++;
+    if (coroutineStats.numSessions > coroutineStats.peakSessions)
+    {
+        coroutineStats.peakSessions = coroutineStats.numSessions;
+    }
+    coroutineStats.sessionsStarted++;
+    pthread_mutex_unlock(&poolMutex);
+
+    pthread_mutex_lock(&loop->mutex);
+    if (loop->newTail != NULL)
+    {
+        loop->newTail->next = coroutine;
+    }
+    else
+    {
+        loop->newHead = coroutine;
+    }
+    loop->newTail = coroutine;
+    pthread_mutex_unlock(&loop->mutex);
+
+    uint64_t wakeup = 1;
+    if (write(loop->wakeFd, &wakeup, sizeof(wakeup)) < 0)
+    {
+        perror("write");
+    }
+
+    return COROUTINE_SUCCESS;
+}
+
+
+/*
+* Function:     coroutineSelf
+* Purpose:      Identifies the calling session - like pthread_self(), which it is outside a session.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      pthread_t                       An ID no other running session or thread has.
+*/
+pthread_t coroutineSelf()
+{
+    if (standInSelf != 0)
+    {
+        return standInSelf;
+    }
+
+    return currentCoroutine != NULL ? (pthread_t)(uintptr_t)currentCoroutine : pthread_self();
+}
+
+
+/*
+* Function:     coroutineIsSession
+* Purpose:      Checks whether the caller is a session, which must never block its event loop.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             1 in a session, 0 on any other thread.
+*/
+int coroutineIsSession()
+{
+    return currentCoroutine != NULL;
+}
+
+
+/*
+* Function:     coroutineWaitFd
+* Purpose:      Waits until a socket is ready. In a session, the loop runs other sessions meanwhile.
+*
+* Inputs:       int             fd              The socket.
+*               short           events          POLLIN and/or POLLOUT.
+*               int             timeoutMilliseconds How long to wait, or COROUTINE_NO_TIMEOUT.
+*
+* Outputs:      None
+*
+* Returns:      int                             COROUTINE_READY (also on errors - the next call on the
+*                                               socket reports them), or COROUTINE_TIMED_OUT.
+*/
+int coroutineWaitFd(int fd, short events, int timeoutMilliseconds)
+{
+    Coroutine* coroutine = currentCoroutine;
+    if (coroutine == NULL)
+    {
+        struct pollfd pollFd = {.fd = fd, .events = events};
+        return poll(&pollFd, 1, timeoutMilliseconds) == 0 ? COROUTINE_TIMED_OUT : COROUTINE_READY;
+    }
+
+    CoroutineLoop* loop = coroutine->loop;
+    struct epoll_event event = {.events = EPOLLONESHOT, .data.ptr = coroutine};
+    event.events |= (events & POLLIN) ? EPOLLIN | EPOLLRDHUP : 0;
+    event.events |= (events & POLLOUT) ? EPOLLOUT : 0;
+
+    if (coroutine->registeredFd != fd && coroutine->registeredFd >= 0)
+    {
+        epoll_ctl(loop->epollFd, EPOLL_CTL_DEL, coroutine->registeredFd, NULL);
+        coroutine->registeredFd = -1;
+    }
+
+    int operation = coroutine->registeredFd == fd ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+    if (epoll_ctl(loop->epollFd, operation, fd, &event) != 0 &&
+        (errno != EEXIST || epoll_ctl(loop->epollFd, EPOLL_CTL_MOD, fd, &event) != 0))
+    {
+        return COROUTINE_READY;
+    }
+    coroutine->registeredFd = fd;
+
+    if (timeoutMilliseconds != COROUTINE_NO_TIMEOUT)
+    {
+        coroutine->deadline = monotonicMilliseconds() + timeoutMilliseconds;
+        if (coroutine->deadline == 0)
+        {
+            coroutine->deadline = 1;
+        }
+        coroutine->nextTimed = loop->timedWaiters;
+        loop->timedWaiters = coroutine;
+    }
+
+    COROUTINE_COUNT(loop, waits, 1);
+    suspendCoroutine(coroutine);
+
+    return coroutine->waitResult;
+}
+
+
+/*
+* Function:     coroutineSleep
+* Purpose:      Sleeps for a while. In a session, the loop runs other sessions meanwhile.
+*
+* Inputs:       int             milliseconds    How long to sleep.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void coroutineSleep(int milliseconds)
+{
+    Coroutine* coroutine = currentCoroutine;
+    if (coroutine == NULL)
+    {
+        usleep(milliseconds * 1000);
+        return;
+    }
+
+    // A timed wait on no socket - the loop resumes it once the deadline passes
+    CoroutineLoop* loop = coroutine->loop;
+    coroutine->deadline = monotonicMilliseconds() + milliseconds;
+    if (coroutine->deadline == 0)
+    {
+        coroutine->deadline = 1;
+    }
+    coroutine->nextTimed = loop->timedWaiters;
+    loop->timedWaiters = coroutine;
+
+    COROUTINE_COUNT(loop, waits, 1);
+    suspendCoroutine(coroutine);
+}
+
+
+/*
+* Function:     coroutineRecv
+* Purpose:      recv() that, in a session, waits for data by switching back to the loop instead of
+*               blocking it. SO_RCVTIMEO is honoured; MSG_WAITALL is not - callers loop on short reads.
+*
+* Inputs:       int             fd              The socket.
+*               void*           buffer          Where to store the data.
+*               size_t          length          Size of buffer.
+*               int             flags           Flags for recv().
+*
+* Outputs:      buffer
+*
+* Returns:      ssize_t                         As recv() - -1 with errno EAGAIN if SO_RCVTIMEO ran out.
+*/
+ssize_t coroutineRecv(int fd, void* buffer, size_t length, int flags)
+{
+    if (currentCoroutine == NULL || (flags & MSG_DONTWAIT))
+    {
+        return recv(fd, buffer, length, flags);
+    }
+
+    flags = (flags & ~MSG_WAITALL) | MSG_DONTWAIT;
+    int timeout = COROUTINE_NO_TIMEOUT;
+    int isTimeoutRead = 0;
+
+    while (1)
+    {
+        ssize_t numBytesRead = recv(fd, buffer, length, flags);
+        if (numBytesRead >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+        {
+            return numBytesRead;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+
+        // Only looked up once there is actually something to wait for
+        if (!isTimeoutRead)
+        {
+            struct timeval receiveTimeout = {0};
+            socklen_t optionLength = sizeof(receiveTimeout);
+            if (getsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &receiveTimeout, &optionLength) == 0 &&
+                (receiveTimeout.tv_sec != 0 || receiveTimeout.tv_usec != 0))
+            {
+                timeout = receiveTimeout.tv_sec * 1000 + receiveTimeout.tv_usec / 1000;
+            }
+            isTimeoutRead = 1;
+        }
+
+        if (coroutineWaitFd(fd, POLLIN, timeout) == COROUTINE_TIMED_OUT)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+    }
+}
+
+
+/*
+* Function:     coroutineStart
+* Purpose:      Starts the event loop threads.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             COROUTINE_SUCCESS, or COROUTINE_ERROR if they could not be
+*                                               started - clients then get a thread each.
+*/
+int coroutineStart()
+{
+    pageSize = sysconf(_SC_PAGESIZE);
+    mappingSize = pageSize + ((COROUTINE_STACK_SIZE + sizeof(Coroutine) + pageSize - 1) / pageSize) * pageSize;
+
+    __atomic_store_n(&coroutineIsRunning, COROUTINE_RUNNING, __ATOMIC_RELEASE);
+
+    for (numCoroutineLoops = 0; numCoroutineLoops < COROUTINE_NUM_LOOPS; numCoroutineLoops++)
+    {
+        CoroutineLoop* loop = &coroutineLoops[numCoroutineLoops];
+        memset(loop, 0, sizeof(CoroutineLoop));
+        pthread_mutex_init(&loop->mutex, NULL);
+
+        loop->epollFd = epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        struct epoll_event wakeEvent = {.events = EPOLLIN, .data.ptr = NULL};
+
+        if (loop->epollFd < 0 || loop->wakeFd < 0 || epoll_ctl(loop->epollFd, EPOLL_CTL_ADD, loop->wakeFd, &wakeEvent) != 0 ||
+            pthread_create(&loop->thread, NULL, coroutineLoop, loop) != 0)
+        {
+            perror("coroutineStart");
+            if (loop->epollFd >= 0)
+            {
+                close(loop->epollFd);
+            }
+            if (loop->wakeFd >= 0)
+            {
+                close(loop->wakeFd);
+            }
+            coroutineStop();
+            return COROUTINE_ERROR;
+        }
+    }
+
+    return COROUTINE_SUCCESS;
+}
+
+
+/*
+* Function:     coroutineStop
+* Purpose:      Stops the event loop threads. Sessions still waiting are abandoned with their stacks -
+*               by now every client has left, so only unregistered connections can be left over.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void coroutineStop()
+{
+    if (!__atomic_load_n(&coroutineIsRunning, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    __atomic_store_n(&coroutineIsRunning, COROUTINE_STOPPED, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < numCoroutineLoops; i++)
+    {
+        uint64_t wakeup = 1;
+        if (write(coroutineLoops[i].wakeFd, &wakeup, sizeof(wakeup)) < 0)
+        {
+            perror("write");
+        }
+        pthread_join(coroutineLoops[i].thread, NULL);
+        close(coroutineLoops[i].epollFd);
+        close(coroutineLoops[i].wakeFd);
+    }
+    numCoroutineLoops = 0;
+
+    pthread_mutex_lock(&poolMutex);
+    while (pooledCoroutines != NULL)
+    {
+        Coroutine* coroutine = pooledCoroutines;
+        pooledCoroutines = coroutine->next;
+        munmap(coroutine->mapping, mappingSize);
+    }
+    coroutineStats.numPooledStacks = 0;
+    pthread_mutex_unlock(&poolMutex);
+}
+
+#else
+
+int coroutineStart()
+{
+    fprintf(stderr, "[COROUTINE] : built without coroutines - every client gets a thread\n");
+    return COROUTINE_ERROR;
+}
+
+void coroutineStop()
+{
+}
+
+int coroutineSpawn(CoroutineEntry entry, void* arg)
+{
+    (void)entry;
+    (void)arg;
+    return COROUTINE_ERROR;
+}
+
+pthread_t coroutineSelf()
+{
+    return standInSelf != 0 ? standInSelf : pthread_self();
+}
+
+int coroutineWaitFd(int fd, short events, int timeoutMilliseconds)
+{
+    struct pollfd pollFd = {.fd = fd, .events = events};
+    return poll(&pollFd, 1, timeoutMilliseconds) == 0 ? COROUTINE_TIMED_OUT : COROUTINE_READY;
+}
+
+ssize_t coroutineRecv(int fd, void* buffer, size_t length, int flags)
+{
+    return recv(fd, buffer, length, flags);
+}
+
+int coroutineIsSession()
+{
+    return 0;
+}
+
+void coroutineSleep(int milliseconds)
+{
+    usleep(milliseconds * 1000);
+}
+
+#endif
+
+
+/*
+* Function:     coroutineSetSelf
+* Purpose:      Makes coroutineSelf() return the given ID on the calling thread, so a benchmark can play
+*               many clients from one thread. The ID must not be any thread's or session's.
+*
+* Inputs:       pthread_t       sessionID       The ID, or 0 to go back to the thread's own.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void coroutineSetSelf(pthread_t sessionID)
+{
+    standInSelf = sessionID;
+}
+
+
+/*
+* Function:     coroutineGetStats
+* Purpose:      Gets the session counters.
+*
+* Inputs:       CoroutineStats* statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void coroutineGetStats(CoroutineStats* statsP)
+{
+    #ifdef CHAT_COROUTINES
+    pthread_mutex_lock(&poolMutex);
+    #endif
+
+    statsP->numSessions = coroutineStats.numSessions;
+    statsP->peakSessions = coroutineStats.peakSessions;
+    statsP->numPooledStacks = coroutineStats.numPooledStacks;
+    statsP->sessionsStarted = coroutineStats.sessionsStarted;
+
+    #ifdef CHAT_COROUTINES
+    pthread_mutex_unlock(&poolMutex);
+    #endif
+
+    statsP->switches = 0;
+    statsP->waits = 0;
+
+    #ifdef CHAT_COROUTINES
+    for (int i = 0; i < COROUTINE_NUM_LOOPS; i++)
+    {
+        statsP->switches += __atomic_load_n(&coroutineLoops[i].switches, __ATOMIC_RELAXED);
+        statsP->waits += __atomic_load_n(&coroutineLoops[i].waits, __ATOMIC_RELAXED);
+    }
+    #endif
+}
@@ -0,0 +1,876 @@
+/*
+* Filename:		serverFilter.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the message filter stage of the CHAT-SYSTEM server.
+*
+*               Chat messages can be moderated between the client handler and the message queue. The
+*               patterns are read from FILTER_PATTERN_FILE, one per line:
+*                   block <pattern>     Messages containing the pattern are dropped; the sender gets ">>filtered<<".
+*                   mask <pattern>      The pattern is replaced with '*' and the message goes through.
+*               Matching ignores case and finds the pattern anywhere in the message, so "block http://"
+*               and "block www." block links.
+*
+*               All patterns are compiled into one Aho-Corasick automaton, stored as a full transition
+*               table with the failure links (and upper case) already folded in. Checking a message is
+*               then one table lookup per byte, however many patterns there are.
+*
+*               The matching runs on FILTER_NUM_WORKERS filter workers, so a large pattern set never
+*               slows the client handlers down. Each worker has its own queue, and every user's messages
+*               go to the same worker, so they are broadcast in the order they were sent. A full queue
+*               holds the submitting handler up until there is room - a coroutine session sleeps in its
+*               event loop meanwhile, so the other sessions on the loop keep running. Once filtered, a message is passed
+*               to the next stage given to filterStart().
+*
+*               The reload thread checks the pattern file every second, and right away after
+*               filterRequestReload() (SIGHUP). A new automaton is built on the side and swapped in;
+*               workers keep a reference to the one they are using, so the old one is only freed once
+*               the last message being checked against it is done. Traffic never stops for a reload,
+*               and a pattern file that fails to load leaves the old patterns in place.
+*
+*               With no patterns loaded, filterSubmit() returns FILTER_NOT_QUEUED (unless the sender still
+*               has messages queued) and the caller sends the message on itself, skipping the workers.
+*/
+
+#include "../inc/serverFilter.h"
+
+// A pattern as read from the pattern file
+typedef struct
+{
+    int action;
+    int length;
+    char text[FILTER_MAX_PATTERN_LENGTH + 1];
+} FilterPattern;
+
+static FilterWorker filterWorkers[FILTER_NUM_WORKERS];
+static int numFilterWorkers = 0;
+static pthread_t reloadThread;
+static int isReloaderStarted = 0;
+static int filterIsRunning = FILTER_STOPPED;
+static volatile sig_atomic_t reloadRequested = 0;
+
+static FilterNextStage filterNextStage = NULL;
+static void* filterStageArg = NULL;
+
+// Protects currentAutomaton, the automatons' reference counts and filterStats
+static pthread_mutex_t filterMutex = PTHREAD_MUTEX_INITIALIZER;
+static FilterAutomaton* currentAutomaton = NULL;
+static FilterStats filterStats;
+
+// Pattern file as last loaded - a change to any of these means it was edited
+static struct stat loadedFileStat;
+static int isFileLoaded = 0;
+
+
+/*
+* Function:     readPatterns
+* Purpose:      Reads the patterns from a pattern file. Blank lines and lines starting with '#' are skipped.
+*
+* Inputs:       const char*     patternFile     Path of the pattern file.
+*               FilterPattern** patternsP       Where to store the patterns (memFree() with MEM_FILTER_PATTERNS).
+*               int*            numPatterns     Where to store the number of patterns.
+*
+* Outputs:      patternsP, numPatterns
+*
+* Returns:      int                             FILTER_SUCCESS, or FILTER_ERROR if the file could not be read.
+*/
+static int readPatterns(const char* patternFile, FilterPattern** patternsP, int* numPatterns)
+{
+    *patternsP = NULL;
+    *numPatterns = 0;
+
+    FILE* file = fopen(patternFile, "r");
+    if (file == NULL)
+    {
+        return FILTER_ERROR;
+    }
+
+    FilterPattern* patterns = NULL;
+    int capacity = 0;
+    int isFailed = 0;
+    int lineNumber = 0;
+    char line[FILTER_MAX_PATTERN_LENGTH + 32];
+
+    while (!isFailed && fgets(line, sizeof(line), file) != NULL)
+    {
+        lineNumber++;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        char* start = line;
+        while (isspace((unsigned char)*start))
+        {
+            start++;
+        }
+        if (*start == '\0' || *start == '#')
+        {
+            continue;
+        }
+
+        int action;
+        if (strncmp(start, "block ", 6) == 0)
+        {
+            action = FILTER_ACTION_BLOCK;
+        }
+        else if (strncmp(start, "mask ", 5) == 0)
+        {
+            action = FILTER_ACTION_MASK;
+        }
+        else
+        {
+            fprintf(stderr, "[FILTER] : %s:%d - expected \"block <pattern>\" or \"mask <pattern>\"\n", patternFile, lineNumber);
+            isFailed = 1;
+            continue;
+        }
+
+        // Pattern is the rest of the line, without surrounding spaces
+        char* text = strchr(start, ' ');
+        while (isspace((unsigned char)*text))
+        {
+            text++;
+        }
+        int length = strlen(text);
+        while (length > 0 && isspace((unsigned char)text[length - 1]))
+        {
+            length--;
+        }
+        if (length == 0 || length > FILTER_MAX_PATTERN_LENGTH)
+        {
+            fprintf(stderr, "[FILTER] : %s:%d - pattern must be 1 to %d characters\n", patternFile, lineNumber, FILTER_MAX_PATTERN_LENGTH);
+            isFailed = 1;
+            continue;
+        }
+
+        if (*numPatterns == capacity)
+        {
+            int newCapacity = capacity == 0 ? 16 : capacity * 2;
+            FilterPattern* newPatterns = memRealloc(MEM_FILTER_PATTERNS, patterns, newCapacity * sizeof(FilterPattern));
+            if (newPatterns == NULL)
+            {
+                isFailed = 1;
+                continue;
+            }
+            patterns = newPatterns;
+            capacity = newCapacity;
+        }
+
+        FilterPattern* pattern = &patterns[(*numPatterns)++];
+        pattern->action = action;
+        pattern->length = length;
+        for (int i = 0; i < length; i++)
+        {
+            pattern->text[i] = tolower((unsigned char)text[i]);
+        }
+        pattern->text[length] = '\0';
+    }
+
+    if (ferror(file))
+    {
+        isFailed = 1;
+    }
+    fclose(file);
+
+    if (isFailed)
+    {
+        memFree(MEM_FILTER_PATTERNS, patterns);
+        *numPatterns = 0;
+        return FILTER_ERROR;
+    }
+
+    *patternsP = patterns;
+    return FILTER_SUCCESS;
+}
+
+
+/*
+* Function:     filterCompile
+* Purpose:      Reads a pattern file and compiles its patterns into an Aho-Corasick automaton.
+*
+*               The patterns go into a trie first. A breadth-first pass then fills in every missing
+*               transition from the state's failure link (the longest suffix that is also in the trie),
+*               and merges the failure link's actions in, so a state knows every pattern ending there.
+*               Upper case letters finally get the same transitions as lower case ones.
+*
+* Inputs:       const char*     patternFile     Path of the pattern file.
+*
+* Outputs:      None
+*
+* Returns:      FilterAutomaton*                The automaton with one reference (filterFree() it), or NULL
+*                                               if the file could not be compiled. A file without patterns
+*                                               gives an automaton that matches nothing.
+*/
+FilterAutomaton* filterCompile(const char* patternFile)
+{
+    int numPatterns;
+    FilterPattern* patterns;
+    if (readPatterns(patternFile, &patterns, &numPatterns) != FILTER_SUCCESS)
+    {
+        return NULL;
+    }
+
+    // Worst case, every pattern byte is a new state
+    size_t maxStates = 1;
+    for (int i = 0; i < numPatterns; i++)
+    {
+        maxStates += patterns[i].length;
+    }
+    if (maxStates > FILTER_MAX_STATES)
+    {
+        fprintf(stderr, "[FILTER] : %s has too many patterns - %zu bytes, at most %d\n", patternFile, maxStates - 1, FILTER_MAX_STATES - 1);
+        memFree(MEM_FILTER_PATTERNS, patterns);
+        return NULL;
+    }
+
+    FilterAutomaton* automaton = memCalloc(MEM_FILTER_PATTERNS, 1, sizeof(FilterAutomaton));
+    uint16_t* failLinks = memCalloc(MEM_FILTER_PATTERNS, maxStates, sizeof(uint16_t));
+    uint16_t* bfsQueue = memCalloc(MEM_FILTER_PATTERNS, maxStates, sizeof(uint16_t));
+    if (automaton != NULL)
+    {
+        automaton->transitions = memCalloc(MEM_FILTER_PATTERNS, maxStates * FILTER_ALPHABET, sizeof(uint16_t));
+        automaton->actions = memCalloc(MEM_FILTER_PATTERNS, maxStates, sizeof(uint8_t));
+        automaton->maskLengths = memCalloc(MEM_FILTER_PATTERNS, maxStates, sizeof(uint8_t));
+    }
+    if (automaton == NULL || failLinks == NULL || bfsQueue == NULL || automaton->transitions == NULL ||
+        automaton->actions == NULL || automaton->maskLengths == NULL)
+    {
+        filterFree(automaton);
+        memFree(MEM_FILTER_PATTERNS, failLinks);
+        memFree(MEM_FILTER_PATTERNS, bfsQueue);
+        memFree(MEM_FILTER_PATTERNS, patterns);
+        return NULL;
+    }
+
+    uint16_t* transitions = automaton->transitions;
+    int numStates = 1;
+
+    // Trie - state 0 is the root, so 0 doubles as "no transition yet"
+    for (int i = 0; i < numPatterns; i++)
+    {
+        int state = 0;
+        for (int j = 0; j < patterns[i].length; j++)
+        {
+            uint16_t* next = &transitions[state * FILTER_ALPHABET + (unsigned char)patterns[i].text[j]];
+            if (*next == 0)
+            {
+                *next = numStates++;
+            }
+            state = *next;
+        }
+
+        automaton->actions[state] |= patterns[i].action;
+        if (patterns[i].action == FILTER_ACTION_MASK && patterns[i].length > automaton->maskLengths[state])
+        {
+            automaton->maskLengths[state] = patterns[i].length;
+        }
+    }
+
+    // Failure links, breadth first so a state's link is always finished before the state itself
+    int queueHead = 0;
+    int queueTail = 0;
+    for (int c = 0; c < FILTER_ALPHABET; c++)
+    {
+        if (transitions[c] != 0)
+        {
+            failLinks[transitions[c]] = 0;
+            bfsQueue[queueTail++] = transitions[c];
+        }
+    }
+
+    while (queueHead < queueTail)
+    {
+        int state = bfsQueue[queueHead++];
+        int failLink = failLinks[state];
+
+        automaton->actions[state] |= automaton->actions[failLink];
+        if (automaton->maskLengths[failLink] > automaton->maskLengths[state])
+        {
+            automaton->maskLengths[state] = automaton->maskLengths[failLink];
+        }
+
+        for (int c = 0; c < FILTER_ALPHABET; c++)
+        {
+            uint16_t* next = &transitions[state * FILTER_ALPHABET + c];
+            if (*next != 0)
+            {
+                failLinks[*next] = transitions[failLink * FILTER_ALPHABET + c];
+                bfsQueue[queueTail++] = *next;
+            }
+            else
+            {
+                *next = transitions[failLink * FILTER_ALPHABET + c];
+            }
+        }
+    }
+
+    // Patterns are lower case - fold upper case onto them
+    for (int state = 0; state < numStates; state++)
+    {
+        for (int c = 'A'; c <= 'Z'; c++)
+        {
+            transitions[state * FILTER_ALPHABET + c] = transitions[state * FILTER_ALPHABET + tolower(c)];
+        }
+    }
+
+    // Give back the states the patterns shared
+    uint16_t* shrunk = memRealloc(MEM_FILTER_PATTERNS, transitions, (size_t)numStates * FILTER_ALPHABET * sizeof(uint16_t));
+    if (shrunk != NULL)
+    {
+        automaton->transitions = shrunk;
+    }
+
+    automaton->numPatterns = numPatterns;
+    automaton->numStates = numStates;
+    automaton->references = 1;
+
+    memFree(MEM_FILTER_PATTERNS, failLinks);
+    memFree(MEM_FILTER_PATTERNS, bfsQueue);
+    memFree(MEM_FILTER_PATTERNS, patterns);
+
+    return automaton;
+}
+
+
+/*
+* Function:     filterFree
+* Purpose:      Frees an automaton from filterCompile().
+*
+* Inputs:       FilterAutomaton* automaton      The automaton (may be NULL).
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void filterFree(FilterAutomaton* automaton)
+{
+    if (automaton == NULL)
+    {
+        return;
+    }
+
+    memFree(MEM_FILTER_PATTERNS, automaton->transitions);
+    memFree(MEM_FILTER_PATTERNS, automaton->actions);
+    memFree(MEM_FILTER_PATTERNS, automaton->maskLengths);
+    memFree(MEM_FILTER_PATTERNS, automaton);
+}
+
+
+/*
+* Function:     filterApply
+* Purpose:      Checks a message against every pattern in one pass. Masked patterns are overwritten with
+*               FILTER_MASK_CHARACTER; the scan has already read the bytes it overwrites.
+*
+* Inputs:       const FilterAutomaton* automaton    The compiled patterns.
+*               char*           message         NULL terminated message.
+*
+* Outputs:      message                         The message with masked patterns overwritten.
+*
+* Returns:      int                             FILTER_BLOCKED, FILTER_MASKED or FILTER_PASSED.
+*/
+int filterApply(const FilterAutomaton* automaton, char* message)
+{
+    const uint16_t* transitions = automaton->transitions;
+    int verdict = FILTER_PASSED;
+    int state = 0;
+
+    for (int i = 0; message[i] != '\0'; i++)
+    {
+        state = transitions[state * FILTER_ALPHABET + (unsigned char)message[i]];
+
+        uint8_t actions = automaton->actions[state];
+        if (actions == 0)
+        {
+            continue;
+        }
+
+        if (actions & FILTER_ACTION_BLOCK)
+        {
+            return FILTER_BLOCKED;
+        }
+
+        // Longest mask ending here covers the shorter ones
+        int maskLength = automaton->maskLengths[state];
+        memset(message + i + 1 - maskLength, FILTER_MASK_CHARACTER, maskLength);
+        verdict = FILTER_MASKED;
+    }
+
+    return verdict;
+}
+
+
+/*
+* Function:     acquireAutomaton
+* Purpose:      Takes a reference to the current automaton, so a reload cannot free it while in use.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      FilterAutomaton*                The current automaton, or NULL if no patterns are loaded.
+*/
+static FilterAutomaton* acquireAutomaton()
+{
+    pthread_mutex_lock(&filterMutex);
+
+    FilterAutomaton* automaton = currentAutomaton;
+    if (automaton != NULL)
+    {
+        automaton->references++;
+    }
+
+    pthread_mutex_unlock(&filterMutex);
+
+    return automaton;
+}
+
+
+/*
+* Function:     releaseAutomaton
+* Purpose:      Drops a reference to an automaton, freeing it if it was the last one.
+*
+* Inputs:       FilterAutomaton* automaton      The automaton (may be NULL).
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void releaseAutomaton(FilterAutomaton* automaton)
+{
+    if (automaton == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&filterMutex);
+    int isUnused = --automaton->references == 0;
+    pthread_mutex_unlock(&filterMutex);
+
+    if (isUnused)
+    {
+        filterFree(automaton);
+    }
+}
+
+
+/*
+* Function:     filterCheck
+* Purpose:      Filters a message on the caller's thread with the current patterns, for a message that does
+*               not go through the workers.
+*
+* Inputs:       char*           message         The message - matches of mask patterns are overwritten.
+*
+* Outputs:      message
+*
+* Returns:      int                             FILTER_PASSED, FILTER_MASKED or FILTER_BLOCKED.
+*/
+int filterCheck(char* message)
+{
+    int verdict = FILTER_PASSED;
+    FilterAutomaton* automaton = acquireAutomaton();
+    if (automaton != NULL)
+    {
+        verdict = filterApply(automaton, message);
+        releaseAutomaton(automaton);
+    }
+
+    pthread_mutex_lock(&filterMutex);
+    filterStats.messagesFiltered++;
+    filterStats.messagesMasked += verdict == FILTER_MASKED;
+    filterStats.messagesBlocked += verdict == FILTER_BLOCKED;
+    pthread_mutex_unlock(&filterMutex);
+
+    return verdict;
+}
+
+
+/*
+* Function:     loadPatterns
+* Purpose:      Compiles the pattern file and swaps the result in for the current automaton. The old one
+*               is freed once the last worker using it lets go. A file that fails to compile changes nothing.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             FILTER_SUCCESS, or FILTER_ERROR if the old patterns were kept.
+*/
+static int loadPatterns()
+{
+    struct stat fileStat;
+    FilterAutomaton* automaton = NULL;
+    int isFileFound = stat(FILTER_PATTERN_FILE, &fileStat) == 0;
+
+    if (isFileFound)
+    {
+        automaton = filterCompile(FILTER_PATTERN_FILE);
+        if (automaton == NULL)
+        {
+            pthread_mutex_lock(&filterMutex);
+            filterStats.reloadsFailed++;
+            pthread_mutex_unlock(&filterMutex);
+
+            // Remember the broken file anyway, so it is not compiled again every second
+            loadedFileStat = fileStat;
+            isFileLoaded = 1;
+            return FILTER_ERROR;
+        }
+
+        // No patterns at all - messages skip the workers instead of matching nothing
+        if (automaton->numPatterns == 0)
+        {
+            filterFree(automaton);
+            automaton = NULL;
+        }
+    }
+
+    pthread_mutex_lock(&filterMutex);
+
+    FilterAutomaton* oldAutomaton = currentAutomaton;
+    __atomic_store_n(&currentAutomaton, automaton, __ATOMIC_RELEASE);
+    filterStats.numPatterns = automaton != NULL ? automaton->numPatterns : 0;
+    filterStats.numStates = automaton != NULL ? automaton->numStates : 0;
+    filterStats.reloads++;
+
+    pthread_mutex_unlock(&filterMutex);
+
+    releaseAutomaton(oldAutomaton);
+
+    if (isFileFound)
+    {
+        loadedFileStat = fileStat;
+    }
+    isFileLoaded = isFileFound;
+
+    #ifdef TESTING
+        printf("[FILTER] : loaded %d patterns (%d states)\n", automaton != NULL ? automaton->numPatterns : 0,
+            automaton != NULL ? automaton->numStates : 0);
+    #endif
+
+    return FILTER_SUCCESS;
+}
+
+
+/*
+* Function:     isPatternFileChanged
+* Purpose:      Checks whether the pattern file was created, edited, replaced or deleted since it was loaded.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if it changed, 0 if not.
+*/
+static int isPatternFileChanged()
+{
+    struct stat fileStat;
+    if (stat(FILTER_PATTERN_FILE, &fileStat) != 0)
+    {
+        return isFileLoaded;
+    }
+
+    return !isFileLoaded || fileStat.st_ino != loadedFileStat.st_ino || fileStat.st_size != loadedFileStat.st_size ||
+        fileStat.st_mtim.tv_sec != loadedFileStat.st_mtim.tv_sec || fileStat.st_mtim.tv_nsec != loadedFileStat.st_mtim.tv_nsec;
+}
+
+
+/*
+* Function:     filterReloader
+* Purpose:      Thread function that reloads the patterns when asked to, or when the pattern file changes.
+*
+* Inputs:       void*           arg             Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* filterReloader(void* arg)
+{
+    (void)arg;
+    int ticksSinceCheck = 0;
+
+    while (__atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        usleep(FILTER_LOOP_SLEEP_LENGTH);
+
+        if (++ticksSinceCheck >= FILTER_RELOAD_CHECK_INTERVAL / FILTER_LOOP_SLEEP_LENGTH)
+        {
+            ticksSinceCheck = 0;
+            if (isPatternFileChanged())
+            {
+                __atomic_store_n(&reloadRequested, 1, __ATOMIC_RELEASE);
+            }
+        }
+
+        if (__atomic_exchange_n(&reloadRequested, 0, __ATOMIC_ACQUIRE))
+        {
+            if (loadPatterns() != FILTER_SUCCESS)
+            {
+                fprintf(stderr, "[FILTER] : could not load %s - keeping the old patterns\n", FILTER_PATTERN_FILE);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+* Function:     filterWorkerThread
+* Purpose:      Thread function for a filter worker. Checks its queued messages in order and passes them
+*               to the next stage. A message keeps its queue slot until the next stage is done with it,
+*               so filterSubmit() can tell when the sender has nothing left in flight.
+*
+* Inputs:       void*           arg             The worker's FilterWorker.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* filterWorkerThread(void* arg)
+{
+    FilterWorker* worker = arg;
+
+    while (__atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&worker->mutex);
+        while (worker->numQueued == 0 && __atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+        {
+            pthread_cond_wait(&worker->notEmpty, &worker->mutex);
+        }
+        pthread_mutex_unlock(&worker->mutex);
+
+        if (!__atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+        {
+            break;
+        }
+
+        // Only this worker takes from its queue, so the job stays put without the lock
+        FilterJob* job = &worker->queue[worker->head];
+
+        int verdict = filterCheck(job->message.message);
+
+        filterNextStage(job->clientIP, &job->message, &job->mentions, verdict, filterStageArg);
+
+        pthread_mutex_lock(&worker->mutex);
+        worker->head = (worker->head + 1) % FILTER_QUEUE_LENGTH;
+        worker->numQueued--;
+        pthread_cond_signal(&worker->notFull);
+        pthread_mutex_unlock(&worker->mutex);
+    }
+
+    return NULL;
+}
+
+
+/*
+* Function:     filterSubmit
+* Purpose:      Queues a chat message for the filter workers. Waits while the sender's worker is full.
+*
+* Inputs:       const char*     clientIP        The sender's IP address.
+*               const ClientMessage* clientMessageP The message - copied, so it can be freed on return.
+*               const MentionList* mentionsP    Users the message mentions, passed on with it.
+*
+* Outputs:      None
+*
+* Returns:      int                             FILTER_QUEUED, or FILTER_NOT_QUEUED if the caller should pass
+*                                               the message on itself (no patterns, or the workers stopped).
+*/
+int filterSubmit(const char* clientIP, const ClientMessage* clientMessageP, const MentionList* mentionsP)
+{
+    if (!__atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        return FILTER_NOT_QUEUED;
+    }
+
+    // Same user, same worker - FNV-1a over IP and user ID
+    uint32_t hash = 2166136261u;
+    for (const char* c = clientIP; *c != '\0'; c++)
+    {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    for (const char* c = clientMessageP->clientUserID; *c != '\0'; c++)
+    {
+        hash = (hash ^ (unsigned char)*c) * 16777619u;
+    }
+    FilterWorker* worker = &filterWorkers[hash % numFilterWorkers];
+
+    pthread_mutex_lock(&worker->mutex);
+
+    // Nothing to check against - skip the hop, unless earlier messages from this worker are still in flight
+    if (__atomic_load_n(&currentAutomaton, __ATOMIC_ACQUIRE) == NULL && worker->numQueued == 0)
+    {
+        pthread_mutex_unlock(&worker->mutex);
+        return FILTER_NOT_QUEUED;
+    }
+
+    while (worker->numQueued == FILTER_QUEUE_LENGTH && __atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        if (coroutineIsSession())
+        {
+            pthread_mutex_unlock(&worker->mutex);
+            coroutineSleep(FILTER_FULL_RETRY_LENGTH);
+            pthread_mutex_lock(&worker->mutex);
+        }
+        else
+        {
+            pthread_cond_wait(&worker->notFull, &worker->mutex);
+        }
+    }
+
+    if (!__atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_unlock(&worker->mutex);
+        return FILTER_NOT_QUEUED;
+    }
+
+    FilterJob* job = &worker->queue[(worker->head + worker->numQueued) % FILTER_QUEUE_LENGTH];
+    strncpy(job->clientIP, clientIP, CLIENT_IP_LENGTH);
+    job->clientIP[CLIENT_IP_LENGTH] = '\0';
+    job->message = *clientMessageP;
+    job->mentions = *mentionsP;
+    worker->numQueued++;
+
+    pthread_cond_signal(&worker->notEmpty);
+    pthread_mutex_unlock(&worker->mutex);
+
+    return FILTER_QUEUED;
+}
+
+
+/*
+* Function:     filterRequestReload
+* Purpose:      Asks the reload thread to reload the pattern file. Safe to call from a signal handler.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void filterRequestReload()
+{
+    __atomic_store_n(&reloadRequested, 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     filterStart
+* Purpose:      Loads the pattern file (if there is one) and starts the filter workers and the reload thread.
+*
+* Inputs:       FilterNextStage nextStage       Called with every filtered message and its verdict.
+*               void*           stageArg        Passed to nextStage.
+*
+* Outputs:      None
+*
+* Returns:      int                             FILTER_SUCCESS, or FILTER_ERROR if the threads could not be
+*                                               started - messages then skip the filter.
+*/
+int filterStart(FilterNextStage nextStage, void* stageArg)
+{
+    filterNextStage = nextStage;
+    filterStageArg = stageArg;
+
+    if (loadPatterns() != FILTER_SUCCESS)
+    {
+        fprintf(stderr, "[FILTER] : could not load %s - no patterns until it is fixed\n", FILTER_PATTERN_FILE);
+    }
+
+    __atomic_store_n(&filterIsRunning, FILTER_RUNNING, __ATOMIC_RELEASE);
+
+    for (numFilterWorkers = 0; numFilterWorkers < FILTER_NUM_WORKERS; numFilterWorkers++)
+    {
+        FilterWorker* worker = &filterWorkers[numFilterWorkers];
+        worker->head = 0;
+        worker->numQueued = 0;
+        worker->queue = memAlloc(MEM_FILTER_PATTERNS, FILTER_QUEUE_LENGTH * sizeof(FilterJob));
+        if (worker->queue == NULL)
+        {
+            break;
+        }
+
+        pthread_mutex_init(&worker->mutex, NULL);
+        pthread_cond_init(&worker->notEmpty, NULL);
+        pthread_cond_init(&worker->notFull, NULL);
+
+        if (pthread_create(&worker->thread, NULL, filterWorkerThread, worker) != 0)
+        {
+            perror("pthread_create");
+            memFree(MEM_FILTER_PATTERNS, worker->queue);
+            break;
+        }
+    }
+
+    isReloaderStarted = numFilterWorkers == FILTER_NUM_WORKERS && pthread_create(&reloadThread, NULL, filterReloader, NULL) == 0;
+    if (!isReloaderStarted)
+    {
+        filterStop();
+        return FILTER_ERROR;
+    }
+
+    return FILTER_SUCCESS;
+}
+
+
+/*
+* Function:     filterStop
+* Purpose:      Stops the filter workers and the reload thread. Messages still queued are dropped -
+*               the server is shutting down, so there is nobody left to broadcast them to.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void filterStop()
+{
+    if (!__atomic_load_n(&filterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    // Wake every worker and every handler waiting for room
+    __atomic_store_n(&filterIsRunning, FILTER_STOPPED, __ATOMIC_RELEASE);
+    for (int i = 0; i < numFilterWorkers; i++)
+    {
+        pthread_mutex_lock(&filterWorkers[i].mutex);
+        pthread_cond_broadcast(&filterWorkers[i].notEmpty);
+        pthread_cond_broadcast(&filterWorkers[i].notFull);
+        pthread_mutex_unlock(&filterWorkers[i].mutex);
+    }
+
+    for (int i = 0; i < numFilterWorkers; i++)
+    {
+        pthread_join(filterWorkers[i].thread, NULL);
+    }
+    if (isReloaderStarted)
+    {
+        pthread_join(reloadThread, NULL);
+        isReloaderStarted = 0;
+    }
+
+    // Handlers woken above may still hold a worker's mutex for a moment, so the queues are kept
+    pthread_mutex_lock(&filterMutex);
+    FilterAutomaton* automaton = currentAutomaton;
+    currentAutomaton = NULL;
+    pthread_mutex_unlock(&filterMutex);
+
+    releaseAutomaton(automaton);
+}
+
+
+/*
+* Function:     filterGetStats
+* Purpose:      Gets the filter counters.
+*
+* Inputs:       FilterStats*    statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void filterGetStats(FilterStats* statsP)
+{
+    pthread_mutex_lock(&filterMutex);
+    *statsP = filterStats;
+    pthread_mutex_unlock(&filterMutex);
+}
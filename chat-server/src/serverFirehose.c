@@ -0,0 +1,665 @@
+/*
+* Filename:		serverFirehose.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the read-only firehose subscribers of the CHAT-SYSTEM server.
+*
+*               Analytics and archival tools connect to FIREHOSE_PORT instead of the chat port and send
+*               a ">>firehose<<" client message (">>firehose<< deflate" for a compressed stream). They
+*               are not chat clients: they are not in connectedClients[], do not count against
+*               MAX_CLIENTS and do not keep the server running.
+*
+*               The chat broadcaster only copies each broadcast into a ring of FIREHOSE_RING_SLOTS;
+*               everything else happens on the firehose thread, so subscribers never add to the
+*               fan-out latency of chat clients. Every FIREHOSE_BATCH_INTERVAL, each subscriber is sent
+*               the broadcasts it has not seen yet as one write of back-to-back JSON objects - the same
+*               framing chat clients get. A compressed subscriber gets a single deflate stream, flushed
+*               at the end of every batch, which inflates to that same sequence of JSON objects.
+*
+*               Delivery is relaxed: sockets are non-blocking, and a subscriber that has not taken its
+*               last batch yet is simply not sent another one. If it falls more than the ring behind,
+*               the oldest messages are skipped and it is told how many with ">>lagged<< <count>".
+*               Over the memory budget, subscribers still working through their last batch are cut off
+*               to free their output buffers (firehoseReclaim).
+*/
+
+#include "../inc/serverFirehose.h"
+
+static pthread_mutex_t firehoseMutex = PTHREAD_MUTEX_INITIALIZER;
+static Broadcast* firehoseRing = NULL;
+static uint64_t firehoseHead = 0;               // Number of broadcasts ever published
+static FirehoseStats firehoseStats;
+
+static pthread_mutex_t subscribersMutex = PTHREAD_MUTEX_INITIALIZER;  // Held by the firehose thread while it works on subscribers
+static FirehoseSubscriber subscribers[FIREHOSE_MAX_SUBSCRIBERS];
+static int numStreaming = 0;           // Publishing is skipped while nobody is listening
+static int firehoseSocket = -1;
+static pthread_t firehoseThread;
+static int firehoseIsRunning = FIREHOSE_STOPPED;
+
+
+/*
+* Function:     firehoseMicroseconds
+* Purpose:      Gets the monotonic clock in microseconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Microseconds since an arbitrary start point.
+*/
+static int64_t firehoseMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+/*
+* Function:     firehosePublish
+* Purpose:      Adds a broadcast to the firehose ring. Called by the chat broadcaster, so it only copies.
+*
+* Inputs:       const Broadcast*    broadcastP      The broadcast.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void firehosePublish(const Broadcast* broadcastP)
+{
+    if (__atomic_load_n(&numStreaming, __ATOMIC_RELAXED) == 0)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&firehoseMutex);
+    if (firehoseRing != NULL)
+    {
+        firehoseRing[firehoseHead % FIREHOSE_RING_SLOTS] = *broadcastP;
+        firehoseHead++;
+        firehoseStats.messagesPublished++;
+    }
+    pthread_mutex_unlock(&firehoseMutex);
+}
+
+
+/*
+* Function:     appendServerFrame
+* Purpose:      Serializes a server message (no IP or user ID) and appends it to a buffer.
+*
+* Inputs:       char*           buffer          The buffer.
+*               size_t*         lengthP         Bytes used in the buffer.
+*               size_t          capacity        Size of the buffer.
+*               const char*     message         The server message.
+*
+* Outputs:      buffer, lengthP
+*
+* Returns:      void
+*/
+static void appendServerFrame(char* buffer, size_t* lengthP, size_t capacity, const char* message)
+{
+    Broadcast frame = {.clientIP = "", .clientUserID = ""};
+    strncpy(frame.message, message, BROADCAST_MESSAGE_LENGTH);
+    frame.message[BROADCAST_MESSAGE_LENGTH] = '\0'; // Ensure null termination
+
+    char* json = broadcastToJson(&frame);
+    if (json == NULL)
+    {
+        return;
+    }
+
+    size_t jsonLength = strlen(json);
+    if (*lengthP + jsonLength <= capacity)
+    {
+        memcpy(buffer + *lengthP, json, jsonLength);
+        *lengthP += jsonLength;
+    }
+    free(json);
+}
+
+
+/*
+* Function:     closeSubscriber
+* Purpose:      Disconnects a subscriber and frees its slot.
+*
+* Inputs:       FirehoseSubscriber*     subscriberP     The subscriber.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void closeSubscriber(FirehoseSubscriber* subscriberP)
+{
+    if (subscriberP->state == FIREHOSE_SLOT_STREAMING)
+    {
+        __atomic_sub_fetch(&numStreaming, 1, __ATOMIC_RELEASE);
+
+        #ifdef FIREHOSE_ZLIB
+            if (subscriberP->isCompressed)
+            {
+                deflateEnd(&subscriberP->deflater);
+            }
+        #endif
+
+        pthread_mutex_lock(&firehoseMutex);
+        firehoseStats.numSubscribers--;
+        pthread_mutex_unlock(&firehoseMutex);
+    }
+
+    if (subscriberP->output != NULL)
+    {
+        memFree(MEM_OUTBOUND_BUFFERS, subscriberP->output);
+    }
+
+    close(subscriberP->socket);
+    memset(subscriberP, 0, sizeof(FirehoseSubscriber));
+    subscriberP->state = FIREHOSE_SLOT_FREE;
+}
+
+
+/*
+* Function:     acceptSubscribers
+* Purpose:      Accepts every pending connection on the firehose socket. Connections beyond
+*               FIREHOSE_MAX_SUBSCRIBERS are closed straight away.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void acceptSubscribers()
+{
+    int subscriberSocket;
+
+    while ((subscriberSocket = accept(firehoseSocket, NULL, NULL)) >= 0)
+    {
+        FirehoseSubscriber* subscriberP = NULL;
+        for (int i = 0; i < FIREHOSE_MAX_SUBSCRIBERS && subscriberP == NULL; i++)
+        {
+            if (subscribers[i].state == FIREHOSE_SLOT_FREE)
+            {
+                subscriberP = &subscribers[i];
+            }
+        }
+
+        if (subscriberP == NULL)
+        {
+            close(subscriberSocket);
+            continue;
+        }
+
+        fcntl(subscriberSocket, F_SETFL, fcntl(subscriberSocket, F_GETFL, 0) | O_NONBLOCK);
+
+        memset(subscriberP, 0, sizeof(FirehoseSubscriber));
+        subscriberP->state = FIREHOSE_SLOT_HANDSHAKE;
+        subscriberP->socket = subscriberSocket;
+        subscriberP->connectedAt = firehoseMicroseconds();
+    }
+}
+
+
+/*
+* Function:     startStreaming
+* Purpose:      Handles a complete subscription request: replies, and starts the subscriber at the
+*               newest broadcast.
+*
+* Inputs:       FirehoseSubscriber*     subscriberP     The subscriber.
+*
+* Outputs:      None
+*
+* Returns:      int                                     FIREHOSE_SUCCESS, or FIREHOSE_ERROR if the request was not valid.
+*/
+static int startStreaming(FirehoseSubscriber* subscriberP)
+{
+    char reply[JSON_LENGTH];
+    size_t replyLength = 0;
+
+    ClientMessage* request = jsonToClientMessage(subscriberP->request);
+    if (request == NULL || strncmp(request->message, FIREHOSE_SUBSCRIBE_MSG, strlen(FIREHOSE_SUBSCRIBE_MSG)) != 0)
+    {
+        appendServerFrame(reply, &replyLength, sizeof(reply), FIREHOSE_FAIL_MSG);
+        send(subscriberP->socket, reply, replyLength, MSG_NOSIGNAL);
+        free(request);
+        return FIREHOSE_ERROR;
+    }
+
+    int wantsDeflate = strstr(request->message + strlen(FIREHOSE_SUBSCRIBE_MSG), FIREHOSE_DEFLATE_OPTION) != NULL;
+    free(request);
+
+    subscriberP->output = memAlloc(MEM_OUTBOUND_BUFFERS, FIREHOSE_OUTPUT_LENGTH);
+    if (subscriberP->output == NULL)
+    {
+        // Over the memory budget - refuse rather than stream
+        appendServerFrame(reply, &replyLength, sizeof(reply), FIREHOSE_FAIL_MSG);
+        send(subscriberP->socket, reply, replyLength, MSG_NOSIGNAL);
+        return FIREHOSE_ERROR;
+    }
+
+    #ifdef FIREHOSE_ZLIB
+        if (wantsDeflate && deflateInit(&subscriberP->deflater, FIREHOSE_DEFLATE_LEVEL) == Z_OK)
+        {
+            subscriberP->isCompressed = 1;
+        }
+    #else
+        (void)wantsDeflate; // Built without zlib - everyone gets the plain stream
+    #endif
+
+    // The reply itself is never compressed, so the subscriber knows what follows
+    char replyMessage[BROADCAST_MESSAGE_LENGTH + 1];
+    snprintf(replyMessage, sizeof(replyMessage), "%s%s", FIREHOSE_SUCCESS_MSG, subscriberP->isCompressed ? " " FIREHOSE_DEFLATE_OPTION : "");
+    appendServerFrame(reply, &replyLength, sizeof(reply), replyMessage);
+    send(subscriberP->socket, reply, replyLength, MSG_NOSIGNAL);
+
+    pthread_mutex_lock(&firehoseMutex);
+    subscriberP->nextSequence = firehoseHead;
+    firehoseStats.numSubscribers++;
+    pthread_mutex_unlock(&firehoseMutex);
+
+    subscriberP->state = FIREHOSE_SLOT_STREAMING;
+    __atomic_add_fetch(&numStreaming, 1, __ATOMIC_RELEASE);
+
+    return FIREHOSE_SUCCESS;
+}
+
+
+/*
+* Function:     readRequest
+* Purpose:      Reads whatever part of the subscription request has arrived, and starts streaming
+*               once it is complete. Subscribers that take too long are dropped.
+*
+* Inputs:       FirehoseSubscriber*     subscriberP     The subscriber.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void readRequest(FirehoseSubscriber* subscriberP)
+{
+    int roomLeft = JSON_LENGTH - 1 - subscriberP->requestLength;
+    ssize_t numBytesRead = recv(subscriberP->socket, subscriberP->request + subscriberP->requestLength, roomLeft, 0);
+
+    if (numBytesRead == 0 || (numBytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+        closeSubscriber(subscriberP);
+        return;
+    }
+
+    if (numBytesRead > 0)
+    {
+        subscriberP->requestLength += numBytesRead;
+        subscriberP->request[subscriberP->requestLength] = '\0';
+    }
+
+    if (jsonObjectLength(subscriberP->request, subscriberP->requestLength) > 0)
+    {
+        if (startStreaming(subscriberP) != FIREHOSE_SUCCESS)
+        {
+            closeSubscriber(subscriberP);
+        }
+    }
+    else if (subscriberP->requestLength == JSON_LENGTH - 1 ||
+        firehoseMicroseconds() - subscriberP->connectedAt > FIREHOSE_HANDSHAKE_TIMEOUT)
+    {
+        closeSubscriber(subscriberP);
+    }
+}
+
+
+/*
+* Function:     buildBatch
+* Purpose:      Builds the next batch for a subscriber from the broadcasts it has not seen yet,
+*               skipping ahead (with a ">>lagged<<" notice) if the ring has already overwritten some.
+*
+* Inputs:       FirehoseSubscriber*     subscriberP     The subscriber.
+*               char*                   batch           Where to build the batch (FIREHOSE_BATCH_LENGTH bytes).
+*
+* Outputs:      batch
+*
+* Returns:      size_t                                  Length of the batch, 0 if there is nothing new.
+*/
+static size_t buildBatch(FirehoseSubscriber* subscriberP, char* batch)
+{
+    static Broadcast broadcasts[FIREHOSE_BATCH_MAX_MESSAGES];
+    uint64_t numDropped = 0;
+
+    pthread_mutex_lock(&firehoseMutex);
+
+    if (firehoseHead - subscriberP->nextSequence > FIREHOSE_RING_SLOTS)
+    {
+        numDropped = firehoseHead - FIREHOSE_RING_SLOTS - subscriberP->nextSequence;
+        subscriberP->nextSequence = firehoseHead - FIREHOSE_RING_SLOTS;
+        firehoseStats.messagesDropped += numDropped;
+    }
+
+    int numBroadcasts = 0;
+    while (subscriberP->nextSequence < firehoseHead && numBroadcasts < FIREHOSE_BATCH_MAX_MESSAGES)
+    {
+        broadcasts[numBroadcasts++] = firehoseRing[subscriberP->nextSequence % FIREHOSE_RING_SLOTS];
+        subscriberP->nextSequence++;
+    }
+
+    pthread_mutex_unlock(&firehoseMutex);
+
+    // Serialize outside the lock
+    size_t batchLength = 0;
+
+    if (numDropped > 0)
+    {
+        char notice[BROADCAST_MESSAGE_LENGTH + 1];
+        snprintf(notice, sizeof(notice), "%s %llu", FIREHOSE_LAGGED_MSG, (unsigned long long)numDropped);
+        appendServerFrame(batch, &batchLength, FIREHOSE_BATCH_LENGTH, notice);
+    }
+
+    for (int i = 0; i < numBroadcasts; i++)
+    {
+        char* json = broadcastToJson(&broadcasts[i]);
+        if (json != NULL)
+        {
+            size_t jsonLength = strlen(json);
+            memcpy(batch + batchLength, json, jsonLength);
+            batchLength += jsonLength;
+            free(json);
+        }
+    }
+
+    pthread_mutex_lock(&firehoseMutex);
+    firehoseStats.messagesSent += numBroadcasts;
+    firehoseStats.bytesBeforeCompression += batchLength;
+    pthread_mutex_unlock(&firehoseMutex);
+
+    return batchLength;
+}
+
+
+/*
+* Function:     flushSubscriber
+* Purpose:      Sends a subscriber the rest of its last batch, or its next batch if the last one is
+*               out. Never blocks.
+*
+* Inputs:       FirehoseSubscriber*     subscriberP     The subscriber.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void flushSubscriber(FirehoseSubscriber* subscriberP)
+{
+    static char batch[FIREHOSE_BATCH_LENGTH];
+
+    if (subscriberP->outputSent == subscriberP->outputLength)
+    {
+        size_t batchLength = buildBatch(subscriberP, batch);
+        if (batchLength == 0)
+        {
+            return;
+        }
+
+        subscriberP->outputSent = 0;
+
+        #ifdef FIREHOSE_ZLIB
+            if (subscriberP->isCompressed)
+            {
+                z_stream* deflaterP = &subscriberP->deflater;
+                deflaterP->next_in = (Bytef*)batch;
+                deflaterP->avail_in = (uInt)batchLength;
+                deflaterP->next_out = (Bytef*)subscriberP->output;
+                deflaterP->avail_out = FIREHOSE_OUTPUT_LENGTH;
+
+                // Sync flush - the subscriber can inflate everything sent so far
+                deflate(deflaterP, Z_SYNC_FLUSH);
+                subscriberP->outputLength = FIREHOSE_OUTPUT_LENGTH - deflaterP->avail_out;
+            }
+            else
+        #endif
+            {
+                memcpy(subscriberP->output, batch, batchLength);
+                subscriberP->outputLength = batchLength;
+            }
+    }
+
+    ssize_t numBytesSent = send(subscriberP->socket, subscriberP->output + subscriberP->outputSent,
+        subscriberP->outputLength - subscriberP->outputSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+    if (numBytesSent < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+        {
+            closeSubscriber(subscriberP);
+        }
+        return;
+    }
+
+    subscriberP->outputSent += numBytesSent;
+
+    pthread_mutex_lock(&firehoseMutex);
+    firehoseStats.bytesSent += numBytesSent;
+    firehoseStats.batchesSent += subscriberP->outputSent == subscriberP->outputLength;
+    pthread_mutex_unlock(&firehoseMutex);
+}
+
+
+/*
+* Function:     isSubscriberGone
+* Purpose:      Checks whether a streaming subscriber has closed its end. Subscribers never send
+*               anything after the request, so any readable data is discarded.
+*
+* Inputs:       FirehoseSubscriber*     subscriberP     The subscriber.
+*
+* Outputs:      None
+*
+* Returns:      int                                     1 if the subscriber has disconnected, 0 otherwise.
+*/
+static int isSubscriberGone(FirehoseSubscriber* subscriberP)
+{
+    char discard[JSON_LENGTH];
+    ssize_t numBytesRead = recv(subscriberP->socket, discard, sizeof(discard), MSG_DONTWAIT);
+
+    return numBytesRead == 0 || (numBytesRead < 0 && errno != EAGAIN && errno != EWOULDBLOCK);
+}
+
+
+/*
+* Function:     firehoseReclaim
+* Purpose:      Memory reclaimer for MEM_OUTBOUND_BUFFERS - disconnects subscribers that have not taken
+*               all of their last batch yet, freeing their output buffers. Subscribers keeping up are left alone.
+*               Gives up straight away if the firehose thread is busy with the subscribers, as it is
+*               while it allocates an output buffer itself.
+*
+* Inputs:       size_t      bytesWanted     Number of bytes the memory accountant would like freed.
+*
+* Outputs:      None
+*
+* Returns:      size_t                      Number of bytes freed.
+*/
+static size_t firehoseReclaim(size_t bytesWanted)
+{
+    size_t bytesFreed = 0;
+
+    if (pthread_mutex_trylock(&subscribersMutex) != 0)
+    {
+        return 0;
+    }
+
+    for (int i = 0; i < FIREHOSE_MAX_SUBSCRIBERS && bytesFreed < bytesWanted; i++)
+    {
+        FirehoseSubscriber* subscriberP = &subscribers[i];
+        if (subscriberP->state == FIREHOSE_SLOT_STREAMING && subscriberP->outputSent < subscriberP->outputLength)
+        {
+            closeSubscriber(subscriberP);
+            bytesFreed += FIREHOSE_OUTPUT_LENGTH;
+        }
+    }
+
+    pthread_mutex_unlock(&subscribersMutex);
+
+    return bytesFreed;
+}
+
+
+/*
+* Function:     firehoseStreamer
+* Purpose:      Firehose thread - accepts subscribers, reads their requests and sends every
+*               streaming subscriber a batch each FIREHOSE_BATCH_INTERVAL.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* firehoseStreamer(void* arg)
+{
+    (void)arg;
+
+    int ticksPerBatch = FIREHOSE_BATCH_INTERVAL / FIREHOSE_LOOP_SLEEP_LENGTH;
+    int ticks = 0;
+
+    while (__atomic_load_n(&firehoseIsRunning, __ATOMIC_ACQUIRE))
+    {
+        pthread_mutex_lock(&subscribersMutex);
+
+        acceptSubscribers();
+
+        for (int i = 0; i < FIREHOSE_MAX_SUBSCRIBERS; i++)
+        {
+            if (subscribers[i].state == FIREHOSE_SLOT_HANDSHAKE)
+            {
+                readRequest(&subscribers[i]);
+            }
+        }
+
+        if (ticks >= ticksPerBatch)
+        {
+            ticks = 0;
+
+            for (int i = 0; i < FIREHOSE_MAX_SUBSCRIBERS; i++)
+            {
+                if (subscribers[i].state != FIREHOSE_SLOT_STREAMING)
+                {
+                    continue;
+                }
+
+                if (isSubscriberGone(&subscribers[i]))
+                {
+                    closeSubscriber(&subscribers[i]);
+                }
+                else
+                {
+                    flushSubscriber(&subscribers[i]);
+                }
+            }
+        }
+
+        pthread_mutex_unlock(&subscribersMutex);
+
+        usleep(FIREHOSE_LOOP_SLEEP_LENGTH);
+        ticks++;
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     firehoseStart
+* Purpose:      Opens the firehose port and starts the firehose thread.
+*
+* Inputs:       uint16_t        firehosePort    Port subscribers connect to.
+*
+* Outputs:      None
+*
+* Returns:      int                             FIREHOSE_SUCCESS, or FIREHOSE_ERROR if the firehose is unavailable.
+*/
+int firehoseStart(uint16_t firehosePort)
+{
+    firehoseRing = memAllocHuge(MEM_OUTBOUND_BUFFERS, FIREHOSE_RING_SLOTS * sizeof(Broadcast));
+    if (firehoseRing == NULL)
+    {
+        return FIREHOSE_ERROR;
+    }
+
+    if ((firehoseSocket = setupServerSocket(firehosePort)) == SOCKET_ERROR)
+    {
+        memFreeHuge(MEM_OUTBOUND_BUFFERS, firehoseRing, FIREHOSE_RING_SLOTS * sizeof(Broadcast));
+        firehoseRing = NULL;
+        return FIREHOSE_ERROR;
+    }
+    fcntl(firehoseSocket, F_SETFL, fcntl(firehoseSocket, F_GETFL, 0) | O_NONBLOCK);
+
+    __atomic_store_n(&firehoseIsRunning, FIREHOSE_RUNNING, __ATOMIC_RELEASE);
+
+    memRegisterReclaimer(MEM_OUTBOUND_BUFFERS, firehoseReclaim);
+
+    if (pthread_create(&firehoseThread, NULL, firehoseStreamer, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&firehoseIsRunning, FIREHOSE_STOPPED, __ATOMIC_RELEASE);
+        memRegisterReclaimer(MEM_OUTBOUND_BUFFERS, NULL);
+        closeServerSocket(firehoseSocket);
+        memFreeHuge(MEM_OUTBOUND_BUFFERS, firehoseRing, FIREHOSE_RING_SLOTS * sizeof(Broadcast));
+        firehoseRing = NULL;
+        return FIREHOSE_ERROR;
+    }
+
+    return FIREHOSE_SUCCESS;
+}
+
+
+/*
+* Function:     firehoseStop
+* Purpose:      Stops the firehose thread and disconnects all subscribers.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void firehoseStop()
+{
+    if (!__atomic_load_n(&firehoseIsRunning, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    __atomic_store_n(&firehoseIsRunning, FIREHOSE_STOPPED, __ATOMIC_RELEASE);
+    pthread_join(firehoseThread, NULL);
+
+    memRegisterReclaimer(MEM_OUTBOUND_BUFFERS, NULL);
+
+    for (int i = 0; i < FIREHOSE_MAX_SUBSCRIBERS; i++)
+    {
+        if (subscribers[i].state != FIREHOSE_SLOT_FREE)
+        {
+            closeSubscriber(&subscribers[i]);
+        }
+    }
+
+    closeServerSocket(firehoseSocket);
+
+    pthread_mutex_lock(&firehoseMutex);
+    memFreeHuge(MEM_OUTBOUND_BUFFERS, firehoseRing, FIREHOSE_RING_SLOTS * sizeof(Broadcast));
+    firehoseRing = NULL;
+    pthread_mutex_unlock(&firehoseMutex);
+}
+
+
+/*
+* Function:     firehoseGetStats
+* Purpose:      Gets the firehose counters.
+*
+* Inputs:       FirehoseStats*  statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void firehoseGetStats(FirehoseStats* statsP)
+{
+    pthread_mutex_lock(&firehoseMutex);
+    *statsP = firehoseStats;
+    pthread_mutex_unlock(&firehoseMutex);
+}
@@ -7,6 +7,7 @@
 */
 
 #include "../inc/serverIPC.h"
+#include "../inc/serverMemory.h"
 
 /*
 * Function:     setupServerSocket
@@ -30,6 +31,13 @@ int setupServerSocket(uint16_t serverPort)
         return SOCKET_ERROR;
     }
 
+    // Allow rebinding right after a restart, while old connections are still in TIME_WAIT
+    int reuseAddress = 1;
+    if (setsockopt(serverSocket, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress)) < 0)
+    {
+        perror("[SERVER] : setsockopt() FAILED");
+    }
+
     // Initialize server address
     memset(&serverAddress, 0, sizeof(serverAddress));
     serverAddress.sin_family = AF_INET;
@@ -159,8 +167,17 @@ int setupSharedMemory(int msgQID, int serverSocket)
     // Check if shared memory already exists
     if ((sharedMemID = shmget(shmKey, sizeof(SharedData), 0)) == -1)
     {
-        // Shared memory doesn't exist! Create shared memory block
-        if ((sharedMemID = shmget(shmKey, sizeof(SharedData), IPC_CREAT | 0666)) == -1) 
+        // Shared memory doesn't exist! Create shared memory block - on huge pages, however small the
+        // registry is, when the system has them reserved: every fan-out walks it
+        #ifdef CHAT_HUGE_PAGES
+        size_t hugeSize = (sizeof(SharedData) + MEMORY_HUGE_PAGE_LENGTH - 1) & ~(MEMORY_HUGE_PAGE_LENGTH - 1);
+        if ((sharedMemID = shmget(shmKey, hugeSize, IPC_CREAT | SHM_HUGETLB | 0666)) == -1)
+        {
+            fprintf(stderr, "[IPC] : No huge pages for shared memory (%s) - using normal pages\n", strerror(errno));
+        }
+        #endif
+
+        if (sharedMemID == -1 && (sharedMemID = shmget(shmKey, sizeof(SharedData), IPC_CREAT | 0666)) == -1)
         {
             return SHARED_MEM_ERROR;
         }
@@ -183,26 +200,55 @@ int setupSharedMemory(int msgQID, int serverSocket)
 * Returns:      int                     0 if successful, otherwise an error code.
 */
 int initSharedMemory(int sharedMemID, int msgQID, int serverSocket)
+{
+    return initSharedData(getSharedData(sharedMemID), msgQID, serverSocket);
+}
+
+
+/*
+* Function:     initSharedData
+* Purpose:      Initializes the shared data - wherever it is held. The server keeps it in shared memory,
+*               in-process benchmarks on the heap.
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to the shared data to be initialized.
+*               int             msgQID          Message queue ID broadcasts are queued on.
+*               int             serverSocket    Server socket file descriptor, or -1 if there is none.
+*
+* Outputs:      None
+*
+* Returns:      int                             0 if successful, otherwise an error code.
+*/
+int initSharedData(SharedData* sharedDataP, int msgQID, int serverSocket)
 {
     int retVal = SUCCESS;
     
     // Initialize shared data
-    SharedData* sharedDataP = getSharedData(sharedMemID);
     sharedDataP->msgQueueID = msgQID;
     sharedDataP->numClients = 0;
     sharedDataP->serverSocket = serverSocket;
     sharedDataP->serverIsRunning = 1;
 
-    for (int i = 0; i < MAX_CLIENTS; i++)
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
     {
-        sharedDataP->connectedClients[i].clientIP[0] = 0;
-        sharedDataP->connectedClients[i].clientUserID[0] = 0;
-        sharedDataP->connectedClients[i].threadID = 0;
-        sharedDataP->connectedClients[i].clientSocket = 0;
+        RegistryShard* shardP = &sharedDataP->shards[shard];
+        shardP->numClients = 0;
+
+        for (int i = 0; i < REGISTRY_SHARD_CAPACITY; i++)
+        {
+            shardP->connectedClients[i].clientIP[0] = 0;
+            shardP->connectedClients[i].clientUserID[0] = 0;
+            shardP->connectedClients[i].threadID = 0;
+            shardP->connectedClients[i].clientSocket = 0;
+        }
+
+        if (pthread_mutex_init(&shardP->mutex, NULL) != 0) {
+            perror("pthread_mutex_init");
+            retVal = SHARED_MEM_ERROR;
+        }
     }
 
     // Initialize mutex
-    if (pthread_mutex_init(&sharedDataP->mutex, NULL) != 0) {
+    if (pthread_mutex_init(&sharedDataP->deliveryMutex, NULL) != 0) {
         perror("pthread_mutex_init");
         retVal = SHARED_MEM_ERROR;
     }
@@ -227,8 +273,12 @@ int closeSharedMemory(int sharedMemID)
 
     SharedData* sharedDataP = getSharedData(sharedMemID);
 
-    // Clean up mutex first
-    pthread_mutex_destroy(&sharedDataP->mutex);
+    // Clean up mutexes first
+    pthread_mutex_destroy(&sharedDataP->deliveryMutex);
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+    {
+        pthread_mutex_destroy(&sharedDataP->shards[shard].mutex);
+    }
 
     // Detach and remove shared memory segment
     if (shmdt(sharedDataP) == -1) {
@@ -264,30 +314,149 @@ SharedData* getSharedData(int sharedMemID)
 }
 
 
+/*
+* Function:     sharedDataIsRunning
+* Purpose:      Checks whether the server is still supposed to be running, without taking any lock.
+*               Pairs with sharedDataStop(): a thread that sees the server socket fail after it was
+*               closed is guaranteed to see the server stopped.
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to shared data
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if the server is running, 0 once it has been stopped.
+*/
+int sharedDataIsRunning(SharedData* sharedDataP)
+{
+    return __atomic_load_n(&sharedDataP->serverIsRunning, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+* Function:     sharedDataStop
+* Purpose:      Marks the server stopped, then closes the server socket to wake up accept().
+*               The flag is published first, so the accepting thread never mistakes the close for an error.
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to shared data
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sharedDataStop(SharedData* sharedDataP)
+{
+    __atomic_store_n(&sharedDataP->serverIsRunning, 0, __ATOMIC_RELEASE);
+    closeServerSocket(sharedDataP->serverSocket);
+}
+
+
+/*
+* Function:     registryGetShard
+* Purpose:      Finds the registry shard a user ID belongs to. The user ID is hashed (FNV-1a),
+*               so every session of the same user lands in the same shard and a lookup by user ID
+*               only has to lock that one shard.
+*
+* Inputs:       const char*         clientUserID        The user ID of the client.
+*               SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      RegistryShard*                          The shard the user ID belongs to.
+*/
+RegistryShard* registryGetShard(const char* clientUserID, SharedData* sharedDataP)
+{
+    uint32_t hash = 2166136261u;
+
+    for (int i = 0; i < CLIENT_USERID_LENGTH && clientUserID[i] != '\0'; i++)
+    {
+        hash ^= (unsigned char)clientUserID[i];
+        hash *= 16777619u;
+    }
+
+    return &sharedDataP->shards[hash % REGISTRY_NUM_SHARDS];
+}
+
+
+/*
+* Function:     registryLockAll
+* Purpose:      Locks every registry shard, for the few operations that need a consistent view of
+*               all clients (e.g. the presence roster). Shards are always locked in ascending order,
+*               so this never deadlocks against another thread doing the same.
+*
+* Inputs:       SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void registryLockAll(SharedData* sharedDataP)
+{
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+    {
+        pthread_mutex_lock(&sharedDataP->shards[shard].mutex);
+    }
+}
+
+
+/*
+* Function:     registryUnlockAll
+* Purpose:      Unlocks every registry shard locked by registryLockAll().
+*
+* Inputs:       SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void registryUnlockAll(SharedData* sharedDataP)
+{
+    for (int shard = REGISTRY_NUM_SHARDS - 1; shard >= 0; shard--)
+    {
+        pthread_mutex_unlock(&sharedDataP->shards[shard].mutex);
+    }
+}
+
+
+/*
+* Function:     registryGetNumClients
+* Purpose:      Gets the number of connected clients across all shards, without taking any lock.
+*
+* Inputs:       SharedData*         sharedDataP         Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                                     The number of connected clients.
+*/
+int registryGetNumClients(SharedData* sharedDataP)
+{
+    return __atomic_load_n(&sharedDataP->numClients, __ATOMIC_ACQUIRE);
+}
+
+
 /*
 * Function:     findThreadIDInList
-* Purpose:      Searches for a client thread ID in the connected clients list.
-*               NOTE: Make sure to lock and unlock mutex before and after calling this function!
+* Purpose:      Searches for a client thread ID in a shard's connected clients list.
+*               NOTE: Make sure to lock and unlock shardP->mutex before and after calling this function!
 *
 * Inputs:       pthread_t           threadID            The thread ID of the client to find.
-*               SharedData*         sharedDataP         Pointer to the shared data structure containing the list of connected clients.
+*               RegistryShard*      shardP              Pointer to the shard the client's user ID belongs to.
 *
 * Outputs:      None
 *
-* Returns:      int                                     The index of the client in the list if found, or ENTRY_NOT_FOUND_OR_NULL if not found or sharedDataP is NULL.
+* Returns:      int                                     The index of the client in the shard if found, or ENTRY_NOT_FOUND_OR_NULL if not found or shardP is NULL.
 */
-int findThreadIDInList(pthread_t threadID, SharedData* sharedDataP)
+int findThreadIDInList(pthread_t threadID, RegistryShard* shardP)
 {
     // Check for null pointers
-    if (sharedDataP == NULL) {
+    if (shardP == NULL) {
         return ENTRY_NOT_FOUND_OR_NULL;
     }
 
     int foundIndex = ENTRY_NOT_FOUND_OR_NULL;
 
-    for (int i = 0; i < sharedDataP->numClients; i++)
+    for (int i = 0; i < shardP->numClients; i++)
     {
-        if (sharedDataP->connectedClients[i].threadID == threadID)
+        if (shardP->connectedClients[i].threadID == threadID)
         {
             // Match found
             foundIndex = i;
@@ -301,30 +470,30 @@ int findThreadIDInList(pthread_t threadID, SharedData* sharedDataP)
 
 /*
 * Function:     findUserInList
-* Purpose:      Finds the index of a given client in the client list. 
-*               NOTE: Make sure to lock and unlock mutex before and after calling this function!
+* Purpose:      Finds the index of a given client in a shard's client list. 
+*               NOTE: Make sure to lock and unlock shardP->mutex before and after calling this function!
 *
 * Inputs:       const char*     clientIP        Client IP C-string
 *               const char*     clientUserID    Client user ID C-string
-*               SharedData*     sharedDataP     Pointer to shared data
+*               RegistryShard*  shardP          Pointer to the shard the user ID belongs to
 *
 * Outputs:      None
 *
-* Returns:      int                         Index of the client in the client list if found, otherwise PID_NOT_FOUND.
+* Returns:      int                             Index of the client in the shard if found, otherwise ENTRY_NOT_FOUND_OR_NULL.
 */
-int findUserInList(const char* clientIP, const char* clientUserID, SharedData* sharedDataP)
+int findUserInList(const char* clientIP, const char* clientUserID, RegistryShard* shardP)
 {
     // Check for null pointers
-    if (clientIP == NULL || clientUserID == NULL || sharedDataP == NULL) {
+    if (clientIP == NULL || clientUserID == NULL || shardP == NULL) {
         return ENTRY_NOT_FOUND_OR_NULL;
     }
 
     int foundIndex = ENTRY_NOT_FOUND_OR_NULL;
 
-    for (int i = 0; i < sharedDataP->numClients; i++)
+    for (int i = 0; i < shardP->numClients; i++)
     {
-        if (strncmp(sharedDataP->connectedClients[i].clientIP, clientIP, CLIENT_IP_LENGTH) == 0 &&
-            strncmp(sharedDataP->connectedClients[i].clientUserID, clientUserID, CLIENT_USERID_LENGTH) == 0)
+        if (strncmp(shardP->connectedClients[i].clientIP, clientIP, CLIENT_IP_LENGTH) == 0 &&
+            strncmp(shardP->connectedClients[i].clientUserID, clientUserID, CLIENT_USERID_LENGTH) == 0)
         {
             // Match found
             foundIndex = i;
@@ -338,8 +507,9 @@ int findUserInList(const char* clientIP, const char* clientUserID, SharedData* s
 
 /*
 * Function:     addToList
-* Purpose:      Adds a new client to the list of connected clients in the shared data structure.
-*               NOTE: Make sure to lock and unlock mutex before and after calling this function!
+* Purpose:      Adds a new client to the shard its user ID belongs to. A place is reserved in the
+*               global client count first, so MAX_CLIENTS holds across all shards.
+*               NOTE: Make sure to lock and unlock the user ID's shard mutex before and after calling this function!
 * Inputs:       pthread_t           threadID            The thread ID of the client to add.
 *               const char*         clientIP            The IP address of the client.
 *               const char*         clientUserID        The user ID of the client.
@@ -349,7 +519,8 @@ int findUserInList(const char* clientIP, const char* clientUserID, SharedData* s
 * Outputs:      None
 *
 * Returns:      int                                     SUCCESS if the client is added successfully,
-*                                                       TOO_MANY_CLIENTS if the maximum number of clients is reached,
+*                                                       TOO_MANY_CLIENTS if the maximum number of clients is reached
+*                                                       or the user ID's shard is full,
 *                                                       ENTRY_NOT_FOUND_OR_NULL if clientIP, clientUserID, or sharedDataP is NULL.
 */
 int addToList(pthread_t threadID, const char* clientIP, const char* clientUserID, int clientSocket, SharedData* sharedDataP)
@@ -359,76 +530,92 @@ int addToList(pthread_t threadID, const char* clientIP, const char* clientUserID
         return ENTRY_NOT_FOUND_OR_NULL;
     }
 
-    int retVal = SUCCESS;
-    
-    int currentIndex = sharedDataP->numClients;
+    // Reserve a place among all clients - give it back if the server is full
+    if (__atomic_add_fetch(&sharedDataP->numClients, 1, __ATOMIC_ACQ_REL) > MAX_CLIENTS)
+    {
+        __atomic_sub_fetch(&sharedDataP->numClients, 1, __ATOMIC_ACQ_REL);
+        return TOO_MANY_CLIENTS;
+    }
 
-    if (currentIndex < MAX_CLIENTS)
+    // The shard may be full even when the server is not, if its hash share ran well over
+    RegistryShard* shardP = registryGetShard(clientUserID, sharedDataP);
+    if (shardP->numClients >= REGISTRY_SHARD_CAPACITY)
     {
-        // Copy IP
-        strncpy(sharedDataP->connectedClients[currentIndex].clientIP, clientIP, sizeof(sharedDataP->connectedClients[currentIndex].clientIP) - 1);
-        sharedDataP->connectedClients[currentIndex].clientIP[sizeof(sharedDataP->connectedClients[currentIndex].clientIP) - 1] = '\0'; // Ensure null-termination
+        __atomic_sub_fetch(&sharedDataP->numClients, 1, __ATOMIC_ACQ_REL);
+        fprintf(stderr, "[IPC] : registry shard for user '%s' is full (%d clients) - turning the client away\n", clientUserID, REGISTRY_SHARD_CAPACITY);
+        return TOO_MANY_CLIENTS;
+    }
 
-        // Copy user ID
-        strncpy(sharedDataP->connectedClients[currentIndex].clientUserID, clientUserID, sizeof(sharedDataP->connectedClients[currentIndex].clientUserID) - 1);
-        sharedDataP->connectedClients[currentIndex].clientUserID[sizeof(sharedDataP->connectedClients[currentIndex].clientUserID) - 1] = '\0'; // Ensure null-termination
-        
-        // Copy socket
-        sharedDataP->connectedClients[currentIndex].clientSocket = clientSocket;
+    ClientState* clientP = &shardP->connectedClients[shardP->numClients];
 
-        // Copy thread ID
-        sharedDataP->connectedClients[currentIndex].threadID = threadID;
+    // Copy IP
+    strncpy(clientP->clientIP, clientIP, sizeof(clientP->clientIP) - 1);
+    clientP->clientIP[sizeof(clientP->clientIP) - 1] = '\0'; // Ensure null-termination
 
-        // Update number of DCs
-        sharedDataP->numClients++;
+    // Copy user ID
+    strncpy(clientP->clientUserID, clientUserID, sizeof(clientP->clientUserID) - 1);
+    clientP->clientUserID[sizeof(clientP->clientUserID) - 1] = '\0'; // Ensure null-termination
 
-    }
-    else
-    {
-        retVal = TOO_MANY_CLIENTS;
-    }
+    // Copy socket
+    clientP->clientSocket = clientSocket;
+    clientP->delivery = DELIVERY_TCP;
 
-    return retVal;
+    // Copy thread ID
+    clientP->threadID = threadID;
+
+    // Update number of clients in the shard
+    shardP->numClients++;
+
+    // Mentions of the user are recognized from now on
+    mentionAddUser(clientUserID);
+
+    return SUCCESS;
 }
 
 
 /*
  * Function:     removeFromList
- * Purpose:      Removes a client from the client list.
- *               NOTE: Make sure to lock and unlock mutex before and after calling this function!
+ * Purpose:      Removes a client from a shard's client list.
+ *               NOTE: Make sure to lock and unlock shardP->mutex before and after calling this function!
  * Inputs:       int             entryIndex      Index of the client to be removed.
+ *               RegistryShard*  shardP          Pointer to the shard holding the client
  *               SharedData*     sharedDataP     Pointer to shared data
  *
- * Outputs:      sharedDataP                     Updates the shared data.
+ * Outputs:      shardP                          Updates the shard.
  *
- * Returns:      int                             Index of the removed Data Creator in the master list or PID_NOT_FOUND if not found.
+ * Returns:      int                             Index of the removed client in the shard or ENTRY_NOT_FOUND_OR_NULL if not found.
  */
-int removeFromList(int entryIndex, SharedData* sharedDataP)
+int removeFromList(int entryIndex, RegistryShard* shardP, SharedData* sharedDataP)
 {
     if (entryIndex != ENTRY_NOT_FOUND_OR_NULL)
     {
         // Entry exists, so remove by shifting all entries to the right, to the left by one,
         // starting at the entry's index. 
 
+        // No more mentions of the user
+        mentionRemoveUser(shardP->connectedClients[entryIndex].clientUserID);
+
         // First decrement number of clients
-        sharedDataP->numClients--;
+        shardP->numClients--;
+        __atomic_sub_fetch(&sharedDataP->numClients, 1, __ATOMIC_ACQ_REL);
 
         // This will copy the contents of the next entry up until the penultimate.
         // The caveat is that the entry that used to be the last is still populated, but
         // so long as the numClients is accurate, this should not cause any issues.
-        for (int i = entryIndex; i < sharedDataP->numClients; i++)
+        for (int i = entryIndex; i < shardP->numClients; i++)
         {
-            sharedDataP->connectedClients[i] = sharedDataP->connectedClients[i+1];
+            shardP->connectedClients[i] = shardP->connectedClients[i+1];
         }
 
         // Clean up straggler
-        int numClients = sharedDataP->numClients;
-        if (numClients < MAX_CLIENTS)
+        int numClients = shardP->numClients;
+        if (numClients < REGISTRY_SHARD_CAPACITY)
         {
-            sharedDataP->connectedClients[numClients].clientIP[0] = 0;
-            sharedDataP->connectedClients[numClients].clientUserID[0] = 0;
-            sharedDataP->connectedClients[numClients].threadID = 0;
-            sharedDataP->connectedClients[numClients].clientSocket = 0;
+            shardP->connectedClients[numClients].clientIP[0] = 0;
+            shardP->connectedClients[numClients].clientUserID[0] = 0;
+            shardP->connectedClients[numClients].threadID = 0;
+            shardP->connectedClients[numClients].clientSocket = 0;
+            shardP->connectedClients[numClients].delivery = DELIVERY_TCP;
         }
     }
     else
@@ -443,7 +630,7 @@ int removeFromList(int entryIndex, SharedData* sharedDataP)
 /*
  * Function:     printSharedData
  * Purpose:      Prints the contents of the shared data.
- *               NOTE: Make sure to lock and unlock mutex before and after calling this function!
+ *               NOTE: Make sure to lock and unlock all shards (registryLockAll()) before and after calling this function!
  *
  * Inputs:       SharedData*    sharedDataP     Pointer to the shared data.
  *
@@ -453,13 +640,18 @@ int removeFromList(int entryIndex, SharedData* sharedDataP)
  */
 void printSharedData(SharedData* sharedDataP)
 {
-    printf("\nMessage queue ID: %d  |  # of clients: %d\nAll clients:\n", sharedDataP->msgQueueID, sharedDataP->numClients);
-    for (int i = 0; i < sharedDataP->numClients; i++)
+    printf("\nMessage queue ID: %d  |  # of clients: %d\nAll clients:\n", sharedDataP->msgQueueID, registryGetNumClients(sharedDataP));
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
     {
-        printf("\tThread ID: %lu  |  IP: %s  |  UserID: %s\n", 
-            sharedDataP->connectedClients[i].threadID, 
-            sharedDataP->connectedClients[i].clientIP, 
-            sharedDataP->connectedClients[i].clientUserID);
+        RegistryShard* shardP = &sharedDataP->shards[shard];
+        for (int i = 0; i < shardP->numClients; i++)
+        {
+            printf("\tShard: %d  |  Thread ID: %lu  |  IP: %s  |  UserID: %s\n", 
+                shard,
+                shardP->connectedClients[i].threadID, 
+                shardP->connectedClients[i].clientIP, 
+                shardP->connectedClients[i].clientUserID);
+        }
     }
 
     printf("\n");
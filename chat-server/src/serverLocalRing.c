@@ -0,0 +1,324 @@
+/*
+* Filename:		serverLocalRing.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the shared-memory broadcast ring of the CHAT-SYSTEM server.
+*
+*               The ring (see common/inc/localRing.h for its layout) lives in a memfd. Anyone on this
+*               host that connects to the abstract Unix socket LOCAL_RING_SOCKET_NAME is passed the
+*               memfd and maps it read-only - the memfd is sealed against writes through any new
+*               mapping, so only the server's own mapping can change it.
+*
+*               The chat broadcaster writes each broadcast into the ring once and wakes the readers
+*               with a single futex wake, however many there are. A registered chat client that reads
+*               the ring sends ">>local<<"; from then on the broadcaster skips its TCP send, and the
+*               client is told which ring position its TCP stream stopped at.
+*/
+
+#define _GNU_SOURCE // For memfd_create() and F_SEAL_FUTURE_WRITE
+
+#include "../inc/serverLocalRing.h"
+
+static int ringFd = -1;
+static void* ringMapping = NULL;
+static LocalRingHeader* ringHeader = NULL;
+static LocalRingSlot* ringSlots = NULL;
+
+static pthread_mutex_t localRingMutex = PTHREAD_MUTEX_INITIALIZER;
+static LocalRingStats localRingStats;
+static int isHandedOut = 0;    // No wakeups until someone could be listening
+
+static int ringSocket = -1;
+static pthread_t ringThread;
+static int ringIsRunning = LOCAL_RING_STOPPED;
+
+#define LOCAL_RING_LOOP_SLEEP_LENGTH 10000  // 10 milliseconds
+
+
+/*
+* Function:     localRingPublish
+* Purpose:      Writes a broadcast into the ring and wakes the readers. Only the chat broadcaster
+*               calls this, so there is a single writer.
+*
+* Inputs:       const Broadcast*    broadcastP      The broadcast.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void localRingPublish(const Broadcast* broadcastP)
+{
+    if (ringHeader == NULL)
+    {
+        return;
+    }
+
+    uint64_t sequence = ringHeader->head;
+    LocalRingSlot* slot = &ringSlots[sequence % LOCAL_RING_SLOTS];
+
+    // Mark the slot as being written, so a reader copying it at the same time throws its copy away
+    __atomic_store_n(&slot->sequence, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->broadcast = *broadcastP;
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELEASE);
+
+    __atomic_store_n(&ringHeader->head, sequence + 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ringHeader->futexWord, 1, __ATOMIC_RELEASE);
+
+    if (__atomic_load_n(&isHandedOut, __ATOMIC_ACQUIRE))
+    {
+        localRingFutexWake(&ringHeader->futexWord);
+    }
+
+    pthread_mutex_lock(&localRingMutex);
+    localRingStats.broadcastsWritten++;
+    localRingStats.wakeups += __atomic_load_n(&isHandedOut, __ATOMIC_ACQUIRE);
+    pthread_mutex_unlock(&localRingMutex);
+}
+
+
+/*
+* Function:     localRingGetHead
+* Purpose:      Gets the ring position the next broadcast will be written at.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        Number of broadcasts written so far.
+*/
+uint64_t localRingGetHead()
+{
+    return ringHeader == NULL ? 0 : __atomic_load_n(&ringHeader->head, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+* Function:     localRingIsAvailable
+* Purpose:      Checks whether the ring is being written, i.e. whether clients can be moved onto it.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if the ring is available, 0 otherwise.
+*/
+int localRingIsAvailable()
+{
+    return ringHeader != NULL;
+}
+
+
+/*
+* Function:     handOutRing
+* Purpose:      Passes the ring's memfd to a connected reader.
+*
+* Inputs:       int             readerSocket    The reader's Unix socket.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void handOutRing(int readerSocket)
+{
+    char data = 0;
+    char control[CMSG_SPACE(sizeof(int))];
+    memset(control, 0, sizeof(control));
+
+    struct iovec iov = {.iov_base = &data, .iov_len = 1};
+    struct msghdr message = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control)};
+
+    struct cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+    controlMessage->cmsg_level = SOL_SOCKET;
+    controlMessage->cmsg_type = SCM_RIGHTS;
+    controlMessage->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(controlMessage), &ringFd, sizeof(int));
+
+    if (sendmsg(readerSocket, &message, MSG_NOSIGNAL) == 1)
+    {
+        __atomic_store_n(&isHandedOut, 1, __ATOMIC_RELEASE);
+
+        pthread_mutex_lock(&localRingMutex);
+        localRingStats.ringsHandedOut++;
+        pthread_mutex_unlock(&localRingMutex);
+    }
+}
+
+
+/*
+* Function:     ringHandOut
+* Purpose:      Hand-out thread - passes the ring to every reader that connects to the ring socket.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* ringHandOut(void* arg)
+{
+    (void)arg;
+
+    while (__atomic_load_n(&ringIsRunning, __ATOMIC_ACQUIRE))
+    {
+        int readerSocket;
+        while ((readerSocket = accept(ringSocket, NULL, NULL)) >= 0)
+        {
+            handOutRing(readerSocket);
+            close(readerSocket);
+        }
+
+        usleep(LOCAL_RING_LOOP_SLEEP_LENGTH);
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     createRing
+* Purpose:      Creates the ring's memfd, maps it and seals it so that nobody else can write to it.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             LOCAL_RING_SUCCESS, or LOCAL_RING_ERROR.
+*/
+static int createRing()
+{
+    if ((ringFd = memfd_create("chat-system-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING)) < 0)
+    {
+        perror("[SERVER] : memfd_create() FAILED");
+        return LOCAL_RING_ERROR;
+    }
+
+    if (ftruncate(ringFd, LOCAL_RING_LENGTH) < 0)
+    {
+        perror("[SERVER] : ftruncate() FAILED");
+        close(ringFd);
+        return LOCAL_RING_ERROR;
+    }
+
+    ringMapping = mmap(NULL, LOCAL_RING_LENGTH, PROT_READ | PROT_WRITE, MAP_SHARED, ringFd, 0);
+    if (ringMapping == MAP_FAILED)
+    {
+        perror("[SERVER] : mmap() FAILED");
+        ringMapping = NULL;
+        close(ringFd);
+        return LOCAL_RING_ERROR;
+    }
+
+    LocalRingHeader* header = ringMapping;
+    header->magic = LOCAL_RING_MAGIC;
+    header->version = LOCAL_RING_VERSION;
+    header->numSlots = LOCAL_RING_SLOTS;
+    header->slotSize = sizeof(LocalRingSlot);
+    ringSlots = (LocalRingSlot*)((char*)ringMapping + sizeof(LocalRingHeader));
+
+    // Readers may only map it read-only, and it can never change size under them
+    if (fcntl(ringFd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) < 0)
+    {
+        perror("[SERVER] : fcntl(F_ADD_SEALS) FAILED");
+        munmap(ringMapping, LOCAL_RING_LENGTH);
+        ringMapping = NULL;
+        close(ringFd);
+        return LOCAL_RING_ERROR;
+    }
+
+    ringHeader = header;
+    return LOCAL_RING_SUCCESS;
+}
+
+
+/*
+* Function:     localRingStart
+* Purpose:      Creates the ring and starts handing it out on the ring socket.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             LOCAL_RING_SUCCESS, or LOCAL_RING_ERROR if the ring is unavailable.
+*/
+int localRingStart()
+{
+    if ((ringSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0)
+    {
+        perror("[SERVER] : socket() FAILED");
+        return LOCAL_RING_ERROR;
+    }
+
+    // Abstract socket name - starts with a null byte, nothing on disk to clean up
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path + 1, LOCAL_RING_SOCKET_NAME, sizeof(address.sun_path) - 2);
+    socklen_t addressLength = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(LOCAL_RING_SOCKET_NAME);
+
+    if (bind(ringSocket, (struct sockaddr*)&address, addressLength) < 0 || listen(ringSocket, LOCAL_RING_BACKLOG) < 0)
+    {
+        perror("[SERVER] : ring socket FAILED");
+        close(ringSocket);
+        return LOCAL_RING_ERROR;
+    }
+
+    if (createRing() != LOCAL_RING_SUCCESS)
+    {
+        close(ringSocket);
+        return LOCAL_RING_ERROR;
+    }
+
+    __atomic_store_n(&ringIsRunning, LOCAL_RING_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&ringThread, NULL, ringHandOut, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&ringIsRunning, LOCAL_RING_STOPPED, __ATOMIC_RELEASE);
+        close(ringSocket);
+        return LOCAL_RING_ERROR;
+    }
+
+    return LOCAL_RING_SUCCESS;
+}
+
+
+/*
+* Function:     localRingStop
+* Purpose:      Stops handing out the ring. Readers keep their mapping, which simply stops changing;
+*               the server's mapping stays until exit, as the broadcaster may still be writing.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void localRingStop()
+{
+    if (__atomic_load_n(&ringIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&ringIsRunning, LOCAL_RING_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(ringThread, NULL);
+        close(ringSocket);
+    }
+}
+
+
+/*
+* Function:     localRingGetStats
+* Purpose:      Gets the ring counters.
+*
+* Inputs:       LocalRingStats*     statsP      Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void localRingGetStats(LocalRingStats* statsP)
+{
+    pthread_mutex_lock(&localRingMutex);
+    *statsP = localRingStats;
+    pthread_mutex_unlock(&localRingMutex);
+}
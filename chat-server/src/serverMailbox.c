@@ -0,0 +1,483 @@
+/*
+* Filename:		serverMailbox.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the offline direct message mailboxes of the CHAT-SYSTEM server.
+*
+*               A direct message to a user that is not connected is appended to the chat log like any
+*               other message, and only its sequence number is queued in the recipient's mailbox - 8
+*               bytes per pending message. Each mailbox is a ring of MAILBOX_MAX_MESSAGES entries, so a
+*               user that never comes back costs a bounded amount of memory; the oldest pending message
+*               is dropped when the ring is full. Mailboxes only exist while they hold messages.
+*
+*               When the user registers again, the client handler reads the mailbox, sends the messages,
+*               read back from the log, in a single write, and only then acknowledges them; the mailbox
+*               is emptied and a LOG_RECORD_MAILBOX_DRAINED marker is logged. A failed write leaves the
+*               messages queued for the next time.
+*
+*               Mailboxes are saved in the registry snapshots along with the log sequence they are
+*               consistent with; posting appends to the log under mailboxMutex, so no message can fall
+*               between the two. After a restart, the queued direct messages logged after the snapshot
+*               are queued again from the log, and a drain marker empties the recipient's mailbox as it
+*               did before the restart. Direct messages sent live are logged with their own kind and are
+*               never queued.
+*/
+
+#include "../inc/serverMailbox.h"
+
+static pthread_mutex_t mailboxMutex = PTHREAD_MUTEX_INITIALIZER;
+static Mailbox* mailboxes[MAILBOX_MAX_USERS];
+static int numMailboxes = 0;
+static MailboxStats mailboxStats;
+
+
+/*
+* Function:     findMailbox
+* Purpose:      Finds the mailbox of a user.
+*               NOTE: Make sure to lock and unlock mailboxMutex before and after calling this function!
+*
+* Inputs:       const char*     recipientUserID     User ID of the recipient.
+*
+* Outputs:      None
+*
+* Returns:      int                                 Index of the mailbox, or -1 if the user has none.
+*/
+static int findMailbox(const char* recipientUserID)
+{
+    for (int i = 0; i < numMailboxes; i++)
+    {
+        if (strncmp(mailboxes[i]->recipientUserID, recipientUserID, CLIENT_USERID_LENGTH) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+* Function:     getMailbox
+* Purpose:      Finds the mailbox of a user, creating it if needed.
+*               NOTE: Make sure to lock and unlock mailboxMutex before and after calling this function!
+*
+* Inputs:       const char*     recipientUserID     User ID of the recipient.
+*
+* Outputs:      None
+*
+* Returns:      Mailbox*                            The mailbox, or NULL if all mailboxes are in use or out of memory.
+*/
+static Mailbox* getMailbox(const char* recipientUserID)
+{
+    int index = findMailbox(recipientUserID);
+    if (index != -1)
+    {
+        return mailboxes[index];
+    }
+
+    if (numMailboxes >= MAILBOX_MAX_USERS)
+    {
+        return NULL;
+    }
+
+    Mailbox* mailbox = memCalloc(MEM_HISTORY_CACHE, 1, sizeof(Mailbox));
+    if (mailbox == NULL)
+    {
+        return NULL;
+    }
+
+    strncpy(mailbox->recipientUserID, recipientUserID, CLIENT_USERID_LENGTH);
+    mailbox->recipientUserID[CLIENT_USERID_LENGTH] = '\0'; // Ensure null termination
+    mailboxes[numMailboxes++] = mailbox;
+
+    return mailbox;
+}
+
+
+/*
+* Function:     removeMailbox
+* Purpose:      Frees a mailbox and removes it from the list.
+*               NOTE: Make sure to lock and unlock mailboxMutex before and after calling this function!
+*
+* Inputs:       int             index               Index of the mailbox.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void removeMailbox(int index)
+{
+    mailboxStats.numPending -= mailboxes[index]->count;
+    memFree(MEM_HISTORY_CACHE, mailboxes[index]);
+
+    // Order does not matter - move the last mailbox into the gap
+    mailboxes[index] = mailboxes[--numMailboxes];
+    mailboxes[numMailboxes] = NULL;
+}
+
+
+/*
+* Function:     queueSequence
+* Purpose:      Queues a log sequence in a mailbox, dropping the oldest one if the mailbox is full.
+*               NOTE: Make sure to lock and unlock mailboxMutex before and after calling this function!
+*
+* Inputs:       Mailbox*        mailbox             The mailbox.
+*               uint64_t        sequence            Log sequence of the direct message.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void queueSequence(Mailbox* mailbox, uint64_t sequence)
+{
+    if (mailbox->count == MAILBOX_MAX_MESSAGES)
+    {
+        mailbox->head = (mailbox->head + 1) % MAILBOX_MAX_MESSAGES;
+        mailbox->count--;
+        mailboxStats.numPending--;
+        mailboxStats.numDropped++;
+    }
+
+    mailbox->sequences[(mailbox->head + mailbox->count) % MAILBOX_MAX_MESSAGES] = sequence;
+    mailbox->count++;
+    mailboxStats.numPending++;
+    mailboxStats.numQueued++;
+}
+
+
+/*
+* Function:     mailboxPost
+* Purpose:      Logs a direct message for a user that is not connected and queues it in their mailbox.
+*
+* Inputs:       const char*         recipientUserID     User ID of the recipient.
+*               const Broadcast*    broadcastP          The message.
+*
+* Outputs:      None
+*
+* Returns:      int                                     MAILBOX_SUCCESS, MAILBOX_FULL if no mailbox could be
+*                                                       created, or MAILBOX_ERROR if the log append failed.
+*/
+int mailboxPost(const char* recipientUserID, const Broadcast* broadcastP)
+{
+    int retVal = MAILBOX_SUCCESS;
+
+    pthread_mutex_lock(&mailboxMutex);
+
+    Mailbox* mailbox = getMailbox(recipientUserID);
+    if (mailbox == NULL)
+    {
+        mailboxStats.numDropped++;
+        retVal = MAILBOX_FULL;
+    }
+    else
+    {
+        int64_t sequence = logAppendDirect(broadcastP, recipientUserID);
+        if (sequence < 0)
+        {
+            if (mailbox->count == 0)
+            {
+                removeMailbox(findMailbox(recipientUserID));
+            }
+            retVal = MAILBOX_ERROR;
+        }
+        else
+        {
+            queueSequence(mailbox, (uint64_t)sequence);
+        }
+    }
+
+    pthread_mutex_unlock(&mailboxMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     mailboxPeek
+* Purpose:      Reads a user's pending messages without removing them - call mailboxAck() once they
+*               have been sent.
+*
+* Inputs:       const char*     recipientUserID     User ID of the recipient.
+*               uint64_t*       sequences           Buffer for the log sequences of the pending messages.
+*               int             maxSequences        Size of the buffer (MAILBOX_MAX_MESSAGES holds them all).
+*
+* Outputs:      sequences                           The pending messages, newest maxSequences of them, oldest first.
+*
+* Returns:      int                                 Number of pending messages.
+*/
+int mailboxPeek(const char* recipientUserID, uint64_t* sequences, int maxSequences)
+{
+    int numPending = 0;
+
+    pthread_mutex_lock(&mailboxMutex);
+
+    int index = findMailbox(recipientUserID);
+    if (index != -1)
+    {
+        Mailbox* mailbox = mailboxes[index];
+
+        // Keep the newest if the buffer is too small
+        uint32_t skip = mailbox->count > (uint32_t)maxSequences ? mailbox->count - maxSequences : 0;
+        for (uint32_t i = skip; i < mailbox->count; i++)
+        {
+            sequences[numPending++] = mailbox->sequences[(mailbox->head + i) % MAILBOX_MAX_MESSAGES];
+        }
+    }
+
+    pthread_mutex_unlock(&mailboxMutex);
+
+    return numPending;
+}
+
+
+/*
+* Function:     mailboxAck
+* Purpose:      Removes the messages a user has been sent from their mailbox. Once the mailbox is empty
+*               a drain marker is logged, so recovery does not queue them again; if messages were posted
+*               since mailboxPeek(), they stay queued and recovery may deliver the acknowledged ones
+*               twice, but loses none.
+*
+* Inputs:       const char*     recipientUserID     User ID of the recipient.
+*               uint64_t        lastSequence        Log sequence of the newest message sent.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void mailboxAck(const char* recipientUserID, uint64_t lastSequence)
+{
+    pthread_mutex_lock(&mailboxMutex);
+
+    int index = findMailbox(recipientUserID);
+    if (index != -1)
+    {
+        Mailbox* mailbox = mailboxes[index];
+
+        // Pending messages are oldest first, so the sent ones are at the head
+        while (mailbox->count > 0 && mailbox->sequences[mailbox->head] <= lastSequence)
+        {
+            mailbox->head = (mailbox->head + 1) % MAILBOX_MAX_MESSAGES;
+            mailbox->count--;
+            mailboxStats.numPending--;
+            mailboxStats.numDelivered++;
+        }
+
+        if (mailbox->count == 0)
+        {
+            removeMailbox(index);
+            logAppendMailboxDrained(recipientUserID);
+        }
+    }
+
+    pthread_mutex_unlock(&mailboxMutex);
+}
+
+
+/*
+* Function:     mailboxBeginSnapshot
+* Purpose:      Freezes the mailboxes for a snapshot by holding mailboxMutex until mailboxEndSnapshot().
+*               Fork the snapshot process in between.
+*
+* Inputs:       uint64_t*       upToP               Where to store the log sequence the mailboxes are consistent with.
+*               uint32_t*       numMailboxesP       Where to store the number of mailboxes.
+*
+* Outputs:      The mailbox position and count.
+*
+* Returns:      void
+*/
+void mailboxBeginSnapshot(uint64_t* upToP, uint32_t* numMailboxesP)
+{
+    pthread_mutex_lock(&mailboxMutex);
+
+    *upToP = logGetNextSequence();
+    *numMailboxesP = (uint32_t)numMailboxes;
+}
+
+
+/*
+* Function:     mailboxWriteSnapshot
+* Purpose:      Writes every mailbox to a snapshot, pending messages oldest first. Called in the
+*               snapshot child process, which has its own copy of the frozen mailboxes.
+*
+* Inputs:       SnapshotWriter*     writerP     The snapshot writer.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void mailboxWriteSnapshot(SnapshotWriter* writerP)
+{
+    for (int i = 0; i < numMailboxes; i++)
+    {
+        Mailbox* mailbox = mailboxes[i];
+
+        snapshotWrite(writerP, mailbox->recipientUserID, sizeof(mailbox->recipientUserID));
+        snapshotWrite(writerP, &mailbox->count, sizeof(mailbox->count));
+
+        for (uint32_t j = 0; j < mailbox->count; j++)
+        {
+            snapshotWrite(writerP, &mailbox->sequences[(mailbox->head + j) % MAILBOX_MAX_MESSAGES], sizeof(uint64_t));
+        }
+    }
+}
+
+
+/*
+* Function:     mailboxEndSnapshot
+* Purpose:      Releases the mailboxes after the snapshot process has been forked.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void mailboxEndSnapshot()
+{
+    pthread_mutex_unlock(&mailboxMutex);
+}
+
+
+/*
+* Function:     mailboxLoadSnapshot
+* Purpose:      Loads the mailboxes saved in a snapshot. Called at start-up, before any client connects.
+*
+* Inputs:       SnapshotReader*     readerP         Reader positioned at the first mailbox.
+*               uint32_t            numSaved        Number of mailboxes in the snapshot.
+*
+* Outputs:      None
+*
+* Returns:      int                                 MAILBOX_SUCCESS, or MAILBOX_ERROR if the data is invalid.
+*/
+int mailboxLoadSnapshot(SnapshotReader* readerP, uint32_t numSaved)
+{
+    int retVal = MAILBOX_SUCCESS;
+
+    pthread_mutex_lock(&mailboxMutex);
+
+    for (uint32_t i = 0; i < numSaved && retVal == MAILBOX_SUCCESS; i++)
+    {
+        char recipientUserID[CLIENT_USERID_LENGTH + 1];
+        uint32_t count;
+
+        if (snapshotRead(readerP, recipientUserID, sizeof(recipientUserID)) != SNAPSHOT_SUCCESS ||
+            snapshotRead(readerP, &count, sizeof(count)) != SNAPSHOT_SUCCESS ||
+            count > MAILBOX_MAX_MESSAGES)
+        {
+            retVal = MAILBOX_ERROR;
+            break;
+        }
+        recipientUserID[CLIENT_USERID_LENGTH] = '\0';
+
+        Mailbox* mailbox = getMailbox(recipientUserID);
+        for (uint32_t j = 0; j < count; j++)
+        {
+            uint64_t sequence;
+            if (snapshotRead(readerP, &sequence, sizeof(sequence)) != SNAPSHOT_SUCCESS)
+            {
+                retVal = MAILBOX_ERROR;
+                break;
+            }
+
+            if (mailbox != NULL)
+            {
+                queueSequence(mailbox, sequence);
+            }
+        }
+    }
+
+    // Loading is not new traffic
+    mailboxStats.numQueued = 0;
+    mailboxStats.numDropped = 0;
+
+    pthread_mutex_unlock(&mailboxMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     mailboxRecoverFromLog
+* Purpose:      Queues again the direct messages logged after the last snapshot, so that no pending
+*               message is lost in a crash, and empties the mailboxes whose drain marker follows them.
+*               Called at start-up, after mailboxLoadSnapshot().
+*
+* Inputs:       uint64_t        fromSequence        Log sequence the snapshot's mailboxes are consistent with.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void mailboxRecoverFromLog(uint64_t fromSequence)
+{
+    LogRecord* batch = memAlloc(MEM_HISTORY_CACHE, MAILBOX_RECOVERY_BATCH * sizeof(LogRecord));
+    if (batch == NULL)
+    {
+        return;
+    }
+
+    uint64_t sequence = fromSequence > logGetFirstSequence() ? fromSequence : logGetFirstSequence();
+    uint64_t nextSequence = logGetNextSequence();
+
+    pthread_mutex_lock(&mailboxMutex);
+
+    while (sequence < nextSequence)
+    {
+        int numRecords = logReadRange(sequence, batch, MAILBOX_RECOVERY_BATCH);
+        if (numRecords == LOG_CORRUPT)
+        {
+            sequence++; // Skip the bad record
+            continue;
+        }
+        if (numRecords <= 0)
+        {
+            break;
+        }
+
+        for (int i = 0; i < numRecords; i++)
+        {
+            if (batch[i].kind == LOG_RECORD_DIRECT)
+            {
+                Mailbox* mailbox = getMailbox(batch[i].recipientUserID);
+                if (mailbox != NULL)
+                {
+                    queueSequence(mailbox, batch[i].sequence);
+                }
+            }
+            else if (batch[i].kind == LOG_RECORD_MAILBOX_DRAINED)
+            {
+                int index = findMailbox(batch[i].recipientUserID);
+                if (index != -1)
+                {
+                    removeMailbox(index);
+                }
+            }
+        }
+
+        sequence += numRecords;
+    }
+
+    pthread_mutex_unlock(&mailboxMutex);
+
+    memFree(MEM_HISTORY_CACHE, batch);
+}
+
+
+/*
+* Function:     mailboxGetStats
+* Purpose:      Gets the mailbox counters.
+*
+* Inputs:       MailboxStats*   statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void mailboxGetStats(MailboxStats* statsP)
+{
+    pthread_mutex_lock(&mailboxMutex);
+    *statsP = mailboxStats;
+    statsP->numMailboxes = numMailboxes;
+    pthread_mutex_unlock(&mailboxMutex);
+}
@@ -0,0 +1,657 @@
+/*
+* Filename:		serverMemory.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the memory accountant of the CHAT-SYSTEM server.
+*
+*               Byte counts are kept per category in atomic counters, so the hot paths (parsing a
+*               message, serializing a broadcast) never take a lock to account for memory.
+*               Allocations made through memAlloc() carry a small header holding their size, so
+*               memFree() can release the right amount without the caller tracking it.
+*
+*               When an allocation would push the total above the budget, the registered reclaimers
+*               (e.g. the history cache) are asked to evict first. If that is not enough, the
+*               allocation fails and the caller is expected to shed the work instead.
+*
+*               Large, long-lived pools that are walked on every broadcast can be taken from
+*               memAllocHuge() instead. Such a pool is mapped in whole huge pages, however small -
+*               reserved ones (MAP_HUGETLB) where the system has them, otherwise a mapping aligned to a
+*               huge page and marked for transparent huge pages, which the kernel only backs with huge
+*               pages when they are aligned - so the walk needs a fraction of the TLB entries. It has no
+*               header, so memFreeHuge() is given the size back.
+*/
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../inc/serverMemory.h"
+
+// Header placed in front of every memAlloc() block (kept 16-byte aligned)
+typedef union
+{
+    size_t size;
+    max_align_t align;
+} MemoryHeader;
+
+static atomic_size_t memBudget = MEMORY_BUDGET_BYTES;
+static atomic_size_t memTotalUsed = 0;
+static atomic_size_t memPeakUsed = 0;
+static atomic_size_t memUsed[MEM_NUM_CATEGORIES];
+static atomic_ulong memFailedAllocs[MEM_NUM_CATEGORIES];
+static atomic_ulong memShedCount[MEM_NUM_CATEGORIES];
+static atomic_ulong memHugeBlocks = 0;          // memAllocHuge() blocks mapped on reserved huge pages
+static atomic_ulong memTransparentBlocks = 0;   // ... on aligned mappings marked for transparent huge pages
+static atomic_ulong memNormalBlocks = 0;        // ... and those built without huge pages
+
+static MemoryReclaimer memReclaimers[MEM_NUM_CATEGORIES];
+static pthread_mutex_t memReclaimMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* memCategoryNames[MEM_NUM_CATEGORIES] = {
+    "connection state",
+    "outbound buffers",
+    "history cache",
+    "parser buffers",
+    "filter patterns"
+};
+
+
+/*
+* Function:     memAddUsed
+* Purpose:      Adds bytes to a category and the total, and updates the peak.
+*
+* Inputs:       MemoryCategory      category        Category to charge.
+*               size_t              size            Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      size_t                              The new total number of accounted bytes.
+*/
+static size_t memAddUsed(MemoryCategory category, size_t size)
+{
+    atomic_fetch_add_explicit(&memUsed[category], size, memory_order_relaxed);
+    size_t total = atomic_fetch_add_explicit(&memTotalUsed, size, memory_order_relaxed) + size;
+
+    size_t peak = atomic_load_explicit(&memPeakUsed, memory_order_relaxed);
+    while (total > peak && !atomic_compare_exchange_weak(&memPeakUsed, &peak, total))
+    {
+        // peak reloaded by the failed exchange
+    }
+
+    return total;
+}
+
+
+/*
+* Function:     memSubUsed
+* Purpose:      Removes bytes from a category and the total.
+*
+* Inputs:       MemoryCategory      category        Category to credit.
+*               size_t              size            Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void memSubUsed(MemoryCategory category, size_t size)
+{
+    atomic_fetch_sub_explicit(&memUsed[category], size, memory_order_relaxed);
+    atomic_fetch_sub_explicit(&memTotalUsed, size, memory_order_relaxed);
+}
+
+
+/*
+* Function:     memReclaim
+* Purpose:      Asks the registered reclaimers to free memory until bytesWanted bytes have been freed.
+*               Only one thread reclaims at a time; others simply re-check the budget afterwards.
+*
+* Inputs:       size_t      bytesWanted     Number of bytes that should be freed.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void memReclaim(size_t bytesWanted)
+{
+    size_t freed = 0;
+
+    pthread_mutex_lock(&memReclaimMutex);
+
+    for (int i = 0; i < MEM_NUM_CATEGORIES && freed < bytesWanted; i++)
+    {
+        if (memReclaimers[i] != NULL)
+        {
+            freed += memReclaimers[i](bytesWanted - freed);
+        }
+    }
+
+    pthread_mutex_unlock(&memReclaimMutex);
+}
+
+
+/*
+* Function:     memReserve
+* Purpose:      Charges size bytes to a category if they fit in the budget, running the reclaimers
+*               once if they do not.
+*
+* Inputs:       MemoryCategory      category        Category to charge.
+*               size_t              size            Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      int                                 MEMORY_OK if reserved, otherwise MEMORY_OVER_BUDGET.
+*/
+static int memReserve(MemoryCategory category, size_t size)
+{
+    size_t budget = atomic_load_explicit(&memBudget, memory_order_relaxed);
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        size_t total = memAddUsed(category, size);
+        if (total <= budget)
+        {
+            return MEMORY_OK;
+        }
+
+        // Over budget - undo, then try to evict before giving up
+        memSubUsed(category, size);
+
+        if (attempt == 0)
+        {
+            memReclaim(total - budget);
+        }
+    }
+
+    atomic_fetch_add_explicit(&memFailedAllocs[category], 1, memory_order_relaxed);
+    return MEMORY_OVER_BUDGET;
+}
+
+
+/*
+* Function:     memSetBudget
+* Purpose:      Sets the hard memory budget.
+*
+* Inputs:       size_t      budgetBytes     New budget in bytes.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void memSetBudget(size_t budgetBytes)
+{
+    atomic_store(&memBudget, budgetBytes);
+}
+
+
+/*
+* Function:     memGetBudget
+* Purpose:      Gets the hard memory budget.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      size_t                  Budget in bytes.
+*/
+size_t memGetBudget()
+{
+    return atomic_load(&memBudget);
+}
+
+
+/*
+* Function:     memIsUnderPressure
+* Purpose:      Checks whether accounted memory is above the shedding watermark.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                     1 if new work should be shed, otherwise 0.
+*/
+int memIsUnderPressure()
+{
+    size_t budget = atomic_load_explicit(&memBudget, memory_order_relaxed);
+    size_t total = atomic_load_explicit(&memTotalUsed, memory_order_relaxed);
+
+    return total >= (budget / 100) * MEMORY_SHED_WATERMARK_PERCENT;
+}
+
+
+/*
+* Function:     memAlloc
+* Purpose:      Allocates memory charged to a category. Must be released with memFree().
+*
+* Inputs:       MemoryCategory      category        Category to charge.
+*               size_t              size            Number of bytes to allocate.
+*
+* Outputs:      None
+*
+* Returns:      void*                               Pointer to the memory, or NULL if over budget or malloc failed.
+*/
+void* memAlloc(MemoryCategory category, size_t size)
+{
+    size_t fullSize = size + sizeof(MemoryHeader);
+
+    if (memReserve(category, fullSize) != MEMORY_OK)
+    {
+        return NULL;
+    }
+
+    MemoryHeader* header = malloc(fullSize);
+    if (header == NULL)
+    {
+        memSubUsed(category, fullSize);
+        atomic_fetch_add_explicit(&memFailedAllocs[category], 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    header->size = fullSize;
+    return header + 1;
+}
+
+
+/*
+* Function:     memCalloc
+* Purpose:      Allocates zeroed memory charged to a category. Must be released with memFree().
+*
+* Inputs:       MemoryCategory      category        Category to charge.
+*               size_t              count           Number of elements.
+*               size_t              size            Size of each element.
+*
+* Outputs:      None
+*
+* Returns:      void*                               Pointer to the memory, or NULL if over budget or malloc failed.
+*/
+void* memCalloc(MemoryCategory category, size_t count, size_t size)
+{
+    if (size != 0 && count > ((size_t)-1) / size)
+    {
+        return NULL;
+    }
+
+    void* ptr = memAlloc(category, count * size);
+    if (ptr != NULL)
+    {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+
+/*
+* Function:     memRealloc
+* Purpose:      Resizes memory obtained from memAlloc(), charging or crediting the difference.
+*               On failure the original block is left untouched.
+*
+* Inputs:       MemoryCategory      category        Category the memory is charged to.
+*               void*               ptr             Pointer returned by memAlloc() (NULL to allocate).
+*               size_t              size            New size in bytes.
+*
+* Outputs:      None
+*
+* Returns:      void*                               Pointer to the resized memory, or NULL on failure.
+*/
+void* memRealloc(MemoryCategory category, void* ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return memAlloc(category, size);
+    }
+
+    MemoryHeader* header = ((MemoryHeader*)ptr) - 1;
+    size_t oldSize = header->size;
+    size_t fullSize = size + sizeof(MemoryHeader);
+
+    if (fullSize > oldSize && memReserve(category, fullSize - oldSize) != MEMORY_OK)
+    {
+        return NULL;
+    }
+
+    MemoryHeader* newHeader = realloc(header, fullSize);
+    if (newHeader == NULL)
+    {
+        if (fullSize > oldSize)
+        {
+            memSubUsed(category, fullSize - oldSize);
+        }
+        atomic_fetch_add_explicit(&memFailedAllocs[category], 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    if (fullSize < oldSize)
+    {
+        memSubUsed(category, oldSize - fullSize);
+    }
+
+    newHeader->size = fullSize;
+    return newHeader + 1;
+}
+
+
+/*
+* Function:     memFree
+* Purpose:      Frees memory obtained from memAlloc() and credits its category.
+*
+* Inputs:       MemoryCategory      category        Category the memory was charged to.
+*               void*               ptr             Pointer returned by memAlloc() (may be NULL).
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void memFree(MemoryCategory category, void* ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    MemoryHeader* header = ((MemoryHeader*)ptr) - 1;
+    memSubUsed(category, header->size);
+    free(header);
+}
+
+
+/*
+* Function:     mapTransparentHuge
+* Purpose:      Maps whole huge pages of normal memory starting on a huge page boundary, and marks them
+*               for transparent huge pages.
+*
+* Inputs:       size_t              length          Bytes to map - a multiple of MEMORY_HUGE_PAGE_LENGTH.
+*
+* Outputs:      None
+*
+* Returns:      void*                               The mapping, or MAP_FAILED.
+*/
+#ifdef CHAT_HUGE_PAGES
+static void* mapTransparentHuge(size_t length)
+{
+    // Map a page more than needed, then trim it down to the aligned part
+    uint8_t* mapping = mmap(NULL, length + MEMORY_HUGE_PAGE_LENGTH, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED)
+    {
+        return MAP_FAILED;
+    }
+
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)mapping + MEMORY_HUGE_PAGE_LENGTH - 1) & ~(MEMORY_HUGE_PAGE_LENGTH - 1));
+    size_t headLength = aligned - mapping;
+    size_t tailLength = MEMORY_HUGE_PAGE_LENGTH - headLength;
+
+    if (headLength > 0)
+    {
+        munmap(mapping, headLength);
+    }
+    if (tailLength > 0)
+    {
+        munmap(aligned + length, tailLength);
+    }
+
+    madvise(aligned, length, MADV_HUGEPAGE);
+    return aligned;
+}
+#endif
+
+
+/*
+* Function:     hugeMappedSize
+* Purpose:      Gets how much memAllocHuge() maps for a block - whole huge pages, or whole normal pages
+*               when built without them.
+*
+* Inputs:       size_t              size            Number of bytes asked for.
+*
+* Outputs:      None
+*
+* Returns:      size_t                              Number of bytes mapped.
+*/
+static size_t hugeMappedSize(size_t size)
+{
+    #ifdef CHAT_HUGE_PAGES
+    size_t pageSize = MEMORY_HUGE_PAGE_LENGTH;
+    #else
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    #endif
+
+    return (size + pageSize - 1) / pageSize * pageSize;
+}
+
+
+/*
+* Function:     memAllocHuge
+* Purpose:      Allocates zeroed memory charged to a category, on huge pages where possible. The block
+*               starts on a page boundary. Must be released with memFreeHuge(), given the same size.
+*               The whole mapping is charged, so blocks are charged in MEMORY_HUGE_PAGE_LENGTH steps.
+*
+* Inputs:       MemoryCategory      category        Category to charge.
+*               size_t              size            Number of bytes to allocate.
+*
+* Outputs:      None
+*
+* Returns:      void*                               Pointer to the memory, or NULL if over budget or mmap failed.
+*/
+void* memAllocHuge(MemoryCategory category, size_t size)
+{
+    size_t mappedSize = hugeMappedSize(size);
+    void* mapping = MAP_FAILED;
+    atomic_ulong* blockCounter = &memNormalBlocks;
+
+    #ifdef CHAT_HUGE_PAGES
+    mapping = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    blockCounter = &memHugeBlocks;
+
+    if (mapping == MAP_FAILED)
+    {
+        // No huge pages reserved - the kernel may still back an aligned mapping with transparent ones
+        mapping = mapTransparentHuge(mappedSize);
+        blockCounter = &memTransparentBlocks;
+    }
+    #else
+    mapping = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    #endif
+
+    if (mapping == MAP_FAILED)
+    {
+        atomic_fetch_add_explicit(&memFailedAllocs[category], 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    if (memReserve(category, mappedSize) != MEMORY_OK)
+    {
+        munmap(mapping, mappedSize);
+        return NULL;
+    }
+
+    atomic_fetch_add_explicit(blockCounter, 1, memory_order_relaxed);
+    return mapping;
+}
+
+
+/*
+* Function:     memFreeHuge
+* Purpose:      Frees memory allocated with memAllocHuge() and credits its category.
+*
+* Inputs:       MemoryCategory      category        Category the memory was charged to.
+*               void*               ptr             Pointer returned by memAllocHuge() (may be NULL).
+*               size_t              size            The size it was allocated with.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void memFreeHuge(MemoryCategory category, void* ptr, size_t size)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    size_t mappedSize = hugeMappedSize(size);
+    memSubUsed(category, mappedSize);
+    munmap(ptr, mappedSize);
+}
+
+
+/*
+* Function:     memCharge
+* Purpose:      Charges memory that was allocated elsewhere (e.g. by the common messaging library).
+*               The bytes are always recorded, since the memory already exists; if they take the total
+*               over budget, the reclaimers are run once before reporting it.
+*
+* Inputs:       MemoryCategory      category        Category to charge.
+*               size_t              size            Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      int                                 MEMORY_OK, or MEMORY_OVER_BUDGET if the total is now above budget.
+*/
+int memCharge(MemoryCategory category, size_t size)
+{
+    size_t budget = atomic_load_explicit(&memBudget, memory_order_relaxed);
+    size_t total = memAddUsed(category, size);
+
+    if (total > budget)
+    {
+        memReclaim(total - budget);
+        total = atomic_load_explicit(&memTotalUsed, memory_order_relaxed);
+    }
+
+    return total <= budget ? MEMORY_OK : MEMORY_OVER_BUDGET;
+}
+
+
+/*
+* Function:     memRelease
+* Purpose:      Credits memory previously charged with memCharge().
+*
+* Inputs:       MemoryCategory      category        Category to credit.
+*               size_t              size            Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void memRelease(MemoryCategory category, size_t size)
+{
+    memSubUsed(category, size);
+}
+
+
+/*
+* Function:     memRegisterReclaimer
+* Purpose:      Registers the function used to evict memory from a category when over budget.
+*
+* Inputs:       MemoryCategory      category        Category the reclaimer frees memory from.
+*               MemoryReclaimer     reclaimer       Reclaim callback (NULL to unregister).
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void memRegisterReclaimer(MemoryCategory category, MemoryReclaimer reclaimer)
+{
+    pthread_mutex_lock(&memReclaimMutex);
+    memReclaimers[category] = reclaimer;
+    pthread_mutex_unlock(&memReclaimMutex);
+}
+
+
+/*
+* Function:     memNoteShed
+* Purpose:      Counts a piece of work dropped because of memory pressure.
+*
+* Inputs:       MemoryCategory      category        Category whose budget caused the drop.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void memNoteShed(MemoryCategory category)
+{
+    atomic_fetch_add_explicit(&memShedCount[category], 1, memory_order_relaxed);
+}
+
+
+/*
+* Function:     memGetUsed
+* Purpose:      Gets the number of bytes charged to a category.
+*
+* Inputs:       MemoryCategory      category        Category to query.
+*
+* Outputs:      None
+*
+* Returns:      size_t                              Bytes in use.
+*/
+size_t memGetUsed(MemoryCategory category)
+{
+    return atomic_load_explicit(&memUsed[category], memory_order_relaxed);
+}
+
+
+/*
+* Function:     memGetTotalUsed
+* Purpose:      Gets the number of bytes charged to all categories.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      size_t                  Bytes in use.
+*/
+size_t memGetTotalUsed()
+{
+    return atomic_load_explicit(&memTotalUsed, memory_order_relaxed);
+}
+
+
+/*
+* Function:     memCategoryName
+* Purpose:      Gets a printable name for a category.
+*
+* Inputs:       MemoryCategory      category        Category.
+*
+* Outputs:      None
+*
+* Returns:      const char*                         Category name.
+*/
+const char* memCategoryName(MemoryCategory category)
+{
+    if (category < 0 || category >= MEM_NUM_CATEGORIES)
+    {
+        return "unknown";
+    }
+
+    return memCategoryNames[category];
+}
+
+
+/*
+* Function:     memPrintStats
+* Purpose:      Prints per-category memory usage, failed allocations and shed counts.
+*
+* Inputs:       FILE*       out         Stream to print to.
+*
+* Outputs:      Memory statistics on out.
+*
+* Returns:      void
+*/
+void memPrintStats(FILE* out)
+{
+    fprintf(out, "Memory: %zu / %zu bytes used (peak %zu)\n",
+        memGetTotalUsed(), memGetBudget(), atomic_load(&memPeakUsed));
+
+    for (int i = 0; i < MEM_NUM_CATEGORIES; i++)
+    {
+        fprintf(out, "\t%-18s %10zu bytes  |  failed allocs: %lu  |  shed: %lu\n",
+            memCategoryNames[i],
+            memGetUsed(i),
+            atomic_load(&memFailedAllocs[i]),
+            atomic_load(&memShedCount[i]));
+    }
+
+    fprintf(out, "\tHuge pages: %lu pools on reserved huge pages, %lu on transparent huge pages, %lu on normal pages\n",
+        atomic_load(&memHugeBlocks), atomic_load(&memTransparentBlocks), atomic_load(&memNormalBlocks));
+}
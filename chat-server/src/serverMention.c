@@ -0,0 +1,365 @@
+/*
+* Filename:		serverMention.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for @mentions in the CHAT-SYSTEM server.
+*
+*               A message mentions a user by containing "@<userID>". Rather than every client (or the
+*               broadcaster) searching every message for every user, each message is parsed once when
+*               it comes in, against a trie of the connected users' IDs: at every '@', the trie is
+*               walked along the following characters, and the longest user ID that ends on a word
+*               boundary is a mention. A message is parsed in time proportional to its length, however
+*               many users are connected.
+*
+*               The trie is kept by addToList() and removeFromList(). Its nodes come from a fixed pool
+*               sized for MAX_CLIENTS users; the same user ID connected from two addresses is counted
+*               twice and stays until both have left.
+*
+*               The resulting MentionList travels with the message to the chat broadcaster, which sends
+*               each mentioned user a ">>mention<< <sender>" server message ahead of the broadcast.
+*/
+
+#include "../inc/serverMention.h"
+#include "../inc/serverIPC.h"
+
+#define MENTION_MAX_NODES (MAX_CLIENTS * CLIENT_USERID_LENGTH + 1)
+#define MENTION_NO_NODE 0       // Node 0 is the root, so never anyone's child or sibling
+
+typedef struct
+{
+    char character;
+    uint32_t firstChild;
+    uint32_t nextSibling;
+    uint32_t numUsers;          // Users whose ID passes through (or ends at) this node
+    uint32_t numEnding;         // Users whose ID ends at this node
+} MentionNode;
+
+// Protects everything below
+static pthread_mutex_t mentionMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static MentionNode mentionNodes[MENTION_MAX_NODES];
+static uint32_t numUsedNodes = 1;
+static uint32_t freeNodes = MENTION_NO_NODE;    // Freed nodes, chained through nextSibling
+static MentionStats mentionStats;
+
+
+/*
+* Function:     isUserIDCharacter
+* Purpose:      Checks whether a character can be part of a user ID - a mention ends at the first one that cannot.
+*
+* Inputs:       char            character       The character.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if it can, 0 if not.
+*/
+static int isUserIDCharacter(char character)
+{
+    return isalnum((unsigned char)character) || character == '_' || character == '-';
+}
+
+
+/*
+* Function:     findChild
+* Purpose:      Finds a node's child for a character.
+*               NOTE: Make sure to lock and unlock mentionMutex before and after calling this function!
+*
+* Inputs:       uint32_t        node            The node.
+*               char            character       The character.
+*
+* Outputs:      None
+*
+* Returns:      uint32_t                        The child, or MENTION_NO_NODE.
+*/
+static uint32_t findChild(uint32_t node, char character)
+{
+    uint32_t child = mentionNodes[node].firstChild;
+    while (child != MENTION_NO_NODE && mentionNodes[child].character != character)
+    {
+        child = mentionNodes[child].nextSibling;
+    }
+
+    return child;
+}
+
+
+/*
+* Function:     freeBranch
+* Purpose:      Returns a node and everything below it to the free list.
+*               NOTE: Make sure to lock and unlock mentionMutex before and after calling this function!
+*
+* Inputs:       uint32_t        node            The node, already unlinked from its parent.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void freeBranch(uint32_t node)
+{
+    uint32_t child = mentionNodes[node].firstChild;
+    while (child != MENTION_NO_NODE)
+    {
+        uint32_t nextSibling = mentionNodes[child].nextSibling;
+        freeBranch(child);
+        child = nextSibling;
+    }
+
+    mentionNodes[node].nextSibling = freeNodes;
+    freeNodes = node;
+    mentionStats.numNodes--;
+}
+
+
+/*
+* Function:     mentionAddUser
+* Purpose:      Adds a connected user's ID to the trie.
+*
+* Inputs:       const char*     clientUserID    The user ID.
+*
+* Outputs:      None
+*
+* Returns:      int                             MENTION_SUCCESS, or MENTION_ERROR if the node pool is exhausted.
+*/
+int mentionAddUser(const char* clientUserID)
+{
+    int length = strnlen(clientUserID, CLIENT_USERID_LENGTH);
+    int retVal = MENTION_SUCCESS;
+
+    if (length == 0)
+    {
+        return retVal;
+    }
+
+    pthread_mutex_lock(&mentionMutex);
+
+    // Make sure every node exists before counting the user in any of them
+    uint32_t node = 0;
+    int depth = 0;
+    for ( ; depth < length; depth++)
+    {
+        uint32_t child = findChild(node, clientUserID[depth]);
+        if (child == MENTION_NO_NODE)
+        {
+            if (freeNodes != MENTION_NO_NODE)
+            {
+                child = freeNodes;
+                freeNodes = mentionNodes[child].nextSibling;
+            }
+            else if (numUsedNodes < MENTION_MAX_NODES)
+            {
+                child = numUsedNodes++;
+            }
+            else
+            {
+                retVal = MENTION_ERROR;
+                break;
+            }
+
+            mentionNodes[child] = (MentionNode){.character = clientUserID[depth], .nextSibling = mentionNodes[node].firstChild};
+            mentionNodes[node].firstChild = child;
+            mentionStats.numNodes++;
+        }
+        node = child;
+    }
+
+    if (retVal == MENTION_SUCCESS)
+    {
+        node = 0;
+        for (depth = 0; depth < length; depth++)
+        {
+            node = findChild(node, clientUserID[depth]);
+            mentionNodes[node].numUsers++;
+        }
+        mentionNodes[node].numEnding++;
+        mentionStats.numUsers++;
+    }
+
+    pthread_mutex_unlock(&mentionMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     mentionRemoveUser
+* Purpose:      Takes a user ID that disconnected out of the trie, freeing the nodes nobody else uses.
+*
+* Inputs:       const char*     clientUserID    The user ID.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void mentionRemoveUser(const char* clientUserID)
+{
+    int length = strnlen(clientUserID, CLIENT_USERID_LENGTH);
+
+    pthread_mutex_lock(&mentionMutex);
+
+    // Only if it is really there - the pool may have been exhausted when it was added
+    uint32_t node = 0;
+    int depth = 0;
+    while (depth < length && (node = findChild(node, clientUserID[depth])) != MENTION_NO_NODE)
+    {
+        depth++;
+    }
+
+    if (length > 0 && depth == length && mentionNodes[node].numEnding > 0)
+    {
+        mentionNodes[node].numEnding--;
+        mentionStats.numUsers--;
+
+        uint32_t parent = 0;
+        for (int depth = 0; depth < length; depth++)
+        {
+            node = findChild(parent, clientUserID[depth]);
+            if (--mentionNodes[node].numUsers > 0)
+            {
+                parent = node;
+                continue;
+            }
+
+            // Nobody below here any more - unlink the whole branch and free it
+            uint32_t* link = &mentionNodes[parent].firstChild;
+            while (*link != node)
+            {
+                link = &mentionNodes[*link].nextSibling;
+            }
+            *link = mentionNodes[node].nextSibling;
+
+            freeBranch(node);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&mentionMutex);
+}
+
+
+/*
+* Function:     mentionParse
+* Purpose:      Finds the connected users a message mentions.
+*
+* Inputs:       const char*     message         The message.
+*               MentionList*    mentionsP       Where to store the mentioned user IDs.
+*
+* Outputs:      mentionsP
+*
+* Returns:      int                             Number of users mentioned.
+*/
+int mentionParse(const char* message, MentionList* mentionsP)
+{
+    mentionsP->numTargets = 0;
+
+    pthread_mutex_lock(&mentionMutex);
+
+    for (int i = 0; message[i] != '\0'; i++)
+    {
+        if (message[i] != MENTION_MARKER || (i > 0 && isUserIDCharacter(message[i - 1])))
+        {
+            continue;
+        }
+
+        // Longest connected user ID starting right after the marker and ending on a word boundary
+        const char* start = message + i + 1;
+        uint32_t node = 0;
+        int matchLength = 0;
+        for (int length = 0; length < CLIENT_USERID_LENGTH && start[length] != '\0'; length++)
+        {
+            node = findChild(node, start[length]);
+            if (node == MENTION_NO_NODE)
+            {
+                break;
+            }
+            if (mentionNodes[node].numEnding > 0 && !isUserIDCharacter(start[length + 1]))
+            {
+                matchLength = length + 1;
+            }
+        }
+
+        if (matchLength == 0 || mentionsP->numTargets == MENTION_MAX_TARGETS)
+        {
+            continue;
+        }
+
+        char target[CLIENT_USERID_LENGTH + 1];
+        memcpy(target, start, matchLength);
+        target[matchLength] = '\0';
+
+        if (!mentionIsTarget(mentionsP, target))
+        {
+            strcpy(mentionsP->targets[mentionsP->numTargets++], target);
+            mentionStats.mentionsFound++;
+        }
+        i += matchLength;
+    }
+
+    mentionStats.messagesParsed++;
+    mentionStats.messagesWithMentions += mentionsP->numTargets > 0;
+
+    pthread_mutex_unlock(&mentionMutex);
+
+    return mentionsP->numTargets;
+}
+
+
+/*
+* Function:     mentionIsTarget
+* Purpose:      Checks whether a user is in a mention list.
+*
+* Inputs:       const MentionList* mentionsP    The mention list.
+*               const char*     clientUserID    The user ID.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if the user is mentioned, 0 if not.
+*/
+int mentionIsTarget(const MentionList* mentionsP, const char* clientUserID)
+{
+    for (int i = 0; i < mentionsP->numTargets; i++)
+    {
+        if (strcmp(mentionsP->targets[i], clientUserID) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+/*
+* Function:     mentionNotePriorityCopy
+* Purpose:      Counts a message sent straight to a mentioned user because chat messages were being shed.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void mentionNotePriorityCopy()
+{
+    pthread_mutex_lock(&mentionMutex);
+    mentionStats.priorityCopies++;
+    pthread_mutex_unlock(&mentionMutex);
+}
+
+
+/*
+* Function:     mentionGetStats
+* Purpose:      Gets the mention counters.
+*
+* Inputs:       MentionStats*   statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void mentionGetStats(MentionStats* statsP)
+{
+    pthread_mutex_lock(&mentionMutex);
+    *statsP = mentionStats;
+    pthread_mutex_unlock(&mentionMutex);
+}
@@ -0,0 +1,368 @@
+/*
+* Filename:		serverMulticast.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the multicast broadcast mode of the CHAT-SYSTEM server.
+*
+*               For LANs with many clients on one segment, a client can send ">>multicast<<" to have
+*               its broadcasts sent to MULTICAST_GROUP instead of its socket. Each broadcast is then
+*               sent once, as a MulticastPacket with a sequence number, however many clients listen.
+*
+*               Multicast is lossy. A client that sees a gap in the sequence numbers sends
+*               ">>nack<< <first> <count>" over its TCP connection, and the missing broadcasts are
+*               resent to it over TCP from a history of the last MULTICAST_HISTORY_SLOTS. When the
+*               chat is quiet, a heartbeat with the next sequence number is sent every
+*               MULTICAST_HEARTBEAT_INTERVAL, so a client also notices when the last packets were lost.
+*
+*               Packets go out on MULTICAST_INTERFACE (loopback by default, so the mode can be tried on
+*               one host) with a TTL of 1.
+*/
+
+#include "../inc/serverMulticast.h"
+
+static int multicastSocket = -1;
+static struct sockaddr_in groupAddress;
+static int hasSubscribers = 0;
+
+static pthread_mutex_t multicastMutex = PTHREAD_MUTEX_INITIALIZER;
+static MulticastHistoryEntry* history = NULL;
+static uint64_t nextSequence = 0;
+static int64_t lastSendTime = 0;
+static MulticastStats multicastStats;
+
+
+/*
+* Function:     multicastMicroseconds
+* Purpose:      Gets the monotonic clock in microseconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Microseconds since an arbitrary start point.
+*/
+static int64_t multicastMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+/*
+* Function:     sendPacket
+* Purpose:      Sends one packet to the multicast group.
+*
+* Inputs:       uint32_t            kind            MULTICAST_KIND_BROADCAST or MULTICAST_KIND_HEARTBEAT.
+*               uint64_t            sequence        Sequence number of the packet.
+*               const Broadcast*    broadcastP      The broadcast, or NULL for a heartbeat.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void sendPacket(uint32_t kind, uint64_t sequence, const Broadcast* broadcastP)
+{
+    MulticastPacket packet;
+    memset(&packet, 0, sizeof(packet));
+    packet.magic = htonl(MULTICAST_MAGIC);
+    packet.kind = htonl(kind);
+    packet.sequence = htobe64(sequence);
+    if (broadcastP != NULL)
+    {
+        packet.broadcast = *broadcastP;
+    }
+
+    int isSent = sendto(multicastSocket, &packet, sizeof(packet), 0, (struct sockaddr*)&groupAddress, sizeof(groupAddress)) == sizeof(packet);
+
+    multicastStats.sendErrors += !isSent;
+    lastSendTime = multicastMicroseconds();
+}
+
+
+/*
+* Function:     multicastPublish
+* Purpose:      Numbers a broadcast, keeps it for repairs and sends it to the group.
+*
+* Inputs:       const Broadcast*    broadcastP      The broadcast.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void multicastPublish(const Broadcast* broadcastP)
+{
+    if (history == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&multicastMutex);
+
+    uint64_t sequence = nextSequence++;
+    MulticastHistoryEntry* entry = &history[sequence % MULTICAST_HISTORY_SLOTS];
+    entry->sequence = sequence;
+    entry->broadcast = *broadcastP;
+
+    sendPacket(MULTICAST_KIND_BROADCAST, sequence, broadcastP);
+    multicastStats.packetsSent++;
+
+    pthread_mutex_unlock(&multicastMutex);
+}
+
+
+/*
+* Function:     multicastHeartbeat
+* Purpose:      Sends a heartbeat if there are multicast clients and nothing was sent for
+*               MULTICAST_HEARTBEAT_INTERVAL. Cheap to call on every client monitor tick.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void multicastHeartbeat()
+{
+    if (history == NULL || !__atomic_load_n(&hasSubscribers, __ATOMIC_ACQUIRE))
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&multicastMutex);
+
+    if (multicastMicroseconds() - lastSendTime >= MULTICAST_HEARTBEAT_INTERVAL)
+    {
+        sendPacket(MULTICAST_KIND_HEARTBEAT, nextSequence, NULL);
+        multicastStats.heartbeatsSent++;
+    }
+
+    pthread_mutex_unlock(&multicastMutex);
+}
+
+
+/*
+* Function:     multicastGetNextSequence
+* Purpose:      Gets the sequence number the next broadcast will be sent with.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        The next sequence number.
+*/
+uint64_t multicastGetNextSequence()
+{
+    pthread_mutex_lock(&multicastMutex);
+    uint64_t sequence = nextSequence;
+    pthread_mutex_unlock(&multicastMutex);
+
+    return sequence;
+}
+
+
+/*
+* Function:     multicastAddSubscriber
+* Purpose:      Notes that a client has switched to multicast, so heartbeats are worth sending.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void multicastAddSubscriber()
+{
+    __atomic_store_n(&hasSubscribers, 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     multicastIsAvailable
+* Purpose:      Checks whether multicast is set up, i.e. whether clients can be moved onto it.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if multicast is available, 0 otherwise.
+*/
+int multicastIsAvailable()
+{
+    return history != NULL;
+}
+
+
+/*
+* Function:     multicastRepair
+* Purpose:      Handles a ">>nack<< <first> <count>" from a client: resends the broadcasts it missed
+*               over its TCP connection, in a single write, after a ">>repair<< <count> <lost>" header.
+*               Broadcasts that have already left the history are counted as lost.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const char*     nackArguments   The NACK message after ">>nack<<".
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void multicastRepair(int clientSocket, const char* nackArguments)
+{
+    MulticastHistoryEntry entries[MULTICAST_MAX_REPAIR];
+    char batch[(MULTICAST_MAX_REPAIR + 1) * JSON_LENGTH];
+
+    unsigned long long firstSequence = 0;
+    unsigned long long numWanted = 0;
+    if (history == NULL || sscanf(nackArguments, "%llu %llu", &firstSequence, &numWanted) != 2 || numWanted == 0)
+    {
+        return;
+    }
+
+    // Copy what is still in the history - the sends happen outside the lock
+    int numFound = 0;
+    uint64_t numLost = 0;
+
+    if (numWanted > MULTICAST_MAX_REPAIR)
+    {
+        // Too far behind to be worth repairing in full - the oldest are given up on
+        numLost = numWanted - MULTICAST_MAX_REPAIR;
+        firstSequence += numLost;
+        numWanted = MULTICAST_MAX_REPAIR;
+    }
+
+    pthread_mutex_lock(&multicastMutex);
+
+    for (uint64_t sequence = firstSequence; sequence < firstSequence + numWanted && sequence < nextSequence; sequence++)
+    {
+        MulticastHistoryEntry* entry = &history[sequence % MULTICAST_HISTORY_SLOTS];
+        if (entry->sequence == sequence)
+        {
+            entries[numFound++] = *entry;
+        }
+        else
+        {
+            numLost++;
+        }
+    }
+
+    multicastStats.nacksReceived++;
+    multicastStats.broadcastsRepaired += numFound;
+    multicastStats.broadcastsLost += numLost;
+
+    pthread_mutex_unlock(&multicastMutex);
+
+    Broadcast header = {.clientIP = "", .clientUserID = ""};
+    snprintf(header.message, sizeof(header.message), "%s %d %llu", MULTICAST_REPAIR_MSG, numFound, (unsigned long long)numLost);
+
+    size_t batchLength = 0;
+    for (int i = -1; i < numFound; i++)
+    {
+        char* json = broadcastToJson(i < 0 ? &header : &entries[i].broadcast);
+        if (json != NULL)
+        {
+            size_t jsonLength = strlen(json);
+            memcpy(batch + batchLength, json, jsonLength);
+            batchLength += jsonLength;
+            free(json);
+        }
+    }
+
+    clientSend(clientSocket, batch, batchLength, MSG_NOSIGNAL);
+}
+
+
+/*
+* Function:     multicastStart
+* Purpose:      Sets up the multicast socket and the repair history.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             MULTICAST_SUCCESS, or MULTICAST_ERROR if multicast is unavailable.
+*/
+int multicastStart()
+{
+    if ((multicastSocket = socket(AF_INET, SOCK_DGRAM, 0)) < 0)
+    {
+        perror("[SERVER] : socket() FAILED");
+        return MULTICAST_ERROR;
+    }
+
+    unsigned char ttl = MULTICAST_TTL;
+    unsigned char loop = 1; // Clients on this host get the packets too
+    struct in_addr interfaceAddress;
+    inet_pton(AF_INET, MULTICAST_INTERFACE, &interfaceAddress);
+
+    if (setsockopt(multicastSocket, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0 ||
+        setsockopt(multicastSocket, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop)) < 0 ||
+        setsockopt(multicastSocket, IPPROTO_IP, IP_MULTICAST_IF, &interfaceAddress, sizeof(interfaceAddress)) < 0)
+    {
+        perror("[SERVER] : setsockopt() FAILED");
+        close(multicastSocket);
+        return MULTICAST_ERROR;
+    }
+
+    memset(&groupAddress, 0, sizeof(groupAddress));
+    groupAddress.sin_family = AF_INET;
+    groupAddress.sin_port = htons(MULTICAST_PORT);
+    inet_pton(AF_INET, MULTICAST_GROUP, &groupAddress.sin_addr);
+
+    MulticastHistoryEntry* newHistory = memCalloc(MEM_HISTORY_CACHE, MULTICAST_HISTORY_SLOTS, sizeof(MulticastHistoryEntry));
+    if (newHistory == NULL)
+    {
+        close(multicastSocket);
+        return MULTICAST_ERROR;
+    }
+
+    // Slot 0 must not look like it holds sequence 0 yet
+    for (int i = 0; i < MULTICAST_HISTORY_SLOTS; i++)
+    {
+        newHistory[i].sequence = UINT64_MAX;
+    }
+    history = newHistory;
+
+    return MULTICAST_SUCCESS;
+}
+
+
+/*
+* Function:     multicastStop
+* Purpose:      Closes the multicast socket. The history stays until exit, as the broadcaster may
+*               still be running.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void multicastStop()
+{
+    if (multicastSocket >= 0)
+    {
+        pthread_mutex_lock(&multicastMutex);
+        close(multicastSocket);
+        multicastSocket = -1;
+        pthread_mutex_unlock(&multicastMutex);
+    }
+}
+
+
+/*
+* Function:     multicastGetStats
+* Purpose:      Gets the multicast counters.
+*
+* Inputs:       MulticastStats*     statsP      Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void multicastGetStats(MulticastStats* statsP)
+{
+    pthread_mutex_lock(&multicastMutex);
+    *statsP = multicastStats;
+    pthread_mutex_unlock(&multicastMutex);
+}
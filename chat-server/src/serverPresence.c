@@ -0,0 +1,743 @@
+/*
+* Filename:		serverPresence.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the presence roster of the CHAT-SYSTEM server.
+*
+*               When a client registers, it is sent the full roster of connected users once:
+*               a ">>roster<< <count>" server message followed by ">>online<< <userID> ..." frames.
+*               After that, it only receives deltas: ">>joined<< <userID> ..." and ">>left<< <userID> ...".
+*
+*               Joins and leaves are not sent as they happen. They are queued, and the presence thread
+*               sends them out every PRESENCE_WINDOW_LENGTH, packing as many user IDs as fit into each
+*               frame and all frames into one write per client. Within a window, a join and a leave of
+*               the same user cancel out, so a quick reconnect costs nothing. If more changes pile up
+*               than PRESENCE_MAX_PENDING, the queue is dropped and everyone gets a full roster instead,
+*               which is never bigger than MAX_CLIENTS user IDs. Deltas and typing frames are sent one
+*               registry shard at a time; only a full roster, which has to be consistent, locks them all.
+*
+*               Deltas are idempotent (a set of online users), so a delta that repeats what a client's
+*               roster already showed is harmless.
+*
+*               Typing indicators ride on the same thread but are lossy and lowest priority. A typing
+*               client pings ">>typing<<" every few hundred milliseconds; pings only refresh a timestamp.
+*               Each window, the set of users that pinged within TYPING_EXPIRY_LENGTH is turned into one
+*               ">>typing<< <userID> ..." frame, sent only when the set has changed. It is sent without
+*               blocking and skipped for any client that still has unsent output queued, and skipped
+*               altogether under memory pressure; a skipped frame is simply resent next window.
+*               There are no rooms, so the set is server-wide.
+*/
+
+#include "../inc/serverPresence.h"
+
+static pthread_mutex_t presenceMutex = PTHREAD_MUTEX_INITIALIZER;
+static PresenceDelta pendingDeltas[PRESENCE_MAX_PENDING];
+static int numPendingDeltas = 0;
+static int rosterResyncNeeded = 0;
+static PresenceStats presenceStats;
+
+static TypingUser typingUsers[MAX_CLIENTS];
+static int numTypingUsers = 0;
+static char lastTypingFrame[BROADCAST_MESSAGE_LENGTH + 1] = PRESENCE_TYPING_MSG;
+static int typingResendNeeded = 0;
+
+static SharedData* presenceSharedDataP = NULL;
+static pthread_t presenceThread;
+static int presenceIsRunning = PRESENCE_STOPPED;
+
+
+/*
+* Function:     appendFrame
+* Purpose:      Serializes a server message and appends it to a batch buffer.
+*
+* Inputs:       char*           batch           The batch buffer.
+*               size_t*         batchLengthP    Bytes used in the batch.
+*               size_t          batchCapacity   Size of the batch buffer.
+*               const char*     message         The server message.
+*
+* Outputs:      batch, batchLengthP
+*
+* Returns:      int                             1 if the frame was added, 0 if it did not fit.
+*/
+static int appendFrame(char* batch, size_t* batchLengthP, size_t batchCapacity, const char* message)
+{
+    Broadcast frame = {.clientIP = "", .clientUserID = ""};
+    strncpy(frame.message, message, BROADCAST_MESSAGE_LENGTH);
+    frame.message[BROADCAST_MESSAGE_LENGTH] = '\0'; // Ensure null termination
+
+    char* json = broadcastToJson(&frame);
+    if (json == NULL)
+    {
+        return 0;
+    }
+
+    size_t jsonLength = strlen(json);
+    int isAdded = *batchLengthP + jsonLength <= batchCapacity;
+    if (isAdded)
+    {
+        memcpy(batch + *batchLengthP, json, jsonLength);
+        *batchLengthP += jsonLength;
+    }
+    free(json);
+
+    return isAdded;
+}
+
+
+/*
+* Function:     appendUserFrames
+* Purpose:      Appends "<prefix> <userID> <userID> ..." frames for a list of users, packing as many
+*               user IDs into each frame as fit in a broadcast message.
+*
+* Inputs:       char*           batch           The batch buffer.
+*               size_t*         batchLengthP    Bytes used in the batch.
+*               size_t          batchCapacity   Size of the batch buffer.
+*               const char*     prefix          Frame prefix, e.g. PRESENCE_JOINED_MSG.
+*               const char*     userIDs[]       The user IDs.
+*               int             numUserIDs      Number of user IDs.
+*
+* Outputs:      batch, batchLengthP
+*
+* Returns:      int                             Number of frames added.
+*/
+static int appendUserFrames(char* batch, size_t* batchLengthP, size_t batchCapacity, const char* prefix,
+    const char* userIDs[], int numUserIDs)
+{
+    char message[BROADCAST_MESSAGE_LENGTH + 1];
+    int messageLength = 0;
+    int numFrames = 0;
+
+    for (int i = 0; i < numUserIDs; i++)
+    {
+        int userIDLength = (int)strlen(userIDs[i]);
+
+        // Flush the current frame if this user ID does not fit
+        if (messageLength > 0 && messageLength + 1 + userIDLength > BROADCAST_MESSAGE_LENGTH)
+        {
+            numFrames += appendFrame(batch, batchLengthP, batchCapacity, message);
+            messageLength = 0;
+        }
+
+        if (messageLength == 0)
+        {
+            messageLength = snprintf(message, sizeof(message), "%s", prefix);
+        }
+        messageLength += snprintf(message + messageLength, sizeof(message) - messageLength, " %s", userIDs[i]);
+    }
+
+    if (messageLength > 0)
+    {
+        numFrames += appendFrame(batch, batchLengthP, batchCapacity, message);
+    }
+
+    return numFrames;
+}
+
+
+/*
+* Function:     buildRoster
+* Purpose:      Builds the full roster frames of all connected users.
+*               NOTE: Make sure to lock and unlock all shards (registryLockAll()) before and after calling this function!
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to the shared data structure.
+*               char*           batch           The batch buffer.
+*               size_t*         batchLengthP    Bytes used in the batch.
+*               size_t          batchCapacity   Size of the batch buffer.
+*
+* Outputs:      batch, batchLengthP
+*
+* Returns:      int                             Number of frames added.
+*/
+static int buildRoster(SharedData* sharedDataP, char* batch, size_t* batchLengthP, size_t batchCapacity)
+{
+    // Off the caller's stack like the batch - every shard is locked, so only one roster is built at a time
+    static const char* userIDs[MAX_CLIENTS];
+    int numUserIDs = 0;
+
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+    {
+        RegistryShard* shardP = &sharedDataP->shards[shard];
+        for (int i = 0; i < shardP->numClients; i++)
+        {
+            userIDs[numUserIDs++] = shardP->connectedClients[i].clientUserID;
+        }
+    }
+
+    char header[BROADCAST_MESSAGE_LENGTH + 1];
+    snprintf(header, sizeof(header), "%s %d", PRESENCE_ROSTER_MSG, numUserIDs);
+
+    int numFrames = appendFrame(batch, batchLengthP, batchCapacity, header);
+    numFrames += appendUserFrames(batch, batchLengthP, batchCapacity, PRESENCE_ONLINE_MSG, userIDs, numUserIDs);
+
+    return numFrames;
+}
+
+
+/*
+* Function:     presenceSendRoster
+* Purpose:      Sends the full roster to a newly registered client in a single write. It is queued whole
+*               without waiting for the socket, so nothing sent to the client after the shards are
+*               unlocked can overtake it. If the client's output queue cannot take it, everyone gets a
+*               full roster next window instead.
+*               NOTE: Make sure to lock and unlock all shards (registryLockAll()) before and after calling this function!
+*
+* Inputs:       int             clientSocket    Client's socket.
+*               SharedData*     sharedDataP     Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void presenceSendRoster(int clientSocket, SharedData* sharedDataP)
+{
+    // Too big for a client handler's stack with many clients - and every shard is locked, so one roster is built at a time
+    static char batch[(MAX_CLIENTS + 1) * JSON_LENGTH];
+    size_t batchLength = 0;
+
+    int numFrames = buildRoster(sharedDataP, batch, &batchLength, sizeof(batch));
+    int isSent = clientSend(clientSocket, batch, batchLength, MSG_DONTWAIT) >= 0;
+
+    pthread_mutex_lock(&presenceMutex);
+    if (isSent)
+    {
+        presenceStats.framesSent += numFrames;
+    }
+    else
+    {
+        rosterResyncNeeded = 1;
+    }
+    pthread_mutex_unlock(&presenceMutex);
+
+    if (!isSent)
+    {
+        fprintf(stderr, "[PRESENCE] : could not queue the roster for socket %d - sending everyone a full roster\n", clientSocket);
+    }
+}
+
+
+/*
+* Function:     queueDelta
+* Purpose:      Queues a join or leave, cancelling out the opposite change of the same user if it
+*               is still pending.
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*               int             isJoin          1 for a join, 0 for a leave.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void queueDelta(const char* clientIP, const char* clientUserID, int isJoin)
+{
+    pthread_mutex_lock(&presenceMutex);
+
+    presenceStats.deltasQueued++;
+
+    for (int i = 0; i < numPendingDeltas; i++)
+    {
+        if (strncmp(pendingDeltas[i].clientIP, clientIP, CLIENT_IP_LENGTH) == 0 &&
+            strncmp(pendingDeltas[i].clientUserID, clientUserID, CLIENT_USERID_LENGTH) == 0 &&
+            pendingDeltas[i].isJoin != isJoin)
+        {
+            // Joined and left (or the other way round) within the window - nothing to tell
+            pendingDeltas[i] = pendingDeltas[--numPendingDeltas];
+            presenceStats.deltasCoalesced += 2;
+            pthread_mutex_unlock(&presenceMutex);
+            return;
+        }
+    }
+
+    if (numPendingDeltas == PRESENCE_MAX_PENDING)
+    {
+        // Too much churn - a full roster is cheaper than the deltas
+        numPendingDeltas = 0;
+        rosterResyncNeeded = 1;
+    }
+
+    if (!rosterResyncNeeded)
+    {
+        PresenceDelta* delta = &pendingDeltas[numPendingDeltas++];
+        strncpy(delta->clientIP, clientIP, CLIENT_IP_LENGTH);
+        delta->clientIP[CLIENT_IP_LENGTH] = '\0'; // Ensure null termination
+        strncpy(delta->clientUserID, clientUserID, CLIENT_USERID_LENGTH);
+        delta->clientUserID[CLIENT_USERID_LENGTH] = '\0'; // Ensure null termination
+        delta->isJoin = isJoin;
+    }
+
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+
+/*
+* Function:     presenceJoined
+* Purpose:      Queues a "joined" delta for a user that has registered.
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void presenceJoined(const char* clientIP, const char* clientUserID)
+{
+    queueDelta(clientIP, clientUserID, 1);
+}
+
+
+/*
+* Function:     presenceLeft
+* Purpose:      Queues a "left" delta for a user that has disconnected.
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void presenceLeft(const char* clientIP, const char* clientUserID)
+{
+    queueDelta(clientIP, clientUserID, 0);
+}
+
+
+/*
+* Function:     flushDeltas
+* Purpose:      Sends the deltas queued during the last window to all connected clients,
+*               one write per client.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void flushDeltas()
+{
+    static PresenceDelta deltas[PRESENCE_MAX_PENDING];
+    static char batch[PRESENCE_BATCH_LENGTH];
+
+    // Take the queue - the lock is not held while sending
+    pthread_mutex_lock(&presenceMutex);
+    int numDeltas = numPendingDeltas;
+    int isResync = rosterResyncNeeded;
+    memcpy(deltas, pendingDeltas, numDeltas * sizeof(PresenceDelta));
+    numPendingDeltas = 0;
+    rosterResyncNeeded = 0;
+    pthread_mutex_unlock(&presenceMutex);
+
+    if (numDeltas == 0 && !isResync)
+    {
+        return;
+    }
+
+    size_t batchLength = 0;
+    int numFrames = 0;
+    int numClients = 0;
+
+    if (isResync)
+    {
+        // The roster is built with every shard locked, so it matches the registry. Any change after it
+        // queues a delta for the next window, so it is sent like the deltas - one shard locked at a time
+        registryLockAll(presenceSharedDataP);
+        numFrames = buildRoster(presenceSharedDataP, batch, &batchLength, sizeof(batch));
+        registryUnlockAll(presenceSharedDataP);
+    }
+    else
+    {
+        const char* joined[PRESENCE_MAX_PENDING];
+        const char* left[PRESENCE_MAX_PENDING];
+        int numJoined = 0;
+        int numLeft = 0;
+
+        for (int i = 0; i < numDeltas; i++)
+        {
+            if (deltas[i].isJoin)
+            {
+                joined[numJoined++] = deltas[i].clientUserID;
+            }
+            else
+            {
+                left[numLeft++] = deltas[i].clientUserID;
+            }
+        }
+
+        numFrames += appendUserFrames(batch, &batchLength, sizeof(batch), PRESENCE_LEFT_MSG, left, numLeft);
+        numFrames += appendUserFrames(batch, &batchLength, sizeof(batch), PRESENCE_JOINED_MSG, joined, numJoined);
+    }
+
+    // Deltas are idempotent, so each shard can be sent them on its own
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+    {
+        RegistryShard* shardP = &presenceSharedDataP->shards[shard];
+
+        pthread_mutex_lock(&shardP->mutex);
+        for (int i = 0; i < shardP->numClients; i++)
+        {
+            clientSend(shardP->connectedClients[i].clientSocket, batch, batchLength, 0);
+        }
+        numClients += shardP->numClients;
+        pthread_mutex_unlock(&shardP->mutex);
+    }
+
+    pthread_mutex_lock(&presenceMutex);
+    presenceStats.batchesSent += numClients;
+    presenceStats.framesSent += (uint64_t)numFrames * numClients;
+    presenceStats.rosterResyncs += isResync;
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+
+/*
+* Function:     monotonicMicroseconds
+* Purpose:      Gets the monotonic clock in microseconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Microseconds since an arbitrary start point.
+*/
+static int64_t monotonicMicroseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+
+/*
+* Function:     findTypingUser
+* Purpose:      Finds a user in the typing set.
+*               NOTE: Make sure to lock and unlock presenceMutex before and after calling this function!
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      int                             Index in typingUsers, or -1 if the user is not typing.
+*/
+static int findTypingUser(const char* clientIP, const char* clientUserID)
+{
+    for (int i = 0; i < numTypingUsers; i++)
+    {
+        if (strncmp(typingUsers[i].clientIP, clientIP, CLIENT_IP_LENGTH) == 0 &&
+            strncmp(typingUsers[i].clientUserID, clientUserID, CLIENT_USERID_LENGTH) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+* Function:     presenceTyping
+* Purpose:      Records a typing ping. Nothing is sent here - the presence thread picks it up.
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void presenceTyping(const char* clientIP, const char* clientUserID)
+{
+    int64_t now = monotonicMicroseconds();
+
+    pthread_mutex_lock(&presenceMutex);
+
+    presenceStats.typingPings++;
+
+    int typingIndex = findTypingUser(clientIP, clientUserID);
+    if (typingIndex == -1 && numTypingUsers < MAX_CLIENTS)
+    {
+        typingIndex = numTypingUsers++;
+        TypingUser* typingUser = &typingUsers[typingIndex];
+        strncpy(typingUser->clientIP, clientIP, CLIENT_IP_LENGTH);
+        typingUser->clientIP[CLIENT_IP_LENGTH] = '\0'; // Ensure null termination
+        strncpy(typingUser->clientUserID, clientUserID, CLIENT_USERID_LENGTH);
+        typingUser->clientUserID[CLIENT_USERID_LENGTH] = '\0'; // Ensure null termination
+    }
+
+    if (typingIndex != -1)
+    {
+        typingUsers[typingIndex].lastPing = now;
+    }
+
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+
+/*
+* Function:     presenceStoppedTyping
+* Purpose:      Takes a user out of the typing set, e.g. once their message has been sent or they left.
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void presenceStoppedTyping(const char* clientIP, const char* clientUserID)
+{
+    pthread_mutex_lock(&presenceMutex);
+
+    int typingIndex = findTypingUser(clientIP, clientUserID);
+    if (typingIndex != -1)
+    {
+        typingUsers[typingIndex] = typingUsers[--numTypingUsers];
+    }
+
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+
+/*
+* Function:     buildTypingFrame
+* Purpose:      Drops expired typists and builds the ">>typing<<" message for the rest. Typists that do
+*               not fit in one message are counted as " +N" at the end.
+*               NOTE: Make sure to lock and unlock presenceMutex before and after calling this function!
+*
+* Inputs:       char*           message         Where to build the message (BROADCAST_MESSAGE_LENGTH + 1 bytes).
+*
+* Outputs:      message
+*
+* Returns:      void
+*/
+static void buildTypingFrame(char* message)
+{
+    int64_t expiredBefore = monotonicMicroseconds() - TYPING_EXPIRY_LENGTH;
+
+    for (int i = 0; i < numTypingUsers; )
+    {
+        if (typingUsers[i].lastPing < expiredBefore)
+        {
+            typingUsers[i] = typingUsers[--numTypingUsers];
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    int messageLength = snprintf(message, BROADCAST_MESSAGE_LENGTH + 1, "%s", PRESENCE_TYPING_MSG);
+    int numListed = 0;
+
+    for (; numListed < numTypingUsers; numListed++)
+    {
+        int userIDLength = (int)strlen(typingUsers[numListed].clientUserID);
+        int roomLeft = BROADCAST_MESSAGE_LENGTH - messageLength;
+        int isLast = numListed == numTypingUsers - 1;
+
+        // Keep room for the " +N" count unless this is the last one
+        if (1 + userIDLength > roomLeft - (isLast ? 0 : TYPING_MORE_LENGTH))
+        {
+            break;
+        }
+        messageLength += snprintf(message + messageLength, BROADCAST_MESSAGE_LENGTH + 1 - messageLength,
+            " %s", typingUsers[numListed].clientUserID);
+    }
+
+    if (numListed < numTypingUsers)
+    {
+        snprintf(message + messageLength, BROADCAST_MESSAGE_LENGTH + 1 - messageLength, " +%d", numTypingUsers - numListed);
+    }
+}
+
+
+/*
+* Function:     flushTyping
+* Purpose:      Sends the "who is typing" frame to all connected clients if it has changed. It never
+*               waits: the frame is queued whole or not at all, a client that still has output queued
+*               (in its socket or its output queue) is skipped, and so is everyone while the server is
+*               under memory pressure. Skipped clients get the frame next window.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void flushTyping()
+{
+    char message[BROADCAST_MESSAGE_LENGTH + 1];
+
+    pthread_mutex_lock(&presenceMutex);
+    buildTypingFrame(message);
+    int isChanged = typingResendNeeded || strcmp(message, lastTypingFrame) != 0;
+    pthread_mutex_unlock(&presenceMutex);
+
+    if (!isChanged)
+    {
+        return;
+    }
+
+    if (memIsUnderPressure())
+    {
+        // Typing is the first thing to go
+        memNoteShed(MEM_OUTBOUND_BUFFERS);
+        pthread_mutex_lock(&presenceMutex);
+        typingResendNeeded = 1;
+        presenceStats.typingFramesDropped++;
+        pthread_mutex_unlock(&presenceMutex);
+        return;
+    }
+
+    char frame[JSON_LENGTH];
+    size_t frameLength = 0;
+    if (!appendFrame(frame, &frameLength, sizeof(frame), message))
+    {
+        return;
+    }
+
+    int numSent = 0;
+    int numDropped = 0;
+
+    for (int shard = 0; shard < REGISTRY_NUM_SHARDS; shard++)
+    {
+        RegistryShard* shardP = &presenceSharedDataP->shards[shard];
+
+        pthread_mutex_lock(&shardP->mutex);
+
+        for (int i = 0; i < shardP->numClients; i++)
+        {
+            int clientSocket = shardP->connectedClients[i].clientSocket;
+            int unsentBytes = 0;
+
+            // Chat and presence data already queued for this client go first
+            if (ioctl(clientSocket, SIOCOUTQ, &unsentBytes) != 0)
+            {
+                unsentBytes = 0;
+            }
+            if (unsentBytes + tlsGetPendingLength(clientSocket) > TYPING_MAX_UNSENT_BYTES)
+            {
+                numDropped++;
+                continue;
+            }
+
+            if (clientSend(clientSocket, frame, frameLength, MSG_DONTWAIT) == (ssize_t)frameLength)
+            {
+                numSent++;
+            }
+            else
+            {
+                numDropped++;
+            }
+        }
+
+        pthread_mutex_unlock(&shardP->mutex);
+    }
+
+    pthread_mutex_lock(&presenceMutex);
+    strcpy(lastTypingFrame, message);
+    typingResendNeeded = numDropped > 0;
+    presenceStats.typingFramesSent += numSent;
+    presenceStats.typingFramesDropped += numDropped;
+    pthread_mutex_unlock(&presenceMutex);
+}
+
+
+/*
+* Function:     presenceBroadcaster
+* Purpose:      Presence thread - sends the queued deltas, then the typing frame, every PRESENCE_WINDOW_LENGTH.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* presenceBroadcaster(void* arg)
+{
+    (void)arg;
+
+    int ticksPerWindow = PRESENCE_WINDOW_LENGTH / PRESENCE_LOOP_SLEEP_LENGTH;
+    int ticks = 0;
+
+    while (__atomic_load_n(&presenceIsRunning, __ATOMIC_ACQUIRE))
+    {
+        if (ticks >= ticksPerWindow)
+        {
+            ticks = 0;
+            flushDeltas();
+            flushTyping();
+        }
+
+        usleep(PRESENCE_LOOP_SLEEP_LENGTH);
+        ticks++;
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     presenceStart
+* Purpose:      Starts the presence thread.
+*
+* Inputs:       SharedData*     sharedDataP     Pointer to the shared data structure.
+*
+* Outputs:      None
+*
+* Returns:      int                             PRESENCE_SUCCESS, or PRESENCE_ERROR if the thread could not be started.
+*/
+int presenceStart(SharedData* sharedDataP)
+{
+    presenceSharedDataP = sharedDataP;
+    __atomic_store_n(&presenceIsRunning, PRESENCE_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&presenceThread, NULL, presenceBroadcaster, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&presenceIsRunning, PRESENCE_STOPPED, __ATOMIC_RELEASE);
+        return PRESENCE_ERROR;
+    }
+
+    return PRESENCE_SUCCESS;
+}
+
+
+/*
+* Function:     presenceStop
+* Purpose:      Stops the presence thread. Pending deltas are dropped - nobody is left to send them to.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void presenceStop()
+{
+    if (__atomic_load_n(&presenceIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&presenceIsRunning, PRESENCE_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(presenceThread, NULL);
+    }
+}
+
+
+/*
+* Function:     presenceGetStats
+* Purpose:      Gets the presence counters.
+*
+* Inputs:       PresenceStats*  statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void presenceGetStats(PresenceStats* statsP)
+{
+    pthread_mutex_lock(&presenceMutex);
+    *statsP = presenceStats;
+    pthread_mutex_unlock(&presenceMutex);
+}
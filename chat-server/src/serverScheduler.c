@@ -0,0 +1,588 @@
+/*
+* Filename:		serverScheduler.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the work-stealing task scheduler of the CHAT-SYSTEM server.
+*
+*               Work that can be split into independent tasks (today: the chunks of a broadcast's fan-out)
+*               is run on a pool of worker threads, one per online CPU up to SCHEDULER_MAX_WORKERS,
+*               instead of on the one thread whose role it is. When one room is busy and the rest are
+*               idle, all of the workers take part rather than one thread doing it all.
+*
+*               Each worker has a Chase-Lev deque: the worker pushes and takes tasks at the bottom
+*               without locking, and idle workers steal from the top with a single compare-and-swap.
+*               Tasks submitted from outside a worker go to a worker's inbox (a short mutex-protected
+*               list), which that worker moves into its deque. A task submitted with an affinity (e.g. a
+*               slice of the client registry) always goes to the same worker, so the same sockets are
+*               normally written from the same CPU - stealing only moves work when that worker is behind.
+*
+*               A submitter waits for its task group in schedulerWait(), running (stealing) tasks
+*               itself while it waits, so a group always finishes even if every worker is busy.
+*
+*               Workers with nothing to run or steal sleep on a condition variable. A submitter only
+*               takes the sleep mutex when a worker is actually asleep.
+*
+*               NOTE: Tasks must not take a mutex their submitter may be holding while it waits.
+*/
+
+#include "../inc/serverScheduler.h"
+
+#define SCHEDULER_DEQUE_MASK (SCHEDULER_DEQUE_LENGTH - 1)
+
+// Each part is on its own cache line: top is written by thieves, bottom and the counters only by the
+// owner, and the inbox by submitters - none of them invalidates the line another is using.
+typedef struct
+{
+    pthread_t thread;
+    // Chase-Lev deque - the owner pushes and takes at bottom, thieves steal at top
+    int64_t top __attribute__((aligned(CACHE_LINE_LENGTH)));
+    int64_t bottom __attribute__((aligned(CACHE_LINE_LENGTH)));
+    SchedulerTask* tasks[SCHEDULER_DEQUE_LENGTH];
+    // Tasks submitted from other threads, until the owner moves them into the deque
+    pthread_mutex_t inboxMutex __attribute__((aligned(CACHE_LINE_LENGTH)));
+    SchedulerTask* inboxHead;
+    SchedulerTask* inboxTail;
+    // Counted by the worker itself, summed by schedulerGetStats()
+    SchedulerStats counters __attribute__((aligned(CACHE_LINE_LENGTH)));
+} __attribute__((aligned(CACHE_LINE_LENGTH))) SchedulerWorker;
+
+// Counts from threads that are not workers (submitters and waiters)
+static SchedulerStats schedulerStats __attribute__((aligned(CACHE_LINE_LENGTH)));
+
+#define SCHEDULER_COUNT(counter, amount) \
+    __atomic_add_fetch(&(currentWorker != NULL ? &currentWorker->counters : &schedulerStats)->counter, amount, __ATOMIC_RELAXED)
+
+static SchedulerWorker schedulerWorkers[SCHEDULER_MAX_WORKERS];
+static int numSchedulerWorkers = 0;           // Published once every worker is set up - workers may already be stealing
+static int schedulerIsRunning = SCHEDULER_STOPPED;
+static unsigned int nextWorker = 0;
+
+// Worker running on this thread, if any
+static __thread SchedulerWorker* currentWorker = NULL;
+
+// Sleeping workers wait for numQueued (tasks submitted and not yet taken) to go above 0
+static pthread_mutex_t sleepMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t workAvailable = PTHREAD_COND_INITIALIZER;
+static int numSleeping = 0;
+static int numQueued = 0;
+
+
+/*
+* Function:     pushTask
+* Purpose:      Pushes a task at the bottom of a worker's deque.
+*               NOTE: Only the worker itself may call this!
+*
+* Inputs:       SchedulerWorker* workerP        The worker.
+*               SchedulerTask*  taskP           The task.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if pushed, 0 if the deque is full.
+*/
+static int pushTask(SchedulerWorker* workerP, SchedulerTask* taskP)
+{
+    int64_t bottom = __atomic_load_n(&workerP->bottom, __ATOMIC_RELAXED);
+    int64_t top = __atomic_load_n(&workerP->top, __ATOMIC_ACQUIRE);
+
+    if (bottom - top >= SCHEDULER_DEQUE_LENGTH)
+    {
+        return 0;
+    }
+
+    __atomic_store_n(&workerP->tasks[bottom & SCHEDULER_DEQUE_MASK], taskP, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&workerP->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+
+/*
+* Function:     takeTask
+* Purpose:      Takes the newest task from the bottom of a worker's deque. Races with thieves only for the
+*               last task, and settles that with the same compare-and-swap they use.
+*               NOTE: Only the worker itself may call this!
+*
+* Inputs:       SchedulerWorker* workerP        The worker.
+*
+* Outputs:      None
+*
+* Returns:      SchedulerTask*                  The task, or NULL if the deque is empty.
+*/
+static SchedulerTask* takeTask(SchedulerWorker* workerP)
+{
+    int64_t bottom = __atomic_load_n(&workerP->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&workerP->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t top = __atomic_load_n(&workerP->top, __ATOMIC_RELAXED);
+
+    if (top > bottom)
+    {
+        // Empty
+        __atomic_store_n(&workerP->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return NULL;
+    }
+
+    SchedulerTask* taskP = __atomic_load_n(&workerP->tasks[bottom & SCHEDULER_DEQUE_MASK], __ATOMIC_RELAXED);
+    if (top == bottom)
+    {
+        // Last one - a thief may be after it too
+        if (!__atomic_compare_exchange_n(&workerP->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            taskP = NULL;
+        }
+        __atomic_store_n(&workerP->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return taskP;
+}
+
+
+/*
+* Function:     stealTask
+* Purpose:      Steals the oldest task from the top of another worker's deque, or else from its inbox.
+*
+* Inputs:       SchedulerWorker* victimP        The worker to steal from.
+*
+* Outputs:      None
+*
+* Returns:      SchedulerTask*                  The task, or NULL if there was none (or another thief won it).
+*/
+static SchedulerTask* stealTask(SchedulerWorker* victimP)
+{
+    int64_t top = __atomic_load_n(&victimP->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&victimP->bottom, __ATOMIC_ACQUIRE);
+
+    if (top < bottom)
+    {
+        SchedulerTask* taskP = __atomic_load_n(&victimP->tasks[top & SCHEDULER_DEQUE_MASK], __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&victimP->top, &top, top + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED))
+        {
+            return taskP;
+        }
+        return NULL;
+    }
+
+    // Nothing in the deque - the victim may be busy with a long task and not have emptied its inbox
+    SchedulerTask* taskP = NULL;
+    if (__atomic_load_n(&victimP->inboxHead, __ATOMIC_RELAXED) != NULL && pthread_mutex_trylock(&victimP->inboxMutex) == 0)
+    {
+        taskP = victimP->inboxHead;
+        if (taskP != NULL)
+        {
+            __atomic_store_n(&victimP->inboxHead, taskP->next, __ATOMIC_RELAXED);
+            if (victimP->inboxHead == NULL)
+            {
+                victimP->inboxTail = NULL;
+            }
+        }
+        pthread_mutex_unlock(&victimP->inboxMutex);
+    }
+
+    return taskP;
+}
+
+
+/*
+* Function:     findTask
+* Purpose:      Finds a task to run: from the caller's own deque and inbox if it is a worker, otherwise
+*               (or if those are empty) stolen from the other workers.
+*
+* Inputs:       SchedulerWorker* workerP        The calling worker, or NULL for another thread.
+*
+* Outputs:      None
+*
+* Returns:      SchedulerTask*                  The task, or NULL if none was found.
+*/
+static SchedulerTask* findTask(SchedulerWorker* workerP)
+{
+    SchedulerTask* taskP = NULL;
+
+    if (workerP != NULL)
+    {
+        if ((taskP = takeTask(workerP)) != NULL)
+        {
+            return taskP;
+        }
+
+        // Move the inbox into the deque, where the others can steal from it
+        if (__atomic_load_n(&workerP->inboxHead, __ATOMIC_RELAXED) != NULL)
+        {
+            pthread_mutex_lock(&workerP->inboxMutex);
+            while (workerP->inboxHead != NULL && pushTask(workerP, workerP->inboxHead))
+            {
+                __atomic_store_n(&workerP->inboxHead, workerP->inboxHead->next, __ATOMIC_RELAXED);
+            }
+            if (workerP->inboxHead == NULL)
+            {
+                workerP->inboxTail = NULL;
+            }
+            pthread_mutex_unlock(&workerP->inboxMutex);
+
+            if ((taskP = takeTask(workerP)) != NULL)
+            {
+                return taskP;
+            }
+        }
+    }
+
+    // Steal, starting from a different worker each time so thieves spread out
+    int start = __atomic_fetch_add(&nextWorker, 1, __ATOMIC_RELAXED);
+    int numWorkers = __atomic_load_n(&numSchedulerWorkers, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < numWorkers && taskP == NULL; i++)
+    {
+        SchedulerWorker* victimP = &schedulerWorkers[(start + i) % numWorkers];
+        if (victimP != workerP)
+        {
+            taskP = stealTask(victimP);
+        }
+    }
+
+    if (taskP != NULL && workerP != NULL)
+    {
+        SCHEDULER_COUNT(tasksStolen, 1);
+    }
+
+    return taskP;
+}
+
+
+/*
+* Function:     runTask
+* Purpose:      Runs a task and counts it done in its group.
+*
+* Inputs:       SchedulerTask*  taskP           The task.
+*               int             isQueued        1 if the task was taken from a deque or inbox.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void runTask(SchedulerTask* taskP, int isQueued)
+{
+    if (isQueued)
+    {
+        __atomic_sub_fetch(&numQueued, 1, __ATOMIC_SEQ_CST);
+    }
+
+    // Read before running - the task (and its group) may be gone as soon as the group is done
+    SchedulerGroup* groupP = taskP->groupP;
+
+    taskP->function(taskP->arg);
+    SCHEDULER_COUNT(tasksRun, 1);
+
+    __atomic_sub_fetch(&groupP->numPending, 1, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     schedulerWorker
+* Purpose:      Thread function for a worker. Runs its own tasks, steals when it has none, and sleeps
+*               when nobody has any.
+*
+* Inputs:       void*           arg             The worker's SchedulerWorker.
+*
+* Outputs:      None
+*
+* Returns:      void*                           NULL
+*/
+static void* schedulerWorker(void* arg)
+{
+    currentWorker = arg;
+
+    while (__atomic_load_n(&schedulerIsRunning, __ATOMIC_ACQUIRE))
+    {
+        SchedulerTask* taskP = findTask(currentWorker);
+        if (taskP != NULL)
+        {
+            runTask(taskP, 1);
+            continue;
+        }
+
+        pthread_mutex_lock(&sleepMutex);
+        __atomic_add_fetch(&numSleeping, 1, __ATOMIC_SEQ_CST);
+
+        int hasQueuedTasks = __atomic_load_n(&numQueued, __ATOMIC_SEQ_CST) > 0;
+        while (!hasQueuedTasks && __atomic_load_n(&schedulerIsRunning, __ATOMIC_ACQUIRE))
+        {
+            pthread_cond_wait(&workAvailable, &sleepMutex);
+            hasQueuedTasks = __atomic_load_n(&numQueued, __ATOMIC_SEQ_CST) > 0;
+        }
+
+        __atomic_sub_fetch(&numSleeping, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&sleepMutex);
+
+        // Queued somewhere, but just taken by someone else - let them get on with it
+        if (hasQueuedTasks)
+        {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+* Function:     schedulerSubmit
+* Purpose:      Submits a task. Without workers (or with a full deque), the task is run right here.
+*
+* Inputs:       SchedulerTask*  taskP           Storage for the task - must stay valid until the group is waited for.
+*               SchedulerGroup* groupP          The task's group.
+*               SchedulerFunction function      The task's code.
+*               void*           arg             Passed to function.
+*               int             affinity        Key for the worker that should run it (e.g. a chunk of
+*                                               sockets), or SCHEDULER_ANY_WORKER.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void schedulerSubmit(SchedulerTask* taskP, SchedulerGroup* groupP, SchedulerFunction function, void* arg, int affinity)
+{
+    taskP->function = function;
+    taskP->arg = arg;
+    taskP->groupP = groupP;
+    taskP->next = NULL;
+
+    __atomic_add_fetch(&groupP->numPending, 1, __ATOMIC_RELAXED);
+    SCHEDULER_COUNT(tasksSubmitted, 1);
+
+    if (!__atomic_load_n(&schedulerIsRunning, __ATOMIC_ACQUIRE) || numSchedulerWorkers == 0)
+    {
+        SCHEDULER_COUNT(tasksRunInline, 1);
+        runTask(taskP, 0);
+        return;
+    }
+
+    SchedulerWorker* targetP = currentWorker;
+    if (affinity != SCHEDULER_ANY_WORKER)
+    {
+        targetP = &schedulerWorkers[(unsigned int)affinity % numSchedulerWorkers];
+    }
+    else if (targetP == NULL)
+    {
+        targetP = &schedulerWorkers[__atomic_fetch_add(&nextWorker, 1, __ATOMIC_RELAXED) % numSchedulerWorkers];
+    }
+
+    if (targetP == currentWorker)
+    {
+        if (!pushTask(targetP, taskP))
+        {
+            SCHEDULER_COUNT(tasksRunInline, 1);
+            runTask(taskP, 0);
+            return;
+        }
+    }
+    else
+    {
+        pthread_mutex_lock(&targetP->inboxMutex);
+        if (targetP->inboxTail != NULL)
+        {
+            targetP->inboxTail->next = taskP;
+        }
+        else
+        {
+            __atomic_store_n(&targetP->inboxHead, taskP, __ATOMIC_RELAXED);
+        }
+        targetP->inboxTail = taskP;
+        pthread_mutex_unlock(&targetP->inboxMutex);
+    }
+
+    // Paired with the sleeping worker's numSleeping then numQueued - one of the two sees the other
+    __atomic_add_fetch(&numQueued, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&numSleeping, __ATOMIC_SEQ_CST) > 0)
+    {
+        pthread_mutex_lock(&sleepMutex);
+        pthread_cond_signal(&workAvailable);
+        pthread_mutex_unlock(&sleepMutex);
+    }
+}
+
+
+/*
+* Function:     schedulerWait
+* Purpose:      Waits until every task in a group has run, running other tasks meanwhile.
+*
+* Inputs:       SchedulerGroup* groupP          The group.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void schedulerWait(SchedulerGroup* groupP)
+{
+    int numSpins = 0;
+
+    while (__atomic_load_n(&groupP->numPending, __ATOMIC_ACQUIRE) > 0)
+    {
+        SchedulerTask* taskP = findTask(currentWorker);
+        if (taskP != NULL)
+        {
+            if (currentWorker == NULL)
+            {
+                SCHEDULER_COUNT(tasksRunByWaiters, 1);
+            }
+            runTask(taskP, 1);
+            numSpins = 0;
+        }
+        else if (++numSpins < SCHEDULER_WAIT_SPINS)
+        {
+            sched_yield();
+        }
+        else
+        {
+            // The rest are running somewhere, and taking a while (e.g. a slow client's socket)
+            usleep(SCHEDULER_WAIT_SLEEP_LENGTH);
+        }
+    }
+}
+
+
+/*
+* Function:     schedulerIsAvailable
+* Purpose:      Checks whether there are workers to spread tasks over.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if there are, 0 if submitted tasks just run in the submitter.
+*/
+int schedulerIsAvailable()
+{
+    return __atomic_load_n(&schedulerIsRunning, __ATOMIC_ACQUIRE) && numSchedulerWorkers > 1;
+}
+
+
+/*
+* Function:     schedulerStart
+* Purpose:      Starts the workers - one per online CPU (or SCHEDULER_NUM_WORKERS), up to SCHEDULER_MAX_WORKERS.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             SCHEDULER_SUCCESS, or SCHEDULER_ERROR if no worker could be started.
+*/
+int schedulerStart()
+{
+    long numCPUs = SCHEDULER_NUM_WORKERS > 0 ? SCHEDULER_NUM_WORKERS : sysconf(_SC_NPROCESSORS_ONLN);
+
+    return schedulerStartWorkers(numCPUs < 1 ? 1 : (int)numCPUs);
+}
+
+
+/*
+* Function:     schedulerStartWorkers
+* Purpose:      Starts a given number of workers, up to SCHEDULER_MAX_WORKERS. The scheduler can be started
+*               again with another number once schedulerStop() has returned.
+*
+* Inputs:       int         numWanted           Workers to start.
+*
+* Outputs:      None
+*
+* Returns:      int                             SCHEDULER_SUCCESS, or SCHEDULER_ERROR if no worker could be started.
+*/
+int schedulerStartWorkers(int numWanted)
+{
+    int numWorkers;
+
+    if (numWanted > SCHEDULER_MAX_WORKERS)
+    {
+        numWanted = SCHEDULER_MAX_WORKERS;
+    }
+
+    __atomic_store_n(&schedulerIsRunning, SCHEDULER_RUNNING, __ATOMIC_RELEASE);
+
+    for (numWorkers = 0; numWorkers < numWanted; numWorkers++)
+    {
+        SchedulerWorker* workerP = &schedulerWorkers[numWorkers];
+        memset(workerP, 0, sizeof(SchedulerWorker));
+        pthread_mutex_init(&workerP->inboxMutex, NULL);
+
+        if (pthread_create(&workerP->thread, NULL, schedulerWorker, workerP) != 0)
+        {
+            perror("pthread_create");
+            break;
+        }
+    }
+
+    // Workers steal from each other only once all of them exist
+    __atomic_store_n(&numSchedulerWorkers, numWorkers, __ATOMIC_RELEASE);
+    schedulerStats.numWorkers = numWorkers;
+
+    if (numWorkers == 0)
+    {
+        __atomic_store_n(&schedulerIsRunning, SCHEDULER_STOPPED, __ATOMIC_RELEASE);
+        return SCHEDULER_ERROR;
+    }
+
+    return SCHEDULER_SUCCESS;
+}
+
+
+/*
+* Function:     schedulerStop
+* Purpose:      Stops the workers. Tasks submitted from now on run in the submitter.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void schedulerStop()
+{
+    if (!schedulerIsRunning)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&sleepMutex);
+    __atomic_store_n(&schedulerIsRunning, SCHEDULER_STOPPED, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&workAvailable);
+    pthread_mutex_unlock(&sleepMutex);
+
+    for (int i = 0; i < numSchedulerWorkers; i++)
+    {
+        pthread_join(schedulerWorkers[i].thread, NULL);
+    }
+
+    // Workers of the next start never look for ones of this one
+    __atomic_store_n(&numSchedulerWorkers, 0, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     schedulerGetStats
+* Purpose:      Gets the scheduler counters.
+*
+* Inputs:       SchedulerStats* statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void schedulerGetStats(SchedulerStats* statsP)
+{
+    statsP->numWorkers = schedulerStats.numWorkers;
+    statsP->tasksSubmitted = 0;
+    statsP->tasksRun = 0;
+    statsP->tasksStolen = 0;
+    statsP->tasksRunByWaiters = 0;
+    statsP->tasksRunInline = 0;
+
+    for (int i = -1; i < SCHEDULER_MAX_WORKERS; i++)
+    {
+        SchedulerStats* countersP = i < 0 ? &schedulerStats : &schedulerWorkers[i].counters;
+
+        statsP->tasksSubmitted += __atomic_load_n(&countersP->tasksSubmitted, __ATOMIC_RELAXED);
+        statsP->tasksRun += __atomic_load_n(&countersP->tasksRun, __ATOMIC_RELAXED);
+        statsP->tasksStolen += __atomic_load_n(&countersP->tasksStolen, __ATOMIC_RELAXED);
+        statsP->tasksRunByWaiters += __atomic_load_n(&countersP->tasksRunByWaiters, __ATOMIC_RELAXED);
+        statsP->tasksRunInline += __atomic_load_n(&countersP->tasksRunInline, __ATOMIC_RELAXED);
+    }
+}
@@ -0,0 +1,296 @@
+/*
+* Filename:		serverSession.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the session registry of the CHAT-SYSTEM server.
+*
+*               Unlike the SharedData client list, which only holds currently connected clients,
+*               the session registry remembers every user that has registered (up to SESSION_MAX_KNOWN),
+*               along with the log sequence up to which they have received broadcasts. It is saved in
+*               registry snapshots (serverSnapshot.c), so it survives a server restart or crash.
+*
+*               When a known user registers again, the server can send them the messages they missed
+*               while they were away, read straight from the chat log.
+*/
+
+#include "../inc/serverSession.h"
+
+static pthread_mutex_t sessionMutex = PTHREAD_MUTEX_INITIALIZER;
+static SessionRecord sessions[SESSION_MAX_KNOWN];
+static int numSessions = 0;
+static uint64_t sessionVersion = 0;
+
+
+/*
+* Function:     findSession
+* Purpose:      Finds a session by IP and user ID.
+*               NOTE: Make sure to lock and unlock sessionMutex before and after calling this function!
+*
+* Inputs:       const char*     clientIP        Client IP C-string.
+*               const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      int                             Index of the session, or -1 if not found.
+*/
+static int findSession(const char* clientIP, const char* clientUserID)
+{
+    for (int i = 0; i < numSessions; i++)
+    {
+        if (strncmp(sessions[i].clientIP, clientIP, CLIENT_IP_LENGTH) == 0 &&
+            strncmp(sessions[i].clientUserID, clientUserID, CLIENT_USERID_LENGTH) == 0)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+
+/*
+* Function:     newSessionSlot
+* Purpose:      Gets a free session slot, forgetting the least recently seen session if the registry is full.
+*               Disconnected sessions are forgotten before connected ones.
+*               NOTE: Make sure to lock and unlock sessionMutex before and after calling this function!
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             Index of the slot.
+*/
+static int newSessionSlot()
+{
+    if (numSessions < SESSION_MAX_KNOWN)
+    {
+        return numSessions++;
+    }
+
+    int oldest = 0;
+    for (int i = 1; i < numSessions; i++)
+    {
+        if (sessions[i].isConnected < sessions[oldest].isConnected ||
+            (sessions[i].isConnected == sessions[oldest].isConnected && sessions[i].lastSeen < sessions[oldest].lastSeen))
+        {
+            oldest = i;
+        }
+    }
+
+    return oldest;
+}
+
+
+/*
+* Function:     sessionConnect
+* Purpose:      Records that a user has registered.
+*
+* Inputs:       const char*     clientIP            Client IP C-string.
+*               const char*     clientUserID        Client user ID C-string.
+*               uint64_t        currentSequence     Next log sequence (the user receives broadcasts from here).
+*               uint64_t*       lastSequenceP       Where to store, for a returning user, the sequence up to
+*                                                   which they had received broadcasts.
+*
+* Outputs:      lastSequenceP                       Set if the session was resumed.
+*
+* Returns:      int                                 SESSION_RESUMED for a known user, otherwise SESSION_NEW.
+*/
+int sessionConnect(const char* clientIP, const char* clientUserID, uint64_t currentSequence, uint64_t* lastSequenceP)
+{
+    int retVal = SESSION_NEW;
+
+    pthread_mutex_lock(&sessionMutex);
+
+    int index = findSession(clientIP, clientUserID);
+    if (index != -1 && !sessions[index].isConnected)
+    {
+        *lastSequenceP = sessions[index].lastSequence;
+        retVal = SESSION_RESUMED;
+    }
+    else if (index == -1)
+    {
+        index = newSessionSlot();
+
+        strncpy(sessions[index].clientIP, clientIP, CLIENT_IP_LENGTH);
+        sessions[index].clientIP[CLIENT_IP_LENGTH] = '\0'; // Ensure null termination
+        strncpy(sessions[index].clientUserID, clientUserID, CLIENT_USERID_LENGTH);
+        sessions[index].clientUserID[CLIENT_USERID_LENGTH] = '\0'; // Ensure null termination
+    }
+
+    sessions[index].isConnected = 1;
+    sessions[index].lastSeen = (int64_t)time(NULL);
+    sessions[index].lastSequence = currentSequence;
+    sessionVersion++;
+
+    pthread_mutex_unlock(&sessionMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     sessionDisconnect
+* Purpose:      Records that a user has disconnected.
+*
+* Inputs:       const char*     clientIP            Client IP C-string.
+*               const char*     clientUserID        Client user ID C-string.
+*               uint64_t        currentSequence     Next log sequence (the user has received everything before it).
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sessionDisconnect(const char* clientIP, const char* clientUserID, uint64_t currentSequence)
+{
+    pthread_mutex_lock(&sessionMutex);
+
+    int index = findSession(clientIP, clientUserID);
+    if (index != -1)
+    {
+        sessions[index].isConnected = 0;
+        sessions[index].lastSeen = (int64_t)time(NULL);
+        sessions[index].lastSequence = currentSequence;
+        sessionVersion++;
+    }
+
+    pthread_mutex_unlock(&sessionMutex);
+}
+
+
+/*
+* Function:     sessionIsKnownUser
+* Purpose:      Checks whether a user ID has ever registered (from any IP).
+*
+* Inputs:       const char*     clientUserID    Client user ID C-string.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if known, otherwise 0.
+*/
+int sessionIsKnownUser(const char* clientUserID)
+{
+    int isKnown = 0;
+
+    pthread_mutex_lock(&sessionMutex);
+
+    for (int i = 0; i < numSessions && !isKnown; i++)
+    {
+        isKnown = strncmp(sessions[i].clientUserID, clientUserID, CLIENT_USERID_LENGTH) == 0;
+    }
+
+    pthread_mutex_unlock(&sessionMutex);
+
+    return isKnown;
+}
+
+
+/*
+* Function:     sessionCopyAll
+* Purpose:      Copies all sessions, e.g. for a snapshot.
+*
+* Inputs:       SessionRecord*  records         Buffer for up to maxRecords sessions.
+*               int             maxRecords      Size of the buffer.
+*               uint64_t*       versionP        Where to store the registry version of the copy.
+*
+* Outputs:      records, versionP
+*
+* Returns:      int                             Number of sessions copied.
+*/
+int sessionCopyAll(SessionRecord* records, int maxRecords, uint64_t* versionP)
+{
+    pthread_mutex_lock(&sessionMutex);
+
+    int numCopied = numSessions < maxRecords ? numSessions : maxRecords;
+    memcpy(records, sessions, numCopied * sizeof(SessionRecord));
+    *versionP = sessionVersion;
+
+    pthread_mutex_unlock(&sessionMutex);
+
+    return numCopied;
+}
+
+
+/*
+* Function:     sessionRestore
+* Purpose:      Replaces the registry with sessions loaded from a snapshot. Users that were connected
+*               when the snapshot was taken stayed connected until the server stopped, so they are
+*               treated as having received everything up to resumeSequence.
+*
+* Inputs:       const SessionRecord*    records         Sessions to restore.
+*               int                     numRecords      Number of sessions.
+*               uint64_t                resumeSequence  Next log sequence at start-up.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void sessionRestore(const SessionRecord* records, int numRecords, uint64_t resumeSequence)
+{
+    pthread_mutex_lock(&sessionMutex);
+
+    numSessions = numRecords < SESSION_MAX_KNOWN ? numRecords : SESSION_MAX_KNOWN;
+    memcpy(sessions, records, numSessions * sizeof(SessionRecord));
+
+    for (int i = 0; i < numSessions; i++)
+    {
+        sessions[i].clientIP[CLIENT_IP_LENGTH] = '\0';
+        sessions[i].clientUserID[CLIENT_USERID_LENGTH] = '\0';
+
+        if (sessions[i].isConnected || sessions[i].lastSequence > resumeSequence)
+        {
+            sessions[i].isConnected = 0;
+            sessions[i].lastSequence = resumeSequence;
+        }
+    }
+
+    sessionVersion++;
+
+    pthread_mutex_unlock(&sessionMutex);
+}
+
+
+/*
+* Function:     sessionGetVersion
+* Purpose:      Gets the registry version, which changes whenever a session changes.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                Registry version.
+*/
+uint64_t sessionGetVersion()
+{
+    pthread_mutex_lock(&sessionMutex);
+    uint64_t version = sessionVersion;
+    pthread_mutex_unlock(&sessionMutex);
+
+    return version;
+}
+
+
+/*
+* Function:     sessionGetStats
+* Purpose:      Gets the number of known and connected sessions.
+*
+* Inputs:       int*            numKnown        Where to store the number of known sessions.
+*               int*            numConnected    Where to store the number of connected sessions.
+*
+* Outputs:      The stats.
+*
+* Returns:      void
+*/
+void sessionGetStats(int* numKnown, int* numConnected)
+{
+    pthread_mutex_lock(&sessionMutex);
+
+    *numKnown = numSessions;
+    *numConnected = 0;
+    for (int i = 0; i < numSessions; i++)
+    {
+        *numConnected += sessions[i].isConnected;
+    }
+
+    pthread_mutex_unlock(&sessionMutex);
+}
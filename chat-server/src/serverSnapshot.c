@@ -0,0 +1,572 @@
+/*
+* Filename:		serverSnapshot.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the registry snapshots of the CHAT-SYSTEM server.
+*
+*               A snapshot holds the session registry (serverSession.c), the offline mailboxes
+*               (serverMailbox.c) and the full-text history index (historyIndex.c), tagged with the log
+*               sequences they cover. The chat log itself is already persisted, so on start-up the
+*               server loads the latest snapshot and only replays the log records appended after it,
+*               instead of rebuilding everything from the whole log.
+*
+*               Snapshots are taken with fork(): the parent copies the (small) session registry, holds
+*               the mailbox and index locks just for the fork, and carries on; the child writes its
+*               frozen copy-on-write view of them to a temporary file and exits. The file is fsync'ed and
+*               renamed over the previous snapshot, so a crash at any point leaves either the old or the
+*               new snapshot in place - never a partial one. A CRC32C trailer catches anything else.
+*
+*               The snapshot thread takes a snapshot every SNAPSHOT_INTERVAL_SECONDS if anything
+*               changed, and once more when the server shuts down.
+*/
+
+#include "../inc/serverSnapshot.h"
+#include "../inc/serverSession.h"
+#include "../inc/historyIndex.h"
+#include "../inc/serverMailbox.h"
+#include "../inc/chatLog.h"
+
+static pthread_mutex_t snapshotMutex = PTHREAD_MUTEX_INITIALIZER;
+static SessionRecord snapshotSessions[SESSION_MAX_KNOWN];
+static SnapshotWriter snapshotWriter;
+static SnapshotStats snapshotStats = {.restoreMicroseconds = -1};
+static uint64_t snapshotSessionVersion = 0;
+static uint64_t snapshotIndexedUpTo = 0;
+
+static char snapshotDirectory[LOG_DIR_LENGTH];
+static pthread_t snapshotThread;
+static int snapshotterIsRunning = SNAPSHOTTER_STOPPED;
+
+
+/*
+* Function:     elapsedMicroseconds
+* Purpose:      Gets the time elapsed since a monotonic clock reading.
+*
+* Inputs:       struct timespec     start       The earlier reading.
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Microseconds elapsed.
+*/
+static int64_t elapsedMicroseconds(struct timespec start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (int64_t)(now.tv_sec - start.tv_sec) * 1000000 + (now.tv_nsec - start.tv_nsec) / 1000;
+}
+
+
+/*
+* Function:     writeAll
+* Purpose:      Writes a whole buffer to a file, retrying short writes.
+*
+* Inputs:       int             fd              The file.
+*               const void*     data            Data to write.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      int                             SNAPSHOT_SUCCESS or SNAPSHOT_ERROR.
+*/
+static int writeAll(int fd, const void* data, size_t length)
+{
+    const uint8_t* current = data;
+
+    while (length > 0)
+    {
+        ssize_t numWritten = write(fd, current, length);
+        if (numWritten < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (numWritten <= 0)
+        {
+            return SNAPSHOT_ERROR;
+        }
+
+        current += numWritten;
+        length -= numWritten;
+    }
+
+    return SNAPSHOT_SUCCESS;
+}
+
+
+/*
+* Function:     snapshotFlush
+* Purpose:      Writes out the buffered data of a snapshot writer.
+*
+* Inputs:       SnapshotWriter*     writerP     The writer.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void snapshotFlush(SnapshotWriter* writerP)
+{
+    if (writerP->used > 0 && !writerP->hasFailed)
+    {
+        writerP->hasFailed = writeAll(writerP->fd, writerP->buffer, writerP->used) != SNAPSHOT_SUCCESS;
+    }
+
+    writerP->used = 0;
+}
+
+
+/*
+* Function:     snapshotWrite
+* Purpose:      Appends data to a snapshot, adding it to the running checksum. Errors are remembered
+*               in the writer and reported when the snapshot is finished.
+*
+* Inputs:       SnapshotWriter*     writerP     The writer.
+*               const void*         data        Data to write.
+*               size_t              length      Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void snapshotWrite(SnapshotWriter* writerP, const void* data, size_t length)
+{
+    writerP->checksum = crc32cExtend(writerP->checksum, data, length);
+
+    if (writerP->used + length > SNAPSHOT_WRITE_BUFFER_SIZE)
+    {
+        snapshotFlush(writerP);
+    }
+
+    if (length > SNAPSHOT_WRITE_BUFFER_SIZE)
+    {
+        // Too big to buffer - write it straight through
+        if (!writerP->hasFailed)
+        {
+            writerP->hasFailed = writeAll(writerP->fd, data, length) != SNAPSHOT_SUCCESS;
+        }
+        return;
+    }
+
+    memcpy(writerP->buffer + writerP->used, data, length);
+    writerP->used += length;
+}
+
+
+/*
+* Function:     snapshotRead
+* Purpose:      Copies the next bytes out of a snapshot.
+*
+* Inputs:       SnapshotReader*     readerP     The reader.
+*               void*               data        Where to copy the data.
+*               size_t              length      Number of bytes.
+*
+* Outputs:      data
+*
+* Returns:      int                             SNAPSHOT_SUCCESS, or SNAPSHOT_CORRUPT if the snapshot is too short.
+*/
+int snapshotRead(SnapshotReader* readerP, void* data, size_t length)
+{
+    const uint8_t* source = snapshotReadInPlace(readerP, length);
+    if (source == NULL)
+    {
+        return SNAPSHOT_CORRUPT;
+    }
+
+    memcpy(data, source, length);
+
+    return SNAPSHOT_SUCCESS;
+}
+
+
+/*
+* Function:     snapshotReadInPlace
+* Purpose:      Gets a pointer to the next bytes of a snapshot without copying them. The data is
+*               only valid during the restore and may be unaligned.
+*
+* Inputs:       SnapshotReader*     readerP     The reader.
+*               size_t              length      Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      const uint8_t*                  The data, or NULL if the snapshot is too short.
+*/
+const uint8_t* snapshotReadInPlace(SnapshotReader* readerP, size_t length)
+{
+    if (length > readerP->length - readerP->offset)
+    {
+        return NULL;
+    }
+
+    const uint8_t* data = readerP->data + readerP->offset;
+    readerP->offset += length;
+
+    return data;
+}
+
+
+/*
+* Function:     snapshotPath
+* Purpose:      Builds the path of the snapshot file (or its temporary file).
+*
+* Inputs:       const char*     snapshotDir     Directory holding the snapshot.
+*               const char*     suffix          "" for the snapshot, SNAPSHOT_TEMP_SUFFIX for the temporary file.
+*               char*           path            Buffer of SNAPSHOT_PATH_LENGTH bytes.
+*
+* Outputs:      path                            The path.
+*
+* Returns:      void
+*/
+static void snapshotPath(const char* snapshotDir, const char* suffix, char* path)
+{
+    snprintf(path, SNAPSHOT_PATH_LENGTH, "%.*s/%s%s", LOG_DIR_LENGTH, snapshotDir, SNAPSHOT_FILE_NAME, suffix);
+}
+
+
+/*
+* Function:     writeSnapshotFile
+* Purpose:      Writes a snapshot to a temporary file, syncs it, and renames it over the previous one.
+*               Runs in the snapshot child process, so it only uses system calls and data that were
+*               prepared before the fork - no locks, no heap allocation, no stdio.
+*
+* Inputs:       const char*             snapshotDir     Directory holding the snapshot.
+*               const SnapshotHeader*   headerP         The snapshot header.
+*
+* Outputs:      None
+*
+* Returns:      int                                     SNAPSHOT_SUCCESS or SNAPSHOT_ERROR.
+*/
+static int writeSnapshotFile(const char* snapshotDir, const SnapshotHeader* headerP)
+{
+    char tempPath[SNAPSHOT_PATH_LENGTH];
+    char path[SNAPSHOT_PATH_LENGTH];
+    snapshotPath(snapshotDir, SNAPSHOT_TEMP_SUFFIX, tempPath);
+    snapshotPath(snapshotDir, "", path);
+
+    SnapshotWriter* writerP = &snapshotWriter;
+    writerP->fd = open(tempPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writerP->fd < 0)
+    {
+        return SNAPSHOT_ERROR;
+    }
+    writerP->hasFailed = 0;
+    writerP->checksum = 0;
+    writerP->used = 0;
+
+    snapshotWrite(writerP, headerP, sizeof(SnapshotHeader));
+    snapshotWrite(writerP, snapshotSessions, headerP->numSessions * sizeof(SessionRecord));
+    mailboxWriteSnapshot(writerP);
+    historyIndexWriteSnapshot(writerP);
+
+    uint32_t checksum = writerP->checksum;
+    snapshotWrite(writerP, &checksum, sizeof(checksum));
+    snapshotFlush(writerP);
+
+    int hasFailed = writerP->hasFailed || fsync(writerP->fd) != 0;
+    hasFailed = close(writerP->fd) != 0 || hasFailed;
+
+    if (hasFailed || rename(tempPath, path) != 0)
+    {
+        unlink(tempPath);
+        return SNAPSHOT_ERROR;
+    }
+
+    // Make the rename itself durable
+    int dirFd = open(snapshotDir, O_RDONLY | O_DIRECTORY);
+    if (dirFd >= 0)
+    {
+        fsync(dirFd);
+        close(dirFd);
+    }
+
+    return SNAPSHOT_SUCCESS;
+}
+
+
+/*
+* Function:     snapshotTake
+* Purpose:      Takes a snapshot of the session registry and the history index.
+*               The server is only paused for the fork; the child process writes the file.
+*
+* Inputs:       const char*     snapshotDir     Directory holding the snapshot (the chat log directory).
+*
+* Outputs:      None
+*
+* Returns:      int                             SNAPSHOT_SUCCESS or SNAPSHOT_ERROR.
+*/
+int snapshotTake(const char* snapshotDir)
+{
+    int retVal = SNAPSHOT_SUCCESS;
+
+    pthread_mutex_lock(&snapshotMutex);
+
+    // The child must not run one-time initialization (it takes locks)
+    crc32cIsHardwareAccelerated();
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.createdAt = (int64_t)time(NULL);
+
+    uint64_t sessionVersion;
+    header.numSessions = (uint32_t)sessionCopyAll(snapshotSessions, SESSION_MAX_KNOWN, &sessionVersion);
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    mailboxBeginSnapshot(&header.mailboxUpTo, &header.numMailboxes);
+    historyIndexBeginSnapshot(&header.indexedUpTo, &header.indexFirstSequence, &header.numTerms);
+    pid_t childPid = fork();
+    if (childPid == 0)
+    {
+        _exit(writeSnapshotFile(snapshotDir, &header) == SNAPSHOT_SUCCESS ? 0 : 1);
+    }
+    historyIndexEndSnapshot();
+    mailboxEndSnapshot();
+
+    int64_t pauseMicroseconds = elapsedMicroseconds(start);
+
+    int status = 0;
+    if (childPid < 0)
+    {
+        perror("fork");
+        retVal = SNAPSHOT_ERROR;
+    }
+    else
+    {
+        while (waitpid(childPid, &status, 0) < 0 && errno == EINTR)
+        {
+            // retry
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            fprintf(stderr, "[SNAPSHOT] : could not write snapshot to %s\n", snapshotDir);
+            retVal = SNAPSHOT_ERROR;
+        }
+    }
+
+    if (retVal == SNAPSHOT_SUCCESS)
+    {
+        char path[SNAPSHOT_PATH_LENGTH];
+        struct stat fileStat;
+        snapshotPath(snapshotDir, "", path);
+
+        snapshotStats.numTaken++;
+        snapshotStats.lastBytes = stat(path, &fileStat) == 0 ? (uint64_t)fileStat.st_size : 0;
+        snapshotStats.lastPauseMicroseconds = pauseMicroseconds;
+        snapshotStats.lastWriteMicroseconds = elapsedMicroseconds(start);
+        snapshotSessionVersion = sessionVersion;
+        snapshotIndexedUpTo = header.indexedUpTo;
+    }
+    else
+    {
+        snapshotStats.numFailed++;
+    }
+
+    pthread_mutex_unlock(&snapshotMutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     snapshotRestore
+* Purpose:      Loads the latest snapshot at start-up. Must be called after logOpen() and before
+*               historyIndexStart(), which then only indexes the log records after the snapshot.
+*
+* Inputs:       const char*     snapshotDir     Directory holding the snapshot (the chat log directory).
+*
+* Outputs:      None
+*
+* Returns:      int                             SNAPSHOT_SUCCESS, SNAPSHOT_NOT_FOUND if there is no snapshot,
+*                                               SNAPSHOT_CORRUPT if it is invalid, or SNAPSHOT_ERROR.
+*/
+int snapshotRestore(const char* snapshotDir)
+{
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    char path[SNAPSHOT_PATH_LENGTH];
+    snapshotPath(snapshotDir, "", path);
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        if (errno == ENOENT)
+        {
+            return SNAPSHOT_NOT_FOUND;
+        }
+        perror("open");
+        return SNAPSHOT_ERROR;
+    }
+
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(SnapshotHeader) + sizeof(uint32_t))
+    {
+        close(fd);
+        return SNAPSHOT_CORRUPT;
+    }
+
+    size_t length = fileStat.st_size;
+    uint8_t* data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        perror("mmap");
+        return SNAPSHOT_ERROR;
+    }
+
+    int retVal = SNAPSHOT_SUCCESS;
+    SnapshotHeader header;
+    uint32_t checksum;
+    SnapshotReader reader = {.data = data, .length = length - sizeof(checksum), .offset = 0};
+
+    memcpy(&checksum, data + reader.length, sizeof(checksum));
+    if (crc32c(data, reader.length) != checksum ||
+        snapshotRead(&reader, &header, sizeof(header)) != SNAPSHOT_SUCCESS ||
+        header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.numSessions > SESSION_MAX_KNOWN ||
+        snapshotRead(&reader, snapshotSessions, header.numSessions * sizeof(SessionRecord)) != SNAPSHOT_SUCCESS ||
+        mailboxLoadSnapshot(&reader, header.numMailboxes) != MAILBOX_SUCCESS)
+    {
+        retVal = SNAPSHOT_CORRUPT;
+    }
+
+    if (retVal == SNAPSHOT_SUCCESS)
+    {
+        uint64_t nextSequence = logGetNextSequence();
+        sessionRestore(snapshotSessions, header.numSessions, nextSequence);
+
+        // Queue again the direct messages sent after the snapshot
+        mailboxRecoverFromLog(header.mailboxUpTo);
+
+        // If recovery truncated the log below what was indexed, those sequences will be reused - rebuild instead
+        if (header.indexedUpTo <= nextSequence &&
+            historyIndexLoadSnapshot(&reader, header.numTerms, header.indexedUpTo, header.indexFirstSequence) == INDEX_SUCCESS)
+        {
+            snapshotStats.restoredTerms = header.numTerms;
+        }
+
+        snapshotStats.restoredSessions = header.numSessions;
+        snapshotStats.restoreMicroseconds = elapsedMicroseconds(start);
+        snapshotSessionVersion = sessionGetVersion();
+        snapshotIndexedUpTo = header.indexedUpTo;
+    }
+
+    munmap(data, length);
+
+    return retVal;
+}
+
+
+/*
+* Function:     snapshotter
+* Purpose:      Snapshot thread - takes a snapshot every SNAPSHOT_INTERVAL_SECONDS if the sessions
+*               or the index have changed since the last one.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* snapshotter(void* arg)
+{
+    (void)arg;
+
+    int ticksPerInterval = (SNAPSHOT_INTERVAL_SECONDS * 1000000) / SNAPSHOT_LOOP_SLEEP_LENGTH;
+    int ticks = 0;
+
+    while (__atomic_load_n(&snapshotterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        if (ticks >= ticksPerInterval)
+        {
+            ticks = 0;
+
+            uint64_t indexedUpTo;
+            size_t numTerms;
+            size_t postingBytes;
+            historyIndexGetStats(&indexedUpTo, &numTerms, &postingBytes);
+
+            if (sessionGetVersion() != snapshotSessionVersion || indexedUpTo != snapshotIndexedUpTo)
+            {
+                snapshotTake(snapshotDirectory);
+            }
+        }
+
+        usleep(SNAPSHOT_LOOP_SLEEP_LENGTH);
+        ticks++;
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     snapshotStart
+* Purpose:      Starts the snapshot thread. The chat log must already be open.
+*
+* Inputs:       const char*     snapshotDir     Directory holding the snapshot (the chat log directory).
+*
+* Outputs:      None
+*
+* Returns:      int                             SNAPSHOT_SUCCESS, or SNAPSHOT_ERROR if the thread could not be started.
+*/
+int snapshotStart(const char* snapshotDir)
+{
+    strncpy(snapshotDirectory, snapshotDir, LOG_DIR_LENGTH - 1);
+    snapshotDirectory[LOG_DIR_LENGTH - 1] = '\0';
+
+    __atomic_store_n(&snapshotterIsRunning, SNAPSHOTTER_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&snapshotThread, NULL, snapshotter, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&snapshotterIsRunning, SNAPSHOTTER_STOPPED, __ATOMIC_RELEASE);
+        return SNAPSHOT_ERROR;
+    }
+
+    return SNAPSHOT_SUCCESS;
+}
+
+
+/*
+* Function:     snapshotStop
+* Purpose:      Stops the snapshot thread and takes a final snapshot. Must be called before
+*               historyIndexStop() and logClose().
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void snapshotStop()
+{
+    if (__atomic_load_n(&snapshotterIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&snapshotterIsRunning, SNAPSHOTTER_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(snapshotThread, NULL);
+
+        snapshotTake(snapshotDirectory);
+    }
+}
+
+
+/*
+* Function:     snapshotGetStats
+* Purpose:      Gets the snapshot and restore counters.
+*
+* Inputs:       SnapshotStats*  statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void snapshotGetStats(SnapshotStats* statsP)
+{
+    pthread_mutex_lock(&snapshotMutex);
+    *statsP = snapshotStats;
+    pthread_mutex_unlock(&snapshotMutex);
+}
@@ -0,0 +1,322 @@
+/*
+* Filename:		serverSpam.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for near-duplicate spam detection in the CHAT-SYSTEM server.
+*
+*               Every chat message is checked before it is queued for broadcast, since a flood that
+*               gets in is multiplied by the fan-out. Spammers change a character or two between
+*               pastes, so messages are compared by fingerprint rather than by exact text:
+*                   - The text is normalized: letters and digits only, lower case.
+*                   - A rolling hash gives a hash for every SPAM_SHINGLE_LENGTH-character shingle.
+*                   - The MinHash signature keeps, for each of SPAM_NUM_HASHES seeds, the smallest
+*                     seeded shingle hash. Two messages sharing most shingles share most of it.
+*                   - The signature is cut into SPAM_NUM_BANDS bands; messages with one equal band
+*                     are near-duplicates.
+*
+*               Band hashes are counted in a count-min sketch, once keyed by the sender and once on
+*               their own. A message is rejected if one of its bands has been seen SPAM_SENDER_LIMIT
+*               times from the sender, or SPAM_GLOBAL_LIMIT times from anyone. The sketch has two
+*               windows of SPAM_WINDOW_LENGTH seconds: counts go into the current one, checks add the
+*               previous one, and at each rotation the previous one is cleared and becomes current.
+*               The sketch has a fixed size, so a check takes the same time and no memory however
+*               many senders or messages there are. Rejected messages still count, so a flood stays
+*               rejected while it keeps going.
+*/
+
+#include "../inc/serverSpam.h"
+
+#define SPAM_ROLLING_BASE 257ULL
+#define SPAM_SKETCH_MASK (SPAM_SKETCH_WIDTH - 1)
+#define SPAM_COUNTER_MAX UINT16_MAX
+
+// Protects everything below
+static pthread_mutex_t spamMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint16_t spamSketch[2][SPAM_SKETCH_DEPTH][SPAM_SKETCH_WIDTH];
+static int currentWindow = 0;
+static int64_t currentWindowStart = 0;
+static SpamStats spamStats;
+
+
+/*
+* Function:     mixHash
+* Purpose:      Scrambles a 64-bit value (MurmurHash3 finalizer), so related inputs give unrelated hashes.
+*
+* Inputs:       uint64_t        value           Value to scramble.
+*
+* Outputs:      None
+*
+* Returns:      uint64_t                        The scrambled value.
+*/
+static uint64_t mixHash(uint64_t value)
+{
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+
+/*
+* Function:     monotonicSeconds
+* Purpose:      Gets the monotonic clock in seconds.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int64_t                         Seconds since an arbitrary start point.
+*/
+static int64_t monotonicSeconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec;
+}
+
+
+/*
+* Function:     getBandHashes
+* Purpose:      Fingerprints a message: normalizes it, computes its MinHash signature from rolling shingle
+*               hashes, and hashes each band of the signature.
+*
+* Inputs:       const char*     message         The message.
+*               uint64_t*       bandHashes      Where to store SPAM_NUM_BANDS band hashes.
+*
+* Outputs:      bandHashes
+*
+* Returns:      int                             Length of the normalized text.
+*/
+static int getBandHashes(const char* message, uint64_t* bandHashes)
+{
+    char text[CLIENT_MESSAGE_LENGTH + 1];
+    int length = 0;
+
+    for (int i = 0; message[i] != '\0' && length < CLIENT_MESSAGE_LENGTH; i++)
+    {
+        if (isalnum((unsigned char)message[i]))
+        {
+            text[length++] = tolower((unsigned char)message[i]);
+        }
+    }
+
+    uint64_t signature[SPAM_NUM_HASHES];
+    for (int i = 0; i < SPAM_NUM_HASHES; i++)
+    {
+        signature[i] = UINT64_MAX;
+    }
+
+    // Base to the power of the shingle length, to take the outgoing character off the rolling hash
+    uint64_t outgoingFactor = 1;
+    for (int i = 0; i < SPAM_SHINGLE_LENGTH; i++)
+    {
+        outgoingFactor *= SPAM_ROLLING_BASE;
+    }
+
+    // A message shorter than one shingle is its own single shingle
+    int shingleLength = length < SPAM_SHINGLE_LENGTH ? length : SPAM_SHINGLE_LENGTH;
+    uint64_t rollingHash = 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        rollingHash = rollingHash * SPAM_ROLLING_BASE + (unsigned char)text[i];
+        if (i >= SPAM_SHINGLE_LENGTH)
+        {
+            rollingHash -= outgoingFactor * (unsigned char)text[i - SPAM_SHINGLE_LENGTH];
+        }
+
+        if (i + 1 < shingleLength)
+        {
+            continue;
+        }
+
+        for (int j = 0; j < SPAM_NUM_HASHES; j++)
+        {
+            uint64_t seeded = mixHash(rollingHash ^ (0x9e3779b97f4a7c15ULL * (j + 1)));
+            if (seeded < signature[j])
+            {
+                signature[j] = seeded;
+            }
+        }
+    }
+
+    for (int band = 0; band < SPAM_NUM_BANDS; band++)
+    {
+        uint64_t bandHash = band;
+        for (int i = 0; i < SPAM_BAND_SIZE; i++)
+        {
+            bandHash = mixHash(bandHash ^ signature[band * SPAM_BAND_SIZE + i]);
+        }
+        bandHashes[band] = bandHash;
+    }
+
+    return length;
+}
+
+
+/*
+* Function:     rotateWindows
+* Purpose:      Starts a new window if the current one is over. After a long quiet spell both are cleared.
+*               NOTE: Make sure to lock and unlock spamMutex before and after calling this function!
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void rotateWindows()
+{
+    int64_t now = monotonicSeconds();
+    if (currentWindowStart == 0)
+    {
+        currentWindowStart = now;
+        return;
+    }
+
+    int64_t windowsPassed = (now - currentWindowStart) / SPAM_WINDOW_LENGTH;
+
+    if (windowsPassed <= 0)
+    {
+        return;
+    }
+
+    for (int64_t i = 0; i < windowsPassed && i < 2; i++)
+    {
+        currentWindow ^= 1;
+        memset(spamSketch[currentWindow], 0, sizeof(spamSketch[currentWindow]));
+        spamStats.windowsRotated++;
+    }
+
+    currentWindowStart += windowsPassed * SPAM_WINDOW_LENGTH;
+}
+
+
+/*
+* Function:     countKey
+* Purpose:      Counts a key in the current window and estimates how often it was seen in both windows.
+*               NOTE: Make sure to lock and unlock spamMutex before and after calling this function!
+*
+* Inputs:       uint64_t        key             The key.
+*
+* Outputs:      None
+*
+* Returns:      int                             Times the key was seen before, never underestimated.
+*/
+static int countKey(uint64_t key)
+{
+    int estimate = SPAM_COUNTER_MAX;
+
+    for (int row = 0; row < SPAM_SKETCH_DEPTH; row++)
+    {
+        int column = mixHash(key + row * 0x632be59bd9b4e019ULL) & SPAM_SKETCH_MASK;
+        uint16_t* counter = &spamSketch[currentWindow][row][column];
+
+        int seen = *counter + spamSketch[currentWindow ^ 1][row][column];
+        if (seen < estimate)
+        {
+            estimate = seen;
+        }
+
+        if (*counter < SPAM_COUNTER_MAX)
+        {
+            (*counter)++;
+        }
+    }
+
+    return estimate;
+}
+
+
+/*
+* Function:     spamCheck
+* Purpose:      Checks whether a chat message floods the chat, and counts it.
+*
+* Inputs:       const char*     clientIP        The sender's IP address.
+*               const ClientMessage* clientMessageP The message.
+*
+* Outputs:      None
+*
+* Returns:      int                             SPAM_ACCEPTED, SPAM_SENDER_FLOOD or SPAM_GLOBAL_FLOOD.
+*/
+int spamCheck(const char* clientIP, const ClientMessage* clientMessageP)
+{
+    uint64_t bandHashes[SPAM_NUM_BANDS];
+    int length = getBandHashes(clientMessageP->message, bandHashes);
+
+    // Sender key - FNV-1a over IP and user ID
+    uint64_t senderKey = 14695981039346656037ULL;
+    for (const char* c = clientIP; *c != '\0'; c++)
+    {
+        senderKey = (senderKey ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+    senderKey = (senderKey ^ '/') * 1099511628211ULL;
+    for (const char* c = clientMessageP->clientUserID; *c != '\0'; c++)
+    {
+        senderKey = (senderKey ^ (unsigned char)*c) * 1099511628211ULL;
+    }
+
+    int senderSeen = 0;
+    int globalSeen = 0;
+
+    pthread_mutex_lock(&spamMutex);
+
+    rotateWindows();
+
+    for (int band = 0; band < SPAM_NUM_BANDS; band++)
+    {
+        int seen = countKey(mixHash(senderKey ^ bandHashes[band]));
+        if (seen > senderSeen)
+        {
+            senderSeen = seen;
+        }
+
+        if (length >= SPAM_MIN_GLOBAL_LENGTH)
+        {
+            seen = countKey(bandHashes[band]);
+            if (seen > globalSeen)
+            {
+                globalSeen = seen;
+            }
+        }
+    }
+
+    int verdict = SPAM_ACCEPTED;
+    if (senderSeen >= SPAM_SENDER_LIMIT)
+    {
+        verdict = SPAM_SENDER_FLOOD;
+        spamStats.senderFloods++;
+    }
+    else if (globalSeen >= SPAM_GLOBAL_LIMIT)
+    {
+        verdict = SPAM_GLOBAL_FLOOD;
+        spamStats.globalFloods++;
+    }
+    spamStats.messagesChecked++;
+
+    pthread_mutex_unlock(&spamMutex);
+
+    return verdict;
+}
+
+
+/*
+* Function:     spamGetStats
+* Purpose:      Gets the spam detection counters.
+*
+* Inputs:       SpamStats*      statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void spamGetStats(SpamStats* statsP)
+{
+    pthread_mutex_lock(&spamMutex);
+    *statsP = spamStats;
+    pthread_mutex_unlock(&spamMutex);
+}
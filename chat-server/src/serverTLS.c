@@ -0,0 +1,943 @@
+/*
+* Filename:		serverTLS.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for TLS connections to the CHAT-SYSTEM server.
+*
+*               Clients that want an encrypted connection connect to TLS_PORT. A listener thread accepts
+*               them and starts a normal client handler, which does the TLS handshake (OpenSSL) and then
+*               treats the client like any other.
+*
+*               Userspace TLS would have the chat broadcaster encrypt every broadcast once per recipient.
+*               Instead, sessions ask OpenSSL for kernel TLS: after the handshake the keys are handed to
+*               the kernel, which encrypts whatever is written to the socket. The broadcaster's fan-out
+*               then stays exactly what it is for plaintext clients - one send() per client.
+*
+*               Where the kernel cannot take a session (no "tls" module, or a cipher it does not support),
+*               the session falls back to SSL_write() and SSL_read(). An SSL object cannot be used by two
+*               threads at once, so every SSL call takes the session's mutex. TLS sockets are
+*               non-blocking, kernel TLS or not - a handler waiting for its client's next message waits in
+*               its event loop (or poll()), never inside a call, so nobody is held up by it.
+*
+*               Every chat client's sends, TLS or not, go through an output queue: what the socket does
+*               not take right away is kept, in order, and written before anything sent after it. A
+*               send may wait for its queue to empty - a session in its event loop, any other thread in
+*               poll() - or, with MSG_DONTWAIT, be taken whole or refused whole. The connection monitor
+*               calls tlsFlushPending() to push out what sends that did not wait left behind. Every
+*               fan-out takes each recipient's queue, so the queues are one pool, indexed by socket, on
+*               huge pages (memAllocHuge()) rather than scattered over the heap.
+*
+*               Which sockets have a TLS session is kept in a table indexed by socket; tlsSend() and
+*               tlsRecv() fall through to transportSend() and transportRecv() for all the others.
+*
+*               Built without CHAT_TLS (make TLS=0), the listener is unavailable and everything falls through.
+*/
+
+#include "../inc/serverTLS.h"
+
+static TLSStats tlsStats;
+
+#define TLS_COUNT(counter, amount) __atomic_add_fetch(&tlsStats.counter, amount, __ATOMIC_RELAXED)
+
+static TLSOutput* tlsOutputs = NULL;            // TLS_MAX_FDS queues, indexed by socket - memAllocHuge()ed on the first send
+static pthread_once_t tlsOutputsOnce = PTHREAD_ONCE_INIT;
+static int highestOutputFd = -1;
+static int numPendingOutputs = 0;               // Queues holding data
+
+#ifdef CHAT_TLS
+
+static TLSSession* tlsSessions[TLS_MAX_FDS];   // Atomic per slot - a socket number is reused as soon as it is closed
+static SSL_CTX* tlsContext = NULL;
+
+static int tlsSocket = -1;
+static pthread_t tlsThread;
+static int tlsIsRunning = TLS_STOPPED;
+static TLSAcceptHandler tlsAcceptHandler = NULL;
+static void* tlsHandlerArg = NULL;
+
+// Marks a socket accepted on the TLS port before its handshake, until it has a session
+static TLSSession pendingSession;
+
+
+/*
+* Function:     getSession
+* Purpose:      Gets a socket's TLS session.
+*
+* Inputs:       int             clientSocket    The socket.
+*
+* Outputs:      None
+*
+* Returns:      TLSSession*                     The session, or NULL for a socket without one.
+*/
+static TLSSession* getSession(int clientSocket)
+{
+    if (clientSocket < 0 || clientSocket >= TLS_MAX_FDS)
+    {
+        return NULL;
+    }
+
+    TLSSession* session = __atomic_load_n(&tlsSessions[clientSocket], __ATOMIC_ACQUIRE);
+    return session == &pendingSession ? NULL : session;
+}
+
+
+/*
+* Function:     writeSession
+* Purpose:      Encrypts and writes as much as a userspace TLS session's non-blocking socket takes now.
+*
+* Inputs:       TLSSession*     session         The session.
+*               const char*     data            Data to write.
+*               size_t          length          Number of bytes.
+*               short*          waitEventsP     Where to store what the socket must be waited for before
+*                                               the rest can go.
+*
+* Outputs:      waitEventsP
+*
+* Returns:      ssize_t                         Number of bytes written, or -1 on error. Bytes not written
+*                                               must be offered again, from the same first byte.
+*/
+static ssize_t writeSession(TLSSession* session, const char* data, size_t length, short* waitEventsP)
+{
+    size_t numSent = 0;
+    int isFailed = 0;
+
+    pthread_mutex_lock(&session->mutex);
+
+    while (numSent < length)
+    {
+        size_t written = 0;
+        int result = SSL_write_ex(session->ssl, data + numSent, length - numSent, &written);
+        if (result > 0)
+        {
+            numSent += written;
+            continue;
+        }
+
+        int sslError = SSL_get_error(session->ssl, result);
+        if (sslError == SSL_ERROR_WANT_READ || sslError == SSL_ERROR_WANT_WRITE)
+        {
+            *waitEventsP = sslError == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT;
+        }
+        else
+        {
+            isFailed = 1;
+        }
+        break;
+    }
+
+    pthread_mutex_unlock(&session->mutex);
+
+    TLS_COUNT(userspaceSends, 1);
+    TLS_COUNT(userspaceBytes, numSent);
+
+    return isFailed ? -1 : (ssize_t)numSent;
+}
+
+#endif // CHAT_TLS
+
+
+/*
+* Function:     writeAvailable
+* Purpose:      Writes as much as a chat client's socket takes now, without waiting - SSL_write() for a
+*               userspace TLS session, transportSend() for everything else.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const char*     data            Data to write.
+*               size_t          length          Number of bytes.
+*               short*          waitEventsP     Where to store what the socket must be waited for before
+*                                               the rest can go.
+*
+* Outputs:      waitEventsP
+*
+* Returns:      ssize_t                         Number of bytes written, or -1 on error.
+*/
+static ssize_t writeAvailable(int clientSocket, const char* data, size_t length, short* waitEventsP)
+{
+    #ifdef CHAT_TLS
+        TLSSession* session = getSession(clientSocket);
+        if (session != NULL && !session->isKernelSend)
+        {
+            return writeSession(session, data, length, waitEventsP);
+        }
+    #endif
+
+    size_t numSent = 0;
+    while (numSent < length)
+    {
+        ssize_t numBytesSent = transportSend(clientSocket, data + numSent, length - numSent, MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (numBytesSent > 0)
+        {
+            numSent += numBytesSent;
+        }
+        else if (numBytesSent == 0 || errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            *waitEventsP = POLLOUT;
+            break;
+        }
+        else if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+
+    return (ssize_t)numSent;
+}
+
+
+/*
+* Function:     createOutputs
+* Purpose:      Allocates the pool of output queues, one per socket number. Run once, by the first send.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void createOutputs()
+{
+    TLSOutput* outputs = memAllocHuge(MEM_CONNECTION_STATE, TLS_MAX_FDS * sizeof(TLSOutput));
+    if (outputs == NULL)
+    {
+        fprintf(stderr, "[TLS] : could not allocate the output queues - nothing can be sent\n");
+        return;
+    }
+
+    for (int clientSocket = 0; clientSocket < TLS_MAX_FDS; clientSocket++)
+    {
+        pthread_mutex_init(&outputs[clientSocket].mutex, NULL);
+    }
+
+    __atomic_store_n(&tlsOutputs, outputs, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     getOutput
+* Purpose:      Gets a chat client's output queue, creating the pool on the first send.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*
+* Outputs:      None
+*
+* Returns:      TLSOutput*                      The queue, or NULL if the socket is out of range or there
+*                                               is no pool.
+*/
+static TLSOutput* getOutput(int clientSocket)
+{
+    if (clientSocket < 0 || clientSocket >= TLS_MAX_FDS)
+    {
+        return NULL;
+    }
+
+    pthread_once(&tlsOutputsOnce, createOutputs);
+
+    TLSOutput* outputs = __atomic_load_n(&tlsOutputs, __ATOMIC_ACQUIRE);
+    if (outputs == NULL)
+    {
+        return NULL;
+    }
+
+    int highestFd = __atomic_load_n(&highestOutputFd, __ATOMIC_RELAXED);
+    while (clientSocket > highestFd &&
+        !__atomic_compare_exchange_n(&highestOutputFd, &highestFd, clientSocket, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+    {
+    }
+
+    return &outputs[clientSocket];
+}
+
+
+/*
+* Function:     dropPending
+* Purpose:      Frees what an output queue still holds. The queue's mutex must be held.
+*
+* Inputs:       TLSOutput*      outputP         The queue.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void dropPending(TLSOutput* outputP)
+{
+    if (outputP->pending != NULL)
+    {
+        memFree(MEM_OUTBOUND_BUFFERS, outputP->pending);
+        outputP->pending = NULL;
+        outputP->pendingLength = 0;
+        __atomic_sub_fetch(&numPendingOutputs, 1, __ATOMIC_RELAXED);
+    }
+}
+
+
+/*
+* Function:     flushOutput
+* Purpose:      Writes as much of an output queue as its socket takes now. The queue's mutex must be held.
+*               A failed write breaks the queue - its client is going away.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               TLSOutput*      outputP         The socket's queue.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void flushOutput(int clientSocket, TLSOutput* outputP)
+{
+    if (outputP->pendingLength == 0 || outputP->isBroken)
+    {
+        return;
+    }
+
+    ssize_t numWritten = writeAvailable(clientSocket, outputP->pending, outputP->pendingLength, &outputP->waitEvents);
+    if (numWritten < 0)
+    {
+        outputP->isBroken = 1;
+        dropPending(outputP);
+    }
+    else if ((size_t)numWritten == outputP->pendingLength)
+    {
+        dropPending(outputP);
+    }
+    else
+    {
+        // SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER - OpenSSL takes its unfinished record from the new address
+        memmove(outputP->pending, outputP->pending + numWritten, outputP->pendingLength - numWritten);
+        outputP->pendingLength -= numWritten;
+    }
+}
+
+
+/*
+* Function:     queueOutput
+* Purpose:      Appends data to an output queue. The queue's mutex must be held.
+*
+* Inputs:       TLSOutput*      outputP         The queue.
+*               const char*     data            Data to append.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      int                             TLS_SUCCESS, or TLS_ERROR if there was no memory for it.
+*/
+static int queueOutput(TLSOutput* outputP, const char* data, size_t length)
+{
+    char* pending = memRealloc(MEM_OUTBOUND_BUFFERS, outputP->pending, outputP->pendingLength + length);
+    if (pending == NULL)
+    {
+        return TLS_ERROR;
+    }
+
+    if (outputP->pending == NULL)
+    {
+        __atomic_add_fetch(&numPendingOutputs, 1, __ATOMIC_RELAXED);
+    }
+
+    memcpy(pending + outputP->pendingLength, data, length);
+    outputP->pending = pending;
+    outputP->pendingLength += length;
+
+    return TLS_SUCCESS;
+}
+
+
+/*
+* Function:     forgetOutput
+* Purpose:      Empties a socket's output queue, dropping whatever it still holds, so the next client
+*               given the socket number starts with a clean one.
+*
+* Inputs:       int             clientSocket    The socket.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void forgetOutput(int clientSocket)
+{
+    TLSOutput* outputs = __atomic_load_n(&tlsOutputs, __ATOMIC_ACQUIRE);
+    if (outputs == NULL)
+    {
+        return;
+    }
+
+    TLSOutput* outputP = &outputs[clientSocket];
+
+    pthread_mutex_lock(&outputP->mutex);
+    dropPending(outputP);
+    outputP->waitEvents = 0;
+    outputP->isBroken = 0;
+    pthread_mutex_unlock(&outputP->mutex);
+}
+
+
+/*
+* Function:     tlsSend
+* Purpose:      Sends data to a chat client, after whatever is still queued for it. What the socket does
+*               not take right away is queued; a send without MSG_DONTWAIT then waits until the queue is
+*               empty - in a session, in its event loop. With MSG_DONTWAIT the data is taken whole or not
+*               at all, so a client never gets a cut-off frame; it is refused only if it would take a
+*               queue that is not empty past TLS_OUTPUT_MAX_PENDING. Only a session's own socket may be waited
+*               on from a session - anything sent to another client's must use MSG_DONTWAIT.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const void*     data            Data to send.
+*               size_t          length          Number of bytes.
+*               int             flags           0, or MSG_DONTWAIT never to wait. MSG_NOSIGNAL is implied.
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         length once sent (or queued, with MSG_DONTWAIT), or -1 on
+*                                               error - errno EAGAIN if a MSG_DONTWAIT send was refused.
+*/
+ssize_t tlsSend(int clientSocket, const void* data, size_t length, int flags)
+{
+    TLSOutput* outputP = getOutput(clientSocket);
+    if (outputP == NULL)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    int isWaiting = !(flags & MSG_DONTWAIT);
+    ssize_t retVal = (ssize_t)length;
+
+    pthread_mutex_lock(&outputP->mutex);
+
+    flushOutput(clientSocket, outputP);
+
+    if (outputP->isBroken)
+    {
+        errno = EPIPE;
+        retVal = -1;
+    }
+    else if (!isWaiting && outputP->pendingLength > 0 && outputP->pendingLength + length > TLS_OUTPUT_MAX_PENDING)
+    {
+        TLS_COUNT(sendsRefused, 1);
+        errno = EAGAIN;
+        retVal = -1;
+    }
+    else
+    {
+        // Straight to the socket only if nothing is queued ahead of it
+        ssize_t numWritten = 0;
+        if (outputP->pendingLength == 0)
+        {
+            numWritten = writeAvailable(clientSocket, data, length, &outputP->waitEvents);
+        }
+
+        if (numWritten < 0)
+        {
+            outputP->isBroken = 1;
+            errno = EPIPE;
+            retVal = -1;
+        }
+        else if ((size_t)numWritten < length)
+        {
+            TLS_COUNT(sendsQueued, 1);
+            if (queueOutput(outputP, (const char*)data + numWritten, length - numWritten) != TLS_SUCCESS)
+            {
+                // Part of the frame may be on the wire, or in OpenSSL's unfinished record - the stream cannot be continued
+                outputP->isBroken = 1;
+                errno = ENOMEM;
+                retVal = -1;
+            }
+        }
+    }
+
+    while (isWaiting && retVal >= 0 && outputP->pendingLength > 0)
+    {
+        short waitEvents = outputP->waitEvents;
+        pthread_mutex_unlock(&outputP->mutex);
+
+        coroutineWaitFd(clientSocket, waitEvents, COROUTINE_NO_TIMEOUT);
+
+        pthread_mutex_lock(&outputP->mutex);
+        flushOutput(clientSocket, outputP);
+
+        if (outputP->isBroken)
+        {
+            errno = EPIPE;
+            retVal = -1;
+        }
+    }
+
+    pthread_mutex_unlock(&outputP->mutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     tlsGetPendingLength
+* Purpose:      Gets how much a chat client's output queue holds - a hint, as it can change right after.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*
+* Outputs:      None
+*
+* Returns:      size_t                          Number of bytes queued.
+*/
+size_t tlsGetPendingLength(int clientSocket)
+{
+    TLSOutput* outputs = __atomic_load_n(&tlsOutputs, __ATOMIC_ACQUIRE);
+    if (clientSocket < 0 || clientSocket >= TLS_MAX_FDS || outputs == NULL)
+    {
+        return 0;
+    }
+
+    return __atomic_load_n(&outputs[clientSocket].pendingLength, __ATOMIC_RELAXED);
+}
+
+
+/*
+* Function:     tlsFlushPending
+* Purpose:      Writes what every socket can take of its output queue, so what sends that did not wait
+*               left queued goes out without another send to push it. Called by the connection monitor;
+*               skips queues another thread is using.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void tlsFlushPending()
+{
+    if (__atomic_load_n(&numPendingOutputs, __ATOMIC_RELAXED) == 0)
+    {
+        return;
+    }
+
+    TLSOutput* outputs = __atomic_load_n(&tlsOutputs, __ATOMIC_ACQUIRE);
+    int highestFd = __atomic_load_n(&highestOutputFd, __ATOMIC_RELAXED);
+
+    for (int clientSocket = 0; clientSocket <= highestFd; clientSocket++)
+    {
+        TLSOutput* outputP = &outputs[clientSocket];
+        if (__atomic_load_n(&outputP->pendingLength, __ATOMIC_RELAXED) > 0 && pthread_mutex_trylock(&outputP->mutex) == 0)
+        {
+            flushOutput(clientSocket, outputP);
+            pthread_mutex_unlock(&outputP->mutex);
+        }
+    }
+}
+
+#ifdef CHAT_TLS
+
+
+/*
+* Function:     tlsRecv
+* Purpose:      Reads decrypted data from a chat client - transportRecv() for a socket without TLS.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               void*           buffer          Where to store the data.
+*               size_t          length          Size of buffer.
+*               int             flags           0, or MSG_PEEK to leave the data for the next read.
+*
+* Outputs:      buffer
+*
+* Returns:      ssize_t                         Number of bytes read, 0 if the client closed the connection, or -1 on error.
+*/
+ssize_t tlsRecv(int clientSocket, void* buffer, size_t length, int flags)
+{
+    TLSSession* session = getSession(clientSocket);
+    if (session == NULL)
+    {
+        return transportRecv(clientSocket, buffer, length, flags);
+    }
+
+    while (1)
+    {
+        // Only one thread ever reads, so the socket is waited on outside the lock
+        pthread_mutex_lock(&session->mutex);
+
+        size_t numRead = 0;
+        int result = flags & MSG_PEEK ? SSL_peek_ex(session->ssl, buffer, length, &numRead) :
+            SSL_read_ex(session->ssl, buffer, length, &numRead);
+        int sslError = result > 0 ? SSL_ERROR_NONE : SSL_get_error(session->ssl, result);
+
+        pthread_mutex_unlock(&session->mutex);
+
+        if (result > 0)
+        {
+            return (ssize_t)numRead;
+        }
+        if (sslError == SSL_ERROR_ZERO_RETURN)
+        {
+            return 0;
+        }
+        if (sslError != SSL_ERROR_WANT_READ && sslError != SSL_ERROR_WANT_WRITE)
+        {
+            return -1;
+        }
+
+        // Not waitForSocket() - a coroutine session lets the other sessions on its loop run meanwhile
+        coroutineWaitFd(clientSocket, sslError == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT, COROUTINE_NO_TIMEOUT);
+    }
+}
+
+
+/*
+* Function:     tlsIsClient
+* Purpose:      Checks whether a socket was accepted on the TLS port.
+*
+* Inputs:       int             clientSocket    The socket.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 for a TLS client, 0 otherwise.
+*/
+int tlsIsClient(int clientSocket)
+{
+    return clientSocket >= 0 && clientSocket < TLS_MAX_FDS && __atomic_load_n(&tlsSessions[clientSocket], __ATOMIC_ACQUIRE) != NULL;
+}
+
+
+/*
+* Function:     acceptSession
+* Purpose:      Runs SSL_accept() on a non-blocking socket until the handshake is done, fails, or runs
+*               out of TLS_HANDSHAKE_TIMEOUT.
+*
+* Inputs:       SSL*            ssl             The session's SSL object.
+*               int             clientSocket    The socket, already non-blocking.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 once the handshake is done, anything else if it failed.
+*/
+static int acceptSession(SSL* ssl, int clientSocket)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t deadline = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000 + TLS_HANDSHAKE_TIMEOUT * 1000;
+
+    while (1)
+    {
+        int result = SSL_accept(ssl);
+        int sslError = result == 1 ? SSL_ERROR_NONE : SSL_get_error(ssl, result);
+        if (sslError != SSL_ERROR_WANT_READ && sslError != SSL_ERROR_WANT_WRITE)
+        {
+            return result;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int64_t remaining = deadline - ((int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+        if (remaining <= 0 ||
+            coroutineWaitFd(clientSocket, sslError == SSL_ERROR_WANT_READ ? POLLIN : POLLOUT, (int)remaining) == COROUTINE_TIMED_OUT)
+        {
+            return -1;
+        }
+    }
+}
+
+
+/*
+* Function:     tlsHandshake
+* Purpose:      Does the server side of the TLS handshake and hands the session's keys to the kernel
+*               where it can take them. On failure the socket is forgotten; the caller closes it.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*
+* Outputs:      None
+*
+* Returns:      int                             TLS_SUCCESS, or TLS_ERROR.
+*/
+int tlsHandshake(int clientSocket)
+{
+    TLSSession* session = memCalloc(MEM_CONNECTION_STATE, 1, sizeof(TLSSession));
+    if (session == NULL)
+    {
+        tlsForget(clientSocket);
+        return TLS_ERROR;
+    }
+
+    session->ssl = SSL_new(tlsContext);
+    if (session->ssl == NULL || SSL_set_fd(session->ssl, clientSocket) != 1)
+    {
+        SSL_free(session->ssl);
+        memFree(MEM_CONNECTION_STATE, session);
+        TLS_COUNT(handshakesFailed, 1);
+        tlsForget(clientSocket);
+        return TLS_ERROR;
+    }
+
+    fcntl(clientSocket, F_SETFL, fcntl(clientSocket, F_GETFL, 0) | O_NONBLOCK);
+    int result = acceptSession(session->ssl, clientSocket);
+
+    if (result != 1)
+    {
+        SSL_free(session->ssl);
+        memFree(MEM_CONNECTION_STATE, session);
+        TLS_COUNT(handshakesFailed, 1);
+        tlsForget(clientSocket);
+        return TLS_ERROR;
+    }
+
+    session->isKernelSend = BIO_get_ktls_send(SSL_get_wbio(session->ssl)) > 0;
+    session->isKernelRecv = BIO_get_ktls_recv(SSL_get_rbio(session->ssl)) > 0;
+    pthread_mutex_init(&session->mutex, NULL);
+
+    // The socket stays non-blocking - SSL calls take turns, so none of them may block, and kernel TLS
+    // sends go through the output queue like every other send
+    __atomic_store_n(&tlsSessions[clientSocket], session, __ATOMIC_RELEASE);
+
+    TLS_COUNT(handshakes, 1);
+    TLS_COUNT(kernelSendSessions, session->isKernelSend);
+    TLS_COUNT(kernelRecvSessions, session->isKernelRecv);
+
+    #ifdef TESTING
+        printf("TLS session on socket %d: %s, kernel send %s, kernel receive %s\n", clientSocket,
+            SSL_get_cipher(session->ssl), session->isKernelSend ? "yes" : "no", session->isKernelRecv ? "yes" : "no");
+    #endif
+
+    return TLS_SUCCESS;
+}
+
+
+/*
+* Function:     tlsForget
+* Purpose:      Ends a socket's TLS session, if it has one, and frees its output queue. Must be called
+*               before the socket is closed, once no other thread can send to it any more.
+*
+* Inputs:       int             clientSocket    The socket.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void tlsForget(int clientSocket)
+{
+    if (clientSocket < 0 || clientSocket >= TLS_MAX_FDS)
+    {
+        return;
+    }
+
+    forgetOutput(clientSocket);
+
+    TLSSession* session = getSession(clientSocket);
+    __atomic_store_n(&tlsSessions[clientSocket], NULL, __ATOMIC_RELEASE);
+
+    if (session != NULL)
+    {
+        SSL_shutdown(session->ssl); // Best effort - the close_notify is not waited for
+        SSL_free(session->ssl);
+        pthread_mutex_destroy(&session->mutex);
+        memFree(MEM_CONNECTION_STATE, session);
+    }
+}
+
+
+/*
+* Function:     tlsListener
+* Purpose:      Listener thread - accepts TLS connections and hands each one to a client handler.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* tlsListener(void* arg)
+{
+    (void)arg;
+
+    while (__atomic_load_n(&tlsIsRunning, __ATOMIC_ACQUIRE))
+    {
+        int clientSocket;
+        while ((clientSocket = accept(tlsSocket, NULL, NULL)) >= 0)
+        {
+            if (clientSocket >= TLS_MAX_FDS)
+            {
+                close(clientSocket);
+                continue;
+            }
+
+            // Marked before the handler starts, so it knows to do the handshake
+            __atomic_store_n(&tlsSessions[clientSocket], &pendingSession, __ATOMIC_RELEASE);
+
+            if (tlsAcceptHandler(clientSocket, tlsHandlerArg) != TLS_SUCCESS)
+            {
+                tlsForget(clientSocket);
+                close(clientSocket);
+            }
+        }
+
+        usleep(TLS_LOOP_SLEEP_LENGTH);
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     createContext
+* Purpose:      Creates the server's TLS context and loads its certificate and key.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             TLS_SUCCESS, or TLS_ERROR.
+*/
+static int createContext()
+{
+    tlsContext = SSL_CTX_new(TLS_server_method());
+    if (tlsContext == NULL)
+    {
+        return TLS_ERROR;
+    }
+
+    SSL_CTX_set_min_proto_version(tlsContext, TLS1_2_VERSION);
+
+    // Kernel TLS, and nothing that would make OpenSSL write on the read side after the handshake -
+    // no renegotiation, and no TLS 1.3 session tickets (clients reconnect rarely)
+    SSL_CTX_set_options(tlsContext, SSL_OP_ENABLE_KTLS | SSL_OP_NO_RENEGOTIATION);
+    SSL_CTX_set_num_tickets(tlsContext, 0);
+    SSL_CTX_set_mode(tlsContext, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    if (SSL_CTX_use_certificate_chain_file(tlsContext, TLS_CERT_FILE) != 1 ||
+        SSL_CTX_use_PrivateKey_file(tlsContext, TLS_KEY_FILE, SSL_FILETYPE_PEM) != 1 ||
+        SSL_CTX_check_private_key(tlsContext) != 1)
+    {
+        fprintf(stderr, "[SERVER] : cannot load TLS certificate '%s' and key '%s'\n", TLS_CERT_FILE, TLS_KEY_FILE);
+        SSL_CTX_free(tlsContext);
+        tlsContext = NULL;
+        return TLS_ERROR;
+    }
+
+    return TLS_SUCCESS;
+}
+
+
+/*
+* Function:     tlsStart
+* Purpose:      Loads the certificate, opens the TLS port and starts the listener thread.
+*
+* Inputs:       uint16_t            tlsPort         Port TLS clients connect to.
+*               TLSAcceptHandler    acceptHandler   Starts a client handler for an accepted connection.
+*               void*               handlerArg      Passed to acceptHandler.
+*
+* Outputs:      None
+*
+* Returns:      int                                 TLS_SUCCESS, or TLS_ERROR if TLS is unavailable.
+*/
+int tlsStart(uint16_t tlsPort, TLSAcceptHandler acceptHandler, void* handlerArg)
+{
+    if (createContext() != TLS_SUCCESS)
+    {
+        return TLS_ERROR;
+    }
+
+    if ((tlsSocket = setupServerSocket(tlsPort)) == SOCKET_ERROR)
+    {
+        SSL_CTX_free(tlsContext);
+        tlsContext = NULL;
+        return TLS_ERROR;
+    }
+    fcntl(tlsSocket, F_SETFL, fcntl(tlsSocket, F_GETFL, 0) | O_NONBLOCK);
+
+    tlsAcceptHandler = acceptHandler;
+    tlsHandlerArg = handlerArg;
+    __atomic_store_n(&tlsIsRunning, TLS_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&tlsThread, NULL, tlsListener, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&tlsIsRunning, TLS_STOPPED, __ATOMIC_RELEASE);
+        closeServerSocket(tlsSocket);
+        SSL_CTX_free(tlsContext);
+        tlsContext = NULL;
+        return TLS_ERROR;
+    }
+
+    return TLS_SUCCESS;
+}
+
+
+/*
+* Function:     tlsStop
+* Purpose:      Stops accepting TLS connections. Connected clients keep their sessions, and the
+*               context stays until exit for their handlers.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void tlsStop()
+{
+    if (__atomic_load_n(&tlsIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&tlsIsRunning, TLS_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(tlsThread, NULL);
+        closeServerSocket(tlsSocket);
+    }
+}
+
+#else // Built without TLS - no listener, and every socket is plaintext
+
+ssize_t tlsRecv(int clientSocket, void* buffer, size_t length, int flags)
+{
+    return transportRecv(clientSocket, buffer, length, flags);
+}
+
+int tlsIsClient(int clientSocket)
+{
+    (void)clientSocket;
+    return 0;
+}
+
+int tlsHandshake(int clientSocket)
+{
+    (void)clientSocket;
+    return TLS_ERROR;
+}
+
+void tlsForget(int clientSocket)
+{
+    if (clientSocket >= 0 && clientSocket < TLS_MAX_FDS)
+    {
+        forgetOutput(clientSocket);
+    }
+}
+
+int tlsStart(uint16_t tlsPort, TLSAcceptHandler acceptHandler, void* handlerArg)
+{
+    (void)tlsPort;
+    (void)acceptHandler;
+    (void)handlerArg;
+
+    fprintf(stderr, "[SERVER] : built without TLS (make TLS=1)\n");
+    return TLS_ERROR;
+}
+
+void tlsStop()
+{
+}
+
+#endif // CHAT_TLS
+
+
+/*
+* Function:     tlsGetStats
+* Purpose:      Gets the TLS counters.
+*
+* Inputs:       TLSStats*       statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void tlsGetStats(TLSStats* statsP)
+{
+    statsP->handshakes = __atomic_load_n(&tlsStats.handshakes, __ATOMIC_RELAXED);
+    statsP->handshakesFailed = __atomic_load_n(&tlsStats.handshakesFailed, __ATOMIC_RELAXED);
+    statsP->kernelSendSessions = __atomic_load_n(&tlsStats.kernelSendSessions, __ATOMIC_RELAXED);
+    statsP->kernelRecvSessions = __atomic_load_n(&tlsStats.kernelRecvSessions, __ATOMIC_RELAXED);
+    statsP->userspaceSends = __atomic_load_n(&tlsStats.userspaceSends, __ATOMIC_RELAXED);
+    statsP->userspaceBytes = __atomic_load_n(&tlsStats.userspaceBytes, __ATOMIC_RELAXED);
+    statsP->sendsQueued = __atomic_load_n(&tlsStats.sendsQueued, __ATOMIC_RELAXED);
+    statsP->sendsRefused = __atomic_load_n(&tlsStats.sendsRefused, __ATOMIC_RELAXED);
+}
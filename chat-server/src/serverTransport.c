@@ -0,0 +1,459 @@
+/*
+* Filename:		serverTransport.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the transports that carry the bytes of CHAT-SYSTEM
+*               client connections.
+*
+*               Every byte to or from a plaintext client (or a kernel TLS one) goes through
+*               transportSend() and transportRecv(), from tlsSend() and tlsRecv(). The server uses the
+*               socket transport: send(), and coroutineRecv() so a handler waits on its event loop.
+*
+*               The loopback transport keeps each connection in memory instead, so a benchmark can
+*               run registration, parsing, queueing and fan-out for thousands of clients in one
+*               process, with no sockets and no kernel in the way. A connection has an inbox the
+*               client writes into and the server reads from, and an outbox the other way round.
+*               The client is assumed to keep up: a send that does not fit in the outbox is counted
+*               and dropped whole rather than holding the server up. Loopback buffers stand in for kernel
+*               socket buffers, so they are not charged to the memory budget either.
+*
+*               NOTE: A loopback connection must only be closed once the server is done with it.
+*/
+
+#include "../inc/serverTransport.h"
+
+typedef struct
+{
+    pthread_mutex_t mutex;
+    size_t inboxLength;
+    size_t outboxLength;
+    char inbox[TRANSPORT_LOOPBACK_INBOX_LENGTH];
+    char outbox[TRANSPORT_LOOPBACK_OUTBOX_LENGTH];
+} LoopbackConnection;
+
+static TransportStats transportStats;
+
+#define TRANSPORT_COUNT(counter, amount) __atomic_add_fetch(&transportStats.counter, amount, __ATOMIC_RELAXED)
+
+static ssize_t socketSend(int clientSocket, const void* data, size_t length, int flags);
+static ssize_t loopbackSend(int clientSocket, const void* data, size_t length, int flags);
+static ssize_t loopbackRecv(int clientSocket, void* buffer, size_t length, int flags);
+
+static const Transport socketTransport = {"sockets", socketSend, coroutineRecv};
+static const Transport loopbackTransport = {"loopback", loopbackSend, loopbackRecv};
+
+static const Transport* currentTransport = &socketTransport;
+
+// Protects opening and closing - sends and reads only take their connection's own mutex
+static pthread_mutex_t loopbackMutex = PTHREAD_MUTEX_INITIALIZER;
+static LoopbackConnection* loopbackConnections[TRANSPORT_LOOPBACK_MAX_CONNECTIONS];    // Atomic per slot
+
+
+/*
+* Function:     socketSend
+* Purpose:      Sends data on a client's socket.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const void*     data            Data to send.
+*               size_t          length          Number of bytes.
+*               int             flags           Flags for send().
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         Number of bytes sent, or -1 on error.
+*/
+static ssize_t socketSend(int clientSocket, const void* data, size_t length, int flags)
+{
+    return send(clientSocket, data, length, flags);
+}
+
+
+/*
+* Function:     getConnection
+* Purpose:      Finds the loopback connection behind a socket number.
+*
+* Inputs:       int             clientSocket    The connection's socket number.
+*
+* Outputs:      None
+*
+* Returns:      LoopbackConnection*             The connection, or NULL (with errno set to EBADF) if it is not open.
+*/
+static LoopbackConnection* getConnection(int clientSocket)
+{
+    int slot = clientSocket - TRANSPORT_LOOPBACK_FIRST_SOCKET;
+    LoopbackConnection* connectionP = NULL;
+
+    if (slot >= 0 && slot < TRANSPORT_LOOPBACK_MAX_CONNECTIONS)
+    {
+        connectionP = __atomic_load_n(&loopbackConnections[slot], __ATOMIC_ACQUIRE);
+    }
+
+    if (connectionP == NULL)
+    {
+        errno = EBADF;
+    }
+
+    return connectionP;
+}
+
+
+/*
+* Function:     loopbackSend
+* Purpose:      Sends data to a loopback client - appends it to the connection's outbox, or drops it
+*               whole if it does not fit, so the client never reads a cut-off frame.
+*
+* Inputs:       int             clientSocket    The connection's socket number.
+*               const void*     data            Data to send.
+*               size_t          length          Number of bytes.
+*               int             flags           Ignored - a loopback send never blocks.
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         length, or -1 if the connection is not open.
+*/
+static ssize_t loopbackSend(int clientSocket, const void* data, size_t length, int flags)
+{
+    LoopbackConnection* connectionP = getConnection(clientSocket);
+    if (connectionP == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&connectionP->mutex);
+
+    size_t roomLeft = TRANSPORT_LOOPBACK_OUTBOX_LENGTH - connectionP->outboxLength;
+    size_t numKept = length <= roomLeft ? length : 0;
+    memcpy(connectionP->outbox + connectionP->outboxLength, data, numKept);
+    connectionP->outboxLength += numKept;
+
+    pthread_mutex_unlock(&connectionP->mutex);
+
+    TRANSPORT_COUNT(loopbackSends, 1);
+    TRANSPORT_COUNT(loopbackBytesSent, length);
+    TRANSPORT_COUNT(loopbackBytesDropped, length - numKept);
+
+    return (ssize_t)length;
+}
+
+
+/*
+* Function:     loopbackRecv
+* Purpose:      Reads what a loopback client has written from the connection's inbox.
+*
+* Inputs:       int             clientSocket    The connection's socket number.
+*               void*           buffer          Where to store the data.
+*               size_t          length          Size of buffer.
+*               int             flags           0, or MSG_PEEK to leave the data for the next read.
+*
+* Outputs:      buffer
+*
+* Returns:      ssize_t                         Number of bytes read, or -1 (errno EAGAIN) if there is nothing to read.
+*/
+static ssize_t loopbackRecv(int clientSocket, void* buffer, size_t length, int flags)
+{
+    LoopbackConnection* connectionP = getConnection(clientSocket);
+    if (connectionP == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&connectionP->mutex);
+
+    size_t numRead = length < connectionP->inboxLength ? length : connectionP->inboxLength;
+    memcpy(buffer, connectionP->inbox, numRead);
+
+    if (!(flags & MSG_PEEK))
+    {
+        connectionP->inboxLength -= numRead;
+        memmove(connectionP->inbox, connectionP->inbox + numRead, connectionP->inboxLength);
+    }
+
+    pthread_mutex_unlock(&connectionP->mutex);
+
+    if (numRead == 0)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+
+    return (ssize_t)numRead;
+}
+
+
+/*
+* Function:     transportSockets
+* Purpose:      Gets the socket transport - the server's.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      const Transport*                The transport.
+*/
+const Transport* transportSockets()
+{
+    return &socketTransport;
+}
+
+
+/*
+* Function:     transportLoopback
+* Purpose:      Gets the in-memory loopback transport.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      const Transport*                The transport.
+*/
+const Transport* transportLoopback()
+{
+    return &loopbackTransport;
+}
+
+
+/*
+* Function:     transportUse
+* Purpose:      Sets the transport every client connection uses from now on.
+*               NOTE: Make sure to call this before any client connects!
+*
+* Inputs:       const Transport* transportP     The transport.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void transportUse(const Transport* transportP)
+{
+    __atomic_store_n(&currentTransport, transportP, __ATOMIC_RELEASE);
+}
+
+
+/*
+* Function:     transportGetCurrent
+* Purpose:      Gets the transport client connections use.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      const Transport*                The transport.
+*/
+const Transport* transportGetCurrent()
+{
+    return __atomic_load_n(&currentTransport, __ATOMIC_ACQUIRE);
+}
+
+
+/*
+* Function:     transportSend
+* Purpose:      Sends data to a client over the current transport.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const void*     data            Data to send.
+*               size_t          length          Number of bytes.
+*               int             flags           Flags for send().
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         Number of bytes sent, or -1 on error.
+*/
+ssize_t transportSend(int clientSocket, const void* data, size_t length, int flags)
+{
+    return transportGetCurrent()->send(clientSocket, data, length, flags);
+}
+
+
+/*
+* Function:     transportRecv
+* Purpose:      Reads data from a client over the current transport.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               void*           buffer          Where to store the data.
+*               size_t          length          Size of buffer.
+*               int             flags           0, or MSG_PEEK to leave the data for the next read.
+*
+* Outputs:      buffer
+*
+* Returns:      ssize_t                         Number of bytes read, 0 if the client closed the connection, or -1 on error.
+*/
+ssize_t transportRecv(int clientSocket, void* buffer, size_t length, int flags)
+{
+    return transportGetCurrent()->recv(clientSocket, buffer, length, flags);
+}
+
+
+/*
+* Function:     transportLoopbackOpen
+* Purpose:      Opens a loopback connection.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      int                             The connection's socket number, or TRANSPORT_ERROR if all are in use.
+*/
+int transportLoopbackOpen()
+{
+    int clientSocket = TRANSPORT_ERROR;
+
+    pthread_mutex_lock(&loopbackMutex);
+
+    for (int slot = 0; slot < TRANSPORT_LOOPBACK_MAX_CONNECTIONS; slot++)
+    {
+        if (loopbackConnections[slot] == NULL)
+        {
+            LoopbackConnection* connectionP = calloc(1, sizeof(LoopbackConnection));
+            if (connectionP == NULL)
+            {
+                perror("calloc");
+                break;
+            }
+
+            pthread_mutex_init(&connectionP->mutex, NULL);
+            __atomic_store_n(&loopbackConnections[slot], connectionP, __ATOMIC_RELEASE);
+            transportStats.numLoopbackConnections++;
+
+            clientSocket = TRANSPORT_LOOPBACK_FIRST_SOCKET + slot;
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&loopbackMutex);
+
+    return clientSocket;
+}
+
+
+/*
+* Function:     transportLoopbackClose
+* Purpose:      Closes a loopback connection.
+*               NOTE: Make sure the server no longer has the connection in its registry!
+*
+* Inputs:       int             clientSocket    The connection's socket number.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void transportLoopbackClose(int clientSocket)
+{
+    int slot = clientSocket - TRANSPORT_LOOPBACK_FIRST_SOCKET;
+    if (slot < 0 || slot >= TRANSPORT_LOOPBACK_MAX_CONNECTIONS)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&loopbackMutex);
+
+    LoopbackConnection* connectionP = loopbackConnections[slot];
+    if (connectionP != NULL)
+    {
+        __atomic_store_n(&loopbackConnections[slot], NULL, __ATOMIC_RELEASE);
+        transportStats.numLoopbackConnections--;
+        pthread_mutex_destroy(&connectionP->mutex);
+        free(connectionP);
+    }
+
+    pthread_mutex_unlock(&loopbackMutex);
+}
+
+
+/*
+* Function:     transportLoopbackWrite
+* Purpose:      Writes data to the server as the client of a loopback connection.
+*
+* Inputs:       int             clientSocket    The connection's socket number.
+*               const void*     data            Data to write.
+*               size_t          length          Number of bytes.
+*
+* Outputs:      None
+*
+* Returns:      int                             TRANSPORT_SUCCESS, or TRANSPORT_ERROR if the connection is
+*                                               not open or the server has not read enough of the inbox yet.
+*/
+int transportLoopbackWrite(int clientSocket, const void* data, size_t length)
+{
+    int retVal = TRANSPORT_ERROR;
+
+    LoopbackConnection* connectionP = getConnection(clientSocket);
+    if (connectionP == NULL)
+    {
+        return TRANSPORT_ERROR;
+    }
+
+    pthread_mutex_lock(&connectionP->mutex);
+
+    if (length <= TRANSPORT_LOOPBACK_INBOX_LENGTH - connectionP->inboxLength)
+    {
+        memcpy(connectionP->inbox + connectionP->inboxLength, data, length);
+        connectionP->inboxLength += length;
+        retVal = TRANSPORT_SUCCESS;
+    }
+
+    pthread_mutex_unlock(&connectionP->mutex);
+
+    return retVal;
+}
+
+
+/*
+* Function:     transportLoopbackRead
+* Purpose:      Reads what the server has sent as the client of a loopback connection, emptying its outbox.
+*
+* Inputs:       int             clientSocket    The connection's socket number.
+*               void*           buffer          Where to store the data.
+*               size_t          length          Size of buffer.
+*
+* Outputs:      buffer
+*
+* Returns:      ssize_t                         Number of bytes read (0 if there was nothing), or -1 if the
+*                                               connection is not open.
+*/
+ssize_t transportLoopbackRead(int clientSocket, void* buffer, size_t length)
+{
+    LoopbackConnection* connectionP = getConnection(clientSocket);
+    if (connectionP == NULL)
+    {
+        return -1;
+    }
+
+    pthread_mutex_lock(&connectionP->mutex);
+
+    size_t numRead = length < connectionP->outboxLength ? length : connectionP->outboxLength;
+    memcpy(buffer, connectionP->outbox, numRead);
+    connectionP->outboxLength -= numRead;
+    memmove(connectionP->outbox, connectionP->outbox + numRead, connectionP->outboxLength);
+
+    pthread_mutex_unlock(&connectionP->mutex);
+
+    TRANSPORT_COUNT(loopbackReads, 1);
+    TRANSPORT_COUNT(loopbackBytesRead, numRead);
+
+    return (ssize_t)numRead;
+}
+
+
+/*
+* Function:     transportGetStats
+* Purpose:      Gets the loopback counters.
+*
+* Inputs:       TransportStats* statsP          Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void transportGetStats(TransportStats* statsP)
+{
+    pthread_mutex_lock(&loopbackMutex);
+    statsP->numLoopbackConnections = transportStats.numLoopbackConnections;
+    pthread_mutex_unlock(&loopbackMutex);
+
+    statsP->loopbackSends = __atomic_load_n(&transportStats.loopbackSends, __ATOMIC_RELAXED);
+    statsP->loopbackBytesSent = __atomic_load_n(&transportStats.loopbackBytesSent, __ATOMIC_RELAXED);
+    statsP->loopbackBytesDropped = __atomic_load_n(&transportStats.loopbackBytesDropped, __ATOMIC_RELAXED);
+    statsP->loopbackReads = __atomic_load_n(&transportStats.loopbackReads, __ATOMIC_RELAXED);
+    statsP->loopbackBytesRead = __atomic_load_n(&transportStats.loopbackBytesRead, __ATOMIC_RELAXED);
+}
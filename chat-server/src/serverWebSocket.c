@@ -0,0 +1,733 @@
+/*
+* Filename:		serverWebSocket.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for the WebSocket gateway of the CHAT-SYSTEM server.
+*
+*               Browsers cannot open plain TCP sockets, so web users connect to WEBSOCKET_PORT instead.
+*               The gateway thread only accepts connections; each one is then handed to a normal client
+*               handler, which does the RFC 6455 handshake and from there on treats the client like any
+*               other - same registry, same broadcaster, same presence and mailbox traffic.
+*
+*               The only difference is on the wire:
+*                   - Each text frame from the client holds one serialized ClientMessage. Frames must be
+*                     masked and unfragmented; pings are answered and pongs ignored.
+*                   - Each serialized Broadcast to the client goes in a text frame of its own. Server
+*                     code sends to clients through clientSend(), which frames the JSON objects in a
+*                     buffer for WebSocket clients and sends the buffer as it is to everyone else.
+*                   - The chat broadcaster frames each broadcast once and sends the same frame to every
+*                     WebSocket client, so fan-out to them costs the same single send() as to TCP clients.
+*
+*               Which sockets are WebSocket clients is kept in a table indexed by socket, so telling
+*               them apart on the send path is a single load.
+*/
+
+#include "../inc/serverWebSocket.h"
+
+static unsigned char isWebSocketSocket[WEBSOCKET_MAX_FDS];     // Set and cleared atomically - the next handler of a reused fd reads it
+
+static int websocketSocket = -1;
+static pthread_t websocketThread;
+static int websocketIsRunning = WEBSOCKET_STOPPED;
+static WebSocketAcceptHandler websocketAcceptHandler = NULL;
+static void* websocketHandlerArg = NULL;
+
+static WebSocketStats websocketStats;
+
+#define WEBSOCKET_COUNT(counter) __atomic_add_fetch(&websocketStats.counter, 1, __ATOMIC_RELAXED)
+
+static const char base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+/*
+* Function:     base64Encode
+* Purpose:      Encodes bytes as base64, for the handshake's accept key.
+*
+* Inputs:       const uint8_t*  data            Bytes to encode.
+*               size_t          length          Number of bytes.
+*               char*           encoded         Where to store the encoding - at least 4 * ((length + 2) / 3) + 1 bytes.
+*
+* Outputs:      encoded                         The null-terminated encoding.
+*
+* Returns:      void
+*/
+static void base64Encode(const uint8_t* data, size_t length, char* encoded)
+{
+    size_t out = 0;
+
+    for (size_t i = 0; i < length; i += 3)
+    {
+        uint32_t group = (uint32_t)data[i] << 16;
+        if (i + 1 < length)
+        {
+            group |= (uint32_t)data[i + 1] << 8;
+        }
+        if (i + 2 < length)
+        {
+            group |= data[i + 2];
+        }
+
+        encoded[out++] = base64Alphabet[(group >> 18) & 0x3F];
+        encoded[out++] = base64Alphabet[(group >> 12) & 0x3F];
+        encoded[out++] = i + 1 < length ? base64Alphabet[(group >> 6) & 0x3F] : '=';
+        encoded[out++] = i + 2 < length ? base64Alphabet[group & 0x3F] : '=';
+    }
+
+    encoded[out] = '\0';
+}
+
+
+/*
+* Function:     findHeader
+* Purpose:      Finds a header in a handshake request. Header names are case-insensitive.
+*
+* Inputs:       const char*     request         The null-terminated request.
+*               const char*     name            Header name, without the colon.
+*               char*           value           Where to store the value, without surrounding spaces.
+*               size_t          valueLength     Size of value.
+*
+* Outputs:      value
+*
+* Returns:      int                             1 if the header was found, 0 otherwise.
+*/
+static int findHeader(const char* request, const char* name, char* value, size_t valueLength)
+{
+    size_t nameLength = strlen(name);
+
+    // Headers start after the request line
+    const char* line = strstr(request, "\r\n");
+    while (line != NULL && line[2] != '\r' && line[2] != '\0')
+    {
+        line += 2;
+        const char* lineEnd = strstr(line, "\r\n");
+        if (lineEnd == NULL)
+        {
+            return 0;
+        }
+
+        if (strncasecmp(line, name, nameLength) == 0 && line[nameLength] == ':')
+        {
+            const char* valueStart = line + nameLength + 1;
+            while (valueStart < lineEnd && (*valueStart == ' ' || *valueStart == '\t'))
+            {
+                valueStart++;
+            }
+
+            const char* valueEnd = lineEnd;
+            while (valueEnd > valueStart && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+            {
+                valueEnd--;
+            }
+
+            size_t length = valueEnd - valueStart;
+            if (length >= valueLength)
+            {
+                return 0;
+            }
+
+            memcpy(value, valueStart, length);
+            value[length] = '\0';
+            return 1;
+        }
+
+        line = lineEnd;
+    }
+
+    return 0;
+}
+
+
+/*
+* Function:     headerHasToken
+* Purpose:      Checks whether a comma-separated header value contains a token, ignoring case
+*               (Connection is often "keep-alive, Upgrade").
+*
+* Inputs:       const char*     value           The header value.
+*               const char*     token           The token.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 if the token is in the value, 0 otherwise.
+*/
+static int headerHasToken(const char* value, const char* token)
+{
+    size_t tokenLength = strlen(token);
+
+    while (*value != '\0')
+    {
+        while (*value == ' ' || *value == ',')
+        {
+            value++;
+        }
+
+        size_t length = strcspn(value, ", ");
+        if (length == tokenLength && strncasecmp(value, token, tokenLength) == 0)
+        {
+            return 1;
+        }
+        value += length;
+    }
+
+    return 0;
+}
+
+
+/*
+* Function:     readHandshakeRequest
+* Purpose:      Reads the client's HTTP upgrade request. A client may not send frames before it has
+*               the server's reply, so the request is everything up to the first blank line.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               char*           request         Where to store the request - WEBSOCKET_REQUEST_LENGTH bytes.
+*
+* Outputs:      request                         The null-terminated request.
+*
+* Returns:      int                             WEBSOCKET_SUCCESS, or WEBSOCKET_ERROR if it timed out, was too long or had trailing data.
+*/
+static int readHandshakeRequest(int clientSocket, char* request)
+{
+    struct timeval timeout = {.tv_sec = WEBSOCKET_HANDSHAKE_TIMEOUT, .tv_usec = 0};
+    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    int retVal = WEBSOCKET_ERROR;
+    size_t requestLength = 0;
+
+    while (requestLength < WEBSOCKET_REQUEST_LENGTH - 1)
+    {
+        ssize_t numBytesRead = coroutineRecv(clientSocket, request + requestLength, WEBSOCKET_REQUEST_LENGTH - 1 - requestLength, 0);
+        if (numBytesRead <= 0)
+        {
+            break;
+        }
+        requestLength += numBytesRead;
+        request[requestLength] = '\0';
+
+        char* requestEnd = strstr(request, "\r\n\r\n");
+        if (requestEnd != NULL)
+        {
+            retVal = requestEnd + 4 == request + requestLength ? WEBSOCKET_SUCCESS : WEBSOCKET_ERROR;
+            break;
+        }
+    }
+
+    // The chat itself may be idle for as long as the user likes
+    timeout.tv_sec = 0;
+    setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    return retVal;
+}
+
+
+/*
+* Function:     websocketHandshake
+* Purpose:      Reads a client's upgrade request and answers it. On failure the client is sent an
+*               HTTP error and forgotten as a WebSocket client; the caller closes the socket.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*
+* Outputs:      None
+*
+* Returns:      int                             WEBSOCKET_SUCCESS, or WEBSOCKET_ERROR.
+*/
+int websocketHandshake(int clientSocket)
+{
+    char request[WEBSOCKET_REQUEST_LENGTH];
+    char key[64];
+    char value[256];
+
+    int isValid = readHandshakeRequest(clientSocket, request) == WEBSOCKET_SUCCESS &&
+        strncmp(request, "GET ", 4) == 0 &&
+        findHeader(request, "Upgrade", value, sizeof(value)) && headerHasToken(value, "websocket") &&
+        findHeader(request, "Connection", value, sizeof(value)) && headerHasToken(value, "Upgrade") &&
+        findHeader(request, "Sec-WebSocket-Key", key, sizeof(key) - sizeof(WEBSOCKET_GUID));
+
+    if (isValid && (!findHeader(request, "Sec-WebSocket-Version", value, sizeof(value)) || strcmp(value, WEBSOCKET_VERSION) != 0))
+    {
+        const char* reply = "HTTP/1.1 426 Upgrade Required\r\nSec-WebSocket-Version: " WEBSOCKET_VERSION "\r\nContent-Length: 0\r\n\r\n";
+        send(clientSocket, reply, strlen(reply), MSG_NOSIGNAL);
+        isValid = 0;
+    }
+    else if (!isValid)
+    {
+        const char* reply = "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\n\r\n";
+        send(clientSocket, reply, strlen(reply), MSG_NOSIGNAL);
+    }
+
+    if (!isValid)
+    {
+        WEBSOCKET_COUNT(handshakesFailed);
+        websocketForget(clientSocket);
+        return WEBSOCKET_ERROR;
+    }
+
+    // Sec-WebSocket-Accept is base64(SHA-1(key + GUID))
+    uint8_t digest[SHA1_DIGEST_LENGTH];
+    char acceptKey[4 * ((SHA1_DIGEST_LENGTH + 2) / 3) + 1];
+    strcat(key, WEBSOCKET_GUID);
+    sha1(key, strlen(key), digest);
+    base64Encode(digest, SHA1_DIGEST_LENGTH, acceptKey);
+
+    char reply[256];
+    int replyLength = snprintf(reply, sizeof(reply),
+        "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", acceptKey);
+
+    if (send(clientSocket, reply, replyLength, MSG_NOSIGNAL) != replyLength)
+    {
+        WEBSOCKET_COUNT(handshakesFailed);
+        websocketForget(clientSocket);
+        return WEBSOCKET_ERROR;
+    }
+
+    return WEBSOCKET_SUCCESS;
+}
+
+
+/*
+* Function:     websocketIsClient
+* Purpose:      Checks whether a socket belongs to a WebSocket client.
+*
+* Inputs:       int             clientSocket    The socket.
+*
+* Outputs:      None
+*
+* Returns:      int                             1 for a WebSocket client, 0 otherwise.
+*/
+int websocketIsClient(int clientSocket)
+{
+    return clientSocket >= 0 && clientSocket < WEBSOCKET_MAX_FDS && __atomic_load_n(&isWebSocketSocket[clientSocket], __ATOMIC_ACQUIRE);
+}
+
+
+/*
+* Function:     websocketForget
+* Purpose:      Stops treating a socket as a WebSocket client. Must be called before the socket is
+*               closed, as its number can be reused by the next connection straight away.
+*
+* Inputs:       int             clientSocket    The socket.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void websocketForget(int clientSocket)
+{
+    if (clientSocket >= 0 && clientSocket < WEBSOCKET_MAX_FDS)
+    {
+        __atomic_store_n(&isWebSocketSocket[clientSocket], 0, __ATOMIC_RELEASE);
+    }
+}
+
+
+/*
+* Function:     sendControlFrame
+* Purpose:      Sends a control frame (close, ping or pong) to a client.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               int             opcode          The frame's opcode.
+*               const uint8_t*  payload         The payload, at most WEBSOCKET_MAX_CONTROL_LENGTH bytes.
+*               size_t          payloadLength   Number of payload bytes.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void sendControlFrame(int clientSocket, int opcode, const uint8_t* payload, size_t payloadLength)
+{
+    uint8_t frame[2 + WEBSOCKET_MAX_CONTROL_LENGTH];
+
+    frame[0] = WEBSOCKET_FIN | opcode;
+    frame[1] = (uint8_t)payloadLength;
+    memcpy(frame + 2, payload, payloadLength);
+
+    tlsSend(clientSocket, frame, 2 + payloadLength, 0);
+}
+
+
+/*
+* Function:     sendCloseFrame
+* Purpose:      Sends a close frame with a status code.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               int             statusCode      One of the WEBSOCKET_CLOSE_ codes.
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+static void sendCloseFrame(int clientSocket, int statusCode)
+{
+    uint8_t payload[2] = {(uint8_t)(statusCode >> 8), (uint8_t)statusCode};
+    sendControlFrame(clientSocket, WEBSOCKET_OPCODE_CLOSE, payload, sizeof(payload));
+}
+
+
+/*
+* Function:     readExactly
+* Purpose:      Reads exactly the given number of bytes from a socket.
+*
+* Inputs:       int             clientSocket    The socket.
+*               void*           buffer          Where to store the bytes.
+*               size_t          length          Number of bytes to read.
+*
+* Outputs:      buffer
+*
+* Returns:      int                             WEBSOCKET_SUCCESS, or WEBSOCKET_ERROR if the socket closed or failed first.
+*/
+static int readExactly(int clientSocket, void* buffer, size_t length)
+{
+    size_t numRead = 0;
+
+    while (numRead < length)
+    {
+        ssize_t numBytesRead = coroutineRecv(clientSocket, (char*)buffer + numRead, length - numRead, MSG_WAITALL);
+        if (numBytesRead <= 0)
+        {
+            return WEBSOCKET_ERROR;
+        }
+        numRead += numBytesRead;
+    }
+
+    return WEBSOCKET_SUCCESS;
+}
+
+
+/*
+* Function:     websocketReadMessage
+* Purpose:      Reads the next text frame from a WebSocket client and unmasks it. Pings are answered and
+*               pongs skipped on the way. A close, or any frame this gateway does not take (fragmented,
+*               binary, unmasked or longer than the buffer), ends the connection.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               char*           buffer          Where to store the payload.
+*               size_t          bufferLength    Size of buffer - the payload is null-terminated, so one byte less fits.
+*
+* Outputs:      buffer                          The payload of the text frame.
+*
+* Returns:      int                             Payload length, 0 if the client closed the connection, or -1 on error.
+*/
+int websocketReadMessage(int clientSocket, char* buffer, size_t bufferLength)
+{
+    while (1)
+    {
+        uint8_t header[2];
+        if (readExactly(clientSocket, header, sizeof(header)) != WEBSOCKET_SUCCESS)
+        {
+            return -1;
+        }
+
+        int isFinal = header[0] & WEBSOCKET_FIN;
+        int opcode = header[0] & 0x0F;
+        int isMasked = header[1] & WEBSOCKET_MASKED;
+        uint64_t payloadLength = header[1] & 0x7F;
+
+        if (payloadLength == 126)
+        {
+            uint8_t extendedLength[2];
+            if (readExactly(clientSocket, extendedLength, sizeof(extendedLength)) != WEBSOCKET_SUCCESS)
+            {
+                return -1;
+            }
+            payloadLength = (uint64_t)extendedLength[0] << 8 | extendedLength[1];
+        }
+        else if (payloadLength == 127)
+        {
+            // Far longer than any chat message
+            payloadLength = UINT64_MAX;
+        }
+
+        int isControl = opcode & 0x08;
+        int closeCode = 0;
+
+        if (!isMasked || (isControl && (!isFinal || payloadLength > WEBSOCKET_MAX_CONTROL_LENGTH)))
+        {
+            closeCode = WEBSOCKET_CLOSE_PROTOCOL_ERROR;
+        }
+        else if (!isControl && (!isFinal || opcode != WEBSOCKET_OPCODE_TEXT))
+        {
+            // A ClientMessage always fits in one frame, so fragments and binary data are not accepted
+            closeCode = WEBSOCKET_CLOSE_UNSUPPORTED;
+        }
+        else if (payloadLength >= bufferLength)
+        {
+            closeCode = WEBSOCKET_CLOSE_TOO_BIG;
+        }
+
+        if (closeCode != 0)
+        {
+            WEBSOCKET_COUNT(framesRejected);
+            sendCloseFrame(clientSocket, closeCode);
+            return -1;
+        }
+
+        uint8_t mask[4];
+        if (readExactly(clientSocket, mask, sizeof(mask)) != WEBSOCKET_SUCCESS ||
+            readExactly(clientSocket, buffer, payloadLength) != WEBSOCKET_SUCCESS)
+        {
+            return -1;
+        }
+
+        for (uint64_t i = 0; i < payloadLength; i++)
+        {
+            buffer[i] ^= mask[i & 3];
+        }
+        buffer[payloadLength] = '\0';
+
+        switch (opcode)
+        {
+            case WEBSOCKET_OPCODE_TEXT:
+                WEBSOCKET_COUNT(framesReceived);
+                return (int)payloadLength;
+
+            case WEBSOCKET_OPCODE_PING:
+                sendControlFrame(clientSocket, WEBSOCKET_OPCODE_PONG, (uint8_t*)buffer, payloadLength);
+                WEBSOCKET_COUNT(pingsAnswered);
+                break;
+
+            case WEBSOCKET_OPCODE_CLOSE:
+                WEBSOCKET_COUNT(closesReceived);
+                sendCloseFrame(clientSocket, WEBSOCKET_CLOSE_NORMAL);
+                return 0;
+
+            default: // Pong, or a control frame from a later version of the protocol
+                break;
+        }
+    }
+}
+
+
+/*
+* Function:     websocketFrameText
+* Purpose:      Builds an unmasked text frame around a payload.
+*
+* Inputs:       const char*     payload         The payload - at most 65535 bytes.
+*               size_t          payloadLength   Number of bytes.
+*               char*           frame           Where to store the frame - payloadLength + WEBSOCKET_MAX_HEADER_LENGTH bytes.
+*
+* Outputs:      frame                           The frame.
+*
+* Returns:      size_t                          Length of the frame.
+*/
+size_t websocketFrameText(const char* payload, size_t payloadLength, char* frame)
+{
+    size_t headerLength = 2;
+
+    frame[0] = (char)(WEBSOCKET_FIN | WEBSOCKET_OPCODE_TEXT);
+    if (payloadLength < 126)
+    {
+        frame[1] = (char)payloadLength;
+    }
+    else
+    {
+        frame[1] = 126;
+        frame[2] = (char)(payloadLength >> 8);
+        frame[3] = (char)payloadLength;
+        headerLength = 4;
+    }
+
+    memcpy(frame + headerLength, payload, payloadLength);
+    return headerLength + payloadLength;
+}
+
+
+/*
+* Function:     clientSend
+* Purpose:      Sends serialized messages to a chat client. For a WebSocket client, every JSON object
+*               in the data goes in its own text frame, all in a single tlsSend(); for any other client
+*               the data is sent as it is.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const void*     data            One or more serialized messages.
+*               size_t          length          Number of bytes.
+*               int             flags           Flags for tlsSend() - MSG_DONTWAIT sends all or nothing.
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         length once sent, or -1 on error.
+*/
+ssize_t clientSend(int clientSocket, const void* data, size_t length, int flags)
+{
+    if (!websocketIsClient(clientSocket))
+    {
+        return tlsSend(clientSocket, data, length, flags);
+    }
+
+    // Count the objects first - a batch can be long, so the framed copy is sized to fit
+    const char* json = data;
+    int numObjects = 0;
+    for (size_t offset = 0; offset < length; numObjects++)
+    {
+        int objectLength = jsonObjectLength(json + offset, length - offset);
+        offset += objectLength > 0 ? (size_t)objectLength : length - offset;
+    }
+
+    size_t framedSize = length + numObjects * WEBSOCKET_MAX_HEADER_LENGTH;
+    char* framed = memAlloc(MEM_OUTBOUND_BUFFERS, framedSize);
+    if (framed == NULL)
+    {
+        return -1;
+    }
+
+    size_t framedLength = 0;
+    for (size_t offset = 0; offset < length;)
+    {
+        int objectLength = jsonObjectLength(json + offset, length - offset);
+        size_t payloadLength = objectLength > 0 ? (size_t)objectLength : length - offset;
+
+        framedLength += websocketFrameText(json + offset, payloadLength, framed + framedLength);
+        offset += payloadLength;
+    }
+
+    ssize_t numBytesSent = tlsSend(clientSocket, framed, framedLength, flags);
+    memFree(MEM_OUTBOUND_BUFFERS, framed);
+
+    if (numBytesSent < 0)
+    {
+        return -1;
+    }
+
+    __atomic_add_fetch(&websocketStats.framesSent, numObjects, __ATOMIC_RELAXED);
+    return (ssize_t)length;
+}
+
+
+/*
+* Function:     websocketSendFrame
+* Purpose:      Sends an already framed message to a WebSocket client - for the chat broadcaster, which
+*               frames each broadcast once for all of them.
+*
+* Inputs:       int             clientSocket    The client's socket.
+*               const char*     frame           The frame, from websocketFrameText().
+*               size_t          frameLength     Length of the frame.
+*
+* Outputs:      None
+*
+* Returns:      ssize_t                         Number of bytes sent, or -1 on error.
+*/
+ssize_t websocketSendFrame(int clientSocket, const char* frame, size_t frameLength)
+{
+    WEBSOCKET_COUNT(framesSent);
+    return tlsSend(clientSocket, frame, frameLength, 0);
+}
+
+
+/*
+* Function:     websocketGateway
+* Purpose:      Gateway thread - accepts WebSocket connections and hands each one to a client handler.
+*
+* Inputs:       void*       arg         Unused.
+*
+* Outputs:      None
+*
+* Returns:      void*
+*/
+static void* websocketGateway(void* arg)
+{
+    (void)arg;
+
+    while (__atomic_load_n(&websocketIsRunning, __ATOMIC_ACQUIRE))
+    {
+        int clientSocket;
+        while ((clientSocket = accept(websocketSocket, NULL, NULL)) >= 0)
+        {
+            if (clientSocket >= WEBSOCKET_MAX_FDS)
+            {
+                close(clientSocket);
+                continue;
+            }
+
+            // Marked before the handler starts, so nothing is ever sent to it unframed
+            __atomic_store_n(&isWebSocketSocket[clientSocket], 1, __ATOMIC_RELEASE);
+            WEBSOCKET_COUNT(connectionsAccepted);
+
+            if (websocketAcceptHandler(clientSocket, websocketHandlerArg) != WEBSOCKET_SUCCESS)
+            {
+                websocketForget(clientSocket);
+                close(clientSocket);
+            }
+        }
+
+        usleep(WEBSOCKET_LOOP_SLEEP_LENGTH);
+    }
+
+    pthread_exit(NULL);
+}
+
+
+/*
+* Function:     websocketStart
+* Purpose:      Opens the WebSocket port and starts the gateway thread.
+*
+* Inputs:       uint16_t                websocketPort   Port web clients connect to.
+*               WebSocketAcceptHandler  acceptHandler   Starts a client handler for an accepted connection.
+*               void*                   handlerArg      Passed to acceptHandler.
+*
+* Outputs:      None
+*
+* Returns:      int                                     WEBSOCKET_SUCCESS, or WEBSOCKET_ERROR if the gateway is unavailable.
+*/
+int websocketStart(uint16_t websocketPort, WebSocketAcceptHandler acceptHandler, void* handlerArg)
+{
+    if ((websocketSocket = setupServerSocket(websocketPort)) == SOCKET_ERROR)
+    {
+        return WEBSOCKET_ERROR;
+    }
+    fcntl(websocketSocket, F_SETFL, fcntl(websocketSocket, F_GETFL, 0) | O_NONBLOCK);
+
+    websocketAcceptHandler = acceptHandler;
+    websocketHandlerArg = handlerArg;
+    __atomic_store_n(&websocketIsRunning, WEBSOCKET_RUNNING, __ATOMIC_RELEASE);
+
+    if (pthread_create(&websocketThread, NULL, websocketGateway, NULL) != 0)
+    {
+        perror("pthread_create");
+        __atomic_store_n(&websocketIsRunning, WEBSOCKET_STOPPED, __ATOMIC_RELEASE);
+        closeServerSocket(websocketSocket);
+        return WEBSOCKET_ERROR;
+    }
+
+    return WEBSOCKET_SUCCESS;
+}
+
+
+/*
+* Function:     websocketStop
+* Purpose:      Stops accepting WebSocket connections. Connected web clients are left to their handlers.
+*
+* Inputs:       None
+*
+* Outputs:      None
+*
+* Returns:      void
+*/
+void websocketStop()
+{
+    if (__atomic_load_n(&websocketIsRunning, __ATOMIC_ACQUIRE))
+    {
+        __atomic_store_n(&websocketIsRunning, WEBSOCKET_STOPPED, __ATOMIC_RELEASE);
+        pthread_join(websocketThread, NULL);
+        closeServerSocket(websocketSocket);
+    }
+}
+
+
+/*
+* Function:     websocketGetStats
+* Purpose:      Gets the WebSocket gateway counters.
+*
+* Inputs:       WebSocketStats*     statsP      Where to store the stats.
+*
+* Outputs:      statsP                          The stats.
+*
+* Returns:      void
+*/
+void websocketGetStats(WebSocketStats* statsP)
+{
+    statsP->connectionsAccepted = __atomic_load_n(&websocketStats.connectionsAccepted, __ATOMIC_RELAXED);
+    statsP->handshakesFailed = __atomic_load_n(&websocketStats.handshakesFailed, __ATOMIC_RELAXED);
+    statsP->framesReceived = __atomic_load_n(&websocketStats.framesReceived, __ATOMIC_RELAXED);
+    statsP->framesSent = __atomic_load_n(&websocketStats.framesSent, __ATOMIC_RELAXED);
+    statsP->pingsAnswered = __atomic_load_n(&websocketStats.pingsAnswered, __ATOMIC_RELAXED);
+    statsP->closesReceived = __atomic_load_n(&websocketStats.closesReceived, __ATOMIC_RELAXED);
+    statsP->framesRejected = __atomic_load_n(&websocketStats.framesRejected, __ATOMIC_RELAXED);
+}
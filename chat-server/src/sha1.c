@@ -0,0 +1,135 @@
+/*
+* Filename:		sha1.c
+* Project:		CHAT-SYSTEM/chat-server
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This file contains source code for SHA-1 hashes (FIPS 180-4) used by the WebSocket handshake
+*               of the CHAT-SYSTEM server. SHA-1 is only used there because RFC 6455 requires it - it
+*               is not used for anything that needs to be collision resistant.
+*/
+
+#include <string.h>
+#include "../inc/sha1.h"
+
+#define SHA1_BLOCK_LENGTH 64
+#define SHA1_ROTATE_LEFT(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+
+/*
+* Function:     sha1Block
+* Purpose:      Mixes one 64-byte block into the hash state.
+*
+* Inputs:       uint32_t        state[5]        The hash state.
+*               const uint8_t*  block           The block.
+*
+* Outputs:      state
+*
+* Returns:      void
+*/
+static void sha1Block(uint32_t state[5], const uint8_t* block)
+{
+    uint32_t words[80];
+
+    for (int i = 0; i < 16; i++)
+    {
+        words[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+            (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++)
+    {
+        words[i] = SHA1_ROTATE_LEFT(words[i - 3] ^ words[i - 8] ^ words[i - 14] ^ words[i - 16], 1);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3], e = state[4];
+
+    for (int i = 0; i < 80; i++)
+    {
+        uint32_t f, k;
+        if (i < 20)
+        {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        }
+        else if (i < 40)
+        {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        }
+        else if (i < 60)
+        {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        }
+        else
+        {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        uint32_t temp = SHA1_ROTATE_LEFT(a, 5) + f + e + k + words[i];
+        e = d;
+        d = c;
+        c = SHA1_ROTATE_LEFT(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+}
+
+
+/*
+* Function:     sha1
+* Purpose:      Computes the SHA-1 digest of a buffer.
+*
+* Inputs:       const void*     data            Data to hash.
+*               size_t          length          Number of bytes.
+*               uint8_t         digest[]        Where to store the digest.
+*
+* Outputs:      digest                          The 20-byte digest.
+*
+* Returns:      void
+*/
+void sha1(const void* data, size_t length, uint8_t digest[SHA1_DIGEST_LENGTH])
+{
+    uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    const uint8_t* bytes = data;
+    size_t remaining = length;
+
+    while (remaining >= SHA1_BLOCK_LENGTH)
+    {
+        sha1Block(state, bytes);
+        bytes += SHA1_BLOCK_LENGTH;
+        remaining -= SHA1_BLOCK_LENGTH;
+    }
+
+    // Last block(s): the rest of the data, a 1 bit, zeros and the length in bits
+    uint8_t tail[SHA1_BLOCK_LENGTH * 2];
+    memset(tail, 0, sizeof(tail));
+    memcpy(tail, bytes, remaining);
+    tail[remaining] = 0x80;
+
+    size_t tailLength = remaining + 1 + 8 <= SHA1_BLOCK_LENGTH ? SHA1_BLOCK_LENGTH : SHA1_BLOCK_LENGTH * 2;
+    uint64_t lengthInBits = (uint64_t)length * 8;
+    for (int i = 0; i < 8; i++)
+    {
+        tail[tailLength - 1 - i] = (uint8_t)(lengthInBits >> (i * 8));
+    }
+
+    for (size_t offset = 0; offset < tailLength; offset += SHA1_BLOCK_LENGTH)
+    {
+        sha1Block(state, tail + offset);
+    }
+
+    for (int i = 0; i < 5; i++)
+    {
+        digest[i * 4] = (uint8_t)(state[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(state[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(state[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)state[i];
+    }
+}
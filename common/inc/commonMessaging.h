@@ -19,6 +19,7 @@
 #define CLIENT_MESSAGE_LENGTH 80 // Client to server message length maximum is 80 + 1 for null-terminator
 #define MAX_BROADCASTS_PER_MSG 2
 #define JSON_LENGTH 256
+#define CACHE_LINE_LENGTH 64 // State written by different threads is kept this far apart
 
 // Message structs
 typedef struct Broadcast
@@ -41,4 +42,7 @@ struct Broadcast* jsonToBroadcast(const char* json_str);
 char* clientMessageToJson(ClientMessage* msg);
 struct ClientMessage* jsonToClientMessage(const char* json_str);
 
+// Framing - several JSON objects may arrive in one read
+int jsonObjectLength(const char* buffer, int length);
+
 #endif // COMMONMESSAGING_H_INCLUDED
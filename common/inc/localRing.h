@@ -0,0 +1,68 @@
+/*
+* Filename:		localRing.h
+* Project:		CHAT-SYSTEM/common
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains the layout of the shared-memory broadcast ring and function prototypes
+*               for reading it, for same-host clients of the CHAT-SYSTEM system.
+*/
+
+#ifndef LOCALRING_H_INCLUDED
+#define LOCALRING_H_INCLUDED
+
+#include <stdint.h>
+
+#include "commonMessaging.h"
+
+#define LOCAL_RING_SOCKET_NAME "chat-system-ring"   // Abstract Unix socket the server hands the ring out on
+#define LOCAL_RING_MAGIC 0x474e5243                 // "CRNG"
+#define LOCAL_RING_VERSION 1
+#define LOCAL_RING_SLOTS 1024
+#define LOCAL_RING_CACHE_LINE 64
+
+#define LOCAL_RING_SUCCESS 0
+#define LOCAL_RING_ERROR -1
+#define LOCAL_RING_MESSAGE 1
+#define LOCAL_RING_EMPTY 0
+
+// Start of the ring. Only the server writes to it; clients map it read-only.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numSlots;
+    uint32_t slotSize;
+    uint32_t futexWord;     // Bumped after every broadcast - readers FUTEX_WAIT on it
+    uint32_t reserved;
+    uint64_t head;          // Number of broadcasts ever written
+} __attribute__((aligned(LOCAL_RING_CACHE_LINE))) LocalRingHeader;
+
+// One broadcast. sequence is the broadcast's position + 1 once it is written, 0 while it is being written.
+typedef struct
+{
+    uint64_t sequence;
+    Broadcast broadcast;
+} __attribute__((aligned(LOCAL_RING_CACHE_LINE))) LocalRingSlot;
+
+#define LOCAL_RING_LENGTH (sizeof(LocalRingHeader) + LOCAL_RING_SLOTS * sizeof(LocalRingSlot))
+
+// A client's read-only view of the ring
+typedef struct
+{
+    void* mapping;
+    const LocalRingHeader* header;
+    const LocalRingSlot* slots;
+    uint64_t nextSequence;  // Next broadcast to read
+} LocalRing;
+
+// Reading the ring
+int localRingOpen(LocalRing* ringP);
+int localRingRead(LocalRing* ringP, Broadcast* broadcastP, uint64_t* numLaggedP);
+void localRingWait(LocalRing* ringP, int timeoutMilliseconds);
+void localRingClose(LocalRing* ringP);
+
+// Futex wrappers, shared with the server's writer
+void localRingFutexWait(const uint32_t* futexWordP, uint32_t expected, int timeoutMilliseconds);
+void localRingFutexWake(uint32_t* futexWordP);
+
+#endif // LOCALRING_H_INCLUDED
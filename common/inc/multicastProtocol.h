@@ -0,0 +1,36 @@
+/*
+* Filename:		multicastProtocol.h
+* Project:		CHAT-SYSTEM/common
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This header file contains the packet layout of the multicast broadcast mode of the CHAT-SYSTEM system.
+*/
+
+#ifndef MULTICASTPROTOCOL_H_INCLUDED
+#define MULTICASTPROTOCOL_H_INCLUDED
+
+#include <stdint.h>
+
+#include "commonMessaging.h"
+
+#define MULTICAST_GROUP "239.255.42.99"     // Administratively scoped - stays on the site
+#define MULTICAST_PORT 30002
+#define MULTICAST_MAGIC 0x4d434843          // "CHCM"
+
+#define MULTICAST_MSG ">>multicast<<"       // Client asks for broadcasts by multicast; the reply is ">>multicast<< <sequence>"
+#define MULTICAST_NACK_MSG ">>nack<<"       // ">>nack<< <first sequence> <count>" - client is missing these
+#define MULTICAST_REPAIR_MSG ">>repair<<"   // ">>repair<< <count> <lost>" - followed by count broadcasts; lost ones are gone for good
+
+#define MULTICAST_KIND_BROADCAST 0
+#define MULTICAST_KIND_HEARTBEAT 1          // No broadcast - only tells idle clients the next sequence, to expose lost tail packets
+
+// One datagram. Integers are in network byte order.
+typedef struct
+{
+    uint32_t magic;
+    uint32_t kind;
+    uint64_t sequence;      // Broadcast's sequence, or for a heartbeat the sequence the next broadcast will have
+    Broadcast broadcast;
+} __attribute__((packed)) MulticastPacket;
+
+#endif // MULTICASTPROTOCOL_H_INCLUDED
@@ -123,4 +123,46 @@ struct ClientMessage* jsonToClientMessage(const char* json_str)
     }
     
     return msg;
-}
\ No newline at end of file
+}
+
+/*
+* Function:       jsonObjectLength
+* Purpose:        Find the end of the first complete JSON object in a buffer, so that a reader can
+*                 split a stream holding several serialized messages (or part of one) back into messages.
+*                 Braces inside string values are ignored.
+*
+* Inputs:         const char* buffer  Received data (not necessarily null-terminated).
+*                 int length          Number of bytes in buffer.
+*
+* Outputs:        None
+*
+* Returns:        int  Number of bytes up to and including the closing brace of the first object,
+*                      or 0 if the buffer does not yet hold a complete object.
+*/
+int jsonObjectLength(const char* buffer, int length)
+{
+    int depth = 0;
+    int inString = 0;
+
+    for (int i = 0; i < length; i++)
+    {
+        if (buffer[i] == '"')
+        {
+            inString = !inString;
+        }
+        else if (!inString && buffer[i] == '{')
+        {
+            depth++;
+        }
+        else if (!inString && buffer[i] == '}' && depth > 0)
+        {
+            depth--;
+            if (depth == 0)
+            {
+                return i + 1;
+            }
+        }
+    }
+
+    return 0;
+}
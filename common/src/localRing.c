@@ -0,0 +1,251 @@
+/*
+* Filename:		localRing.c
+* Project:		CHAT-SYSTEM/common
+* By:			Ekaterina (Kate) Stroganova
+* Date:			October 18, 2026
+* Description:  This C file contains implementations for reading the shared-memory broadcast ring of the
+*               CHAT-SYSTEM system.
+*
+*               A client on the same host as the server connects to the abstract Unix socket
+*               LOCAL_RING_SOCKET_NAME and is passed a memfd holding the ring, which it maps read-only.
+*               The server writes each broadcast into the ring once, however many clients read it.
+*               Reading costs no system calls while there is something to read; an idle reader
+*               sleeps on the header's futex word, which the server wakes once per broadcast.
+*
+*               Each slot works like a seqlock: a reader copies the broadcast and then checks the
+*               slot's sequence did not change while it was copying. A reader that falls more than
+*               LOCAL_RING_SLOTS behind skips the broadcasts that were overwritten.
+*/
+
+#include <unistd.h>
+#include <stddef.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <linux/futex.h>
+
+#include "../inc/localRing.h"
+
+/*
+* Function:       localRingFutexWait
+* Purpose:        Sleep until a futex word no longer holds an expected value, or a timeout passes.
+*                 The word lives in shared memory, so this is a process-shared futex.
+*
+* Inputs:         const uint32_t* futexWordP          The futex word.
+*                 uint32_t expected                   Value the word held when the caller looked.
+*                 int timeoutMilliseconds             Longest time to sleep.
+*
+* Outputs:        None
+*
+* Returns:        void
+*/
+void localRingFutexWait(const uint32_t* futexWordP, uint32_t expected, int timeoutMilliseconds)
+{
+    struct timespec timeout = {.tv_sec = timeoutMilliseconds / 1000, .tv_nsec = (timeoutMilliseconds % 1000) * 1000000L};
+    syscall(SYS_futex, futexWordP, FUTEX_WAIT, expected, &timeout, NULL, 0);
+}
+
+/*
+* Function:       localRingFutexWake
+* Purpose:        Wake everyone sleeping on a futex word.
+*
+* Inputs:         uint32_t* futexWordP                The futex word.
+*
+* Outputs:        None
+*
+* Returns:        void
+*/
+void localRingFutexWake(uint32_t* futexWordP)
+{
+    syscall(SYS_futex, futexWordP, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+/*
+* Function:       receiveRingFd
+* Purpose:        Connect to the server's ring socket and receive the ring's file descriptor.
+*
+* Inputs:         None
+*
+* Outputs:        None
+*
+* Returns:        int  The ring's file descriptor, or LOCAL_RING_ERROR.
+*/
+static int receiveRingFd()
+{
+    int ringSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ringSocket < 0)
+    {
+        return LOCAL_RING_ERROR;
+    }
+
+    // Abstract socket name - starts with a null byte, nothing on disk
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path + 1, LOCAL_RING_SOCKET_NAME, sizeof(address.sun_path) - 2);
+    socklen_t addressLength = offsetof(struct sockaddr_un, sun_path) + 1 + strlen(LOCAL_RING_SOCKET_NAME);
+
+    if (connect(ringSocket, (struct sockaddr*)&address, addressLength) < 0)
+    {
+        close(ringSocket);
+        return LOCAL_RING_ERROR;
+    }
+
+    char data;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {.iov_base = &data, .iov_len = 1};
+    struct msghdr message = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control)};
+
+    int ringFd = LOCAL_RING_ERROR;
+    if (recvmsg(ringSocket, &message, MSG_CMSG_CLOEXEC) > 0)
+    {
+        struct cmsghdr* controlMessage = CMSG_FIRSTHDR(&message);
+        if (controlMessage != NULL && controlMessage->cmsg_level == SOL_SOCKET && controlMessage->cmsg_type == SCM_RIGHTS)
+        {
+            memcpy(&ringFd, CMSG_DATA(controlMessage), sizeof(int));
+        }
+    }
+
+    close(ringSocket);
+    return ringFd;
+}
+
+/*
+* Function:       localRingOpen
+* Purpose:        Get the ring from a server on this host and map it read-only. Reading starts at the
+*                 newest broadcast; set ringP->nextSequence to start elsewhere.
+*
+* Inputs:         LocalRing* ringP    Where to store the ring.
+*
+* Outputs:        ringP               The mapped ring.
+*
+* Returns:        int  LOCAL_RING_SUCCESS, or LOCAL_RING_ERROR if no ring is available.
+*/
+int localRingOpen(LocalRing* ringP)
+{
+    memset(ringP, 0, sizeof(LocalRing));
+
+    int ringFd = receiveRingFd();
+    if (ringFd < 0)
+    {
+        return LOCAL_RING_ERROR;
+    }
+
+    void* mapping = mmap(NULL, LOCAL_RING_LENGTH, PROT_READ, MAP_SHARED, ringFd, 0);
+    close(ringFd);
+    if (mapping == MAP_FAILED)
+    {
+        return LOCAL_RING_ERROR;
+    }
+
+    const LocalRingHeader* header = mapping;
+    if (header->magic != LOCAL_RING_MAGIC || header->version != LOCAL_RING_VERSION ||
+        header->numSlots != LOCAL_RING_SLOTS || header->slotSize != sizeof(LocalRingSlot))
+    {
+        munmap(mapping, LOCAL_RING_LENGTH);
+        return LOCAL_RING_ERROR;
+    }
+
+    ringP->mapping = mapping;
+    ringP->header = header;
+    ringP->slots = (const LocalRingSlot*)((const char*)mapping + sizeof(LocalRingHeader));
+    ringP->nextSequence = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+
+    return LOCAL_RING_SUCCESS;
+}
+
+/*
+* Function:       localRingRead
+* Purpose:        Read the next broadcast from the ring, without any system call.
+*
+* Inputs:         LocalRing* ringP            The ring.
+*                 Broadcast* broadcastP       Where to store the broadcast.
+*                 uint64_t* numLaggedP        Where to store how many broadcasts were skipped because
+*                                             they were overwritten before this reader got to them.
+*
+* Outputs:        broadcastP, numLaggedP
+*
+* Returns:        int  LOCAL_RING_MESSAGE if a broadcast was read, LOCAL_RING_EMPTY if there is none yet.
+*/
+int localRingRead(LocalRing* ringP, Broadcast* broadcastP, uint64_t* numLaggedP)
+{
+    *numLaggedP = 0;
+
+    while (1)
+    {
+        uint64_t head = __atomic_load_n(&ringP->header->head, __ATOMIC_ACQUIRE);
+        if (ringP->nextSequence >= head)
+        {
+            return LOCAL_RING_EMPTY;
+        }
+
+        // Too far behind - the oldest ones are gone
+        if (head - ringP->nextSequence > LOCAL_RING_SLOTS)
+        {
+            *numLaggedP += head - LOCAL_RING_SLOTS - ringP->nextSequence;
+            ringP->nextSequence = head - LOCAL_RING_SLOTS;
+        }
+
+        const LocalRingSlot* slot = &ringP->slots[ringP->nextSequence % LOCAL_RING_SLOTS];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+
+        memcpy(broadcastP, &slot->broadcast, sizeof(Broadcast));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (sequence == ringP->nextSequence + 1 && __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence)
+        {
+            ringP->nextSequence++;
+            return LOCAL_RING_MESSAGE;
+        }
+
+        // Overwritten while copying - skip it
+        ringP->nextSequence++;
+        (*numLaggedP)++;
+    }
+}
+
+/*
+* Function:       localRingWait
+* Purpose:        Sleep until the server writes a broadcast this reader has not read, or a timeout passes.
+*
+* Inputs:         LocalRing* ringP            The ring.
+*                 int timeoutMilliseconds     Longest time to sleep.
+*
+* Outputs:        None
+*
+* Returns:        void
+*/
+void localRingWait(LocalRing* ringP, int timeoutMilliseconds)
+{
+    uint32_t futexWord = __atomic_load_n(&ringP->header->futexWord, __ATOMIC_ACQUIRE);
+
+    // Check after reading the word, so a broadcast written in between is not slept through
+    if (__atomic_load_n(&ringP->header->head, __ATOMIC_ACQUIRE) > ringP->nextSequence)
+    {
+        return;
+    }
+
+    localRingFutexWait(&ringP->header->futexWord, futexWord, timeoutMilliseconds);
+}
+
+/*
+* Function:       localRingClose
+* Purpose:        Unmap the ring.
+*
+* Inputs:         LocalRing* ringP    The ring.
+*
+* Outputs:        None
+*
+* Returns:        void
+*/
+void localRingClose(LocalRing* ringP)
+{
+    if (ringP->mapping != NULL)
+    {
+        munmap(ringP->mapping, LOCAL_RING_LENGTH);
+        ringP->mapping = NULL;
+    }
+}